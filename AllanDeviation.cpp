@@ -0,0 +1,222 @@
+#include "AllanDeviation.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+
+#include "util.h"
+
+AllanDeviation::AllanDeviation(int64_t const nominal_ticks_per_second):
+    _nominal(nominal_ticks_per_second)
+{
+    reset();
+}
+
+void AllanDeviation::reset()
+{
+    _levels = {};
+    _seconds = 0;
+    restart();
+}
+
+void AllanDeviation::restart()
+{
+    for (Level & level : _levels)
+    {
+        level.x_n = 0;
+        level.s_n = 0;
+        level.has_half = false;
+    }
+    _x = 0;
+    _started = false;
+}
+
+void AllanDeviation::add_second(int64_t const ticks)
+{
+    if (!_started)
+    {
+        _add_block(0, _x, _x);
+        _started = true;
+    }
+    _x += ticks - _nominal;
+    _add_block(0, _x, _x);
+    ++_seconds;
+}
+
+// A block of 2^level phases has ended. x is the first of them and s their sum.
+void AllanDeviation::_add_block(size_t const index, int64_t const x, int64_t const s)
+{
+    Level & level = _levels[index];
+
+    if (level.x_n == 2)
+    {
+        double const d = x - 2 * level.x[1] + level.x[0];
+        level.adev_sum += d * d;
+        ++level.adev_n;
+    }
+    if (level.s_n == 2)
+    {
+        double const d = s - 2 * level.s[1] + level.s[0];
+        level.mdev_sum += d * d;
+        ++level.mdev_n;
+    }
+    level.x[0] = level.x[1];
+    level.x[1] = x;
+    level.x_n = std::min(level.x_n + 1, 2);
+    level.s[0] = level.s[1];
+    level.s[1] = s;
+    level.s_n = std::min(level.s_n + 1, 2);
+
+    if (index + 1 == levels)
+    {
+        return;
+    }
+    if (level.has_half)
+    {
+        level.has_half = false;
+        _add_block(index + 1, level.half_x, level.half_s + s);
+    }
+    else
+    {
+        level.half_x = x;
+        level.half_s = s;
+        level.has_half = true;
+    }
+}
+
+double AllanDeviation::adev(size_t const index) const
+{
+    Level const & level = _levels[index];
+    if (level.adev_n == 0)
+    {
+        return 0;
+    }
+    double const m = tau_s(index);
+    return std::sqrt(level.adev_sum / (2.0 * level.adev_n)) / (m * _nominal);
+}
+
+double AllanDeviation::mdev(size_t const index) const
+{
+    Level const & level = _levels[index];
+    if (level.mdev_n == 0)
+    {
+        return 0;
+    }
+    double const m = tau_s(index);
+    return std::sqrt(level.mdev_sum / (2.0 * level.mdev_n)) / (m * m * _nominal);
+}
+
+void AllanDeviation::print() const
+{
+    printf("Stability over %" PRIu64 " s:\n", _seconds);
+    printf("   tau s        n       ADEV       MDEV\n");
+    for (size_t i = 0; i < levels && count(i) > 0; ++i)
+    {
+        printf("%8" PRIu32 " %8" PRIu32 " %10.3e %10.3e\n", tau_s(i), count(i), adev(i), mdev(i));
+    }
+}
+
+namespace
+{
+    // Close enough to normal for this, and the same everywhere.
+    class Noise
+    {
+    public:
+        double next()
+        {
+            double sum = 0;
+            for (int i = 0; i < 12; ++i)
+            {
+                _lcg = _lcg * 1664525 + 1013904223;
+                sum += (_lcg >> 8) / double(1 << 24);
+            }
+            return sum - 6;
+        }
+
+    private:
+        uint32_t _lcg = 12345;
+    };
+
+    bool near(double const value, double const expected, double const tolerance)
+    {
+        return std::abs(value / expected - 1) < tolerance;
+    }
+}
+
+bool allan_deviation_test()
+{
+    int64_t constexpr nominal = 1000000;
+
+    // A steady offset has no instability at all.
+    {
+        AllanDeviation allan(nominal);
+        for (int i = 0; i < 1000; ++i)
+        {
+            allan.add_second(nominal + 37);
+        }
+        test_assert(allan.seconds() == 1000);
+        test_assert(allan.count(0) == 999);
+        test_assert(allan.count(3) == 1000 / 8 - 2);
+        test_assert(allan.count(9) == 0);
+        for (size_t i = 0; i < 9; ++i)
+        {
+            test_assert(allan.adev(i) == 0 && allan.mdev(i) == 0);
+        }
+    }
+
+    // White frequency noise: ADEV falls as 1/sqrt(tau), and MDEV is 1/sqrt(2) of it.
+    {
+        double constexpr sigma = 100;
+        AllanDeviation allan(nominal);
+        Noise noise;
+        for (int i = 0; i < 20000; ++i)
+        {
+            allan.add_second(nominal + std::lround(sigma * noise.next()));
+        }
+        for (size_t i = 0; i <= 6; ++i)
+        {
+            double const expected = sigma / nominal / std::sqrt(AllanDeviation::tau_s(i));
+            test_assert(near(allan.adev(i), expected, 0.2));
+        }
+        for (size_t i = 3; i <= 6; ++i)
+        {
+            test_assert(near(allan.mdev(i) / allan.adev(i), 1 / std::sqrt(2.0), 0.25));
+        }
+    }
+
+    // White phase noise: ADEV falls as 1/tau, and MDEV as tau^-3/2.
+    {
+        AllanDeviation allan(nominal);
+        Noise noise;
+        double prev_x = 0;
+        for (int i = 0; i < 20000; ++i)
+        {
+            double const x = std::round(100 * noise.next());
+            allan.add_second(nominal + x - prev_x);
+            prev_x = x;
+        }
+        test_assert(near(allan.adev(2) / allan.adev(5), 8, 0.25));
+        test_assert(near(allan.mdev(2) / allan.mdev(5), 8 * std::sqrt(8.0), 0.3));
+    }
+
+    // A gap in the seconds doesn't make a jump in phase, and what came before is kept.
+    {
+        AllanDeviation allan(nominal);
+        for (int i = 0; i < 100; ++i)
+        {
+            allan.add_second(nominal + 5);
+        }
+        allan.restart();
+        for (int i = 0; i < 100; ++i)
+        {
+            allan.add_second(nominal - 5);
+        }
+        test_assert(allan.count(0) == 2 * 99);
+        test_assert(allan.adev(0) == 0 && allan.adev(4) == 0);
+        allan.reset();
+        test_assert(allan.seconds() == 0 && allan.count(0) == 0);
+    }
+
+    return true;
+}
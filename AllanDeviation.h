@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+bool allan_deviation_test();
+
+/*
+ * Allan and modified Allan deviation of an oscillator, at taus of 1, 2, 4, ... seconds, kept up
+ * to date one second at a time.
+ *
+ * Each second comes in as the length of that second in ticks of the oscillator, and the phase
+ * is their running sum less nominal ticks a second. Level k works with the phase every 2^k
+ * seconds, and with sums of 2^k phases in consecutive blocks, each built from two blocks of the
+ * level below, so a second costs a constant amount of work and memory is fixed. The second
+ * differences are of consecutive samples at each level, not of every one second apart, so the
+ * longer taus have fewer estimates in them than a fully overlapping estimator would have.
+ *
+ * Phase is kept in whole ticks, so a steady frequency offset drops out exactly.
+ */
+class AllanDeviation
+{
+public:
+    static size_t constexpr levels = 14;
+
+    explicit AllanDeviation(int64_t nominal_ticks_per_second);
+
+    void add_second(int64_t ticks);
+
+    // The seconds before and after this one weren't consecutive. What's been seen so far is kept.
+    void restart();
+
+    // Clears everything.
+    void reset();
+
+    static uint32_t tau_s(size_t level) { return uint32_t(1) << level; }
+
+    // The number of second differences that went into each deviation at a level.
+    uint32_t count(size_t level) const { return _levels[level].adev_n; }
+    double adev(size_t level) const;
+    double mdev(size_t level) const;
+
+    uint64_t seconds() const { return _seconds; }
+
+    // A table of the levels with anything in them, over USB.
+    void print() const;
+
+private:
+    struct Level
+    {
+        // The last two phases at this level's spacing, and how many of them there are.
+        int64_t x[2];
+        uint8_t x_n;
+        // The last two block sums, likewise.
+        int64_t s[2];
+        uint8_t s_n;
+        // The first of a pair of blocks on its way to the level above.
+        int64_t half_x;
+        int64_t half_s;
+        bool has_half;
+
+        double adev_sum;
+        uint32_t adev_n;
+        double mdev_sum;
+        uint32_t mdev_n;
+    };
+
+    int64_t const _nominal;
+    int64_t _x = 0;
+    bool _started = false;
+    uint64_t _seconds = 0;
+    std::array<Level, levels> _levels;
+
+    void _add_block(size_t level, int64_t x, int64_t s);
+};
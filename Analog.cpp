@@ -317,7 +317,9 @@ bool Analog::unit_test()
 {
 #ifdef HOST_BUILD
     {
-        Pps pps(0, 0);
+        IdlePpsSource source;
+        Pps pps(source);
+        pps.set_quiet(true);
         Analog analog(pps, 0, 0, 0, 0, 0);
 
         analog._hour_hand.ticks_since_top = 231107;
@@ -338,7 +340,9 @@ bool Analog::unit_test()
     }
 
     {
-        Pps pps(0, 0);
+        IdlePpsSource source;
+        Pps pps(source);
+        pps.set_quiet(true);
         Analog analog(pps, 0, 0, 0, 0, 0);
 
         analog._hour_hand.ticks_since_top =    11;
@@ -362,7 +366,7 @@ bool Analog::unit_test()
     return true;
 }
 
-void Analog::AnalogTimePrinter::print(size_t line, uint8_t /*tenths*/)
+void Analog::AnalogTimePrinter::print(size_t line, TopOfSecond const & /*top*/, uint8_t /*tenths*/)
 {
     Time t;
     _get_analog_time(t);
@@ -45,7 +45,7 @@ public:
         {
         }
 
-        void print(size_t line, uint8_t tenths) override;
+        void print(size_t line, TopOfSecond const & top, uint8_t tenths) override;
     private:
         Display & _disp;
         std::function<void(Time&)> _get_analog_time;
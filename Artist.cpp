@@ -67,40 +67,59 @@ Artist::Artist(Display & display,
     digital_display->add_item(move(contents));
     digital_display->add_item(move(brightness));
 
+    auto time_code_standard = make_unique<Radiobutton<TimeCodeStandard const>>("Standard");
+    for (auto const * standard : time_code_standards())
+    {
+        // The tables themselves, not copies: Wwvb tells a change of standard by its address.
+        time_code_standard->add_item(standard->name, shared_ptr<TimeCodeStandard const>(standard, [](auto const *) {}));
+    }
+    _time_code_standard = time_code_standard.get();
+
+    auto wwvb_emitter = make_unique<Menu>("WWVB Emitter");
+    wwvb_emitter->add_item(move(time_code_standard));
+
+    auto usb_output = make_unique<Radiobutton<UsbOutputMode>>("USB Output");
+    usb_output->add_item("Debug Text", make_shared<UsbOutputMode>(UsbOutputMode::DebugText));
+    usb_output->add_item("Refclock", make_shared<UsbOutputMode>(UsbOutputMode::Refclock));
+    usb_output->add_item("Stability", make_shared<UsbOutputMode>(UsbOutputMode::Stability));
+    _usb_output = usb_output.get();
+
     auto menu = make_unique<Menu>("Menu");
     menu->add_item(move(digital_display));
     menu->add_item(make_unique<Menu>("Analog Clock Face"));
-    menu->add_item(make_unique<Menu>("WWVB Emitter"));
+    menu->add_item(move(wwvb_emitter));
     menu->add_item(make_unique<Menu>("Navigation"));
+    menu->add_item(move(usb_output));
     menu->add_item(make_unique<Menu>("Test Features"));
 
     _menu = move(menu);
 }
 
-void Artist::top_of_tenth_of_second(uint8_t tenths)
+void Artist::tenth_of_second_ahead(uint8_t tenths, bool next_second, uint64_t tenth_us)
 {
     if (_menu_depth == 0)
     {
-        _show_main_display(tenths);
+        _show_main_display(next_second ? _gps.tops_of_seconds().next() : _gps.tops_of_seconds().prev(), tenths);
+        _disp.commit(tenth_us);
     }
 }
 
-void Artist::_show_main_display(uint8_t tenths)
+void Artist::_show_main_display(TopOfSecond const & top, uint8_t tenths)
 {
     for (size_t line = 0; line < _main_display_contents.size(); ++line)
     {
-        _main_display_contents[line]().print(line, tenths);
+        _main_display_contents[line]().print(line, top, tenths);
     }
 }
 
-void TimePrinter::print(size_t line, uint8_t tenths)
+void TimePrinter::print(size_t line, TopOfSecond const & top, uint8_t tenths)
 {
     Ymdhms ymdhms;
 
     bool print_result;
-    if (_time_rep->make_ymdhms(_gps.tops_of_seconds().prev(), ymdhms))
+    if (_time_rep->make_ymdhms(top, ymdhms))
     {
-        string abbrev = _time_rep->abbrev(_gps.tops_of_seconds().prev().utc_ymdhms);
+        string abbrev = _time_rep->abbrev(top.utc_ymdhms);
         print_result = _disp.printf(
             line,
             "%-4s%04d.%02d.%02d %02d.%02d.%02d.%d",
@@ -148,7 +167,7 @@ Menuverable * Menuverable::leaf_to_display(size_t depth)
     return next->leaf_to_display(depth - 1);
 }
 
-void Artist::button_pressed(Button button)
+void Artist::button_pressed(Button button, uint64_t now_us)
 {
     if (_menu_depth == 0)
     {
@@ -186,6 +205,7 @@ void Artist::button_pressed(Button button)
     if (_menu_depth != 0)
     {
         _show_menu();
+        _disp.commit(now_us);
     }
 }
 
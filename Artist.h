@@ -11,6 +11,7 @@
 #include "Display.h"
 #include "Buttons.h"
 #include "GpsUBlox.h"
+#include "TimeCode.h"
 
 class Menuverable
 {
@@ -103,7 +104,8 @@ private:
 class LinePrinter
 {
 public:
-    virtual void print(size_t line, uint8_t tenths) = 0;
+    // Draws the given tenth of the second whose top is given.
+    virtual void print(size_t line, TopOfSecond const & top, uint8_t tenths) = 0;
 };
 
 class TimePrinter: public LinePrinter
@@ -118,13 +120,19 @@ public:
     {
     }
 
-    void print(size_t line, uint8_t tenths) override;
+    void print(size_t line, TopOfSecond const & top, uint8_t tenths) override;
 private:
     Display & _disp;
     GpsUBlox & _gps;
     std::shared_ptr<TimeRepresentation> _time_rep;
 };
 
+enum class UsbOutputMode {
+    DebugText,
+    Refclock,
+    Stability
+};
+
 class Artist
 {
 public:
@@ -133,19 +141,27 @@ public:
            GpsUBlox & gps,
            std::vector<std::tuple<std::string, std::shared_ptr<LinePrinter>>> const & extra_line_options);
 
-    void top_of_tenth_of_second(uint8_t tenths);
-    void button_pressed(Button button);
+    // Each draws a whole frame, if there's anything new to show, and commits it to go out at
+    // the given time. The main display is drawn during the tenth before the one it shows, so
+    // that it's waiting to go out at the top of its tenth; tenth 0 is drawn from the top of the
+    // next second. The menus go out straight away.
+    void tenth_of_second_ahead(uint8_t tenths, bool next_second, uint64_t tenth_us);
+    void button_pressed(Button button, uint64_t now_us);
 
     uint32_t error_count() const { return _error_count; }
 
     uint8_t get_brightness() const { return _brightness->selected() - 1; }
 
+    UsbOutputMode get_usb_output_mode() { return _usb_output->get(); }
+
+    TimeCodeStandard const & get_time_code_standard() { return _time_code_standard->get(); }
+
 private:
     Display & _disp;
     Buttons & _buttons;
     GpsUBlox & _gps;
 
-    void _show_main_display(uint8_t tenths);
+    void _show_main_display(TopOfSecond const & top, uint8_t tenths);
 
     std::array<std::function<LinePrinter&()>, Display::num_lines> _main_display_contents;
 
@@ -157,6 +173,8 @@ private:
     void _show_menu();
 
     IntSelector * _brightness;
+    Radiobutton<UsbOutputMode> * _usb_output;
+    Radiobutton<TimeCodeStandard const> * _time_code_standard;
 
     uint32_t _error_count = 0;
 };
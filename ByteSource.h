@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#ifdef HOST_BUILD
+  #include <cstdio>
+#endif
+
+#include "RingBuffer.h"
+
+// The receiving side of a serial link, so a parser can be fed from hardware, a file, or a test.
+class ByteSource
+{
+public:
+    // Up to max_n of the bytes that have arrived, without waiting for more. Returns how many.
+    virtual size_t read(uint8_t * data, size_t max_n) = 0;
+};
+
+// Moves what bytes have arrived into buffer, as far as it has room. Returns how many.
+template <size_t buffer_len>
+size_t fill_from(ByteSource & source, RingBuffer<uint8_t, buffer_len> & buffer)
+{
+    size_t total = 0;
+    while (!buffer.full())
+    {
+        uint8_t chunk[64];
+        size_t const room = buffer_len - buffer.count();
+        size_t const n = source.read(chunk, room < sizeof(chunk) ? room : sizeof(chunk));
+        for (size_t i = 0; i < n; ++i)
+        {
+            buffer.push(chunk[i]);
+        }
+        total += n;
+        if (n == 0)
+        {
+            break;
+        }
+    }
+    return total;
+}
+
+// Bytes from memory.
+class SpanByteSource: public ByteSource
+{
+public:
+    SpanByteSource(uint8_t const * const data, size_t const len): _data(data), _len(len) {}
+
+    size_t read(uint8_t * const data, size_t const max_n) override
+    {
+        size_t n = 0;
+        while (n < max_n && _pos < _len)
+        {
+            data[n++] = _data[_pos++];
+        }
+        return n;
+    }
+
+private:
+    uint8_t const * const _data;
+    size_t const _len;
+    size_t _pos = 0;
+};
+
+#ifdef HOST_BUILD
+// Bytes from a file, or a pipe or socket opened as one.
+class FileByteSource: public ByteSource
+{
+public:
+    FileByteSource(FILE * const file): _file(file) {}
+
+    size_t read(uint8_t * const data, size_t const max_n) override
+    {
+        return fread(data, 1, max_n, _file);
+    }
+
+private:
+    FILE * const _file;
+};
+#endif
@@ -0,0 +1,218 @@
+#include "Capture.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+CaptureWriter::CaptureWriter(std::function<void(char const * line)> write_line,
+                             std::function<uint32_t()> us_since_edge):
+    _write_line(write_line),
+    _us_since_edge(us_since_edge)
+{
+}
+
+void CaptureWriter::flush()
+{
+    char line[16];
+    if (_pending_edges == 1)
+    {
+        _write_line("@E");
+    }
+    else if (_pending_edges > 1)
+    {
+        snprintf(line, sizeof(line), "@I %" PRIu32, _pending_edges);
+        _write_line(line);
+    }
+    _pending_edges = 0;
+}
+
+void CaptureWriter::edge(bool const locked)
+{
+    if (locked != _locked)
+    {
+        flush();
+        _write_line(locked ? "@L 1" : "@L 0");
+        _locked = locked;
+    }
+    ++_pending_edges;
+}
+
+void CaptureWriter::bytes(uint8_t const * const data, size_t const len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    flush();
+
+    uint32_t const us = _us_since_edge();
+    for (size_t start = 0; start < len; start += CaptureRecord::max_bytes)
+    {
+        char line[16 + 2 * CaptureRecord::max_bytes];
+        int pos = snprintf(line, sizeof(line), "@B %" PRIu32 " ", us);
+        size_t const end = std::min(len, start + CaptureRecord::max_bytes);
+        for (size_t i = start; i < end; ++i)
+        {
+            pos += snprintf(line + pos, sizeof(line) - pos, "%02x", data[i]);
+        }
+        _write_line(line);
+    }
+}
+
+namespace
+{
+    int hex_digit(char const c)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f')
+        {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F')
+        {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    // A decimal number followed by a space or the end of the line.
+    bool parse_number(char const * & p, uint32_t & value)
+    {
+        char * end;
+        unsigned long const x = strtoul(p, &end, 10);
+        if (end == p || (*end != ' ' && *end != '\0' && *end != '\r' && *end != '\n'))
+        {
+            return false;
+        }
+        value = x;
+        p = end;
+        return true;
+    }
+
+    bool at_end(char const * p)
+    {
+        return *p == '\0' || *p == '\r' || *p == '\n';
+    }
+}
+
+bool capture_parse_line(char const * line, CaptureRecord & record)
+{
+    if (line[0] != '@' || line[1] == '\0')
+    {
+        return false;
+    }
+    char const kind = line[1];
+    char const * p = line + 2;
+
+    if (kind == 'E')
+    {
+        record.type = CaptureRecord::Type::edges;
+        record.value = 1;
+        return at_end(p);
+    }
+
+    if (*p++ != ' ')
+    {
+        return false;
+    }
+
+    if (kind == 'L' || kind == 'I')
+    {
+        record.type = kind == 'L' ? CaptureRecord::Type::lock : CaptureRecord::Type::edges;
+        return parse_number(p, record.value) && at_end(p);
+    }
+
+    if (kind == 'B')
+    {
+        record.type = CaptureRecord::Type::bytes;
+        if (!parse_number(p, record.value) || *p++ != ' ')
+        {
+            return false;
+        }
+        record.len = 0;
+        while (!at_end(p))
+        {
+            int const hi = hex_digit(p[0]);
+            int const lo = hi < 0 ? -1 : hex_digit(p[1]);
+            if (lo < 0 || record.len == CaptureRecord::max_bytes)
+            {
+                return false;
+            }
+            record.data[record.len++] = (hi << 4) | lo;
+            p += 2;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool capture_test()
+{
+    std::vector<std::string> lines;
+    uint32_t us = 0;
+    CaptureWriter writer([&](char const * line) { lines.push_back(line); }, [&]() { return us; });
+
+    // Idle edges are run together, and long reads split over several lines.
+    writer.edge(false);
+    writer.edge(true);
+    writer.edge(true);
+    writer.edge(true);
+    us = 123456;
+    uint8_t data[40];
+    for (size_t i = 0; i < sizeof(data); ++i)
+    {
+        data[i] = 0xb5 + i;
+    }
+    writer.bytes(data, sizeof(data));
+    writer.bytes(data, 0);
+    writer.edge(true);
+    writer.edge(false);
+    writer.flush();
+
+    test_assert(lines.size() == 8);
+    test_assert(lines[0] == "@E");
+    test_assert(lines[1] == "@L 1");
+    test_assert(lines[2] == "@I 3");
+    test_assert(lines[3].substr(0, 14) == "@B 123456 b5b6");
+    test_assert(lines[5] == "@E");
+    test_assert(lines[6] == "@L 0");
+    test_assert(lines[7] == "@E");
+
+    CaptureRecord record;
+    test_assert(capture_parse_line(lines[0].c_str(), record));
+    test_assert(record.type == CaptureRecord::Type::edges && record.value == 1);
+    test_assert(capture_parse_line(lines[1].c_str(), record));
+    test_assert(record.type == CaptureRecord::Type::lock && record.value == 1);
+    test_assert(capture_parse_line(lines[2].c_str(), record));
+    test_assert(record.type == CaptureRecord::Type::edges && record.value == 3);
+
+    test_assert(capture_parse_line(lines[3].c_str(), record));
+    test_assert(record.type == CaptureRecord::Type::bytes && record.value == 123456);
+    test_assert(record.len == CaptureRecord::max_bytes);
+    test_assert(std::equal(record.data, record.data + record.len, data));
+    test_assert(capture_parse_line((lines[4] + "\r\n").c_str(), record));
+    test_assert(record.len == sizeof(data) - CaptureRecord::max_bytes);
+    test_assert(std::equal(record.data, record.data + record.len, data + CaptureRecord::max_bytes));
+
+    // Everything else we print, and damaged lines.
+    test_assert(!capture_parse_line("PPS lock persistence: 3", record));
+    test_assert(!capture_parse_line("", record));
+    test_assert(!capture_parse_line("@", record));
+    test_assert(!capture_parse_line("@E 1", record));
+    test_assert(!capture_parse_line("@I", record));
+    test_assert(!capture_parse_line("@I x", record));
+    test_assert(!capture_parse_line("@B 12 b5f", record));
+    test_assert(!capture_parse_line("@B 12 b5zz", record));
+    test_assert(!capture_parse_line("@B12 b5", record));
+    test_assert(!capture_parse_line("@X 1", record));
+
+    return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "ByteSource.h"
+
+bool capture_test();
+
+/*
+ * Bytes from the GPS UART, with when they came relative to the PPS, as lines of text that can go
+ * out over USB among everything else we print, and be replayed on a host later (see
+ * CaptureReplay.h). Capture lines start with '@', and anything else is skipped on replay:
+ *
+ *   @L 1              The PPS is now locked (0 for unlocked). Applies to the edges after it.
+ *   @E                A PPS edge.
+ *   @I 37             37 edges in a row with no bytes between them.
+ *   @B 123456 b56201  Bytes read 123456 us after the last edge, in hex.
+ */
+
+struct CaptureRecord
+{
+    static size_t constexpr max_bytes = 32;
+
+    enum class Type: uint8_t
+    {
+        lock,
+        edges,
+        bytes,
+    };
+
+    Type type;
+    // Lock: 1 if locked. Edges: how many. Bytes: microseconds after the last edge.
+    uint32_t value;
+    uint8_t data[max_bytes];
+    size_t len;
+};
+
+// False if the line isn't a well formed capture line.
+bool capture_parse_line(char const * line, CaptureRecord & record);
+
+class CaptureWriter
+{
+public:
+    // write_line gets each line without its newline.
+    CaptureWriter(std::function<void(char const * line)> write_line,
+                  std::function<uint32_t()> us_since_edge);
+
+    void edge(bool locked);
+    void bytes(uint8_t const * data, size_t len);
+
+    // Writes out any edges still being counted.
+    void flush();
+
+private:
+    std::function<void(char const *)> _write_line;
+    std::function<uint32_t()> _us_since_edge;
+    bool _locked = false;
+    uint32_t _pending_edges = 0;
+};
+
+// Reads through to another ByteSource, writing everything it reads to a capture.
+class CaptureByteSource: public ByteSource
+{
+public:
+    CaptureByteSource(ByteSource & source, CaptureWriter & writer):
+        _source(source), _writer(writer) {}
+
+    size_t read(uint8_t * const data, size_t const max_n) override
+    {
+        size_t const n = _source.read(data, max_n);
+        _writer.bytes(data, n);
+        return n;
+    }
+
+private:
+    ByteSource & _source;
+    CaptureWriter & _writer;
+};
@@ -0,0 +1,145 @@
+#include "CaptureReplay.h"
+
+#include <string>
+#include <vector>
+
+#include "packing.h"
+#include "util.h"
+
+CaptureReplay::CaptureReplay(std::function<void(uint32_t edge, TopOfSecond const & top)> on_edge):
+    _on_edge(on_edge),
+    _gps(_port, _source, false)
+{
+}
+
+size_t CaptureReplay::RecordSource::read(uint8_t * const data, size_t const max_n)
+{
+    size_t n = 0;
+    while (_record && n < max_n && _pos < _record->len)
+    {
+        data[n++] = _record->data[_pos++];
+    }
+    return n;
+}
+
+bool CaptureReplay::line(char const * const text)
+{
+    CaptureRecord record;
+    if (!capture_parse_line(text, record))
+    {
+        return false;
+    }
+
+    switch (record.type)
+    {
+    case CaptureRecord::Type::lock:
+        _locked = record.value != 0;
+        break;
+    case CaptureRecord::Type::edges:
+        for (uint32_t i = 0; i < record.value; ++i)
+        {
+            _gps.pps_lock_state(_locked);
+            _gps.pps_pulsed();
+            _on_edge(_edges, _gps.tops_of_seconds().prev());
+            ++_edges;
+        }
+        break;
+    case CaptureRecord::Type::bytes:
+        _source.set(&record);
+        _gps.dispatch(uint64_t(_edges) * 1000000 + record.value);
+        _source.set(nullptr);
+        _bytes += record.len;
+        break;
+    }
+    return true;
+}
+
+namespace
+{
+    // NAV-PVT and NAV-TIMELS as the receiver sends them shortly after the edge that began sec.
+    void receiver_second(CaptureWriter & writer, uint8_t const sec)
+    {
+        UbxNavPvt pvt{};
+        pvt.year = 2016;
+        pvt.month = 12;
+        pvt.day = 31;
+        pvt.hour = 23;
+        pvt.min = 59;
+        pvt.sec = sec;
+        pvt.valid = 0x07;
+        pvt.fixType = 3;
+        pvt.flags = 0x01;
+        uint8_t frame[UbxNavPvt::len + ubx_overhead_len];
+        size_t len = ubx_encode(pvt, frame);
+        // Split, as the receiver's bytes come in over several reads.
+        writer.bytes(frame, 40);
+        writer.bytes(frame + 40, len - 40);
+
+        UbxNavTimeLs time_ls{};
+        time_ls.currLs = 17;
+        time_ls.lsChange = 1;
+        time_ls.timeToLsEvent = 60 - sec;
+        time_ls.valid = 0x03;
+        len = ubx_encode(time_ls, frame);
+        writer.bytes(frame, len);
+    }
+}
+
+bool capture_replay_test()
+{
+    std::vector<std::string> lines;
+    uint32_t us = 0;
+    CaptureWriter writer([&](char const * line) { lines.push_back(line); }, [&]() { return us; });
+
+    // A few idle seconds unlocked, with some noise, then locked ones with the receiver talking.
+    writer.edge(false);
+    writer.edge(false);
+    us = 500000;
+    uint8_t const noise[] = {0x00, 0xff, 0x62, 0x24};
+    writer.bytes(noise, sizeof(noise));
+    for (uint8_t sec = 55; sec < 59; ++sec)
+    {
+        writer.edge(true);
+        us = 80000;
+        receiver_second(writer, sec);
+    }
+    writer.edge(true);
+    writer.flush();
+
+    std::vector<TopOfSecond> tops;
+    bool edges_in_order = true;
+    CaptureReplay replay([&](uint32_t edge, TopOfSecond const & top) {
+        edges_in_order = edges_in_order && edge == tops.size();
+        tops.push_back(top);
+    });
+    test_assert(!replay.line("GPS Message counts: 0 0 0"));
+    for (auto const & line : lines)
+    {
+        test_assert(replay.line(line.c_str()));
+    }
+
+    test_assert(edges_in_order);
+    test_assert(tops.size() == 7);
+    test_assert_unsigned_eq(replay.edges(), 7u);
+    test_assert(replay.bytes() == sizeof(noise) + 4 * (UbxNavPvt::len + UbxNavTimeLs::len + 2 * ubx_overhead_len));
+
+    // Nothing is known until the first locked second's messages.
+    for (size_t i = 0; i < 3; ++i)
+    {
+        test_assert(!tops[i].utc_ymdhms_valid);
+    }
+    for (size_t i = 3; i < tops.size(); ++i)
+    {
+        uint8_t const sec = 56 + (i - 3);
+        test_assert(tops[i].utc_ymdhms_valid);
+        test_assert(tops[i].utc_ymdhms.year == 2016 && tops[i].utc_ymdhms.hour == 23);
+        test_assert(tops[i].utc_ymdhms.sec == sec);
+        test_assert(tops[i].tai_ymdhms_valid);
+        test_assert(tops[i].next_leap_second_valid);
+    }
+
+    int32_t lat, lon;
+    test_assert(replay.gps().position(lat, lon));
+
+    return true;
+}
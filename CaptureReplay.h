@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+
+#include "Capture.h"
+#include "GpsUBlox.h"
+
+bool capture_replay_test();
+
+/*
+ * Plays a capture (see Capture.h) back through GpsUBlox, as though it were on the device,
+ * so what the clock made of a receiver's output can be looked at again on a host.
+ */
+class CaptureReplay
+{
+public:
+    // on_edge is called at each PPS edge with how many edges came before it, and the
+    // top of the second that edge began.
+    CaptureReplay(std::function<void(uint32_t edge, TopOfSecond const & top)> on_edge);
+
+    // Takes one line of the capture. False if it wasn't a capture line.
+    bool line(char const * text);
+
+    uint32_t edges() const { return _edges; }
+    uint64_t bytes() const { return _bytes; }
+    GpsUBlox const & gps() const { return _gps; }
+
+private:
+    // GpsUBlox doesn't configure anything on replay, so nothing is ever sent.
+    class NullPort: public SerialPort
+    {
+    public:
+        bool write(uint8_t const *, size_t) override { return true; }
+        bool idle() override { return true; }
+        void set_baud_rate(uint32_t) override {}
+    };
+
+    class RecordSource: public ByteSource
+    {
+    public:
+        void set(CaptureRecord const * record) { _record = record; _pos = 0; }
+
+        size_t read(uint8_t * data, size_t max_n) override;
+
+    private:
+        CaptureRecord const * _record = nullptr;
+        size_t _pos = 0;
+    };
+
+    std::function<void(uint32_t, TopOfSecond const &)> _on_edge;
+    NullPort _port;
+    RecordSource _source;
+    GpsUBlox _gps;
+
+    bool _locked = false;
+    uint32_t _edges = 0;
+    uint64_t _bytes = 0;
+};
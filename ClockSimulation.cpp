@@ -0,0 +1,239 @@
+#include "ClockSimulation.h"
+
+#include "util.h"
+
+namespace
+{
+    class MemoryPositionStore: public PositionStore
+    {
+    public:
+        bool load(SurveyedPosition & position) override
+        {
+            return valid && position.from_record(record);
+        }
+
+        bool save(SurveyedPosition const & position) override
+        {
+            position.to_record(record);
+            valid = true;
+            ++saves;
+            return true;
+        }
+
+        uint8_t record[SurveyedPosition::record_len];
+        bool valid = false;
+        uint32_t saves = 0;
+    };
+}
+
+ClockSimulation::ClockSimulation(UbxScenario const & scenario, PositionStore * const store):
+    _receiver(scenario),
+    _gps(_receiver, _receiver, true, store),
+    _pps(_pps_source)
+{
+    _pps.set_quiet(true);
+}
+
+void ClockSimulation::run(uint64_t const seconds)
+{
+    uint64_t const end_us = _now_us + seconds * 1000000;
+    while (_now_us < end_us)
+    {
+        uint64_t const step_us = _gps.initialized_successfully() ? _step_us : _configuring_step_us;
+        _now_us = std::min(end_us, std::min(_now_us + step_us, _receiver.next_edge_us()));
+        _receiver.advance(_now_us);
+        _pps_source.now = _now_us;
+
+        UbxSimulator::Edge edge;
+        while (_receiver.take_edge(edge))
+        {
+            _edge(edge);
+        }
+
+        _gps.dispatch(_now_us);
+        int32_t q_err_ps;
+        if (_gps.take_quantization_error(q_err_ps))
+        {
+            _pps.set_quantization_error(_pps.get_completed_seconds() + 1, q_err_ps);
+        }
+    }
+}
+
+void ClockSimulation::_edge(UbxSimulator::Edge const & edge)
+{
+    _pps.simulate_edge(edge.cycles_in_last_second, edge.cycles_in_last_pulse, edge.us);
+    _pps.dispatch_main_thread();
+    _gps.pps_lock_state(_pps.locked());
+    _gps.pps_pulsed();
+
+    TopOfSecond const & top = _gps.tops_of_seconds().prev();
+    ++_stats.edges;
+    if (_pps.locked())
+    {
+        ++_stats.locked_edges;
+        if (top.utc_ymdhms_valid && top.tai_ymdhms_valid)
+        {
+            if (_stats.valid_edges == 0)
+            {
+                _stats.first_valid_second = edge.second;
+            }
+            ++_stats.valid_edges;
+            if (top.utc_ymdhms != edge.utc || top.tai_ymdhms != edge.tai)
+            {
+                ++_stats.wrong_edges;
+            }
+            if (top.utc_ymdhms.sec == 60)
+            {
+                ++_stats.leap_seconds_shown;
+            }
+        }
+    }
+
+    if (on_edge)
+    {
+        on_edge(edge, top, _pps.locked());
+    }
+}
+
+bool clock_simulation_test()
+{
+    // A cold start half an hour before the leap second at the end of 2016.
+    {
+        UbxScenario scenario;
+        scenario.start_utc = Ymdhms(2016, 12, 31, 23, 30, 0);
+        scenario.leap_seconds.push_back({Ymdhms(2016, 12, 31, 0, 0, 0), 1});
+        ClockSimulation sim(scenario);
+        bool seen_midnight = false;
+        sim.on_edge = [&](UbxSimulator::Edge const & edge, TopOfSecond const & top, bool) {
+            if (edge.utc == Ymdhms(2017, 1, 1, 0, 0, 0))
+            {
+                seen_midnight = top.utc_ymdhms_valid && top.utc_ymdhms == edge.utc;
+            }
+        };
+        sim.run(3600);
+
+        ClockSimulation::Stats const & stats = sim.stats();
+        test_assert(sim.gps().initialized_successfully());
+        test_assert_unsigned_eq(sim.receiver().baud_rate(), 230400u);
+        test_assert(stats.first_valid_second < scenario.cold_start_s + 15);
+        test_assert(stats.valid_edges > 3500);
+        test_assert(stats.wrong_edges == 0);
+        test_assert(stats.leap_seconds_shown == 1);
+        test_assert(seen_midnight);
+    }
+
+    // A leap second taken away, as has never happened yet.
+    {
+        UbxScenario scenario;
+        scenario.start_utc = Ymdhms(2030, 6, 30, 23, 50, 0);
+        scenario.gps_minus_utc = 18;
+        scenario.leap_seconds.push_back({Ymdhms(2030, 6, 30, 0, 0, 0), -1});
+        ClockSimulation sim(scenario);
+        bool seen_missing_second = false;
+        sim.on_edge = [&](UbxSimulator::Edge const & edge, TopOfSecond const & top, bool) {
+            if (edge.utc == Ymdhms(2030, 7, 1, 0, 0, 0))
+            {
+                seen_missing_second = top.utc_ymdhms_valid && top.utc_ymdhms == edge.utc;
+            }
+        };
+        sim.run(1200);
+
+        test_assert(sim.stats().valid_edges > 1100);
+        test_assert(sim.stats().wrong_edges == 0);
+        test_assert(seen_missing_second);
+    }
+
+    // Losing the fix for ten minutes, held over throughout, with damaged bytes and NAKed
+    // configuration along the way.
+    {
+        UbxScenario scenario;
+        scenario.start_utc = Ymdhms(2024, 3, 10, 12, 0, 0);
+        scenario.gps_minus_utc = 18;
+        scenario.outages.push_back({600, 1200});
+        scenario.corrupt_one_in = 5000;
+        scenario.nak_one_in = 3;
+        ClockSimulation sim(scenario);
+        bool locked_in_outage = false;
+        bool locked_after_outage = false;
+        sim.on_edge = [&](UbxSimulator::Edge const & edge, TopOfSecond const &, bool locked) {
+            if (edge.second == 1199)
+            {
+                locked_in_outage = locked && sim.pps().holding_over();
+            }
+            if (edge.second == 1299)
+            {
+                locked_after_outage = locked && !sim.pps().holding_over();
+            }
+        };
+        sim.run(1800);
+
+        ClockSimulation::Stats const & stats = sim.stats();
+        test_assert(sim.gps().initialized_successfully());
+        test_assert(sim.receiver().bytes_corrupted() > 10);
+        test_assert(sim.receiver().naks_sent() > 0);
+        test_assert(locked_in_outage);
+        test_assert(locked_after_outage);
+        test_assert(stats.locked_edges > stats.edges - 100);
+        test_assert(stats.wrong_edges == 0);
+    }
+
+    // A damaged length claiming three seconds' worth of messages more than it has, with the
+    // NAV-PVT of the second they get through in damaged too. The late ones mustn't set the time.
+    {
+        UbxScenario scenario;
+        scenario.start_utc = Ymdhms(2024, 3, 10, 12, 0, 0);
+        scenario.gps_minus_utc = 18;
+        for (uint64_t second = 300; second < 600; second += 30)
+        {
+            scenario.damaged_lengths.push_back(second);
+            scenario.damaged_nav_pvts.push_back(second + 4);
+        }
+        ClockSimulation sim(scenario);
+        sim.run(900);
+
+        ClockSimulation::Stats const & stats = sim.stats();
+        test_assert(sim.receiver().bytes_corrupted() == 20);
+        test_assert(stats.valid_edges > stats.edges - 60);
+        test_assert(stats.wrong_edges == 0);
+    }
+
+    // Surveying the antenna's position from scratch, then starting again with it already known.
+    {
+        MemoryPositionStore store;
+        UbxScenario scenario;
+        scenario.start_utc = Ymdhms(2024, 3, 10, 12, 0, 0);
+        scenario.gps_minus_utc = 18;
+        {
+            ClockSimulation sim(scenario, &store);
+            sim.run(SurveyIn::default_min_samples + 120);
+
+            SurveyIn const & survey = sim.gps().survey();
+            test_assert(survey.done());
+            test_assert(survey.stationary());
+            test_assert_unsigned_eq(store.saves, 1u);
+            test_assert(sim.receiver().dyn_model() == UbxCfgNav5::dyn_model_stationary);
+            UbxMgaIniPosLlh given;
+            test_assert(sim.receiver().position_given(given));
+            test_assert(std::abs(given.lat - UbxSimulator::lat) < 20);
+            test_assert(std::abs(given.lon - UbxSimulator::lon) < 20);
+            test_assert(std::abs(given.alt - UbxSimulator::height / 10) < 20);
+            test_assert(survey.tacc_stationary().count > 60);
+            test_assert(survey.tacc_stationary().mean_ns() < survey.tacc_navigating().mean_ns());
+            test_assert(sim.stats().wrong_edges == 0);
+        }
+        {
+            ClockSimulation sim(scenario, &store);
+            sim.run(120);
+
+            test_assert(sim.gps().initialized_successfully());
+            test_assert(sim.gps().survey().stationary());
+            test_assert_unsigned_eq(sim.gps().survey().samples(), 0u);
+            test_assert_unsigned_eq(store.saves, 1u);
+            test_assert(sim.receiver().dyn_model() == UbxCfgNav5::dyn_model_stationary);
+            UbxMgaIniPosLlh given;
+            test_assert(sim.receiver().position_given(given));
+        }
+    }
+
+    return true;
+}
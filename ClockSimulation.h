@@ -0,0 +1,59 @@
+#pragma once
+
+#include <functional>
+
+#include "GpsUBlox.h"
+#include "Pps.h"
+#include "UbxSimulator.h"
+
+bool clock_simulation_test();
+
+/*
+ * GpsUBlox and Pps wired to a UbxSimulator the way gps_clock.cpp wires them to the hardware,
+ * checking the time they come up with at every edge against what the receiver knows it to be.
+ */
+class ClockSimulation
+{
+public:
+    struct Stats
+    {
+        uint64_t edges = 0;
+        uint64_t locked_edges = 0;
+        // Locked, with a UTC and TAI time for the second.
+        uint64_t valid_edges = 0;
+        // Valid, but not the right time.
+        uint64_t wrong_edges = 0;
+        uint64_t leap_seconds_shown = 0;
+        // The edge at which the time first became valid.
+        uint64_t first_valid_second = 0;
+    };
+
+    // GpsUBlox loads and saves its surveyed position in store, if there is one.
+    explicit ClockSimulation(UbxScenario const & scenario, PositionStore * store = nullptr);
+
+    // Runs for the given number of seconds more.
+    void run(uint64_t seconds);
+
+    // Called at each edge, after the clock has seen it.
+    std::function<void(UbxSimulator::Edge const & edge, TopOfSecond const & top, bool locked)> on_edge;
+
+    Stats const & stats() const { return _stats; }
+    GpsUBlox const & gps() const { return _gps; }
+    UbxSimulator const & receiver() const { return _receiver; }
+    Pps const & pps() const { return _pps; }
+
+private:
+    // Often enough for GpsUBlox to get through configuration, then as often as the main loop
+    // needs to get each second's messages in before the next edge.
+    static uint64_t constexpr _configuring_step_us = 1000;
+    static uint64_t constexpr _step_us = 100000;
+
+    UbxSimulator _receiver;
+    GpsUBlox _gps;
+    IdlePpsSource _pps_source;
+    Pps _pps;
+    uint64_t _now_us = 0;
+    Stats _stats;
+
+    void _edge(UbxSimulator::Edge const & edge);
+};
@@ -0,0 +1,126 @@
+#include "Console.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "util.h"
+
+Console::Console(std::function<int()> get_char,
+                 std::function<void(char const * line)> write_line):
+    _get_char(get_char),
+    _write_line(write_line)
+{
+}
+
+void Console::add_command(char const * const name, char const * const help, std::function<void(char const * args)> run)
+{
+    _commands.push_back({name, help, run});
+}
+
+void Console::dispatch()
+{
+    int c;
+    while ((c = _get_char()) >= 0)
+    {
+        if (c == '\r' || c == '\n')
+        {
+            if (_overflow)
+            {
+                _write_line("Line too long.");
+            }
+            else
+            {
+                _line[_len] = '\0';
+                _run_line();
+            }
+            _len = 0;
+            _overflow = false;
+        }
+        else if (_len < max_line)
+        {
+            _line[_len++] = c;
+        }
+        else
+        {
+            _overflow = true;
+        }
+    }
+}
+
+void Console::_run_line()
+{
+    char * name = _line;
+    while (*name == ' ')
+    {
+        ++name;
+    }
+    if (*name == '\0')
+    {
+        return;
+    }
+    char * args = name + strcspn(name, " ");
+    if (*args != '\0')
+    {
+        *args++ = '\0';
+        while (*args == ' ')
+        {
+            ++args;
+        }
+    }
+
+    if (strcmp(name, "help") == 0)
+    {
+        for (Command const & command : _commands)
+        {
+            char line[max_line + 64];
+            snprintf(line, sizeof(line), "%-16s %s", command.name.c_str(), command.help.c_str());
+            _write_line(line);
+        }
+        return;
+    }
+    for (Command const & command : _commands)
+    {
+        if (command.name == name)
+        {
+            command.run(args);
+            return;
+        }
+    }
+
+    char line[max_line + 32];
+    snprintf(line, sizeof(line), "Unknown command: %s", name);
+    _write_line(line);
+}
+
+bool console_test()
+{
+    std::string typed;
+    size_t typed_pos = 0;
+    std::vector<std::string> written;
+    Console console([&]() { return typed_pos < typed.size() ? typed[typed_pos++] : -1; },
+                    [&](char const * const line) { written.push_back(line); });
+
+    std::vector<std::string> runs;
+    console.add_command("history", "PPS history: csv or bin", [&](char const * const args) { runs.push_back(args); });
+
+    // A command may come in pieces, and only runs once its line is done.
+    typed = "hist";
+    console.dispatch();
+    test_assert(runs.empty());
+    typed += "ory  csv\r\n\n  history\r";
+    console.dispatch();
+    test_assert(runs.size() == 2);
+    test_assert(runs[0] == "csv");
+    test_assert(runs[1] == "");
+    test_assert(written.empty());
+
+    typed += "help\nfrobnicate now\n" + std::string(Console::max_line + 1, 'x') + "\nhistory bin\n";
+    console.dispatch();
+    test_assert(written.size() == 3);
+    test_assert(written[0].starts_with("history") && written[0].ends_with("PPS history: csv or bin"));
+    test_assert(written[1] == "Unknown command: frobnicate");
+    test_assert(written[2] == "Line too long.");
+    test_assert(runs.size() == 3 && runs[2] == "bin");
+
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+bool console_test();
+
+/*
+ * Commands typed over USB, a line at a time. Each is a name, and whatever follows it on the line
+ * goes to the command as its arguments. "help" lists them.
+ */
+class Console
+{
+public:
+    static size_t constexpr max_line = 80;
+
+    // get_char returns the next character typed, or a negative number if there isn't one yet.
+    Console(std::function<int()> get_char,
+            std::function<void(char const * line)> write_line);
+
+    void add_command(char const * name, char const * help, std::function<void(char const * args)> run);
+
+    // Runs any commands that have been typed since the last call.
+    void dispatch();
+
+private:
+    struct Command
+    {
+        std::string name;
+        std::string help;
+        std::function<void(char const *)> run;
+    };
+
+    std::function<int()> _get_char;
+    std::function<void(char const *)> _write_line;
+    std::vector<Command> _commands;
+
+    char _line[max_line + 1];
+    size_t _len = 0;
+    bool _overflow = false;
+
+    void _run_line();
+};
@@ -1,9 +1,16 @@
 #include "Display.h"
 
+#include <algorithm>
+#include <cinttypes>
 #include <cstdio>
 #include <cstdarg>
 
-Display::Display(FiveSimdHt16k33Busses & busses):
+#include "util.h"
+#ifdef HOST_BUILD
+  #include "Ht16k33Simulator.h"
+#endif
+
+Display::Display(Ht16k33Busses & busses):
     _busses(busses)
 {
     for (size_t line_idx = 0; line_idx < num_lines; ++line_idx)
@@ -12,7 +19,8 @@ Display::Display(FiveSimdHt16k33Busses & busses):
         {
             _screen_text[line_idx][col] = ' ';
             _screen_dots[line_idx][col] = false;
-            _screen_updates_required[line_idx][col] = true;
+            _screen_images[line_idx][col] = 0;
+            _front_images[line_idx][col] = 0;
         }
     }
 
@@ -92,36 +100,35 @@ Display::Display(FiveSimdHt16k33Busses & busses):
 
 namespace
 {
-    uint16_t char_to_image(char ch)
+    /* -----A-----
+     * |\   |   /|
+     * | \  |  / |
+     * B  C D E  F
+     * |   \|/   |
+     * *-G--*--H-*
+     * |   /|\   |
+     * I  J K L  M
+     * | /  |  \ |
+     * |/   |   \|
+     * -----N----- */
+    constexpr std::array<uint16_t, 128> make_glyphs()
     {
-        /* -----A-----
-         * |\   |   /|
-         * | \  |  / |
-         * B  C D E  F
-         * |   \|/   |
-         * *-G--*--H-*
-         * |   /|\   |
-         * I  J K L  M
-         * | /  |  \ |
-         * |/   |   \|
-         * -----N----- */
-
-        uint32_t constexpr a = 0x0020;
-        uint32_t constexpr b = 0x0001;
-        uint32_t constexpr c = 0x0002;
-        uint32_t constexpr d = 0x0004;
-        uint32_t constexpr e = 0x0008;
-        uint32_t constexpr f = 0x0040;
-        uint32_t constexpr g = 0x0010;
-        uint32_t constexpr h = 0x0400;
-        uint32_t constexpr i = 0x4000;
-        uint32_t constexpr j = 0x2000;
-        uint32_t constexpr k = 0x1000;
-        uint32_t constexpr l = 0x0800;
-        uint32_t constexpr m = 0x0080;
-        uint32_t constexpr n = 0x0200;
-
-        uint32_t constexpr letters[26] = {
+        uint16_t constexpr a = 0x0020;
+        uint16_t constexpr b = 0x0001;
+        uint16_t constexpr c = 0x0002;
+        uint16_t constexpr d = 0x0004;
+        uint16_t constexpr e = 0x0008;
+        uint16_t constexpr f = 0x0040;
+        uint16_t constexpr g = 0x0010;
+        uint16_t constexpr h = 0x0400;
+        uint16_t constexpr i = 0x4000;
+        uint16_t constexpr j = 0x2000;
+        uint16_t constexpr k = 0x1000;
+        uint16_t constexpr l = 0x0800;
+        uint16_t constexpr m = 0x0080;
+        uint16_t constexpr n = 0x0200;
+
+        uint16_t constexpr letters[26] = {
             /* a */ a|b|f|g|h|i|m,
             /* b */ a|d|f|h|k|m|n,
             /* c */ a|b|i|n,
@@ -150,109 +157,47 @@ namespace
             /* z */ a|e|j|n,
         };
 
-        uint32_t constexpr table[95] = {
-            0,               // space
-            0, // !
-            0, // "
-            0, // #
-            a|c|h|m|n|d|k,   // $
-            0, // %
-            0, // &
-            e,               // '
-            0, // (
-            0, // )
-            d|e|h|l|k|j|g|c, // *
-            d|k|g|h,         // +
-            0, // ,
-            g|h,             // -
-            0, // .
-            j|e,             // /
-            a|b|e|f|i|j|m|n, // 0
-            f|m,             // 1
-            a|f|g|h|i|n,     // 2
-            a|f|h|m|n,       // 3
-            b|f|g|h|m,       // 4
-            a|b|g|h|m|n,     // 5
-            b|g|h|i|m|n,     // 6
-            a|e|j,           // 7
-            a|b|f|g|h|i|m|n, // 8
-            a|b|f|g|h|m,     // 9
-            0, // :
-            0, // ;
-            e|l,             // <
-            g|h|n,           // =
-            c|j,             // >
-            0, // ?
-            0, // @
-            letters[0],      // A
-            letters[1],      // B
-            letters[2],      // C
-            letters[3],      // D
-            letters[4],      // E
-            letters[5],      // F
-            letters[6],      // G
-            letters[7],      // H
-            letters[8],      // I
-            letters[9],      // J
-            letters[10],     // K
-            letters[11],     // L
-            letters[12],     // M
-            letters[13],     // N
-            letters[14],     // O
-            letters[15],     // P
-            letters[16],     // Q
-            letters[17],     // R
-            letters[18],     // S
-            letters[19],     // T
-            letters[20],     // U
-            letters[21],     // V
-            letters[22],     // W
-            letters[23],     // X
-            letters[24],     // Y
-            letters[25],     // Z
-            0, // [
-            c|l,             // backslash
-            0, // ]
-            e|f,             // ^
-            n,               // _
-            c,               // `
-            letters[0],      // a
-            letters[1],      // b
-            letters[2],      // c
-            letters[3],      // d
-            letters[4],      // e
-            letters[5],      // f
-            letters[6],      // g
-            letters[7],      // h
-            letters[8],      // i
-            letters[9],      // j
-            letters[10],     // k
-            letters[11],     // l
-            letters[12],     // m
-            letters[13],     // n
-            letters[14],     // o
-            letters[15],     // p
-            letters[16],     // q
-            letters[17],     // r
-            letters[18],     // s
-            letters[19],     // t
-            letters[20],     // u
-            letters[21],     // v
-            letters[22],     // w
-            letters[23],     // x
-            letters[24],     // y
-            letters[25],     // z
-            0, // {
-            d|k,             // |
-            0, // }
-            0, // ~
-        };
-
-        if (' ' <= ch && ch <= '~')
+        // Anything not here is blank, and can't be shown but for space.
+        std::array<uint16_t, 128> glyphs = {};
+        glyphs['$']  = a|c|h|m|n|d|k;
+        glyphs['\''] = e;
+        glyphs['*']  = d|e|h|l|k|j|g|c;
+        glyphs['+']  = d|k|g|h;
+        glyphs['-']  = g|h;
+        glyphs['/']  = j|e;
+        glyphs['0']  = a|b|e|f|i|j|m|n;
+        glyphs['1']  = f|m;
+        glyphs['2']  = a|f|g|h|i|n;
+        glyphs['3']  = a|f|h|m|n;
+        glyphs['4']  = b|f|g|h|m;
+        glyphs['5']  = a|b|g|h|m|n;
+        glyphs['6']  = b|g|h|i|m|n;
+        glyphs['7']  = a|e|j;
+        glyphs['8']  = a|b|f|g|h|i|m|n;
+        glyphs['9']  = a|b|f|g|h|m;
+        glyphs['<']  = e|l;
+        glyphs['=']  = g|h|n;
+        glyphs['>']  = c|j;
+        glyphs['\\'] = c|l;
+        glyphs['^']  = e|f;
+        glyphs['_']  = n;
+        glyphs['`']  = c;
+        glyphs['|']  = d|k;
+        for (size_t letter = 0; letter < 26; ++letter)
         {
-            return table[ch - ' '];
+            glyphs['A' + letter] = letters[letter];
+            glyphs['a' + letter] = letters[letter];
         }
-        return 0x0000;
+        return glyphs;
+    }
+
+    // Built by the compiler, and kept in flash.
+    constexpr std::array<uint16_t, 128> glyphs = make_glyphs();
+
+    uint16_t char_to_image(char ch)
+    {
+        unsigned char const index = ch;
+        return index < glyphs.size() ? glyphs[index] : 0x0000;
     }
 
     uint16_t dot_to_image(bool dot)
@@ -261,7 +206,7 @@ namespace
     }
 }
 
-void Display::dispatch()
+void Display::dispatch(uint64_t const now_us)
 {
     if (_command_in_progress)
     {
@@ -272,7 +217,12 @@ void Display::dispatch()
             if (!success)
             {
                 ++_error_count;
+                if (_slice_being_written < _num_slices)
+                {
+                    _shown_known[_slice_being_written] = false;
+                }
             }
+            _slice_being_written = _num_slices;
         }
     }
 
@@ -292,75 +242,109 @@ void Display::dispatch()
             return;
         }
 
-        for (auto const & slice : _slices)
+        // Nothing goes to the chips but whole frames, one after another, each from when it's due.
+        while (!_begin_next_slice())
         {
-            bool needs_update = false;
-            for (auto const & chip : slice.chips)
+            if (!_frame_waiting || now_us < _frame_due_us)
             {
-                for (size_t common = 0; common < chip.n_columns; ++common)
-                {
-                    uint8_t column = chip.n_columns - common - 1;
-                    if (_screen_updates_required[chip.line_idx][chip.left_column+column])
-                    {
-                        needs_update = true;
-                        goto done_checking_for_updates;
-                    }
-                }
+                return;
             }
-            done_checking_for_updates:
+            _front_images = _committed_images;
+            _frame_waiting = false;
+            _transmit_lag.add(now_us - _frame_due_us);
+        }
+    }
+}
 
-            if (needs_update)
-            {
-                size_t constexpr overhead_bytes = 1;
-                size_t constexpr bytes_per_common = 2;
-                size_t constexpr max_commons_per_chip = 8;
-                size_t constexpr max_command_length = overhead_bytes + bytes_per_common * max_commons_per_chip;
-                static_assert(max_command_length == FiveSimdHt16k33Busses::max_cmd_length);
-                std::array<std::array<uint8_t, max_command_length>, 5> commands;
-                for (size_t bus = 0; bus < slice.chips.size(); ++bus)
-                {
-                    commands[bus][0] = 0x00;
+void Display::commit(uint64_t const due_us)
+{
+    if (_frame_waiting)
+    {
+        ++_frames_superseded;
+    }
+    _committed_images = _screen_images;
+    _frame_waiting = true;
+    _frame_due_us = due_us;
+}
 
-                    Ht16k33 const & chip = slice.chips[bus];
-                    for (size_t common = 0; common < chip.n_columns; ++common)
-                    {
-                        uint8_t column = chip.n_columns - common - 1;
-                        char the_char = _screen_text[chip.line_idx][chip.left_column+column];
-                        bool the_dot  = _screen_dots[chip.line_idx][chip.left_column+column];
+void Display::show_status() const
+{
+    _transmit_lag.print("Display frame transmit lag", 1);
+    ::printf("Display frames superseded before sending: %" PRIu32 "\n", _frames_superseded);
+}
 
-                        uint16_t image = 0;
-                        image |= char_to_image(the_char);
-                        image |= dot_to_image(the_dot);
+bool Display::_begin_next_slice()
+{
+    for (size_t slice_idx = 0; slice_idx < _slices.size(); ++slice_idx)
+    {
+        SliceOfBusses const & slice = _slices[slice_idx];
+
+        // What each chip should show, and where the commons that differ from what it does
+        // begin, and how many there are on the chip with the most.
+        SliceImages images = {};
+        std::array<size_t, 5> first_changed;
+        size_t commons_to_send = 0;
+        for (size_t bus = 0; bus < slice.chips.size(); ++bus)
+        {
+            Ht16k33 const & chip = slice.chips[bus];
+            first_changed[bus] = chip.n_columns;
+            for (size_t common = 0; common < chip.n_columns; ++common)
+            {
+                uint8_t column = chip.n_columns - common - 1;
+                uint16_t const image = _front_images[chip.line_idx][chip.left_column+column];
+                images[bus][common] = image;
 
-                        commands[bus][common*2+1] = (image >> 0) & 0xff;
-                        commands[bus][common*2+2] = (image >> 8) & 0xff;
-                    }
+                if (!_shown_known[slice_idx] || _shown[slice_idx][bus][common] != image)
+                {
+                    first_changed[bus] = std::min(first_changed[bus], common);
+                    commons_to_send = std::max(commons_to_send, common - first_changed[bus] + 1);
                 }
+            }
+        }
 
-                if (_busses.begin_write(
-                        slice.address,
-                        overhead_bytes + bytes_per_common * slice.chips[0].n_columns,
-                        commands[0].data(),
-                        commands[1].data(),
-                        commands[2].data(),
-                        commands[3].data(),
-                        commands[4].data()))
-                {
-                    _command_in_progress = true;
+        if (commons_to_send == 0)
+        {
+            continue;
+        }
 
-                    for (auto const & chip : slice.chips)
-                    {
-                        for (size_t common = 0; common < chip.n_columns; ++common)
-                        {
-                            uint8_t column = chip.n_columns - common - 1;
-                            _screen_updates_required[chip.line_idx][chip.left_column+column] = false;
-                        }
-                    }
-                }
-                return;
+        // The busses are clocked together, so every chip in the slice gets the same number
+        // of commons, each from its own first change, moving along its RAM by itself after
+        // each byte. A chip with nothing new, or too near the end, is sent a few commons it
+        // already shows.
+        size_t constexpr overhead_bytes = 1;
+        size_t constexpr bytes_per_common = 2;
+        size_t constexpr max_command_length = overhead_bytes + bytes_per_common * _max_commons_per_chip;
+        static_assert(max_command_length == Ht16k33Busses::max_cmd_length);
+        std::array<std::array<uint8_t, max_command_length>, 5> commands;
+        for (size_t bus = 0; bus < slice.chips.size(); ++bus)
+        {
+            size_t const first_common = std::min(first_changed[bus], slice.chips[bus].n_columns - commons_to_send);
+            commands[bus][0] = first_common * bytes_per_common;
+            for (size_t i = 0; i < commons_to_send; ++i)
+            {
+                uint16_t const image = images[bus][first_common + i];
+                commands[bus][i*2+1] = (image >> 0) & 0xff;
+                commands[bus][i*2+2] = (image >> 8) & 0xff;
             }
         }
+
+        if (_busses.begin_write(
+                slice.address,
+                overhead_bytes + bytes_per_common * commons_to_send,
+                commands[0].data(),
+                commands[1].data(),
+                commands[2].data(),
+                commands[3].data(),
+                commands[4].data()))
+        {
+            _command_in_progress = true;
+            _slice_being_written = slice_idx;
+            _shown[slice_idx] = images;
+            _shown_known[slice_idx] = true;
+        }
+        return true;
     }
+    return false;
 }
 
 bool Display::printf(size_t line_idx, const char *fmt, ...)
@@ -450,11 +434,8 @@ bool Display::_set_char(size_t line_idx, size_t col, char ch)
         return false;
     }
 
-    if (_screen_text[line_idx][col] != ch)
-    {
-        _screen_text[line_idx][col] = ch;
-        _screen_updates_required[line_idx][col] = true;
-    }
+    _screen_text[line_idx][col] = ch;
+    _screen_images[line_idx][col] = char_to_image(ch) | dot_to_image(_screen_dots[line_idx][col]);
 
     return true;
 }
@@ -471,11 +452,8 @@ bool Display::_set_dot(size_t line_idx, size_t col, bool dot)
         return false;
     }
 
-    if (_screen_dots[line_idx][col] != dot)
-    {
-        _screen_dots[line_idx][col] = dot;
-        _screen_updates_required[line_idx][col] = true;
-    }
+    _screen_dots[line_idx][col] = dot;
+    _screen_images[line_idx][col] = char_to_image(_screen_text[line_idx][col]) | dot_to_image(dot);
 
     return true;
 }
@@ -551,3 +529,190 @@ void Display::_make_progress_on_setting_brightness(uint8_t const pulse_width, bo
         }
     }
 }
+
+#ifdef HOST_BUILD
+bool Display::unit_test()
+{
+    // test_assert's, not ours.
+    using ::printf;
+
+    Ht16k33Simulator busses;
+    Display display(busses);
+    uint64_t now_us = 0;
+
+    // Writes what's been committed, as gps_clock.cpp would between tenths.
+    auto const run = [&]()
+    {
+        uint64_t writes;
+        do
+        {
+            writes = busses.writes();
+            display.dispatch(now_us);
+        }
+        while (writes != busses.writes() || display._command_in_progress);
+    };
+
+    // The chips show the given frame, however it got to them.
+    auto const shows = [&](ScreenOf<uint16_t> const & frame)
+    {
+        for (SliceOfBusses const & slice : display._slices)
+        {
+            for (size_t bus = 0; bus < slice.chips.size(); ++bus)
+            {
+                Ht16k33 const & chip = slice.chips[bus];
+                Ht16k33Simulator::Ram const & ram = busses.ram(bus, slice.address);
+                for (size_t common = 0; common < chip.n_columns; ++common)
+                {
+                    size_t const col = chip.left_column + chip.n_columns - common - 1;
+                    if ((ram[common*2] | (ram[common*2+1] << 8)) != frame[chip.line_idx][col])
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    };
+
+    // The chips show what's been drawn, and the images drawn are the glyphs' and dots'.
+    auto const shown = [&]()
+    {
+        for (size_t line_idx = 0; line_idx < num_lines; ++line_idx)
+        {
+            for (size_t col = 0; col < line_length; ++col)
+            {
+                if (display._screen_images[line_idx][col] != (char_to_image(display._screen_text[line_idx][col]) |
+                                                               dot_to_image(display._screen_dots[line_idx][col])))
+                {
+                    return false;
+                }
+            }
+        }
+        return shows(display._screen_images);
+    };
+
+    // The default layout, redrawn every tenth of a second for ten minutes.
+    auto const draw = [&](uint32_t tenths)
+    {
+        uint32_t const t = tenths / 10;
+        int const s = t % 60;
+        int const m = t / 60 % 60;
+        display.printf(0, "%-4s%04d.%02d.%02d %02d.%02d.%02d.%d", "PDT", 2024, 6, 30, 17, m, s, tenths % 10);
+        display.printf(1, "%-4s%04d.%02d.%02d %02d.%02d.%02d.%d", "CST", 2024, 7, 1, 8, m, s, tenths % 10);
+        display.printf(2, "%-4s%04d.%02d.%02d %02d.%02d.%02d.%d", "UTC", 2024, 7, 1, 0, m, s, tenths % 10);
+        display.printf(3, "%-4s%04d.%02d.%02d %02d.%02d.%02d.%d", "TAI", 2024, 7, 1, 0, m, (s + 37) % 60, tenths % 10);
+        display.printf(4, "Analog clock %02d.%02d.%02d.%01x", 5, m, s, tenths % 10);
+    };
+
+    // The chips start blank, and nothing drawn is shown until it's committed, and then not
+    // before it's due.
+    run();
+    test_assert(shows(ScreenOf<uint16_t>{}));
+    busses.reset_counts();
+    draw(0);
+    run();
+    test_assert(busses.writes() == 0);
+    display.commit(now_us + 100000);
+    run();
+    test_assert(busses.writes() == 0);
+    now_us += 100000;
+    run();
+    test_assert(shown());
+    busses.reset_counts();
+
+    // Each tenth drawn during the one before, as Artist does, is held until it's due, and goes
+    // out then. What rewriting every slice with anything new on it would have cost, as it used
+    // to be.
+    uint32_t constexpr seconds = 600;
+    uint64_t whole_slice_bytes = 0;
+    for (uint32_t tenths = 1; tenths <= seconds * 10; ++tenths)
+    {
+        ScreenOf<char> const previous_text = display._screen_text;
+        ScreenOf<bool> const previous_dots = display._screen_dots;
+        ScreenOf<uint16_t> const previous_images = display._screen_images;
+        draw(tenths);
+        display.commit(now_us + 100000);
+        now_us += 99999;
+        run();
+        test_assert(shows(previous_images));
+        now_us += 1;
+        run();
+        test_assert(shown());
+
+        for (SliceOfBusses const & slice : display._slices)
+        {
+            bool changed = false;
+            for (Ht16k33 const & chip : slice.chips)
+            {
+                for (size_t col = chip.left_column; col < chip.left_column + chip.n_columns; ++col)
+                {
+                    changed = changed ||
+                              previous_text[chip.line_idx][col] != display._screen_text[chip.line_idx][col] ||
+                              previous_dots[chip.line_idx][col] != display._screen_dots[chip.line_idx][col];
+                }
+            }
+            if (changed)
+            {
+                whole_slice_bytes += slice.chips.size() * (2 + 2 * slice.chips[0].n_columns);
+            }
+        }
+    }
+    ::printf("Display: %.0f bytes/s on the wires, against %.0f rewriting whole slices.\n",
+             static_cast<double>(busses.bytes()) / seconds,
+             static_cast<double>(whole_slice_bytes) / seconds);
+    test_assert(busses.bytes() * 2 < whole_slice_bytes);
+    test_assert(display.error_count() == 0);
+    test_assert(display.transmit_lag().count() == seconds * 10 + 1);
+    test_assert(display.transmit_lag().max_cycles() == 0);
+
+    // A change in the middle of a chip is sent from there.
+    busses.reset_counts();
+    display.printf(0, "%-4s%04d.%02d.%02d %02d.%02d.%02d.%d", "PST", 2024, 6, 30, 17, 10, 0, 0);
+    display.commit(now_us);
+    run();
+    test_assert(shown());
+    test_assert(busses.bytes() == 5 * (2 + 2 * 1));
+
+    // A write that fails is sent again in full.
+    busses.fail_next_write();
+    display.printf(4, "Analog clock 06.00.00.0");
+    display.commit(now_us);
+    display.dispatch(now_us);
+    test_assert(!shown());
+    busses.reset_counts();
+    run();
+    test_assert(shown());
+    test_assert(display.error_count() == 1);
+    test_assert(busses.bytes() == 5 * (2 + 2 * 8));
+
+    // A frame committed while another is going out waits for it, so the chips never show the
+    // minute that's ending beside the seconds of the one that's starting.
+    draw(35999);
+    ScreenOf<uint16_t> const ending = display._screen_images;
+    display.commit(now_us);
+    display.dispatch(now_us);
+    now_us += 100000;
+    draw(36000);
+    display.commit(now_us);
+    test_assert(!shows(ending));
+    bool ending_shown = false;
+    for (int i = 0; i < 20; ++i)
+    {
+        display.dispatch(now_us);
+        ending_shown = ending_shown || shows(ending);
+    }
+    test_assert(ending_shown);
+    test_assert(shown());
+
+    // A frame committed before the last one went out replaces it.
+    draw(36001);
+    display.commit(now_us);
+    draw(36002);
+    display.commit(now_us);
+    run();
+    test_assert(shown());
+    test_assert(display._frames_superseded == 1);
+
+    return true;
+}
+#endif
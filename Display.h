@@ -1,6 +1,7 @@
 #pragma once
 
-#include "FiveSimdHt16k33Busses.h"
+#include "Ht16k33Busses.h"
+#include "LatencyHistogram.h"
 
 #include <array>
 
@@ -16,6 +17,13 @@
  * UTC YYYYMMDD hhmmssT
  * TAI YYYYMMDD hhmmssT
  * AREA OF GENERIC TEXT
+ *
+ * Each chip is sent only the part of its RAM that has changed since the last time, as one run
+ * of commons.
+ *
+ * What's drawn isn't shown until it's committed as a frame. Frames go out whole, one after
+ * another, so the chips never show half of one and half of the next; a frame committed while
+ * another waits replaces it.
  */
 
 class Display
@@ -27,21 +35,30 @@ public:
     template <typename T>
     using LineOf = std::array<T, line_length>;
 
-    Display(FiveSimdHt16k33Busses & busses);
+    Display(Ht16k33Busses & busses);
 
-    void dispatch();
+    void dispatch(uint64_t now_us);
 
     bool printf(size_t line_idx, const char *fmt, ...)
         __attribute__ ((format (printf, 3, 4)));
 
+    // Everything drawn so far is a frame, to start going out at due_us on the chip's clock.
+    void commit(uint64_t due_us);
+
+    // From when each frame was due to when it started going out, in microseconds.
+    LatencyHistogram const & transmit_lag() const { return _transmit_lag; }
+    void show_status() const;
+
     uint32_t error_count() const { return _error_count; }
 
     void dump_to_console(bool show_dots);
 
     void set_brightness(uint8_t const pulse_width) { _desired_pulse_width = pulse_width; }
 
+    static bool unit_test();
+
 private:
-    FiveSimdHt16k33Busses & _busses;
+    Ht16k33Busses & _busses;
     bool _command_in_progress = false;
 
     template <typename T>
@@ -52,7 +69,17 @@ private:
 
     ScreenOf<char> _screen_text;
     ScreenOf<bool> _screen_dots;
-    ScreenOf<bool> _screen_updates_required;
+
+    // What each column looks like to its chip, kept up to date as it's drawn.
+    ScreenOf<uint16_t> _screen_images;
+
+    // The frame going out to the chips, and the newest committed after it, if any.
+    ScreenOf<uint16_t> _front_images;
+    ScreenOf<uint16_t> _committed_images;
+    bool _frame_waiting = false;
+    uint64_t _frame_due_us = 0;
+    uint32_t _frames_superseded = 0;
+    LatencyHistogram _transmit_lag{1000};
 
     struct Ht16k33
     {
@@ -88,6 +115,17 @@ private:
     static size_t constexpr _num_slices = 3;
     std::array<SliceOfBusses, _num_slices> _slices;
 
+    // What each chip has been sent, common by common, if that's known: not before the first
+    // write to it, nor after one fails.
+    static size_t constexpr _max_commons_per_chip = 8;
+    using SliceImages = std::array<std::array<uint16_t, _max_commons_per_chip>, 5>;
+    std::array<SliceImages, _num_slices> _shown;
+    std::array<bool, _num_slices> _shown_known = {};
+    size_t _slice_being_written = _num_slices;
+
+    // Starts writing the first slice that isn't showing the front frame. False if there's none.
+    bool _begin_next_slice();
+
     uint8_t _desired_pulse_width;
     std::array<uint8_t, _num_slices> _selected_pulse_width;
     void _make_progress_on_setting_brightness(uint8_t const pulse_width, bool blocking);
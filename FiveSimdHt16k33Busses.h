@@ -7,11 +7,11 @@
 #include "hardware/pio.h"
 #pragma GCC diagnostic pop
 
-class FiveSimdHt16k33Busses
+#include "Ht16k33Busses.h"
+
+class FiveSimdHt16k33Busses: public Ht16k33Busses
 {
 public:
-    static size_t constexpr max_cmd_length = 17;
-
     FiveSimdHt16k33Busses(PIO pio, uint const clock_pin, uint const first_of_five_consecutive_data_pins);
 
     void dispatch();
@@ -23,10 +23,9 @@ public:
         uint8_t const * const cmd1,
         uint8_t const * const cmd2,
         uint8_t const * const cmd3,
-        uint8_t const * const cmd4);
+        uint8_t const * const cmd4) override;
 
-    // Returns true if the operation is complete, sets success to true if all acks were received successfully.
-    bool try_end_write(bool & success);
+    bool try_end_write(bool & success) override;
 
     bool blocking_write(
         uint8_t const addr,
@@ -35,7 +34,7 @@ public:
         uint8_t const * const cmd1,
         uint8_t const * const cmd2,
         uint8_t const * const cmd3,
-        uint8_t const * const cmd4);
+        uint8_t const * const cmd4) override;
 
     bool begin_read(
         uint8_t const addr,
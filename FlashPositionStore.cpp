@@ -0,0 +1,16 @@
+#include "FlashPositionStore.h"
+
+bool FlashPositionStore::load(SurveyedPosition & position)
+{
+    return position.from_record(_sector.data());
+}
+
+bool FlashPositionStore::save(SurveyedPosition const & position)
+{
+    uint8_t record[SurveyedPosition::record_len];
+    position.to_record(record);
+    _sector.write(record, sizeof(record));
+
+    SurveyedPosition written;
+    return load(written);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "FlashSector.h"
+#include "SurveyIn.h"
+
+// Keeps the surveyed position in the last sector of flash. Only written once, after a survey.
+class FlashPositionStore: public PositionStore
+{
+public:
+    bool load(SurveyedPosition & position) override;
+    bool save(SurveyedPosition const & position) override;
+
+private:
+    FlashSector _sector{0};
+};
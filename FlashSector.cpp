@@ -0,0 +1,31 @@
+#include "FlashSector.h"
+
+#include <algorithm>
+
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
+
+FlashSector::FlashSector(size_t const index_from_end):
+    _offset(PICO_FLASH_SIZE_BYTES - (index_from_end + 1) * FLASH_SECTOR_SIZE)
+{
+}
+
+uint8_t const * FlashSector::data() const
+{
+    return reinterpret_cast<uint8_t const *>(XIP_BASE + _offset);
+}
+
+void FlashSector::write(uint8_t const * const data, size_t const len)
+{
+    uint8_t page[FLASH_PAGE_SIZE];
+    std::fill(page, page + sizeof(page), 0xff);
+    std::copy(data, data + std::min(len, sizeof(page)), page);
+
+    multicore_lockout_start_blocking();
+    uint32_t const interrupts = save_and_disable_interrupts();
+    flash_range_erase(_offset, FLASH_SECTOR_SIZE);
+    flash_range_program(_offset, page, sizeof(page));
+    restore_interrupts(interrupts);
+    multicore_lockout_end_blocking();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * One of the sectors at the very end of flash, well clear of the program, for keeping a record
+ * in. Sector 0 is the last one, 1 the one before it, and so on.
+ *
+ * Writing stops the other core and interrupts for as long as erasing and programming take,
+ * around 50 ms, since nothing can run from flash meanwhile. The other core has to have called
+ * multicore_lockout_victim_init().
+ */
+class FlashSector
+{
+public:
+    explicit FlashSector(size_t index_from_end);
+
+    uint8_t const * data() const;
+
+    // Up to a page.
+    void write(uint8_t const * data, size_t len);
+
+private:
+    uint32_t const _offset;
+};
@@ -0,0 +1,16 @@
+#include "FlashThermalModelStore.h"
+
+bool FlashThermalModelStore::load(ThermalModel::Coefficients & coefficients)
+{
+    return coefficients.from_record(_sector.data());
+}
+
+bool FlashThermalModelStore::save(ThermalModel::Coefficients const & coefficients)
+{
+    uint8_t record[ThermalModel::Coefficients::record_len];
+    coefficients.to_record(record);
+    _sector.write(record, sizeof(record));
+
+    ThermalModel::Coefficients written;
+    return load(written);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "FlashSector.h"
+#include "ThermalModel.h"
+
+// Keeps the thermal model's coefficients in the second to last sector of flash, about once a day.
+class FlashThermalModelStore: public ThermalModelStore
+{
+public:
+    bool load(ThermalModel::Coefficients & coefficients) override;
+    bool save(ThermalModel::Coefficients const & coefficients) override;
+
+private:
+    FlashSector _sector{1};
+};
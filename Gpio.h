@@ -38,6 +38,11 @@ public:
         set(!_state);
     }
 
+    bool get() const
+    {
+        return _state;
+    }
+
 private:
     uint const _pin;
     bool _state = false;
@@ -1,234 +1,152 @@
 #include "GpsUBlox.h"
 
-#include "hardware/gpio.h"
-#include "pico/time.h"
+#include <vector>
 
 #include "packing.h"
+#include "UbxMessages.h"
+#include "util.h"
 
-GpsUBlox::GpsUBlox(uart_inst_t * const uart_id, uint const tx_pin, uint const rx_pin):
-    _uart_id(uart_id)
+namespace
 {
-    uint32_t constexpr baud_rate = 9600;
-
-    uart_init(_uart_id, baud_rate);
-    gpio_set_function(tx_pin, GPIO_FUNC_UART);
-    gpio_set_function(rx_pin, GPIO_FUNC_UART);
-    uart_set_translate_crlf(_uart_id, false);
-
-    uint8_t constexpr port_id = 1;
-    uint16_t constexpr tx_ready = 0;
-    uint32_t constexpr mode = 0x000008c0;
-    uint16_t constexpr in_proto_mask = 0x0001;
-    uint16_t constexpr out_proto_mask = 0x0001;
-    uint16_t constexpr flags = 0x0002;
-    if (!_send_ubx_cfg_prt(port_id, tx_ready, mode, baud_rate, in_proto_mask, out_proto_mask, flags))
-    {
-        return;
-    }
+    // UART1 on the receiver, UBX only in and out, 8N1.
+    UbxCfgPrt constexpr ubx_port = {
+        1,          // portID
+        0,          // txReady
+        0x000008c0, // mode
+        230400,     // baudRate
+        0x0001,     // inProtoMask
+        0x0001,     // outProtoMask
+        0x0002,     // flags
+    };
+}
 
-    if (!_send_ubx_cfg_tp5(
-            0,      // tpIdx
-            0,      // antCableDelay
-            0,      // rfGroupDelay
-            1,      // freqPeriod
-            1,      // freqPeriodLock
-            50000,  // pulseLenRatio
-            100000, // pulseLenRatioLock
-            0,      // userConfigDelay
-            true,   // active
-            true,   // lockGnssFreq
-            true,   // lockedOtherSet
-            true,   // isFreq
-            true,   // isLength
-            true,   // alignToTow
-            true,   // polarity
-            1,      // gridUtcGnss
-            true))  // syncMode
+GpsUBlox::GpsUBlox(SerialPort & port, ByteSource & source, bool const configure, PositionStore * const store):
+    _port(port),
+    _source(source),
+    _configuring(configure),
+    _baud_negotiator(ubx_port),
+    _store(store)
+{
+    SurveyedPosition position;
+    if (_store && _store->load(position))
     {
-        return;
+        _survey.restore(position);
     }
+}
 
-    if (!_send_ubx_cfg_msg(0x01, 0x07, 1)) // UBX-NAV-PVT
+// Once we know the baud rate.
+void GpsUBlox::_configure()
+{
+    UbxCfgPrt port = ubx_port;
+    port.baudRate = _baud_negotiator.baud_rate();
+    uint8_t ubx_cfg_prt_msg[UbxCfgPrt::len];
+    ubx_pack(port, ubx_cfg_prt_msg);
+    _configurator.add(UbxCfgPrt::msg_id, ubx_cfg_prt_msg, sizeof(ubx_cfg_prt_msg));
+
+    _add_ubx_cfg_tp5(
+        0,      // tpIdx
+        0,      // antCableDelay
+        0,      // rfGroupDelay
+        1,      // freqPeriod
+        1,      // freqPeriodLock
+        50000,  // pulseLenRatio
+        100000, // pulseLenRatioLock
+        0,      // userConfigDelay
+        true,   // active
+        true,   // lockGnssFreq
+        true,   // lockedOtherSet
+        true,   // isFreq
+        true,   // isLength
+        true,   // alignToTow
+        true,   // polarity
+        1,      // gridUtcGnss
+        true);  // syncMode
+
+    _add_ubx_cfg_msg(0x01, 0x07, 1); // UBX-NAV-PVT
+    _add_ubx_cfg_msg(0x01, 0x26, 1); // UBX-NAV-TIMELS
+    _add_ubx_cfg_msg(0x0D, 0x01, 1); // UBX-TIM-TP
+
+    if (_survey.done())
     {
-        return;
+        _add_ubx_cfg_nav5_stationary();
     }
+}
 
-    if (!_send_ubx_cfg_msg(0x01, 0x26, 1)) // UBX-NAV-TIMELS
+// Whenever every CFG message has been ACKed, including any added after the first lot.
+void GpsUBlox::_on_configured()
+{
+    if (!_initialized_successfully)
     {
-        return;
+        _initialized_successfully = true;
+        printf("GPS init complete.\n");
     }
-
-    if (!_send_ubx_cfg_msg(0x0D, 0x01, 1)) // UBX-TIM-TP
+    if (_survey.done() && !_survey.stationary())
     {
-        return;
+        _send_ubx_mga_ini_pos_llh();
+        _survey.set_stationary();
     }
-
-    _initialized_successfully = true;
 }
 
 void GpsUBlox::show_status() const
 {
-    printf("GPS Message counts: %llu %llu\n", _msg_count_ubx_nav_pvt, _msg_count_ubx_nav_time_ls);
+    printf("GPS Message counts: %" PRIu64 " %" PRIu64 " %" PRIu64 ", stale %" PRIu64 "\n",
+           _msg_count_ubx_nav_pvt, _msg_count_ubx_nav_time_ls, _msg_count_ubx_tim_tp, _msg_count_stale);
+    _survey.show_status();
 }
 
-void GpsUBlox::Checksum::operator()(uint8_t const msg_class,
-                                    uint8_t const msg_id,
-                                    uint16_t const msg_len,
-                                    uint8_t const * const msg)
+void GpsUBlox::_add_ubx_cfg_nav5_stationary()
 {
-    a = 0;
-    b = 0;
-    _next_byte(msg_class);
-    _next_byte(msg_id);
-    _next_byte(msg_len & 0xff);
-    _next_byte(msg_len >> 8);
-    for (uint16_t i = 0; i < msg_len; ++i)
-    {
-        _next_byte(msg[i]);
-    }
+    UbxCfgNav5 nav5 = {};
+    nav5.mask = UbxCfgNav5::mask_dyn;
+    nav5.dynModel = UbxCfgNav5::dyn_model_stationary;
+    uint8_t ubx_cfg_nav5_msg[UbxCfgNav5::len];
+    ubx_pack(nav5, ubx_cfg_nav5_msg);
+    _configurator.add(UbxCfgNav5::msg_id, ubx_cfg_nav5_msg, sizeof(ubx_cfg_nav5_msg));
 }
 
-inline void GpsUBlox::Checksum::_next_byte(uint8_t const byte)
+// Not ACKed, so sent once, straight out.
+void GpsUBlox::_send_ubx_mga_ini_pos_llh()
 {
-    a += byte;
-    b += a;
-}
-
-void GpsUBlox::_send_ubx(uint8_t const msg_class,
-                         uint8_t const msg_id,
-                         uint16_t const msg_len,
-                         uint8_t const * const msg)
-{
-    uint8_t header[6];
-    (Pack<sizeof(header)>(header, LittleEndian())
-        << _sync1
-        << _sync2
-        << msg_class
-        << msg_id
-        << msg_len).finalize();
-
-    Checksum ck;
-    ck(msg_class, msg_id, msg_len, msg);
-    uint8_t footer[2];
-    (Pack<sizeof(footer)>(footer, LittleEndian())
-        << ck.a
-        << ck.b).finalize();
-
-    uart_write_blocking(_uart_id, header, sizeof(header));
-    uart_write_blocking(_uart_id, msg, msg_len);
-    uart_write_blocking(_uart_id, footer, sizeof(footer));
+    SurveyedPosition const & position = _survey.position();
+    UbxMgaIniPosLlh ini = {};
+    ini.type = UbxMgaIniPosLlh::type_pos_llh;
+    ini.lat = position.lat;
+    ini.lon = position.lon;
+    ini.alt = position.height / 10;
+    ini.posAcc = (position.acc + 9) / 10;
+    uint8_t frame[UbxMgaIniPosLlh::len + ubx_overhead_len];
+    _port.write(frame, ubx_encode(ini, frame));
 }
 
-bool GpsUBlox::_send_ubx_cfg(uint8_t const msg_id,
-                             uint16_t const msg_len,
-                             uint8_t const * const msg)
-{
-    uint8_t attempts = 0;
-
-    while (attempts++ < 10)
-    {
-        uint8_t constexpr msg_class = 0x06;
-        _send_ubx(msg_class, msg_id, msg_len, msg);
-
-        uint8_t rx_msg_class;
-        uint8_t rx_msg_id;
-        uint16_t rx_msg_len;
-        uint8_t rx_msg[2];
-
-        absolute_time_t const timeout_time = make_timeout_time_ms(1200);
-        while (absolute_time_diff_us(get_absolute_time(), timeout_time) > 0)
-        {
-            _service_uart();
-            if (_read_ubx(&rx_msg_class, &rx_msg_id, &rx_msg_len, rx_msg, sizeof(rx_msg)))
-            {
-                if (rx_msg_class != 0x05)
-                {
-                    continue;
-                }
-                if (!(rx_msg_id == 0x00 || rx_msg_id == 0x01))
-                {
-                    continue;
-                }
-                if (rx_msg_len != 2)
-                {
-                    continue;
-                }
-                uint8_t acked_class = rx_msg[0];
-                uint8_t acked_id = rx_msg[1];
-                if (acked_class != msg_class)
-                {
-                    continue;
-                }
-                if (acked_id != msg_id)
-                {
-                    continue;
-                }
-                if (rx_msg_id == 0x01)
-                {
-                    return true;
-                }
-                // We got a NAK. Just wait for the timeout to expire before trying again.
-                printf("NAK %02x %02x\n", acked_class, acked_id);
-                continue;
-            }
-        }
-    }
-    return false;
-}
-
-bool GpsUBlox::_send_ubx_cfg_prt(uint8_t const port_id,
-                                 uint16_t const tx_ready,
-                                 uint32_t const mode,
-                                 uint32_t const baud_rate,
-                                 uint16_t const in_proto_mask,
-                                 uint16_t const out_proto_mask,
-                                 uint16_t const flags)
-{
-    uint8_t constexpr reserved = 0;
-    uint8_t ubx_cfg_prt_msg[20];
-    (Pack<sizeof(ubx_cfg_prt_msg)>(ubx_cfg_prt_msg, LittleEndian())
-        << port_id
-        << reserved
-        << tx_ready
-        << mode
-        << baud_rate
-        << in_proto_mask
-        << out_proto_mask
-        << flags
-        << reserved
-        << reserved).finalize();
-    return _send_ubx_cfg(0x00, sizeof(ubx_cfg_prt_msg), ubx_cfg_prt_msg);
-}
-
-bool GpsUBlox::_send_ubx_cfg_msg(uint8_t const msg_class,
-                                 uint8_t const msg_id,
-                                 uint8_t const rate)
+void GpsUBlox::_add_ubx_cfg_msg(uint8_t const msg_class,
+                                uint8_t const msg_id,
+                                uint8_t const rate)
 {
     uint8_t ubx_cfg_msg_msg[3];
     (Pack<sizeof(ubx_cfg_msg_msg)>(ubx_cfg_msg_msg, LittleEndian())
         << msg_class
         << msg_id
         << rate).finalize();
-    return _send_ubx_cfg(0x01, sizeof(ubx_cfg_msg_msg), ubx_cfg_msg_msg);
+    _configurator.add(0x01, ubx_cfg_msg_msg, sizeof(ubx_cfg_msg_msg));
 }
 
-bool GpsUBlox::_send_ubx_cfg_tp5(uint8_t const tpIdx,
-                                 int16_t const antCableDelay,
-                                 int16_t const rfGroupDelay,
-                                 uint32_t const freqPeriod,
-                                 uint32_t const freqPeriodLock,
-                                 uint32_t const pulseLenRatio,
-                                 uint32_t const pulseLenRatioLock,
-                                 int32_t const userConfigDelay,
-                                 bool active,
-                                 bool lockGnssFreq,
-                                 bool lockedOtherSet,
-                                 bool isFreq,
-                                 bool isLength,
-                                 bool alignToTow,
-                                 bool polarity,
-                                 uint8_t gridUtcGnss,
-                                 uint8_t syncMode)
+void GpsUBlox::_add_ubx_cfg_tp5(uint8_t const tpIdx,
+                                int16_t const antCableDelay,
+                                int16_t const rfGroupDelay,
+                                uint32_t const freqPeriod,
+                                uint32_t const freqPeriodLock,
+                                uint32_t const pulseLenRatio,
+                                uint32_t const pulseLenRatioLock,
+                                int32_t const userConfigDelay,
+                                bool active,
+                                bool lockGnssFreq,
+                                bool lockedOtherSet,
+                                bool isFreq,
+                                bool isLength,
+                                bool alignToTow,
+                                bool polarity,
+                                uint8_t gridUtcGnss,
+                                uint8_t syncMode)
 {
     uint32_t flags = 0;
     if (active)
@@ -278,278 +196,347 @@ bool GpsUBlox::_send_ubx_cfg_tp5(uint8_t const tpIdx,
         << pulseLenRatioLock
         << userConfigDelay
         << flags).finalize();
-    return _send_ubx_cfg(0x31, sizeof(ubx_cfg_tp5_msg), ubx_cfg_tp5_msg);
+    _configurator.add(0x31, ubx_cfg_tp5_msg, sizeof(ubx_cfg_tp5_msg));
 }
 
-void GpsUBlox::_service_uart()
+void GpsUBlox::dispatch(uint64_t const now_us)
 {
-    while (uart_is_readable(_uart_id) && !_rx_buf.full())
+    static constexpr std::array handlers = {
+        ubx_handler<GpsUBlox, UbxNavPvt, &GpsUBlox::_on_nav_pvt>(),
+        ubx_handler<GpsUBlox, UbxNavTimeLs, &GpsUBlox::_on_nav_time_ls>(),
+        ubx_handler<GpsUBlox, UbxTimTp, &GpsUBlox::_on_tim_tp>(),
+    };
+    static_assert(ubx_handlers_unique(handlers));
+
+    fill_from(_source, _rx_buf);
+
+    UbxFrame frame;
+    while (_ubx_parser.parse(frame))
+    {
+        if (!_baud_negotiator.on_frame(frame) && !_configurator.on_frame(frame))
+        {
+            ubx_dispatch(handlers, *this, frame);
+        }
+    }
+
+    if (!_configuring)
     {
-        _rx_buf.push(uart_getc(_uart_id));
+        return;
     }
-}
 
-bool GpsUBlox::_read_ubx(uint8_t * msg_class,
-                         uint8_t * msg_id,
-                         uint16_t * msg_len,
-                         uint8_t * msg,
-                         uint16_t msg_buffer_len)
-{
-    uint8_t actual_a;
-    uint8_t actual_b;
-    while (!_rx_buf.empty())
+    if (!_baud_negotiator.done() && !_baud_negotiator.failed())
     {
-        size_t constexpr zero_payload_packet_length = 8;
-        if (_rx_buf.count() < zero_payload_packet_length)
+        _baud_negotiator.dispatch(now_us, _port);
+        if (_baud_negotiator.done())
         {
-            return false;
+            printf("GPS at %" PRIu32 " baud%s.\n", _baud_negotiator.baud_rate(),
+                   _baud_negotiator.fell_back() ? " (fell back)" : "");
+            _configure();
         }
-
-        size_t next_byte = 0;
-        if (_rx_buf.peek(next_byte++) != _sync1)
+        else if (_baud_negotiator.failed())
         {
-            goto bad_packet;
+            printf("GPS init FAILED.\n");
         }
-
-        if (_rx_buf.peek(next_byte++) != _sync2)
+    }
+    else if (_baud_negotiator.done() && !_configurator.failed())
+    {
+        // ACKs come in with the frames above, so it may be done before being dispatched again.
+        if (!_configurator.done())
         {
-            goto bad_packet;
+            _configurator.dispatch(now_us, _port);
         }
+        if (_configurator.done())
+        {
+            _on_configured();
+        }
+        else if (_configurator.failed())
+        {
+            printf("GPS init FAILED.\n");
+        }
+    }
+}
 
-        *msg_class = _rx_buf.peek(next_byte++);
-        *msg_id    = _rx_buf.peek(next_byte++);
+bool GpsUBlox::take_quantization_error(int32_t & q_err_ps)
+{
+    if (!_q_err_fresh)
+    {
+        return false;
+    }
+    _q_err_fresh = false;
 
-        *msg_len = _rx_buf.peek(next_byte + 1);
-        *msg_len <<= 8;
-        *msg_len = _rx_buf.peek(next_byte);
-        next_byte += 2;
+    // Checked as it's taken rather than as it comes, since the edge it's for may have passed
+    // in between.
+    uint32_t const tow_s = (_q_err_tow_ms + 500) / 1000 % _secs_per_week;
+    if (_tow_valid && tow_s != (_tow_s + 1) % _secs_per_week)
+    {
+        ++_msg_count_stale;
+        return false;
+    }
+    q_err_ps = _q_err_ps;
+    return true;
+}
 
-        if (_rx_buf.count() < zero_payload_packet_length + *msg_len)
-        {
-            return false;
-        }
+bool GpsUBlox::_about_this_second(uint32_t const iTOW)
+{
+    uint32_t const tow_s = (iTOW + 500) / 1000 % _secs_per_week;
+    return !_tow_valid || tow_s == _tow_s;
+}
 
-        if (*msg_len > msg_buffer_len)
+void GpsUBlox::_on_nav_pvt(UbxNavPvt const & pvt)
+{
+    if (!_about_this_second(pvt.iTOW))
+    {
+        if (!_tow_disagreement_counted)
         {
-            next_byte = zero_payload_packet_length + *msg_len;
-            goto bad_packet;
+            _tow_disagreement_counted = true;
+            ++_tow_disagreements;
         }
-
-        for (size_t i = 0; i < *msg_len; ++i)
+        if (_tow_disagreements < _max_tow_disagreements)
         {
-            msg[i] = _rx_buf.peek(next_byte++);
+            ++_msg_count_stale;
+            return;
         }
+    }
+    _tow_disagreements = 0;
+    if (_pps_locked)
+    {
+        _tow_s = (pvt.iTOW + 500) / 1000 % _secs_per_week;
+        _tow_valid = true;
+    }
+
+    bool const time_not_disconfirmed = (!pvt.confirmedAvai()) || (pvt.confirmedDate() && pvt.confirmedTime());
+    bool const time_ok = pvt.validDate() && pvt.validTime() && pvt.fullyResolved() && time_not_disconfirmed;
+
+    //printf("UBX-NAV-PVT     %lu    %02d-%02d-%02d %02d:%02d:%02d.%03ld %03ld %03ld +/- %5ld ns    (%s)      %ld.%07ld, %ld.%07ld - %d sats\n", pvt.iTOW, pvt.year, pvt.month, pvt.day, pvt.hour, pvt.min, pvt.sec, pvt.nano/1000000, pvt.nano/1000%1000, pvt.nano%1000, pvt.tAcc, time_ok ? " valid " : "INVALID", pvt.lat/10000000, labs(pvt.lat)%10000000, pvt.lon/10000000, labs(pvt.lon)%10000000, pvt.numSV);
 
-        actual_a = _rx_buf.peek(next_byte++);
-        actual_b = _rx_buf.peek(next_byte++);
+    _position_valid = pvt.gnssFixOK() && !pvt.invalidLlh();
+    if (_position_valid)
+    {
+        _lat = pvt.lat;
+        _lon = pvt.lon;
+    }
 
-        Checksum expected;
-        expected(*msg_class, *msg_id, *msg_len, msg);
-        if (expected.a != actual_a || expected.b != actual_b)
+    if (_survey.on_nav_pvt(pvt))
+    {
+        SurveyedPosition const & position = _survey.position();
+        printf("GPS survey complete: %" PRId32 " %" PRId32 " %" PRId32 " mm +/- %" PRIu32 " mm.\n",
+               position.lat, position.lon, position.height, position.acc);
+        if (_store && !_store->save(position))
         {
-            goto bad_packet;
+            printf("GPS survey not saved.\n");
         }
+        // Otherwise _configure() adds it, when it comes to that.
+        if (_configuring && _baud_negotiator.done())
+        {
+            _add_ubx_cfg_nav5_stationary();
+        }
+    }
 
-        _rx_buf.pop(next_byte);
-        return true;
+    if (time_ok && _pps_locked)
+    {
+        _tops_of_seconds.prev().set_utc_ymdhms(pvt.year, pvt.month, pvt.day, pvt.hour, pvt.min, pvt.sec);
+        _tops_of_seconds.next().set_from_prev_second(_tops_of_seconds.prev());
+    }
+    ++_msg_count_ubx_nav_pvt;
+}
 
-        bad_packet:
-        _rx_buf.pop(next_byte);
+void GpsUBlox::_on_nav_time_ls(UbxNavTimeLs const & time_ls)
+{
+    if (time_ls.version != 0)
+    {
+        return;
+    }
+    if (!_about_this_second(time_ls.iTOW))
+    {
+        ++_msg_count_stale;
+        return;
     }
 
-    return false;
+    //printf("UBX-NAV-TIMELS,%lu,%d,%d,%ld,%d,%d\n", time_ls.iTOW, time_ls.currLs, time_ls.lsChange, time_ls.timeToLsEvent, time_ls.validCurrLs(), time_ls.validTimeToLsEvent());
+
+    if (_pps_locked)
+    {
+        if (time_ls.validCurrLs())
+        {
+            _tops_of_seconds.prev().set_gps_minus_utc(time_ls.currLs);
+        }
+        if (time_ls.validTimeToLsEvent())
+        {
+            _tops_of_seconds.prev().set_next_leap_second(time_ls.timeToLsEvent, time_ls.lsChange);
+        }
+        _tops_of_seconds.next().set_from_prev_second(_tops_of_seconds.prev());
+    }
+    ++_msg_count_ubx_nav_time_ls;
 }
 
-void GpsUBlox::dispatch()
+void GpsUBlox::_on_tim_tp(UbxTimTp const & tim_tp)
 {
-    uint8_t rx_msg_class;
-    uint8_t rx_msg_id;
-    uint16_t rx_msg_len;
-    uint8_t rx_msg[92];
+    if (!tim_tp.qErrInvalid())
+    {
+        _q_err_ps = tim_tp.qErr;
+        _q_err_tow_ms = tim_tp.towMS;
+        _q_err_fresh = true;
+    }
+    ++_msg_count_ubx_tim_tp;
+}
 
-    _service_uart();
+bool gps_ublox_test()
+{
+    class NoPort: public SerialPort
+    {
+    public:
+        bool write(uint8_t const *, size_t) override { return true; }
+        bool idle() override { return true; }
+        void set_baud_rate(uint32_t) override {}
+    };
 
-    while (_read_ubx(&rx_msg_class, &rx_msg_id, &rx_msg_len, rx_msg, sizeof(rx_msg)))
+    class Line: public ByteSource
     {
-        if (rx_msg_class == 0x01) // UBX-NAV
+    public:
+        std::vector<uint8_t> bytes;
+
+        size_t read(uint8_t * const data, size_t const max_n) override
         {
-            if (rx_msg_id == 0x07) // UBX-NAV-PVT
+            size_t n = 0;
+            while (n < max_n && _pos < bytes.size())
             {
-                constexpr size_t len = 92;
-                if (rx_msg_len != len)
-                {
-                    continue;
-                }
-                uint32_t iTOW;
-                uint16_t year;
-                uint8_t month;
-                uint8_t day;
-                uint8_t hour;
-                uint8_t min;
-                uint8_t sec;
-                uint8_t valid;
-                uint32_t tAcc;
-                int32_t nano;
-                uint8_t fixType;
-                uint8_t flags;
-                uint8_t flags2;
-                uint8_t numSV;
-                int32_t lon;
-                int32_t lat;
-                int32_t height;
-                int32_t hMSL;
-                uint32_t hAcc;
-                uint32_t vAcc;
-                int32_t velN;
-                int32_t velE;
-                int32_t velD;
-                int32_t gSpeed;
-                int32_t headMot;
-                uint32_t sAcc;
-                uint32_t headAcc;
-                uint16_t pDOP;
-                uint16_t flags3;
-                int32_t headVeh;
-                int16_t magDec;
-                uint16_t magAcc;
-
-                uint8_t reserved;
-
-                (Unpack<len>(rx_msg, LittleEndian())
-                    >> iTOW
-                    >> year
-                    >> month
-                    >> day
-                    >> hour
-                    >> min
-                    >> sec
-                    >> valid
-                    >> tAcc
-                    >> nano
-                    >> fixType
-                    >> flags
-                    >> flags2
-                    >> numSV
-                    >> lon
-                    >> lat
-                    >> height
-                    >> hMSL
-                    >> hAcc
-                    >> vAcc
-                    >> velN
-                    >> velE
-                    >> velD
-                    >> gSpeed
-                    >> headMot
-                    >> sAcc
-                    >> headAcc
-                    >> pDOP
-                    >> flags3
-                    >> reserved
-                    >> reserved
-                    >> reserved
-                    >> reserved
-                    >> headVeh
-                    >> magDec
-                    >> magAcc).finalize();
-
-                #pragma GCC diagnostic push
-                #pragma GCC diagnostic ignored "-Wunused-variable"
-                bool const validDate =     valid & 0x01;
-                bool const validTime =     valid & 0x02;
-                bool const fullyResolved = valid & 0x04;
-                bool const validMag =      valid & 0x08;
-
-                bool const gnssFixOK =    flags & 0x01;
-                bool const diffSoln =     flags & 0x02;
-                uint8_t const psmState = (flags >> 2) && 0x07;
-                bool const headVehValid = flags & 0x20;
-                uint8_t const carrSoln = (flags >> 6) && 0x03;
-
-                bool const confirmedAvai = flags2 & 0x20;
-                bool const confirmedDate = flags2 & 0x40;
-                bool const confirmedTime = flags2 & 0x80;
-
-                bool const invalidLlh = flags3 & 0x0001;
-                uint8_t const lastCorrectionAge = (flags3 >> 1) & 0x000f;
-
-                bool const time_not_disconfirmed = (!confirmedAvai) || (confirmedDate && confirmedTime);
-                bool const time_ok = validDate && validTime && fullyResolved && time_not_disconfirmed;
-                #pragma GCC diagnostic pop
-
-                //printf("UBX-NAV-PVT     %lu    %02d-%02d-%02d %02d:%02d:%02d.%03ld %03ld %03ld +/- %5ld ns    (%s)      %ld.%07ld, %ld.%07ld - %d sats\n", iTOW, year, month, day, hour, min, sec, nano/1000000, nano/1000%1000, nano%1000, tAcc, time_ok ? " valid " : "INVALID", lat/10000000, labs(lat)%10000000, lon/10000000, labs(lon)%10000000, numSV);
-
-                if (time_ok && _pps_locked)
-                {
-                    _tops_of_seconds.prev().set_utc_ymdhms(year, month, day, hour, min, sec);
-                    _tops_of_seconds.next().set_from_prev_second(_tops_of_seconds.prev());
-                }
-                ++_msg_count_ubx_nav_pvt;
-            }
-            else if (rx_msg_id == 0x26) // UBX-NAV-TIMELS
-            {
-                constexpr size_t len = 24;
-                if (rx_msg_len != len)
-                {
-                    continue;
-                }
-                uint32_t iTOW;
-                uint8_t version;
-                uint8_t reserved;
-                uint8_t srcOfCurrLs;
-                int8_t currLs;
-                uint8_t srcOfLsChange;
-                int8_t lsChange;
-                int32_t timeToLsEvent;
-                uint16_t dateOfLsGpsWn;
-                uint16_t dateOfLsGpsDn;
-                uint8_t valid;
-
-                (Unpack<len>(rx_msg, LittleEndian())
-                    >> iTOW
-                    >> version
-                    >> reserved
-                    >> reserved
-                    >> reserved
-                    >> srcOfCurrLs
-                    >> currLs
-                    >> srcOfLsChange
-                    >> lsChange
-                    >> timeToLsEvent
-                    >> dateOfLsGpsWn
-                    >> dateOfLsGpsDn
-                    >> reserved
-                    >> reserved
-                    >> reserved
-                    >> valid).finalize();
-
-                if (version != 0)
-                {
-                    continue;
-                }
-
-                #pragma GCC diagnostic push
-                #pragma GCC diagnostic ignored "-Wunused-variable"
-                bool const validCurrLs        = valid & 0x01;
-                bool const validTimeToLsEvent = valid & 0x02;
-                #pragma GCC diagnostic pop
-
-                //printf("UBX-NAV-TIMELS,%lu,%d,%d,%ld,%d,%d\n", iTOW, currLs, lsChange, timeToLsEvent, validCurrLs, validTimeToLsEvent);
-
-                if (_pps_locked)
-                {
-                    if (validCurrLs)
-                    {
-                        _tops_of_seconds.prev().set_gps_minus_utc(currLs);
-                    }
-                    if (validTimeToLsEvent)
-                    {
-                        _tops_of_seconds.prev().set_next_leap_second(timeToLsEvent, lsChange);
-                    }
-                    _tops_of_seconds.next().set_from_prev_second(_tops_of_seconds.prev());
-                }
-                ++_msg_count_ubx_nav_time_ls;
+                data[n++] = bytes[_pos++];
             }
+            return n;
         }
+
+    private:
+        size_t _pos = 0;
+    };
+
+    NoPort port;
+    Line line;
+    GpsUBlox gps(port, line, false);
+
+    // 2024-03-10 12:00:00 UTC was 18 s into GPS second 36018 of its week.
+    uint32_t constexpr tow_s_at_noon = 36018;
+    auto const pvt_frame = [](uint8_t const sec, uint8_t * const out) {
+        UbxNavPvt pvt{};
+        pvt.iTOW = (tow_s_at_noon + sec) * 1000;
+        pvt.year = 2024;
+        pvt.month = 3;
+        pvt.day = 10;
+        pvt.hour = 12;
+        pvt.min = 0;
+        pvt.sec = sec;
+        pvt.valid = 0x07;
+        pvt.flags = 0x01;
+        pvt.lat = sec;
+        return ubx_encode(pvt, out);
+    };
+    // With a leap second long past, so the time carries from one second to the next.
+    auto const send_pvt = [&](uint8_t const sec) {
+        uint8_t frame[UbxNavPvt::len + ubx_overhead_len];
+        size_t len = pvt_frame(sec, frame);
+        line.bytes.insert(line.bytes.end(), frame, frame + len);
+
+        UbxNavTimeLs time_ls{};
+        time_ls.iTOW = (tow_s_at_noon + sec) * 1000;
+        time_ls.currLs = 18;
+        time_ls.timeToLsEvent = -100000000;
+        time_ls.valid = 0x03;
+        len = ubx_encode(time_ls, frame);
+        line.bytes.insert(line.bytes.end(), frame, frame + len);
+    };
+    auto const edge = [&]() {
+        gps.pps_lock_state(true);
+        gps.pps_pulsed();
+    };
+    auto const shows = [&](uint8_t const sec) {
+        TopOfSecond const & top = gps.tops_of_seconds().prev();
+        return top.utc_ymdhms_valid && top.utc_ymdhms == Ymdhms(2024, 3, 10, 12, 0, sec);
+    };
+    // The NAV-PVT last taken, which the time may have carried on from without.
+    auto const taken = [&](uint8_t const sec) {
+        int32_t lat;
+        int32_t lon;
+        return gps.position(lat, lon) && lat == sec;
+    };
+
+    for (uint8_t sec = 0; sec < 3; ++sec)
+    {
+        edge();
+        send_pvt(sec);
+        gps.dispatch(0);
+        test_assert(shows(sec));
+    }
+
+    // A damaged length, longer than any message but short enough to fit in the buffer, doesn't
+    // hold up the frame behind it.
+    edge();
+    uint8_t frame[UbxNavPvt::len + ubx_overhead_len];
+    size_t const len = pvt_frame(3, frame);
+    frame[5] = 0x01;
+    line.bytes.insert(line.bytes.end(), frame, frame + len);
+    send_pvt(3);
+    gps.dispatch(0);
+    test_assert(shows(3));
+    test_assert(taken(3));
+
+    // Messages about seconds gone by, as they'd come after a stall, don't set this one.
+    edge();
+    send_pvt(4);
+    gps.dispatch(0);
+    edge();
+    edge();
+    send_pvt(4);
+    send_pvt(5);
+    gps.dispatch(0);
+    test_assert(shows(6));
+    test_assert(taken(4));
+    edge();
+    send_pvt(7);
+    gps.dispatch(0);
+    test_assert(shows(7));
+
+    // But if the receiver keeps disagreeing, second after second, it's right.
+    for (uint8_t sec = 18; sec < 24; ++sec)
+    {
+        edge();
+        send_pvt(sec);
+        gps.dispatch(0);
     }
+    test_assert(shows(23));
+    test_assert(taken(23));
+
+    // A UBX-TIM-TP says how late the coming edge will be. Held up until that edge has gone by,
+    // or taken after it, it would say it of the wrong one, and is dropped.
+    auto const send_tim_tp = [&](uint8_t const sec, int32_t const q_err_ps) {
+        UbxTimTp tim_tp{};
+        tim_tp.towMS = (tow_s_at_noon + sec) * 1000;
+        tim_tp.qErr = q_err_ps;
+        uint8_t tim_tp_frame[UbxTimTp::len + ubx_overhead_len];
+        size_t const tim_tp_len = ubx_encode(tim_tp, tim_tp_frame);
+        line.bytes.insert(line.bytes.end(), tim_tp_frame, tim_tp_frame + tim_tp_len);
+    };
+    int32_t q_err_ps = 0;
+    send_tim_tp(24, 1234);
+    gps.dispatch(0);
+    test_assert(gps.take_quantization_error(q_err_ps));
+    test_assert_signed_eq(q_err_ps, 1234);
+    test_assert(!gps.take_quantization_error(q_err_ps));
+
+    edge();
+    send_pvt(24);
+    send_tim_tp(25, 2345);
+    gps.dispatch(0);
+    edge();
+    test_assert(!gps.take_quantization_error(q_err_ps));
+
+    send_pvt(25);
+    send_tim_tp(25, 3456);
+    gps.dispatch(0);
+    test_assert(!gps.take_quantization_error(q_err_ps));
+
+    send_tim_tp(26, 4567);
+    gps.dispatch(0);
+    test_assert(gps.take_quantization_error(q_err_ps));
+    test_assert_signed_eq(q_err_ps, 4567);
+
+    return true;
 }
@@ -1,25 +1,41 @@
 #pragma once
 
-#include "hardware/uart.h"
-
 #include "time.h"
+#include "ByteSource.h"
 #include "RingBuffer.h"
+#include "SerialPort.h"
+#include "SurveyIn.h"
+#include "UbxParser.h"
+#include "UbxMessages.h"
+#include "UbxConfigurator.h"
+#include "UbxBaudNegotiator.h"
+
+bool gps_ublox_test();
 
 class GpsUBlox
 {
 public:
-    GpsUBlox(uart_inst_t * const uart_id, uint const tx_pin, uint const rx_pin);
+    // Talks to the receiver through port and source, which start at its default baud rate.
+    // Without configure, it only listens, as when replaying a capture. A position surveyed
+    // before is loaded from store, and one surveyed now is saved there.
+    GpsUBlox(SerialPort & port, ByteSource & source, bool configure = true, PositionStore * store = nullptr);
 
+    // Configuration goes on in the background, from dispatch(). This is true once it's done.
     inline bool initialized_successfully() const
     {
         return _initialized_successfully;
     }
 
-    void dispatch();
+    void dispatch(uint64_t now_us);
 
     inline void pps_pulsed()
     {
         _tops_of_seconds.top_of_second_has_passed();
+        if (_tow_valid)
+        {
+            _tow_s = (_tow_s + 1) % _secs_per_week;
+        }
+        _tow_disagreement_counted = false;
     }
 
     inline void pps_lock_state(bool locked) {
@@ -27,89 +43,102 @@ public:
         if (!locked)
         {
             _tops_of_seconds.invalidate();
+            _tow_valid = false;
         }
     }
 
     inline TopsOfSeconds const & tops_of_seconds() const { return _tops_of_seconds; }
 
+    // Latitude and longitude of the last fix, in units of 1e-7 degrees.
+    inline bool position(int32_t & lat, int32_t & lon) const
+    {
+        lat = _lat;
+        lon = _lon;
+        return _position_valid;
+    }
+
+    // How late the next PPS edge will be, in picoseconds, from each UBX-TIM-TP that knows. One
+    // about any other edge, held up past the one it describes, is dropped.
+    bool take_quantization_error(int32_t & q_err_ps);
+
+    inline SurveyIn const & survey() const { return _survey; }
+
     void show_status() const;
 
 private:
     TopsOfSeconds _tops_of_seconds;
 
-    void _service_uart();
-
     bool _initialized_successfully = false;
 
-    uart_inst_t * const _uart_id;
-
     bool _pps_locked = false;
 
-    class Checksum
-    {
-    public:
-        void operator()(uint8_t const msg_class,
-                        uint8_t const msg_id,
-                        uint16_t const msg_len,
-                        uint8_t const * const msg);
-
-        uint8_t a;
-        uint8_t b;
-
-    private:
-        inline void _next_byte(uint8_t const byte);
-    };
-
-    void _send_ubx(uint8_t const msg_class,
-                   uint8_t const msg_id,
-                   uint16_t const msg_len,
-                   uint8_t const * const msg);
-
-    bool _send_ubx_cfg(uint8_t const msg_id,
-                       uint16_t const msg_len,
-                       uint8_t const * const msg);
-
-    bool _send_ubx_cfg_prt(uint8_t const port_id,
-                           uint16_t const tx_ready,
-                           uint32_t const mode,
-                           uint32_t const baud_rate,
-                           uint16_t const in_proto_mask,
-                           uint16_t const out_proto_mask,
-                           uint16_t const flags);
-
-    bool _send_ubx_cfg_msg(uint8_t const msg_class,
-                           uint8_t const msg_id,
-                           uint8_t const rate);
-
-    bool _send_ubx_cfg_tp5(uint8_t const tpIdx,
-                           int16_t const antCableDelay,
-                           int16_t const rfGroupDelay,
-                           uint32_t const freqPeriod,
-                           uint32_t const freqPeriodLock,
-                           uint32_t const pulseLenRatio,
-                           uint32_t const pulseLenRatioLock,
-                           int32_t const userConfigDelay,
-                           bool active,
-                           bool lockGnssFreq,
-                           bool lockedOtherSet,
-                           bool isFreq,
-                           bool isLength,
-                           bool alignToTow,
-                           bool polarity,
-                           uint8_t gridUtcGnss,
-                           uint8_t syncMode);
-
-    bool _read_ubx(uint8_t * msg_class,
-                   uint8_t * msg_id,
-                   uint16_t * msg_len,
-                   uint8_t * msg,
-                   uint16_t msg_buffer_len);
-
-    RingBuffer<uint8_t, 2000> _rx_buf;
-
-    static uint8_t constexpr _sync1 = 181;
-    static uint8_t constexpr _sync2 = 98;
+    int32_t _lat = 0;
+    int32_t _lon = 0;
+    bool _position_valid = false;
+
+    int32_t _q_err_ps = 0;
+    uint32_t _q_err_tow_ms = 0;
+    bool _q_err_fresh = false;
+
+    SerialPort & _port;
+    ByteSource & _source;
+    bool const _configuring;
+    UbxBaudNegotiator _baud_negotiator;
+    UbxConfigurator _configurator;
+    void _configure();
+    void _on_configured();
+
+    PositionStore * const _store;
+    SurveyIn _survey;
+    void _add_ubx_cfg_nav5_stationary();
+    void _send_ubx_mga_ini_pos_llh();
+
+    void _add_ubx_cfg_msg(uint8_t const msg_class,
+                          uint8_t const msg_id,
+                          uint8_t const rate);
+
+    void _add_ubx_cfg_tp5(uint8_t const tpIdx,
+                          int16_t const antCableDelay,
+                          int16_t const rfGroupDelay,
+                          uint32_t const freqPeriod,
+                          uint32_t const freqPeriodLock,
+                          uint32_t const pulseLenRatio,
+                          uint32_t const pulseLenRatioLock,
+                          int32_t const userConfigDelay,
+                          bool active,
+                          bool lockGnssFreq,
+                          bool lockedOtherSet,
+                          bool isFreq,
+                          bool isLength,
+                          bool alignToTow,
+                          bool polarity,
+                          uint8_t gridUtcGnss,
+                          uint8_t syncMode);
+
+    static size_t constexpr _rx_buf_len = 2000;
+    // The longest message the receiver is asked for, or answers with.
+    static uint16_t constexpr _max_payload_len =
+        std::max({UbxAck::len, UbxNavPvt::len, UbxNavTimeLs::len, UbxTimTp::len, UbxCfgPrt::len});
+    RingBuffer<uint8_t, _rx_buf_len> _rx_buf;
+    UbxParser<_rx_buf_len> _ubx_parser{_rx_buf, _max_payload_len};
+
+    // The GPS time of week the second since the last edge began at, as the NAV-PVTs have it
+    // while PPS is locked. A message about any other second has been held up behind damage on
+    // the line, and is dropped. If they disagree for long enough, it's this that's wrong.
+    static uint32_t constexpr _secs_per_week = 7 * secs_per_day;
+    static uint8_t constexpr _max_tow_disagreements = 3;
+    uint32_t _tow_s = 0;
+    bool _tow_valid = false;
+    uint8_t _tow_disagreements = 0;
+    bool _tow_disagreement_counted = false;
+    bool _about_this_second(uint32_t iTOW);
+
+    void _on_nav_pvt(UbxNavPvt const & pvt);
+    void _on_nav_time_ls(UbxNavTimeLs const & time_ls);
+    void _on_tim_tp(UbxTimTp const & tim_tp);
 
     uint64_t _msg_count_ubx_nav_pvt = 0;
     uint64_t _msg_count_ubx_nav_time_ls = 0;
+    uint64_t _msg_count_ubx_tim_tp = 0;
+    uint64_t _msg_count_stale = 0;
 };
@@ -0,0 +1,111 @@
+#include "HoldoverSimulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include "Pps.h"
+#include "util.h"
+
+namespace
+{
+    double constexpr cycles_per_second = 125000000;
+    double constexpr cycles_per_pulse = cycles_per_second / 10;
+
+    class Room
+    {
+    public:
+        explicit Room(ThermalScenario const & scenario):
+            _scenario(scenario),
+            _lcg(scenario.seed),
+            _board_c(scenario.mean_c)
+        {
+        }
+
+        // On to the next second. How long it was on the chip's clock, in GPS seconds.
+        double next_second()
+        {
+            ++_second;
+            double const air_c = _scenario.mean_c + _scenario.swing_c * std::sin(_second * 2 * M_PI / _scenario.period_s);
+            _board_c += (air_c - _board_c) / _scenario.lag_s;
+            double const d = _board_c - 25;
+            return 1 + (_scenario.c0 + d * (_scenario.c1 + d * _scenario.c2)) * 1e-6;
+        }
+
+        double sensor_c()
+        {
+            _lcg = _lcg * 1664525 + 1013904223;
+            double const noise = (_lcg >> 8) / double(1 << 23) - 1;
+            return _board_c + _scenario.sensor_noise_c * noise;
+        }
+
+    private:
+        ThermalScenario const & _scenario;
+        uint32_t _lcg;
+        uint64_t _second = 0;
+        double _board_c;
+    };
+}
+
+HoldoverResult simulate_holdover(ThermalScenario const & scenario)
+{
+    IdlePpsSource source;
+    auto const pps = std::make_unique<Pps>(source);
+    pps->set_quiet(true);
+    Room room(scenario);
+
+    // Where each edge falls on the chip's clock, in microseconds and in cycles.
+    double edge_us = 1e6;
+    double edge_cycles = 0;
+    for (uint32_t second = 0; second < scenario.locked_s; ++second)
+    {
+        double const chip_per_gps = room.next_second();
+        double const prev_edge_cycles = edge_cycles;
+        edge_us += 1e6 * chip_per_gps;
+        edge_cycles += cycles_per_second * chip_per_gps;
+        uint32_t const cycles = std::floor(edge_cycles) - std::floor(prev_edge_cycles);
+
+        pps->simulate_edge(cycles, std::lround(cycles_per_pulse * chip_per_gps), std::llround(edge_us));
+        if (scenario.temperature_sensor)
+        {
+            pps->set_temperature(room.sensor_c());
+        }
+        pps->simulate_dispatch(std::llround(edge_us) + 1000);
+    }
+
+    uint32_t const last_edge = pps->get_completed_seconds();
+    HoldoverResult result = {false, 0, 0};
+    double now_us = edge_us + 1000;
+    for (uint32_t second = 1; second <= scenario.holdover_s; ++second)
+    {
+        edge_us += 1e6 * room.next_second();
+        for (; now_us < edge_us; now_us += 100000)
+        {
+            pps->simulate_dispatch(now_us);
+        }
+        if (scenario.temperature_sensor)
+        {
+            pps->set_temperature(room.sensor_c());
+        }
+
+        double const error_us = static_cast<double>(pps->get_time_us_of(last_edge + second, 0)) - edge_us;
+        result.max_error_us = std::max(result.max_error_us, std::abs(error_us));
+        result.final_error_us = error_us;
+    }
+    result.compensated = pps->holding_over() && scenario.temperature_sensor && pps->thermal_model().usable();
+    return result;
+}
+
+bool holdover_simulation_test()
+{
+    ThermalScenario scenario;
+    HoldoverResult const compensated = simulate_holdover(scenario);
+    scenario.temperature_sensor = false;
+    HoldoverResult const uncompensated = simulate_holdover(scenario);
+
+    test_assert(compensated.compensated && !uncompensated.compensated);
+    test_assert(uncompensated.max_error_us > 200);
+    test_assert(compensated.max_error_us < 0.1 * uncompensated.max_error_us);
+
+    return true;
+}
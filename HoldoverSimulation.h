@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+bool holdover_simulation_test();
+
+// A room whose temperature cycles, and a crystal whose frequency follows it.
+struct ThermalScenario
+{
+    double mean_c = 23;
+    double swing_c = 3;
+    double period_s = 1800;
+    // How slowly the board follows the air.
+    double lag_s = 300;
+    // Of each reading of the die temperature, either way.
+    double sensor_noise_c = 0.5;
+
+    // The crystal's offset in ppm is c0 + c1 d + c2 d^2, with d degrees above 25 C.
+    double c0 = -8;
+    double c1 = 0.25;
+    double c2 = -0.015;
+
+    // Locked, then with no edges at all.
+    uint32_t locked_s = 6 * 3600;
+    uint32_t holdover_s = 3600;
+
+    // Without one, Pps can only hold the frequency it had.
+    bool temperature_sensor = true;
+    uint32_t seed = 1;
+};
+
+struct HoldoverResult
+{
+    bool compensated;
+    // Where Pps put the top of each second during holdover, less where it really was.
+    double max_error_us;
+    double final_error_us;
+};
+
+/*
+ * Runs Pps through a ThermalScenario: edges from the PIO program for locked_s, then none for
+ * holdover_s, with the die temperature each second if there's a sensor.
+ */
+HoldoverResult simulate_holdover(ThermalScenario const & scenario);
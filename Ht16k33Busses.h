@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Five I2C busses of HT16K33s, clocked together: a write goes to the same address on all five
+// at once, with the same number of bytes to each, so Display can run against a simulated set.
+class Ht16k33Busses
+{
+public:
+    static size_t constexpr max_cmd_length = 17;
+
+    // False if a write is still in progress.
+    virtual bool begin_write(
+        uint8_t const addr,
+        size_t const cmd_length,
+        uint8_t const * const cmd0,
+        uint8_t const * const cmd1,
+        uint8_t const * const cmd2,
+        uint8_t const * const cmd3,
+        uint8_t const * const cmd4) = 0;
+
+    // Returns true if the operation is complete, sets success to true if all acks were received successfully.
+    virtual bool try_end_write(bool & success) = 0;
+
+    virtual bool blocking_write(
+        uint8_t const addr,
+        size_t const cmd_length,
+        uint8_t const * const cmd0,
+        uint8_t const * const cmd1,
+        uint8_t const * const cmd2,
+        uint8_t const * const cmd3,
+        uint8_t const * const cmd4) = 0;
+};
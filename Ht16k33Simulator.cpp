@@ -0,0 +1,76 @@
+#include "Ht16k33Simulator.h"
+
+bool Ht16k33Simulator::begin_write(
+    uint8_t const addr,
+    size_t const cmd_length,
+    uint8_t const * const cmd0,
+    uint8_t const * const cmd1,
+    uint8_t const * const cmd2,
+    uint8_t const * const cmd3,
+    uint8_t const * const cmd4)
+{
+    if (_in_progress)
+    {
+        return false;
+    }
+    _in_progress = true;
+    _succeeded = _write(addr, cmd_length, {cmd0, cmd1, cmd2, cmd3, cmd4});
+    return true;
+}
+
+bool Ht16k33Simulator::try_end_write(bool & success)
+{
+    if (!_in_progress)
+    {
+        return false;
+    }
+    _in_progress = false;
+    success = _succeeded;
+    return true;
+}
+
+bool Ht16k33Simulator::blocking_write(
+    uint8_t const addr,
+    size_t const cmd_length,
+    uint8_t const * const cmd0,
+    uint8_t const * const cmd1,
+    uint8_t const * const cmd2,
+    uint8_t const * const cmd3,
+    uint8_t const * const cmd4)
+{
+    if (_in_progress)
+    {
+        return false;
+    }
+    return _write(addr, cmd_length, {cmd0, cmd1, cmd2, cmd3, cmd4});
+}
+
+bool Ht16k33Simulator::_write(uint8_t const addr, size_t const cmd_length, std::array<uint8_t const *, 5> const & cmds)
+{
+    ++_writes;
+    _bytes += cmds.size() * (1 + cmd_length);
+
+    if (_fail_next || cmd_length == 0 || cmd_length > max_cmd_length)
+    {
+        _fail_next = false;
+        return false;
+    }
+
+    for (size_t bus = 0; bus < cmds.size(); ++bus)
+    {
+        // A first byte below 0x10 sets the RAM pointer, and anything after it is data. Anything
+        // else is a command: the oscillator, display and brightness settings, which aren't kept.
+        if (cmds[bus][0] >= ram_length)
+        {
+            continue;
+        }
+        Ram & ram = _chips[addr][bus];
+        size_t pointer = cmds[bus][0];
+        for (size_t i = 1; i < cmd_length; ++i)
+        {
+            ram[pointer] = cmds[bus][i];
+            pointer = (pointer + 1) % ram_length;
+        }
+    }
+    return true;
+}
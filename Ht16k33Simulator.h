@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <map>
+
+#include "Ht16k33Busses.h"
+
+/*
+ * Five busses of HT16K33s, as Display sees them. Each chip keeps its display RAM, moving along it
+ * by itself after each byte written, and the bytes that cross the wires are counted, the address
+ * byte of each write on each bus included.
+ *
+ * A write is over as soon as anyone asks.
+ */
+class Ht16k33Simulator: public Ht16k33Busses
+{
+public:
+    static size_t constexpr ram_length = 16;
+    using Ram = std::array<uint8_t, ram_length>;
+
+    bool begin_write(
+        uint8_t const addr,
+        size_t const cmd_length,
+        uint8_t const * const cmd0,
+        uint8_t const * const cmd1,
+        uint8_t const * const cmd2,
+        uint8_t const * const cmd3,
+        uint8_t const * const cmd4) override;
+
+    bool try_end_write(bool & success) override;
+
+    bool blocking_write(
+        uint8_t const addr,
+        size_t const cmd_length,
+        uint8_t const * const cmd0,
+        uint8_t const * const cmd1,
+        uint8_t const * const cmd2,
+        uint8_t const * const cmd3,
+        uint8_t const * const cmd4) override;
+
+    // The next write goes unacknowledged, and changes nothing.
+    void fail_next_write() { _fail_next = true; }
+
+    Ram const & ram(size_t bus, uint8_t addr) { return _chips[addr][bus]; }
+
+    uint64_t bytes() const { return _bytes; }
+    uint64_t writes() const { return _writes; }
+    void reset_counts() { _bytes = 0; _writes = 0; }
+
+private:
+    std::map<uint8_t, std::array<Ram, 5>> _chips;
+    bool _fail_next = false;
+    bool _in_progress = false;
+    bool _succeeded = false;
+    uint64_t _bytes = 0;
+    uint64_t _writes = 0;
+
+    bool _write(uint8_t addr, size_t cmd_length, std::array<uint8_t const *, 5> const & cmds);
+};
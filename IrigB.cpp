@@ -0,0 +1,171 @@
+#include "IrigB.h"
+
+#include <cstring>
+
+#include "util.h"
+
+namespace
+{
+    // Least significant bit first, starting at the given slot.
+    void put_bits(IrigBFrame & frame, size_t slot, uint32_t value, size_t n_bits)
+    {
+        for (size_t i = 0; i < n_bits; ++i)
+        {
+            frame[slot + i] = ((value >> i) & 1) ? IrigBSymbol::One : IrigBSymbol::Zero;
+        }
+    }
+}
+
+void irig_b_frame(Ymdhms const & utc, IrigBFrame & frame)
+{
+    frame.fill(IrigBSymbol::Zero);
+
+    // Reference marker, then P1 through P9, then P0 which leads into the next frame.
+    frame[0] = IrigBSymbol::Marker;
+    for (size_t slot = 9; slot < irig_b_symbols_per_frame; slot += 10)
+    {
+        frame[slot] = IrigBSymbol::Marker;
+    }
+
+    // Seconds run to 60 during a leap second, which the tens digit has room for.
+    put_bits(frame,  1, utc.sec % 10, 4);
+    put_bits(frame,  6, utc.sec / 10, 3);
+
+    put_bits(frame, 10, utc.min % 10, 4);
+    put_bits(frame, 15, utc.min / 10, 3);
+
+    put_bits(frame, 20, utc.hour % 10, 4);
+    put_bits(frame, 25, utc.hour / 10, 2);
+
+    uint16_t const day_of_year = utc.day_of_year();
+    put_bits(frame, 30, day_of_year % 10, 4);
+    put_bits(frame, 35, day_of_year / 10 % 10, 4);
+    put_bits(frame, 40, day_of_year / 100, 2);
+
+    uint8_t const year = utc.year % 100;
+    put_bits(frame, 50, year % 10, 4);
+    put_bits(frame, 55, year / 10, 4);
+
+    uint32_t const seconds_of_day = (utc.hour * min_per_hour + utc.min) * secs_per_min + utc.sec;
+    put_bits(frame, 80, seconds_of_day, 9);
+    put_bits(frame, 90, seconds_of_day >> 9, 8);
+}
+
+void irig_b_frame_string(IrigBFrame const & frame, char (&str)[irig_b_symbols_per_frame + 1])
+{
+    for (size_t i = 0; i < irig_b_symbols_per_frame; ++i)
+    {
+        switch (frame[i])
+        {
+        case IrigBSymbol::Zero:   str[i] = '0'; break;
+        case IrigBSymbol::One:    str[i] = '1'; break;
+        case IrigBSymbol::Marker: str[i] = 'P'; break;
+        }
+    }
+    str[irig_b_symbols_per_frame] = '\0';
+}
+
+void irig_b_words(IrigBFrame const & frame, uint32_t cycles_per_second, IrigBWords & words)
+{
+    uint32_t const cycles_per_ms = cycles_per_second / 1000;
+    uint32_t const cycles_per_slot = cycles_per_ms * 10;
+
+    for (size_t i = 0; i < irig_b_symbols_per_frame; ++i)
+    {
+        uint32_t high_ms = 2;
+        if (frame[i] == IrigBSymbol::One)
+        {
+            high_ms = 5;
+        }
+        else if (frame[i] == IrigBSymbol::Marker)
+        {
+            high_ms = 8;
+        }
+
+        uint32_t const high_cycles = high_ms * cycles_per_ms;
+        words[2*i]     = high_cycles - irig_b_high_overhead_cycles;
+        words[2*i + 1] = cycles_per_slot - high_cycles - irig_b_low_overhead_cycles;
+    }
+
+    words[irig_b_words_per_frame - 1] = 0;
+}
+
+bool irig_b_test()
+{
+    IrigBFrame frame;
+    char str[irig_b_symbols_per_frame + 1];
+
+    // Day 185, 72930 seconds into the day.
+    irig_b_frame(Ymdhms(2002, 7, 4, 20, 15, 30), frame);
+    irig_b_frame_string(frame, str);
+    test_assert(strcmp(str,
+        "P00000110P"
+        "101001000P"
+        "000000100P"
+        "101000001P"
+        "100000000P"
+        "010000000P"
+        "000000000P"
+        "000000000P"
+        "010001110P"
+        "011100010P") == 0);
+
+    // The leap second at the end of 2016, day 366, 86400 seconds into the day.
+    irig_b_frame(Ymdhms(2016, 12, 31, 23, 59, 60), frame);
+    irig_b_frame_string(frame, str);
+    test_assert(strcmp(str,
+        "P00000011P"
+        "100101010P"
+        "110000100P"
+        "011000110P"
+        "110000000P"
+        "011001000P"
+        "000000000P"
+        "000000000P"
+        "000000011P"
+        "000101010P") == 0);
+
+    irig_b_frame(Ymdhms(2024, 1, 1, 0, 0, 0), frame);
+    irig_b_frame_string(frame, str);
+    test_assert(strcmp(str,
+        "P00000000P"
+        "000000000P"
+        "000000000P"
+        "100000000P"
+        "000000000P"
+        "001000100P"
+        "000000000P"
+        "000000000P"
+        "000000000P"
+        "000000000P") == 0);
+
+    IrigBWords words;
+    uint32_t constexpr cycles_per_second = 125000000;
+    irig_b_frame(Ymdhms(2002, 7, 4, 20, 15, 30), frame);
+    irig_b_words(frame, cycles_per_second, words);
+
+    // Reference marker, 8 ms high, 2 ms low.
+    test_assert_unsigned_eq(words[0], (uint32_t)(1000000 - irig_b_high_overhead_cycles));
+    test_assert_unsigned_eq(words[1], (uint32_t)(250000 - irig_b_low_overhead_cycles));
+    // Zero, 2 ms high.
+    test_assert_unsigned_eq(words[2], (uint32_t)(250000 - irig_b_high_overhead_cycles));
+    test_assert_unsigned_eq(words[3], (uint32_t)(1000000 - irig_b_low_overhead_cycles));
+    // One, 5 ms high.
+    test_assert_unsigned_eq(words[12], (uint32_t)(625000 - irig_b_high_overhead_cycles));
+    test_assert_unsigned_eq(words[13], (uint32_t)(625000 - irig_b_low_overhead_cycles));
+    // P0 ends the frame 2 ms early, waiting for the edge.
+    test_assert_unsigned_eq(words[irig_b_words_per_frame - 2], (uint32_t)(1000000 - irig_b_high_overhead_cycles));
+    test_assert_unsigned_eq(words[irig_b_words_per_frame - 1], (uint32_t)0);
+
+    // With the overhead added back, the frame runs 998 ms before waiting on the next edge.
+    uint64_t total_cycles = 0;
+    for (size_t i = 0; i < irig_b_symbols_per_frame - 1; ++i)
+    {
+        total_cycles += words[2*i] + irig_b_high_overhead_cycles;
+        total_cycles += words[2*i + 1] + irig_b_low_overhead_cycles;
+    }
+    total_cycles += words[irig_b_words_per_frame - 2] + irig_b_high_overhead_cycles;
+    test_assert(total_cycles == static_cast<uint64_t>(cycles_per_second) * 998 / 1000);
+
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "time.h"
+
+bool irig_b_test();
+
+/*
+ * IRIG-B time code (IRIG Standard 200), 100 symbols per second, one every 10 ms.
+ * Each symbol is a pulse at the start of its slot: 2 ms for a zero, 5 ms for a one,
+ * 8 ms for a position marker. The frame's on-time point is the leading edge of
+ * the reference marker in slot 0, and the time it carries is the time of that edge.
+ *
+ * Frames carry BCD time of year and straight binary seconds of day in UTC, as in
+ * B000 (pulse width code) and B120 (the same code on a 1 kHz carrier). The two digit
+ * BCD year goes in control function slots 50-58, where B004/B124 put it; receivers
+ * expecting B000 treat those slots as unused control functions.
+ */
+
+enum class IrigBSymbol: uint8_t
+{
+    Zero,
+    One,
+    Marker,
+};
+
+size_t constexpr irig_b_symbols_per_frame = 100;
+using IrigBFrame = std::array<IrigBSymbol, irig_b_symbols_per_frame>;
+
+void irig_b_frame(Ymdhms const & utc, IrigBFrame & frame);
+
+// Frame as a string of '0', '1', and 'P', for tests and debugging.
+void irig_b_frame_string(IrigBFrame const & frame, char (&str)[irig_b_symbols_per_frame + 1]);
+
+/*
+ * Words for irig_b.pio, two per symbol: cycles to hold the line high, then low, less the
+ * cycles the program spends on its own instructions. The low word of the last symbol is
+ * zero, which sends the program back to wait for the next PPS edge instead, so every frame
+ * starts on its edge no matter how far the chip clock has drifted.
+ */
+size_t constexpr irig_b_words_per_frame = 2 * irig_b_symbols_per_frame;
+using IrigBWords = std::array<uint32_t, irig_b_words_per_frame>;
+
+// Instructions executed per high and low phase in irig_b.pio, outside the counting loops.
+uint32_t constexpr irig_b_high_overhead_cycles = 4;
+uint32_t constexpr irig_b_low_overhead_cycles = 6;
+
+void irig_b_words(IrigBFrame const & frame, uint32_t cycles_per_second, IrigBWords & words);
@@ -0,0 +1,92 @@
+#include "IrigBOutput.h"
+
+#include "pico/time.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+
+#include "irig_b.pio.h"
+
+#include "util.h"
+
+IrigBOutput::IrigBOutput(Pps const & pps,
+                         GpsUBlox const & gps,
+                         PIO pio,
+                         uint const out_pin,
+                         uint const pps_pin):
+    _pps(pps),
+    _gps(gps),
+    _pio(pio),
+    _cycles_per_second(clock_get_hz(clk_sys))
+{
+    _offset = pio_add_program(_pio, &irig_b_program);
+    _sm = pio_claim_unused_sm(_pio, true);
+    irig_b_program_init(_pio, _sm, _offset, out_pin, pps_pin);
+
+    _dma_channel = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(_dma_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(_pio, _sm, true));
+    dma_channel_configure(_dma_channel, &c, &_pio->txf[_sm], nullptr, irig_b_words_per_frame, false);
+}
+
+void IrigBOutput::dispatch(uint32_t const completed_seconds)
+{
+    usec_t const now = time_us_64();
+
+    if (_queued)
+    {
+        if (signed_difference(completed_seconds, _queued_for_completed_seconds) >= 0)
+        {
+            _queued = false;
+        }
+        else if (_pps.get_time_us_of(_queued_for_completed_seconds - 1, _edge_timeout_us) <= now)
+        {
+            // The edge never came. Don't let the frame go out on some later one.
+            _reset();
+            ++_missed_count;
+        }
+    }
+
+    if (_prepared_for_completed_seconds != completed_seconds + 1 &&
+        _pps.get_time_us_of(completed_seconds, _prepare_us) <= now)
+    {
+        _prepare(completed_seconds + 1);
+    }
+
+    // The previous frame is still going out until its last few words are in the FIFO.
+    if (_prepared && !dma_channel_is_busy(_dma_channel))
+    {
+        dma_channel_transfer_from_buffer_now(_dma_channel, _words[_build_buffer].data(), irig_b_words_per_frame);
+        _build_buffer = 1 - _build_buffer;
+        _prepared = false;
+        _queued = true;
+        _queued_for_completed_seconds = _prepared_for_completed_seconds;
+    }
+}
+
+void IrigBOutput::_prepare(uint32_t const completed_seconds)
+{
+    _prepared_for_completed_seconds = completed_seconds;
+    _prepared = false;
+
+    TopOfSecond const & top = _gps.tops_of_seconds().next();
+    if (!(top.utc_ymdhms_valid && _pps.locked()))
+    {
+        ++_missed_count;
+        return;
+    }
+
+    IrigBFrame frame;
+    irig_b_frame(top.utc_ymdhms, frame);
+    irig_b_words(frame, _cycles_per_second, _words[_build_buffer]);
+    _prepared = true;
+}
+
+void IrigBOutput::_reset()
+{
+    dma_channel_abort(_dma_channel);
+    irig_b_program_reset(_pio, _sm, _offset);
+    _queued = false;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wvolatile"
+#include "hardware/pio.h"
+#pragma GCC diagnostic pop
+
+#include "Pps.h"
+#include "GpsUBlox.h"
+#include "IrigB.h"
+
+/*
+ * IRIG-B pulse width code (DCLS) on a GPIO, for lab equipment.
+ *
+ * Each frame is built during the second before the edge it describes, and handed to the
+ * PIO by DMA. The PIO starts every frame on the PPS edge itself, so the CPU does no
+ * per-bit work and its timing has no effect on the output.
+ */
+class IrigBOutput
+{
+public:
+    IrigBOutput(Pps const & pps,
+                GpsUBlox const & gps,
+                PIO pio,
+                uint const out_pin,
+                uint const pps_pin);
+
+    void dispatch(uint32_t const completed_seconds);
+
+    uint32_t missed_count() const { return _missed_count; }
+
+private:
+    Pps const & _pps;
+    GpsUBlox const & _gps;
+    PIO _pio;
+    uint _sm;
+    uint _offset;
+    uint _dma_channel;
+    uint32_t _cycles_per_second;
+
+    // Frames are built once this far into the second before they describe.
+    static uint32_t constexpr _prepare_us = 500000;
+
+    // Give up on a queued frame's edge this far past the previous one.
+    static uint32_t constexpr _edge_timeout_us = 1100000;
+
+    // One buffer is read by DMA while the next frame is built in the other.
+    IrigBWords _words[2];
+    size_t _build_buffer = 0;
+    uint32_t _prepared_for_completed_seconds = 0;
+    bool _prepared = false;
+    uint32_t _queued_for_completed_seconds = 0;
+    bool _queued = false;
+
+    // Seconds for which no frame went out, because the time wasn't known or the edge didn't come.
+    uint32_t _missed_count = 0;
+
+    void _prepare(uint32_t const completed_seconds);
+    void _reset();
+};
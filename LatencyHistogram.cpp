@@ -0,0 +1,96 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+
+#include "util.h"
+
+LatencyHistogram::LatencyHistogram(uint32_t const cycles_per_bin):
+    _cycles_per_bin(cycles_per_bin)
+{
+}
+
+void LatencyHistogram::add(uint32_t const cycles)
+{
+    ++_bins[std::min<size_t>(cycles / _cycles_per_bin, bins - 1)];
+    ++_count;
+    _total_cycles += cycles;
+    _max_cycles = std::max(_max_cycles, cycles);
+}
+
+void LatencyHistogram::reset()
+{
+    _bins = {};
+    _count = 0;
+    _total_cycles = 0;
+    _max_cycles = 0;
+}
+
+uint32_t LatencyHistogram::percentile_cycles(double const fraction) const
+{
+    // Rounded up, but not for the rounding in fraction itself.
+    uint32_t const wanted = std::max(1.0, std::ceil(fraction * _count - 1e-6));
+    uint32_t seen = 0;
+    for (size_t bin = 0; bin < bins - 1; ++bin)
+    {
+        seen += _bins[bin];
+        if (seen >= wanted)
+        {
+            return std::min<uint32_t>((bin + 1) * _cycles_per_bin, _max_cycles);
+        }
+    }
+    return _max_cycles;
+}
+
+void LatencyHistogram::print(char const * const name, uint32_t const cycles_per_us) const
+{
+    double const us_per_bin = static_cast<double>(_cycles_per_bin) / cycles_per_us;
+    printf("%s: %" PRIu32 ", mean %.2f us, 99%% under %.2f us, max %.2f us\n",
+           name,
+           _count,
+           mean_cycles() / cycles_per_us,
+           static_cast<double>(percentile_cycles(0.99)) / cycles_per_us,
+           static_cast<double>(_max_cycles) / cycles_per_us);
+    for (size_t bin = 0; bin < bins; ++bin)
+    {
+        if (_bins[bin] > 0)
+        {
+            printf("  %6.2f us%s %10" PRIu32 "\n", bin * us_per_bin, bin == bins - 1 ? "+" : " ", _bins[bin]);
+        }
+    }
+}
+
+bool latency_histogram_test()
+{
+    LatencyHistogram histogram(125);
+    test_assert(histogram.count() == 0u);
+    test_assert(histogram.mean_cycles() == 0);
+
+    for (uint32_t i = 0; i < 98; ++i)
+    {
+        histogram.add(60 + i % 3);
+    }
+    histogram.add(300);
+    histogram.add(1000000);
+    test_assert(histogram.count() == 100u);
+    test_assert(histogram.count(0) == 98u);
+    test_assert(histogram.count(2) == 1u);
+    test_assert(histogram.count(LatencyHistogram::bins - 1) == 1u);
+    test_assert(histogram.max_cycles() == 1000000u);
+
+    // The first 98 came in the first bin, the 99th in the third, and the last off the end.
+    test_assert(histogram.percentile_cycles(0.5) == 125u);
+    test_assert(histogram.percentile_cycles(0.97) == 125u);
+    test_assert(histogram.percentile_cycles(0.98) == 125u);
+    test_assert(histogram.percentile_cycles(0.99) == 375u);
+    test_assert(histogram.percentile_cycles(0.995) == 1000000u);
+
+    histogram.reset();
+    test_assert(histogram.count() == 0u);
+    test_assert(histogram.count(0) == 0u);
+    test_assert(histogram.max_cycles() == 0u);
+
+    return true;
+}
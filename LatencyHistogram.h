@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+bool latency_histogram_test();
+
+/*
+ * How long something took to be noticed, in cycles of the chip's clock, counted into bins of a
+ * fixed width. The last bin takes everything longer.
+ */
+class LatencyHistogram
+{
+public:
+    static size_t constexpr bins = 32;
+
+    explicit LatencyHistogram(uint32_t cycles_per_bin);
+
+    void add(uint32_t cycles);
+    void reset();
+
+    uint32_t count() const { return _count; }
+    uint32_t count(size_t bin) const { return _bins[bin]; }
+    uint32_t max_cycles() const { return _max_cycles; }
+    double mean_cycles() const { return _count ? static_cast<double>(_total_cycles) / _count : 0; }
+
+    // The top of the bin the given fraction of the latencies fell in or below, or the longest
+    // latency if that's less.
+    uint32_t percentile_cycles(double fraction) const;
+
+    void print(char const * name, uint32_t cycles_per_us) const;
+
+private:
+    uint32_t const _cycles_per_bin;
+    std::array<uint32_t, bins> _bins = {};
+    uint32_t _count = 0;
+    uint64_t _total_cycles = 0;
+    uint32_t _max_cycles = 0;
+};
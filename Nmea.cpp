@@ -0,0 +1,98 @@
+#include "Nmea.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "util.h"
+
+uint8_t nmea_checksum(char const * begin, char const * end)
+{
+    uint8_t sum = 0;
+    for (char const * c = begin; c < end; ++c)
+    {
+        sum ^= static_cast<uint8_t>(*c);
+    }
+    return sum;
+}
+
+namespace
+{
+    bool finish_sentence(char * buf, size_t buf_len, int len)
+    {
+        if (len < 0 || static_cast<size_t>(len) + 5 >= buf_len)
+        {
+            return false;
+        }
+        snprintf(buf + len, buf_len - len, "*%02X\r\n", nmea_checksum(buf + 1, buf + len));
+        return true;
+    }
+
+    // Degrees and decimal minutes, as in ddmm.mmmm
+    void split_angle(int32_t angle, int32_t & degrees, int32_t & minutes_e4)
+    {
+        int64_t const magnitude = std::abs(static_cast<int64_t>(angle));
+        degrees = magnitude / 10000000;
+        minutes_e4 = (magnitude % 10000000) * 60 / 1000;
+    }
+}
+
+bool nmea_zda(char * buf, size_t buf_len, Ymdhms const & utc)
+{
+    int len = snprintf(buf, buf_len, "$GPZDA,%02d%02d%02d.00,%02d,%02d,%04d,00,00",
+                       utc.hour, utc.min, utc.sec,
+                       utc.day, utc.month, utc.year);
+    return finish_sentence(buf, buf_len, len);
+}
+
+bool nmea_rmc(char * buf, size_t buf_len, Ymdhms const & utc, bool valid, int32_t lat, int32_t lon)
+{
+    int32_t lat_deg, lat_min_e4, lon_deg, lon_min_e4;
+    split_angle(lat, lat_deg, lat_min_e4);
+    split_angle(lon, lon_deg, lon_min_e4);
+
+    int len = snprintf(buf, buf_len, "$GPRMC,%02d%02d%02d.00,%c,%02" PRId32 "%02" PRId32 ".%04" PRId32 ",%c,%03" PRId32 "%02" PRId32 ".%04" PRId32 ",%c,0.00,,%02d%02d%02d,,,%c",
+                       utc.hour, utc.min, utc.sec,
+                       valid ? 'A' : 'V',
+                       lat_deg, lat_min_e4 / 10000, lat_min_e4 % 10000,
+                       lat < 0 ? 'S' : 'N',
+                       lon_deg, lon_min_e4 / 10000, lon_min_e4 % 10000,
+                       lon < 0 ? 'W' : 'E',
+                       utc.day, utc.month, utc.year % 100,
+                       valid ? 'A' : 'N');
+    return finish_sentence(buf, buf_len, len);
+}
+
+bool nmea_test()
+{
+    {
+        char const zda[] = "$GPZDA,201530.00,04,07,2002,00,00*60";
+        test_assert_unsigned_eq(nmea_checksum(zda + 1, zda + sizeof(zda) - 4), (uint8_t)0x60);
+
+        char const rmc[] = "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A";
+        test_assert_unsigned_eq(nmea_checksum(rmc + 1, rmc + sizeof(rmc) - 4), (uint8_t)0x6a);
+    }
+
+    {
+        char buf[83];
+        test_assert(nmea_zda(buf, sizeof(buf), Ymdhms(2002, 7, 4, 20, 15, 30)));
+        test_assert(strcmp(buf, "$GPZDA,201530.00,04,07,2002,00,00*60\r\n") == 0);
+
+        test_assert(nmea_zda(buf, sizeof(buf), Ymdhms(2016, 12, 31, 23, 59, 60)));
+        test_assert(strcmp(buf, "$GPZDA,235960.00,31,12,2016,00,00*69\r\n") == 0);
+    }
+
+    {
+        char buf[83];
+        test_assert(nmea_rmc(buf, sizeof(buf), Ymdhms(1994, 3, 23, 12, 35, 19), true, 481173000, 115166667));
+        test_assert(strcmp(buf, "$GPRMC,123519.00,A,4807.0380,N,01131.0000,E,0.00,,230394,,,A*40\r\n") == 0);
+
+        test_assert(nmea_rmc(buf, sizeof(buf), Ymdhms(2016, 12, 31, 23, 59, 60), false, -338590000, -1512100000));
+        test_assert(strcmp(buf, "$GPRMC,235960.00,V,3351.5400,S,15112.6000,W,0.00,,311216,,,N*5F\r\n") == 0);
+
+        char small[20];
+        test_assert(!nmea_rmc(small, sizeof(small), Ymdhms(1994, 3, 23, 12, 35, 19), true, 0, 0));
+    }
+
+    return true;
+}
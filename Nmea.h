@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "time.h"
+
+bool nmea_test();
+
+// XOR of the characters between '$' and '*'.
+uint8_t nmea_checksum(char const * begin, char const * end);
+
+// Each of these writes a complete sentence, including the checksum and CR LF,
+// and returns false if it doesn't fit.
+
+bool nmea_zda(char * buf, size_t buf_len, Ymdhms const & utc);
+
+// Latitude and longitude are in units of 1e-7 degrees, as reported by UBX-NAV-PVT.
+bool nmea_rmc(char * buf, size_t buf_len, Ymdhms const & utc, bool valid, int32_t lat, int32_t lon);
@@ -0,0 +1,96 @@
+#include "NmeaOutput.h"
+
+#include <cstring>
+
+#include "pico/time.h"
+
+#include "uart_tx.pio.h"
+
+#include "Nmea.h"
+
+NmeaOutput::NmeaOutput(Pps const & pps,
+                       GpsUBlox const & gps,
+                       PIO pio,
+                       uint const tx_pin,
+                       uint const baud,
+                       uint32_t const delay_after_edge_us):
+    _pps(pps),
+    _gps(gps),
+    _pio(pio),
+    _delay_after_edge_us(delay_after_edge_us)
+{
+    uint offset = pio_add_program(_pio, &uart_tx_program);
+    _sm = pio_claim_unused_sm(_pio, true);
+    uart_tx_program_init(_pio, _sm, offset, tx_pin, baud);
+}
+
+void NmeaOutput::dispatch(uint32_t const completed_seconds)
+{
+    usec_t const now = time_us_64();
+
+    if (_prepared && !_sending && _prepared_for_completed_seconds == completed_seconds)
+    {
+        if (_pps.get_time_us_of(completed_seconds, _delay_after_edge_us) <= now)
+        {
+            _sending = true;
+            _sentences_sent = 0;
+        }
+    }
+
+    if (_sending)
+    {
+        while (_sentences_sent < _sentences_len &&
+               uart_tx_program_try_putc(_pio, _sm, _sentences[_sentences_sent]))
+        {
+            ++_sentences_sent;
+        }
+        if (_sentences_sent == _sentences_len)
+        {
+            _sending = false;
+            _prepared = false;
+        }
+        return;
+    }
+
+    bool const waiting_to_send = _prepared && _prepared_for_completed_seconds == completed_seconds;
+    if (!waiting_to_send && _prepared_for_completed_seconds != completed_seconds + 1)
+    {
+        if (_pps.get_time_us_of(completed_seconds, _prepare_us) <= now)
+        {
+            _prepare(completed_seconds + 1);
+        }
+    }
+}
+
+void NmeaOutput::_prepare(uint32_t const completed_seconds)
+{
+    _prepared_for_completed_seconds = completed_seconds;
+    _prepared = false;
+
+    TopOfSecond const & top = _gps.tops_of_seconds().next();
+    if (!(top.utc_ymdhms_valid && _pps.locked()))
+    {
+        ++_missed_count;
+        return;
+    }
+
+    int32_t lat;
+    int32_t lon;
+    bool const position_valid = _gps.position(lat, lon);
+
+    if (!nmea_zda(_sentences, sizeof(_sentences), top.utc_ymdhms))
+    {
+        ++_missed_count;
+        return;
+    }
+    size_t const zda_len = strlen(_sentences);
+
+    if (!nmea_rmc(_sentences + zda_len, sizeof(_sentences) - zda_len, top.utc_ymdhms, position_valid, lat, lon))
+    {
+        ++_missed_count;
+        return;
+    }
+
+    _sentences_len = strlen(_sentences);
+    _prepared = true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wvolatile"
+#include "hardware/pio.h"
+#pragma GCC diagnostic pop
+
+#include "Pps.h"
+#include "GpsUBlox.h"
+
+/*
+ * $GPZDA and $GPRMC for other equipment, once per second on a PIO UART.
+ *
+ * The sentences describing each top of second are prepared during the second before it,
+ * and start going out a fixed delay after the edge. Characters are fed to the PIO FIFO
+ * from dispatch() as room appears, so the main loop never waits on the line.
+ */
+class NmeaOutput
+{
+public:
+    NmeaOutput(Pps const & pps,
+               GpsUBlox const & gps,
+               PIO pio,
+               uint const tx_pin,
+               uint const baud,
+               uint32_t const delay_after_edge_us);
+
+    void set_delay_after_edge_us(uint32_t delay_us) { _delay_after_edge_us = delay_us; }
+
+    void dispatch(uint32_t const completed_seconds);
+
+    uint32_t missed_count() const { return _missed_count; }
+
+private:
+    Pps const & _pps;
+    GpsUBlox const & _gps;
+    PIO _pio;
+    uint _sm;
+    uint32_t _delay_after_edge_us;
+
+    // Sentences are prepared once this far into the second before they describe.
+    static uint32_t constexpr _prepare_us = 500000;
+
+    // NMEA 0183 caps a sentence at 82 characters, and we send two.
+    char _sentences[2*83];
+    size_t _sentences_len = 0;
+    size_t _sentences_sent = 0;
+    uint32_t _prepared_for_completed_seconds = 0;
+    bool _prepared = false;
+    bool _sending = false;
+
+    // Seconds for which nothing went out, because the time wasn't known in advance.
+    uint32_t _missed_count = 0;
+
+    void _prepare(uint32_t const completed_seconds);
+};
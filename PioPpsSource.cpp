@@ -0,0 +1,86 @@
+#include "PioPpsSource.h"
+
+#include "pico/time.h"
+
+#include "pps.pio.h"
+
+#include "PpsCapture.h"
+
+PioPpsSource::PioPpsSource(PIO pio, uint const pin):
+    _pio(pio),
+    _pin(pin)
+{
+}
+
+usec_t PioPpsSource::start()
+{
+    _offset = pio_add_program(_pio, &pps_program);
+    _sm_early = pio_claim_unused_sm(_pio, true);
+    _sm_late = pio_claim_unused_sm(_pio, true);
+    return pps_program_init(_pio, _sm_early, _sm_late, _offset, _pin, PpsCapture::initial_count);
+}
+
+usec_t PioPpsSource::restart()
+{
+    // Setting each state machine up again clears its FIFOs and puts it back at its entry point.
+    pio_set_sm_mask_enabled(_pio, (1u << _sm_early) | (1u << _sm_late), false);
+    return pps_program_init(_pio, _sm_early, _sm_late, _offset, _pin, PpsCapture::initial_count);
+}
+
+usec_t PioPpsSource::now_us()
+{
+    return time_us_64();
+}
+
+bool PioPpsSource::pulse_completed()
+{
+    return pps_program_pulse_completed(_pio, _sm_early) && pps_program_pulse_completed(_pio, _sm_late);
+}
+
+void PioPpsSource::get_pulse_counts(uint32_t & early_count, uint32_t & late_count)
+{
+    early_count = pps_program_get_pulse_count(_pio, _sm_early);
+    late_count = pps_program_get_pulse_count(_pio, _sm_late);
+}
+
+bool PioPpsSource::second_completed()
+{
+    return pps_program_second_completed(_pio, _sm_early) && pps_program_second_completed(_pio, _sm_late);
+}
+
+void PioPpsSource::get_second_counts(uint32_t & early_count, uint32_t & late_count)
+{
+    early_count = pps_program_get_second_count(_pio, _sm_early, PpsCapture::initial_count);
+    late_count = pps_program_get_second_count(_pio, _sm_late, PpsCapture::initial_count);
+}
+
+bool PioPpsSource::counts_unpaired()
+{
+    return pps_program_counts_waiting(_pio, _sm_early) != pps_program_counts_waiting(_pio, _sm_late);
+}
+
+void PioPpsSource::enable_interrupt(irq_handler_t const handler)
+{
+    _handler = handler;
+    irq_set_exclusive_handler(_irq(), _handler);
+    // Nothing else gets in ahead of it, so it comes as soon after the edge as it can.
+    irq_set_priority(_irq(), PICO_HIGHEST_IRQ_PRIORITY);
+    _set_interrupt_sources(true);
+    irq_set_enabled(_irq(), true);
+}
+
+void PioPpsSource::disable_interrupt()
+{
+    irq_set_enabled(_irq(), false);
+    _set_interrupt_sources(false);
+    irq_remove_handler(_irq(), _handler);
+    _handler = nullptr;
+}
+
+void PioPpsSource::_set_interrupt_sources(bool const enabled)
+{
+    for (uint const sm : {_sm_early, _sm_late})
+    {
+        pio_set_irq0_source_enabled(_pio, static_cast<pio_interrupt_source>(pis_sm0_rx_fifo_not_empty + sm), enabled);
+    }
+}
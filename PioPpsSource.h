@@ -0,0 +1,46 @@
+#pragma once
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wvolatile"
+#include "hardware/pio.h"
+#pragma GCC diagnostic pop
+#include "hardware/irq.h"
+
+#include "PpsSource.h"
+
+// The pps PIO program on a pair of state machines, and the chip's timer.
+class PioPpsSource: public PpsSource
+{
+public:
+    PioPpsSource(PIO pio, uint const pin);
+
+    usec_t start() override;
+    usec_t restart() override;
+    usec_t now_us() override;
+
+    bool pulse_completed() override;
+    void get_pulse_counts(uint32_t & early_count, uint32_t & late_count) override;
+
+    bool second_completed() override;
+    void get_second_counts(uint32_t & early_count, uint32_t & late_count) override;
+
+    bool counts_unpaired() override;
+
+    // Has handler called on the calling core whenever either state machine has a count waiting,
+    // until disable_interrupt(). The interrupt holds while one does, so the handler has to take
+    // them, or it is called again straight away, and nothing of lower priority on that core runs
+    // until it has.
+    void enable_interrupt(irq_handler_t handler);
+    void disable_interrupt();
+
+private:
+    PIO _pio;
+    uint _pin;
+    uint _offset;
+    uint _sm_early;
+    uint _sm_late;
+    irq_handler_t _handler = nullptr;
+
+    uint _irq() const { return _pio == pio0 ? PIO0_IRQ_0 : PIO1_IRQ_0; }
+    void _set_interrupt_sources(bool enabled);
+};
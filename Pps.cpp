@@ -1,156 +1,415 @@
 #include "Pps.h"
 
 #include <cstdlib>
+#include <cmath>
 #include <algorithm>
 
-#ifndef HOST_BUILD
-  #include "pico/time.h"
-
-  #include "pps.pio.h"
-#else
+#ifdef HOST_BUILD
   uint64_t time_us_64() { return 0; }
 #endif
 
 #include "util.h"
 
-Pps::Pps(PIO pio, uint const pin):
-    _pin(pin),
-    _pio(pio),
-    _bicycles_per_gps_second_average(bicycles_per_chip_second)
+Pps::Pps(PpsSource & source, PpsLockThresholds const & thresholds):
+    _source(source),
+    _cycles_per_gps_second_average(static_cast<uint64_t>(cycles_per_chip_second) << _average_fraction_bits),
+    _thresholds(thresholds),
+    _lock_persistence(thresholds.saturation_limit_lo)
 {
 }
 
-void Pps::pio_init()
+void Pps::start()
 {
-#ifndef HOST_BUILD
-    uint offset = pio_add_program(_pio, &pps_program);
-    _sm = pio_claim_unused_sm(_pio, true);
-    pps_program_init(_pio, _sm, offset, _pin);
-#endif
+    _start_us = _source.start();
 }
 
 void Pps::dispatch_fast_thread()
 {
-#ifndef HOST_BUILD
+    // A count that one state machine pushed for a glitch the other didn't see will never be
+    // paired, and while it waits, the interrupt holds and keeps calling this, shutting out
+    // everything else on core0, including the lockout that lets core1 write flash. Give it a
+    // little longer than the two ever take to push for the same transition, then start them
+    // both again.
+    if (_source.counts_unpaired())
+    {
+        usec_t const now_us = _source.now_us();
+        if (!_unpaired)
+        {
+            _unpaired = true;
+            _unpaired_since_us = now_us;
+        }
+        else if (now_us - _unpaired_since_us > _unpaired_limit_us)
+        {
+            _restart_capture();
+            return;
+        }
+    }
+    else
+    {
+        _unpaired = false;
+    }
+
     if (!_pulse_complete)
     {
-        if (pps_program_pulse_completed(_pio, _sm))
+        if (_source.pulse_completed())
         {
-            _bicycles_in_last_pulse = pps_program_get_bicycles_in_last_complete_pulse(_pio, _sm);
+            uint32_t early_count;
+            uint32_t late_count;
+            _source.get_pulse_counts(early_count, late_count);
+            _capture.pulse(early_count, late_count);
             _pulse_complete = true;
         }
     }
 
     if (_pulse_complete)
     {
-        usec_t possible_top_of_second = time_us_64();
-        if (pps_program_second_completed(_pio, _sm))
+        if (_source.second_completed())
         {
-            _bicycles_in_last_second = pps_program_get_bicycles_in_last_complete_second(_pio, _sm);
-            ++_completed_seconds;
+            // To tell how many times the counts have wrapped, if it's been that long, and how
+            // long this took to notice the edge.
+            uint64_t const now_cycles = (_source.now_us() - _start_us) * PpsCapture::cycles_per_us;
+
+            uint32_t early_count;
+            uint32_t late_count;
+            _source.get_second_counts(early_count, late_count);
             _pulse_complete = false;
+            if (!_capture.second(early_count, late_count, now_cycles))
+            {
+                // Out of step, after a glitch only one state machine saw. The edge is lost, and
+                // the main thread holds over for it as it would for a missing one.
+                _restart_capture();
+                return;
+            }
+            ++_completed_seconds;
+
+            // The edge itself, not when this noticed it.
+            usec_t const top_of_second = _start_us +
+                (_capture.edge_cycles() + PpsCapture::cycles_per_us / 2) / PpsCapture::cycles_per_us;
 
             _completed_seconds_main_thread_a = _completed_seconds;
-            _bicycles_in_last_second_main_thread = _bicycles_in_last_second;
-            _bicycles_in_last_pulse_main_thread = _bicycles_in_last_pulse;
-            _top_of_second_main_thread = possible_top_of_second;
+            _cycles_in_last_second_main_thread = _capture.cycles_in_last_second();
+            _cycles_in_last_pulse_main_thread = _capture.cycles_in_last_pulse();
+            _top_of_second_main_thread = top_of_second;
+            _edge_latency_cycles_main_thread = std::min<uint64_t>(
+                now_cycles > _capture.edge_cycles() ? now_cycles - _capture.edge_cycles() : 0,
+                std::numeric_limits<uint32_t>::max());
+            _edge_interrupt_driven_main_thread = _interrupt_driven;
             _completed_seconds_main_thread_b = _completed_seconds;
         }
     }
-#endif
 }
 
+void Pps::_restart_capture()
+{
+    _start_us = _source.restart();
+    _capture.restart();
+    _pulse_complete = false;
+    _unpaired = false;
+    ++_capture_restarts;
+}
+
+#ifdef HOST_BUILD
+void Pps::simulate_edge(uint32_t const cycles_in_last_second, uint32_t const cycles_in_last_pulse, usec_t const top_us)
+{
+    ++_completed_seconds;
+
+    _completed_seconds_main_thread_a = _completed_seconds;
+    _cycles_in_last_second_main_thread = cycles_in_last_second;
+    _cycles_in_last_pulse_main_thread = cycles_in_last_pulse;
+    _top_of_second_main_thread = top_us;
+    _completed_seconds_main_thread_b = _completed_seconds;
+}
+#endif
+
 void Pps::dispatch_main_thread()
+{
+    _dispatch_main_thread(_source.now_us());
+}
+
+void Pps::_dispatch_main_thread(usec_t const now_us)
 {
     uint32_t completed_seconds;
-    uint32_t bicycles_in_last_second;
-    uint32_t bicycles_in_last_pulse;
+    uint32_t cycles_in_last_second;
+    uint32_t cycles_in_last_pulse;
+    usec_t top_of_second_time_us;
+    uint32_t edge_latency_cycles;
+    bool edge_interrupt_driven;
 
     do
     {
         completed_seconds = _completed_seconds_main_thread_a;
-        bicycles_in_last_second = _bicycles_in_last_second_main_thread;
-        bicycles_in_last_pulse = _bicycles_in_last_pulse_main_thread;
-        _prev_top_of_second_time_us = _top_of_second_main_thread;
+        cycles_in_last_second = _cycles_in_last_second_main_thread;
+        cycles_in_last_pulse = _cycles_in_last_pulse_main_thread;
+        top_of_second_time_us = _top_of_second_main_thread;
+        edge_latency_cycles = _edge_latency_cycles_main_thread;
+        edge_interrupt_driven = _edge_interrupt_driven_main_thread;
     } while (completed_seconds != _completed_seconds_main_thread_b);
 
-    if (completed_seconds != _prev_completed_seconds)
+    if (completed_seconds != _prev_fast_completed_seconds)
+    {
+        _prev_fast_completed_seconds = completed_seconds;
+        _edge_latency[edge_interrupt_driven].add(edge_latency_cycles);
+        _add_second(completed_seconds + _holdover_seconds, top_of_second_time_us, cycles_in_last_second, cycles_in_last_pulse);
+    }
+    else
+    {
+        _dispatch_holdover(now_us);
+    }
+}
+
+void Pps::set_temperature(double const celsius)
+{
+    // The sensor is noisy from one reading to the next. Smoothed only lightly, since the
+    // temperature lagging behind the crystal throws the model off as much as the noise does.
+    _temperature_c = _temperature_valid ? _temperature_c + (celsius - _temperature_c) / 4 : celsius;
+    _temperature_valid = true;
+}
+
+// Once a second should have come and hasn't, keeps the seconds going from the chip's clock.
+void Pps::_dispatch_holdover(usec_t const now_us)
+{
+    if (!_locked)
+    {
+        return;
+    }
+
+    double const next_top_us = _holding_over ?
+        _holdover_top_us + 1e6 * _holdover_chip_time_per_gps_time :
+        _prev_top_of_second_time_us + 1e6 * _chip_time_per_gps_time();
+    if (now_us < next_top_us + _holdover_margin_us)
+    {
+        return;
+    }
+
+    if (!_holding_over)
+    {
+        _start_holdover();
+    }
+    ++_holdover_seconds;
+    _hold_over_second(_prev_fast_completed_seconds + _holdover_seconds);
+}
+
+void Pps::_start_holdover()
+{
+    _holdover_chip_time_per_gps_time = _chip_time_per_gps_time();
+    _holding_over = true;
+    _edges_missing = true;
+    _holdover_elapsed_s = 0;
+    _holdover_top_us = _prev_top_of_second_time_us;
+    _holdover_compensated = _temperature_valid && _thermal.usable() && _thermal_residual_valid;
+    if (!_quiet)
     {
-        uint32_t pulse_error_magnitude = abs(static_cast<int32_t>(bicycles_per_nominal_pulse) -
-                                             static_cast<int32_t>(bicycles_in_last_pulse));
-        bool pulse_indicates_unlocked = pulse_error_magnitude > bicycles_per_nominal_pulse/100;
+        printf("PPS holdover%s.\n", _holdover_compensated ? ", temperature compensated" : "");
+    }
+}
 
-        bool pps_continuity_indicates_unlocked;
-        uint32_t error_magnitude = abs(static_cast<int32_t>(bicycles_per_chip_second) -
-                                       static_cast<int32_t>(bicycles_in_last_second));
-        if (error_magnitude > bicycles_per_chip_second/10000)
+// The top of the next second from the chip's clock, whether or not an edge came for it.
+void Pps::_hold_over_second(uint32_t const completed_seconds)
+{
+    _holdover_top_us += 1e6 * _holdover_chip_time_per_gps_time;
+    _prev_top_of_second_time_us = std::llround(_holdover_top_us);
+    ++_holdover_elapsed_s;
+    _prev_completed_seconds = completed_seconds;
+
+    // The frequency for the second to come, from the model, less what it has lately been
+    // getting wrong while locked, as the crystal ages.
+    if (_holdover_compensated)
+    {
+        _holdover_chip_time_per_gps_time = 1 + (_thermal.ppm_at(_temperature_c) + _thermal_residual_ppm) * 1e-6;
+    }
+
+    if (_holdover_elapsed_s >= holdover_limit_s)
+    {
+        if (!_quiet)
         {
-            // PPS discontinuity
-            _bicycles_per_gps_second_average.reset(bicycles_per_chip_second);
-            pps_continuity_indicates_unlocked = true;
+            printf("PPS holdover ended.\n");
         }
-        else
+        _holding_over = false;
+        _locked = false;
+        _lock_persistence = _thresholds.saturation_limit_lo;
+    }
+    _track_los(true);
+}
+
+void Pps::set_quantization_error(uint32_t const completed_seconds, int32_t const q_err_ps)
+{
+    _q_err_completed_seconds = completed_seconds;
+    _q_err_ps = q_err_ps;
+    _q_err_valid = true;
+}
+
+void Pps::_add_second(uint32_t const completed_seconds,
+                      usec_t const top_us,
+                      uint32_t const cycles_in_last_second,
+                      uint32_t const cycles_in_last_pulse)
+{
+    uint32_t pulse_error_magnitude = abs(static_cast<int32_t>(cycles_per_nominal_pulse) -
+                                         static_cast<int32_t>(cycles_in_last_pulse));
+    bool pulse_indicates_unlocked = pulse_error_magnitude > cycles_per_nominal_pulse/100;
+
+    // Pulses the width the receiver makes them without a fix: its edges come off its own clock
+    // now, and are no better than the chip's. Each still starts a second, but where holdover puts
+    // it.
+    if (_locked && pulse_indicates_unlocked)
+    {
+        if (!_holding_over)
         {
-            // PPS ok, error is due to clock drift in microcontroller.
-            _bicycles_per_gps_second_average.add_point(bicycles_in_last_second);
-            pps_continuity_indicates_unlocked = false;
+            _start_holdover();
         }
+        _hold_over_second(completed_seconds);
+        _history.add(top_us, cycles_in_last_second, cycles_in_last_pulse, _locked);
+        return;
+    }
 
-        if (pps_continuity_indicates_unlocked)
+    // The edge that just came, if TIM-TP described it.
+    bool const edge_q_err_valid = _q_err_valid && _q_err_completed_seconds == completed_seconds;
+    int32_t const edge_q_err_ps = edge_q_err_valid ? _q_err_ps : 0;
+
+    // The first edge after holding over is a second of its own, whatever its length. If it comes
+    // where holdover had it, the seconds were kept right all along, and the lock carries on.
+    bool const edges_missing = _edges_missing;
+    _edges_missing = false;
+    bool reacquired = false;
+    if (_holding_over)
+    {
+        double const held_over_top_us = _holdover_top_us + 1e6 * _holdover_chip_time_per_gps_time;
+        reacquired = std::abs(static_cast<double>(top_us) - held_over_top_us) <= _reacquire_margin_us;
+        _holding_over = false;
+        if (!_quiet)
         {
-            _lock_persistence = _lock_persistence_saturation_limit_lo;
+            printf("PPS holdover ended, edge %s.\n", reacquired ? "where expected" : "elsewhere");
         }
-        else if (pulse_indicates_unlocked)
+    }
+    _prev_top_of_second_time_us = top_us;
+
+    bool pps_continuity_indicates_unlocked;
+    int64_t second = 0;
+    uint32_t error_magnitude = abs(static_cast<int32_t>(cycles_per_chip_second) -
+                                   static_cast<int32_t>(cycles_in_last_second));
+    if (edges_missing || error_magnitude > cycles_per_chip_second/10000)
+    {
+        // PPS discontinuity. The frequency from before holdover is still the best there is.
+        if (!reacquired)
         {
-            _lock_persistence += _lock_persistence_rate_down;
+            _cycles_per_gps_second_average.reset(static_cast<uint64_t>(cycles_per_chip_second) << _average_fraction_bits);
         }
-        else
+        pps_continuity_indicates_unlocked = true;
+    }
+    else
+    {
+        // PPS ok, error is due to clock drift in microcontroller, and to each edge coming
+        // off the receiver's own clock. Take that part out when it's known for both edges.
+        second = static_cast<int64_t>(cycles_in_last_second) << _average_fraction_bits;
+        if (edge_q_err_valid && _prev_edge_q_err_valid)
         {
-            _lock_persistence += _lock_persistence_rate_up;
+            int64_t const late_ps = static_cast<int64_t>(edge_q_err_ps) - _prev_edge_q_err_ps;
+            second -= late_ps * (1 << _average_fraction_bits) / ps_per_cycle;
         }
-        _lock_persistence = std::max(_lock_persistence_saturation_limit_lo,
-                                     std::min(_lock_persistence_saturation_limit_hi,
-                                              _lock_persistence));
+        _cycles_per_gps_second_average.add_point(second);
+        pps_continuity_indicates_unlocked = false;
+    }
+    _prev_edge_q_err_ps = edge_q_err_ps;
+    _prev_edge_q_err_valid = edge_q_err_valid;
+
+    if (reacquired)
+    {
+        // As it was when holdover started.
+    }
+    else if (pps_continuity_indicates_unlocked)
+    {
+        _lock_persistence = _thresholds.saturation_limit_lo;
+    }
+    else if (pulse_indicates_unlocked)
+    {
+        _lock_persistence += _thresholds.rate_down;
+    }
+    else
+    {
+        _lock_persistence += _thresholds.rate_up;
+    }
+    _lock_persistence = std::max(_thresholds.saturation_limit_lo,
+                                 std::min(_thresholds.saturation_limit_hi,
+                                          _lock_persistence));
 
-        if (_locked)
+    if (_locked)
+    {
+        if (_lock_persistence <= _thresholds.threshold_lo)
         {
-            if (_lock_persistence <= _lock_persistence_threshold_lo)
-            {
-                _locked = false;
-            }
+            _locked = false;
         }
-        else
+    }
+    else
+    {
+        if (_lock_persistence >= _thresholds.threshold_hi)
         {
-            if (_lock_persistence >= _lock_persistence_threshold_hi)
-            {
-                _locked = true;
-            }
+            _locked = true;
         }
+    }
 
-        if (_lock_persistence < _lock_persistence_saturation_limit_hi)
+    // Only seconds that are really GPS seconds say anything about the chip's clock.
+    if (_locked && !pps_continuity_indicates_unlocked)
+    {
+        _stability.add_second(second);
+        if (_temperature_valid)
         {
-            printf("PPS lock persistence: %" PRId32 "\n", _lock_persistence);
+            double const ppm = (static_cast<double>(second) /
+                                (static_cast<double>(cycles_per_chip_second) * (1 << _average_fraction_bits)) - 1) * 1e6;
+            _thermal.add_second(_temperature_c, ppm);
+            if (_thermal.usable())
+            {
+                double const residual_ppm = ppm - _thermal.ppm_at(_temperature_c);
+                _thermal_residual_ppm = _thermal_residual_valid ?
+                    _thermal_residual_ppm + (residual_ppm - _thermal_residual_ppm) / _thermal_residual_s :
+                    residual_ppm;
+                _thermal_residual_valid = true;
+            }
         }
+    }
+    else
+    {
+        _stability.restart();
+        _thermal.restart();
+    }
 
-        // Track LOS duration.
-        usec_t chip_time = time_us_64();
-        if (_last_pps_unlocked_time != _last_pps_unlocked_time_invalid)
-        {
-            _total_pps_unlocked_duration += chip_time - _last_pps_unlocked_time;
-            _last_pps_unlocked_time = _last_pps_unlocked_time_invalid;
-        }
-        if (!_locked)
-        {
-            _last_pps_unlocked_time = chip_time;
-        }
+    if (_lock_persistence < _thresholds.saturation_limit_hi && !_quiet)
+    {
+        printf("PPS lock persistence: %" PRId32 "\n", _lock_persistence);
+    }
 
-        _prev_completed_seconds = completed_seconds;
+    _track_los(!_locked);
+    _history.add(top_us, cycles_in_last_second, cycles_in_last_pulse, _locked);
+
+    _prev_completed_seconds = completed_seconds;
+}
+
+// Track LOS duration.
+void Pps::_track_los(bool const lost)
+{
+    usec_t chip_time = _source.now_us();
+    if (_last_pps_unlocked_time != _last_pps_unlocked_time_invalid)
+    {
+        _total_pps_unlocked_duration += chip_time - _last_pps_unlocked_time;
+        _last_pps_unlocked_time = _last_pps_unlocked_time_invalid;
+    }
+    if (lost)
+    {
+        _last_pps_unlocked_time = chip_time;
     }
 }
 
 uint32_t Pps::get_completed_seconds() const
 {
-    return _completed_seconds;
+    return _completed_seconds + _holdover_seconds;
+}
+
+double Pps::_chip_time_per_gps_time() const
+{
+    if (_holding_over)
+    {
+        return _holdover_chip_time_per_gps_time;
+    }
+    return _cycles_per_gps_second_average.get_current_average<double>() /
+        static_cast<double>(static_cast<uint64_t>(cycles_per_chip_second) << _average_fraction_bits);
 }
 
 usec_t Pps::get_time_us_of(uint32_t completed_seconds, usec_t additional_microseconds) const
@@ -161,9 +420,7 @@ usec_t Pps::get_time_us_of(uint32_t completed_seconds, usec_t additional_microse
     usec_t top_of_last_second_gps = million * static_cast<usec_t>(_prev_completed_seconds);
     usec_t top_of_last_second_chip = _prev_top_of_second_time_us;
 
-    double chip_time_per_gps_time =
-        _bicycles_per_gps_second_average.get_current_average<double>() /
-        static_cast<double>(bicycles_per_chip_second);
+    double const chip_time_per_gps_time = _chip_time_per_gps_time();
 
     susec_t top_of_second_delta_gps = signed_difference<usec_t>(top_of_desired_second_gps, top_of_last_second_gps);
     susec_t top_of_second_delta_chip = top_of_second_delta_gps * chip_time_per_gps_time;
@@ -175,25 +432,42 @@ usec_t Pps::get_time_us_of(uint32_t completed_seconds, usec_t additional_microse
 
 void Pps::get_time(uint32_t & completed_seconds, uint32_t & additional_microseconds) const
 {
-    completed_seconds = _completed_seconds;
+    completed_seconds = get_completed_seconds();
 
-    double chip_time_per_gps_time =
-        _bicycles_per_gps_second_average.get_current_average<double>() /
-        static_cast<double>(bicycles_per_chip_second);
+    double const chip_time_per_gps_time = _chip_time_per_gps_time();
 
-    usec_t chip_time = time_us_64();
+    usec_t chip_time = _source.now_us();
     usec_t top_of_last_second_chip = _prev_top_of_second_time_us;
     
     additional_microseconds = (chip_time - top_of_last_second_chip) / chip_time_per_gps_time;
 }
 
+double Pps::get_us_until(uint32_t completed_seconds) const
+{
+    double const chip_time_per_gps_time = _chip_time_per_gps_time();
+
+    int32_t const seconds_after_last_top = completed_seconds - _prev_completed_seconds;
+    double const top_of_desired_second_chip =
+        _prev_top_of_second_time_us + 1e6 * seconds_after_last_top * chip_time_per_gps_time;
+
+    usec_t chip_time = _source.now_us();
+
+    return (top_of_desired_second_chip - chip_time) / chip_time_per_gps_time;
+}
+
 void Pps::show_status() const
 {
-    printf("Bicycles per nominal pulse:%12" PRId32 "\n", bicycles_per_nominal_pulse);
-    printf("Bicycles in last pulse:    %12" PRId32 "\n", _bicycles_in_last_pulse_main_thread);
+    printf("Cycles per nominal pulse:%12" PRId32 "\n", cycles_per_nominal_pulse);
+    printf("Cycles in last pulse:    %12" PRId32 "\n", _cycles_in_last_pulse_main_thread);
+    printf("PPS capture restarts:    %12" PRIu32 "\n", _capture_restarts);
+    printf("Die temperature: %.2f C%s\n", _temperature_c, _holding_over ? ", holding over" : "");
+    _thermal.show_status();
+    _history.show_status();
+    _edge_latency[false].print("PPS edge latency, polled", PpsCapture::cycles_per_us);
+    _edge_latency[true].print("PPS edge latency, interrupt-driven", PpsCapture::cycles_per_us);
 }
 
-void Pps::LosPrinter::print(size_t line, uint8_t /*tenths*/)
+void Pps::LosPrinter::print(size_t line, TopOfSecond const & /*top*/, uint8_t /*tenths*/)
 {
     bool print_result;
     print_result = _disp.printf(line, "GPS LOS SEC.%9lld", _total_pps_unlocked_duration / 1000000);
@@ -208,3 +482,232 @@ std::tuple<std::string, std::shared_ptr<Pps::LosPrinter>> Pps::los_printer(Displ
     return make_tuple("GPS LOS SEC",
                       std::make_shared<LosPrinter>(display, _total_pps_unlocked_duration));
 }
+
+void Pps::StabilityPrinter::print(size_t line, TopOfSecond const & /*top*/, uint8_t /*tenths*/)
+{
+    size_t n_levels = 0;
+    while (n_levels < AllanDeviation::levels && _stability.count(n_levels) > 0)
+    {
+        ++n_levels;
+    }
+
+    bool print_result;
+    if (n_levels == 0)
+    {
+        print_result = _disp.printf(line, "ADEV NO DATA");
+    }
+    else
+    {
+        uint64_t const step = _stability.seconds() / 2;
+        size_t const level = step / 2 % n_levels;
+        bool const modified = step % 2;
+        print_result = _disp.printf(line, "%s %5" PRIu32 "S %8.2E",
+                                    modified ? "MDEV" : "ADEV",
+                                    AllanDeviation::tau_s(level),
+                                    modified ? _stability.mdev(level) : _stability.adev(level));
+    }
+    if (!print_result)
+    {
+        printf("Unable to format line %u of display\n", line);
+    }
+}
+
+std::tuple<std::string, std::shared_ptr<Pps::StabilityPrinter>> Pps::stability_printer(Display & display)
+{
+    return make_tuple("Clock Stability",
+                      std::make_shared<StabilityPrinter>(display, _stability));
+}
+
+bool Pps::unit_test()
+{
+    // A quantization error for some other edge is not applied.
+    {
+        IdlePpsSource source;
+        Pps pps(source);
+        pps.set_quiet(true);
+        pps._lock_persistence = pps._thresholds.saturation_limit_hi;
+        for (uint32_t second = 1; second < 10; ++second)
+        {
+            pps.set_quantization_error(second + 1, 5000 * second);
+            pps._add_second(second, second * 1000000, cycles_per_chip_second, cycles_per_nominal_pulse);
+        }
+        test_assert(pps._chip_time_per_gps_time() == 1.0);
+    }
+
+    // Both edges of a second have to be known for it to be corrected.
+    {
+        IdlePpsSource source;
+        Pps pps(source);
+        pps.set_quiet(true);
+        pps._lock_persistence = pps._thresholds.saturation_limit_hi;
+        pps.set_quantization_error(1, 4000);
+        pps._add_second(1, 1000000, cycles_per_chip_second, cycles_per_nominal_pulse);
+        test_assert(pps._chip_time_per_gps_time() == 1.0);
+
+        // This edge came 4 ns earlier than the last, so the second between them was really half a
+        // cycle longer than it was counted.
+        pps.set_quantization_error(2, 0);
+        pps._add_second(2, 2000000, cycles_per_chip_second, cycles_per_nominal_pulse);
+        double const cycles_in_average = 2.0 * cycles_per_chip_second;
+        test_assert(pps._chip_time_per_gps_time() == (cycles_in_average + 0.5) / cycles_in_average);
+    }
+
+#ifdef HOST_BUILD
+    // Only locked seconds with no discontinuity go into the stability figures.
+    {
+        IdlePpsSource source;
+        Pps pps(source);
+        pps.set_quiet(true);
+        pps._lock_persistence = pps._thresholds.saturation_limit_hi;
+        for (uint32_t second = 1; second <= 20; ++second)
+        {
+            pps._add_second(second, second * 1000000, cycles_per_chip_second + second % 2, cycles_per_nominal_pulse);
+        }
+        test_assert(pps.stability().seconds() == 20);
+        test_assert(pps.stability().adev(0) > 0);
+
+        pps._add_second(21, 20500000, cycles_per_chip_second / 2, cycles_per_nominal_pulse);
+        pps._add_second(22, 21500000, cycles_per_chip_second, cycles_per_nominal_pulse);
+        test_assert(!pps.locked());
+        test_assert(pps.stability().seconds() == 20);
+    }
+
+    // When edges stop coming, seconds carry on from the chip's clock at the frequency it had.
+    {
+        IdlePpsSource source;
+        Pps pps(source);
+        pps.set_quiet(true);
+        pps._lock_persistence = pps._thresholds.saturation_limit_hi;
+        usec_t top_us = 1000000;
+        for (uint32_t second = 1; second <= 100; ++second)
+        {
+            // 10 ppm fast.
+            pps.simulate_edge(cycles_per_chip_second + 1250, cycles_per_nominal_pulse, top_us);
+            pps.simulate_dispatch(top_us + 1000);
+            top_us += 1000010;
+        }
+        uint32_t const last = pps.get_completed_seconds();
+        test_assert(pps.locked() && !pps.holding_over());
+
+        pps.simulate_dispatch(top_us + 50000);
+        test_assert(!pps.holding_over());
+        test_assert(pps.get_completed_seconds() == last);
+        for (usec_t now_us = top_us + 150000; now_us < top_us + 10000000; now_us += 100000)
+        {
+            pps.simulate_dispatch(now_us);
+        }
+        test_assert(pps.holding_over() && pps.locked());
+        test_assert(pps.get_completed_seconds() == last + 10);
+        test_assert(std::abs(signed_difference(pps.get_time_us_of(last + 10, 0), top_us + 9 * 1000010)) <= 1);
+        test_assert(std::abs(signed_difference(pps.get_time_us_of(last + 11, 500000), top_us + 10 * 1000010 + 500005)) <= 1);
+
+        // The first edge back comes where holdover has it, so the lock carries on, at the
+        // frequency it had.
+        top_us += 10 * 1000010;
+        pps.simulate_edge(cycles_per_chip_second + 1250, cycles_per_nominal_pulse, top_us + 3);
+        pps.simulate_dispatch(top_us + 1000);
+        test_assert(!pps.holding_over() && pps.locked());
+        test_assert(pps.get_completed_seconds() == last + 11);
+        test_assert(std::abs(signed_difference(pps.get_time_us_of(last + 12, 0), top_us + 3 + 1000010)) <= 1);
+
+        // Another stop, and an edge back 5 ms from where holdover has it, which starts over.
+        top_us += 1000010;
+        for (usec_t now_us = top_us + 150000; now_us < top_us + 3000000; now_us += 100000)
+        {
+            pps.simulate_dispatch(now_us);
+        }
+        test_assert(pps.holding_over() && pps.get_completed_seconds() == last + 14);
+        top_us += 3 * 1000010;
+        pps.simulate_edge(cycles_per_chip_second + 1250, cycles_per_nominal_pulse, top_us + 5000);
+        pps.simulate_dispatch(top_us + 6000);
+        test_assert(!pps.holding_over() && !pps.locked());
+        test_assert(pps.get_completed_seconds() == last + 15);
+    }
+
+    // Pulses the width the receiver makes them without a fix start holdover straight away. Their
+    // edges still start each second, but where holdover puts it, not where they come.
+    {
+        IdlePpsSource source;
+        Pps pps(source);
+        pps.set_quiet(true);
+        pps._lock_persistence = pps._thresholds.saturation_limit_hi;
+        usec_t top_us = 1000000;
+        for (uint32_t second = 1; second <= 100; ++second)
+        {
+            pps.simulate_edge(cycles_per_chip_second + 1250, cycles_per_nominal_pulse, top_us);
+            pps.simulate_dispatch(top_us + 1000);
+            top_us += 1000010;
+        }
+        uint32_t const last = pps.get_completed_seconds();
+
+        // The receiver's own clock is 2 ppm slow.
+        for (uint32_t second = 0; second < 1000; ++second)
+        {
+            pps.simulate_edge(cycles_per_chip_second + 1500, cycles_per_nominal_pulse / 2, top_us + 2 * second);
+            pps.simulate_dispatch(top_us + 2 * second + 1000);
+            test_assert(pps.holding_over() && pps.locked());
+            top_us += 1000010;
+        }
+        test_assert(pps.get_completed_seconds() == last + 1000);
+        test_assert(std::abs(signed_difference(pps.get_time_us_of(last + 1000, 0), top_us - 1000010)) <= 1);
+        test_assert(pps.history().size() == 1100);
+
+        // Once it has a fix again, its edges are back where holdover has them.
+        pps.simulate_edge(cycles_per_chip_second + 1250, cycles_per_nominal_pulse, top_us);
+        pps.simulate_dispatch(top_us + 1000);
+        test_assert(!pps.holding_over() && pps.locked());
+        test_assert(pps.get_completed_seconds() == last + 1001);
+    }
+
+    // The receiver's time pulse comes off its own clock, so each edge is late by somewhere in one
+    // of its periods, and the PIO program counts whole cycles between edges. This is the RMS error
+    // of the frequency estimate, in parts per billion, with or without the receiver's help.
+    auto const simulate_frequency_error = [](bool const use_quantization_error)
+    {
+        IdlePpsSource source;
+        Pps pps(source);
+        pps.set_quiet(true);
+        pps._lock_persistence = pps._thresholds.saturation_limit_hi;
+
+        double constexpr chip_time_per_gps_time = 1 + 23.7e-6;
+        double constexpr receiver_clock_period_ns = 1e9 / 48e6;
+        double constexpr ns_per_cycle = ps_per_cycle / 1000.0;
+
+        double sum_squared_error = 0;
+        uint32_t n_errors = 0;
+        int64_t prev_cycle = 0;
+        for (uint32_t second = 0; second < 3000; ++second)
+        {
+            // The receiver clock drifts against GPS time, so the error sweeps across its period.
+            double const late_ns = (std::fmod(second * 0.1373, 1.0) - 0.5) * receiver_clock_period_ns;
+            double const edge_ns = 12345.6 + second * 1e9 * chip_time_per_gps_time + late_ns;
+            int64_t const cycle = std::floor(edge_ns / ns_per_cycle);
+
+            if (use_quantization_error)
+            {
+                pps.set_quantization_error(second, std::lround(late_ns * 1000));
+            }
+            if (second > 0)
+            {
+                pps._add_second(second, cycle / PpsCapture::cycles_per_us, cycle - prev_cycle, cycles_per_nominal_pulse);
+            }
+            prev_cycle = cycle;
+
+            // Once the average has filled.
+            if (second > 100)
+            {
+                double const error_ppb = (pps._chip_time_per_gps_time() - chip_time_per_gps_time) * 1e9;
+                sum_squared_error += error_ppb * error_ppb;
+                ++n_errors;
+            }
+        }
+        return std::sqrt(sum_squared_error / n_errors);
+    };
+
+    double const uncorrected_ppb = simulate_frequency_error(false);
+    double const corrected_ppb = simulate_frequency_error(true);
+    test_assert(corrected_ppb < 0.75 * uncorrected_ppb);
+#endif
+
+    return true;
+}
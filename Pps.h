@@ -14,28 +14,97 @@
 #endif
 
 #include <limits>
+#include "AllanDeviation.h"
+#include "LatencyHistogram.h"
 #include "MovingAverage.h"
+#include "PpsCapture.h"
+#include "PpsHistory.h"
+#include "PpsSource.h"
+#include "ThermalModel.h"
 #include "Artist.h"
 
-using usec_t = uint64_t;
-using susec_t = int64_t;
+// How sure Pps is that the edges are GPS seconds. Each good second adds rate_up to a persistence
+// count and each with a pulse of the wrong width adds rate_down, within the saturation limits, and
+// a discontinuity sets it back to the bottom. It locks at threshold_hi and unlocks at threshold_lo.
+struct PpsLockThresholds
+{
+    int32_t threshold_lo = 0;
+    int32_t threshold_hi = 10;
+    int32_t saturation_limit_lo = 0;
+    int32_t saturation_limit_hi = 300;
+    int32_t rate_up = 3;
+    int32_t rate_down = -1;
+};
 
 class Pps
 {
 public:
-    Pps(PIO pio, uint const pin);
+    explicit Pps(PpsSource & source, PpsLockThresholds const & thresholds = PpsLockThresholds());
 
-    void pio_init();
+    void start();
     void dispatch_fast_thread();
     void dispatch_main_thread();
 
+    // Whether core0 calls dispatch_fast_thread() from the PIO's interrupt and sleeps in between,
+    // or polls. Set from the main thread for core0's loop to follow.
+    void set_interrupt_driven(bool const interrupt_driven) { _interrupt_driven = interrupt_driven; }
+    bool interrupt_driven() const { return _interrupt_driven; }
+
+    // From each edge to dispatch_fast_thread() fetching its counts, to within the microsecond the
+    // timer counts in, polled and interrupt-driven.
+    LatencyHistogram const & edge_latency(bool const interrupt_driven) const { return _edge_latency[interrupt_driven]; }
+
+    // Times the state machines have been started over, having got out of step.
+    uint32_t capture_restarts() const { return _capture_restarts; }
+
+#ifdef HOST_BUILD
+    // Stands in for dispatch_fast_thread() seeing the PIO program complete a second, at top_us.
+    void simulate_edge(uint32_t cycles_in_last_second, uint32_t cycles_in_last_pulse, usec_t top_us = 0);
+
+    // dispatch_main_thread(), at now_us.
+    void simulate_dispatch(usec_t now_us) { _dispatch_main_thread(now_us); }
+#endif
+
     uint32_t get_completed_seconds() const;
     usec_t get_time_us_of(uint32_t completed_seconds, usec_t additional_microseconds) const;
 
     void get_time(uint32_t & completed_seconds, uint32_t & additional_microseconds) const;
 
+    // GPS time from now until the top of the given second, without rounding to whole microseconds.
+    double get_us_until(uint32_t completed_seconds) const;
+
     bool locked() const { return _locked; }
 
+    // All the time there has been no lock, up to the last second or holdover second.
+    usec_t unlocked_us() const { return _total_pps_unlocked_duration; }
+
+    // Leaves out the lock persistence and holdover messages, for long simulations.
+    void set_quiet(bool const quiet) { _quiet = quiet; }
+
+    // The chip's die temperature, about once a second, for the thermal model.
+    void set_temperature(double celsius);
+
+    // Edges stopped coming while locked, or came off the receiver's own clock, as pulses the
+    // width it makes them without a fix say, and seconds are being kept from the chip's clock,
+    // with its frequency following the thermal model if there is one. Still locked() meanwhile,
+    // for up to holdover_limit_s, and after, if the first good edge comes where holdover has it.
+    bool holding_over() const { return _holding_over; }
+    static uint32_t constexpr holdover_limit_s = 6 * 3600;
+
+    ThermalModel & thermal_model() { return _thermal; }
+
+    // The receiver's quantization error for the edge that will complete the given second:
+    // how late it comes, in picoseconds, as sent in UBX-TIM-TP ahead of the edge.
+    void set_quantization_error(uint32_t completed_seconds, int32_t q_err_ps);
+
+    // The last few thousand edges, and what looked wrong with them.
+    PpsHistory const & history() const { return _history; }
+
+    // How steady the chip's clock is against GPS, over the seconds it has been locked.
+    AllanDeviation const & stability() const { return _stability; }
+
+    static bool unit_test();
+
     void show_status() const;
 
     class LosPrinter: public LinePrinter
@@ -48,7 +117,7 @@ public:
         {
         }
 
-        void print(size_t line, uint8_t tenths) override;
+        void print(size_t line, TopOfSecond const & top, uint8_t tenths) override;
     private:
         Display & _disp;
         usec_t & _total_pps_unlocked_duration;
@@ -56,44 +125,108 @@ public:
 
     std::tuple<std::string, std::shared_ptr<LosPrinter>> los_printer(Display & display);
 
+    // One tau at a time, ADEV then MDEV, a couple of seconds each.
+    class StabilityPrinter: public LinePrinter
+    {
+    public:
+        StabilityPrinter(Display & display,
+                         AllanDeviation const & stability):
+        _disp(display),
+        _stability(stability)
+        {
+        }
+
+        void print(size_t line, TopOfSecond const & top, uint8_t tenths) override;
+    private:
+        Display & _disp;
+        AllanDeviation const & _stability;
+    };
+
+    std::tuple<std::string, std::shared_ptr<StabilityPrinter>> stability_printer(Display & display);
+
 private:
     // Constants
-    static constexpr uint32_t bicycles_per_chip_second = 125000000/2;
-    static constexpr uint32_t bicycles_per_nominal_pulse = bicycles_per_chip_second/10;
+    static constexpr uint32_t cycles_per_chip_second = PpsCapture::cycles_per_us * 1000000;
+    static constexpr uint32_t cycles_per_nominal_pulse = cycles_per_chip_second/10;
+    static constexpr int32_t ps_per_cycle = 8000;
+
+    PpsSource & _source;
+    bool _quiet = false;
+    bool volatile _interrupt_driven = false;
 
     // Fast thread
-    uint _pin;
-    PIO _pio;
-    uint _sm;
-    uint32_t _bicycles_in_last_second = 0;
-    uint32_t _bicycles_in_last_pulse = 0;
+    usec_t _start_us = 0;
+    PpsCapture _capture;
     uint32_t _completed_seconds = 0;
     bool _pulse_complete = false;
+    uint32_t _capture_restarts = 0;
+    // Well beyond the few cycles between the two state machines' pushes for the same transition.
+    static usec_t constexpr _unpaired_limit_us = 20;
+    bool _unpaired = false;
+    usec_t _unpaired_since_us = 0;
+    void _restart_capture();
 
     // Shared between threads
     uint32_t volatile _completed_seconds_main_thread_a = 0;
-    uint32_t volatile _bicycles_in_last_second_main_thread = 0;
-    uint32_t volatile _bicycles_in_last_pulse_main_thread = 0;
+    uint32_t volatile _cycles_in_last_second_main_thread = 0;
+    uint32_t volatile _cycles_in_last_pulse_main_thread = 0;
     usec_t volatile _top_of_second_main_thread = 0;
+    uint32_t volatile _edge_latency_cycles_main_thread = 0;
+    bool volatile _edge_interrupt_driven_main_thread = false;
     uint32_t volatile _completed_seconds_main_thread_b = 0;
 
     // Main thread
+    void _dispatch_main_thread(usec_t now_us);
+    uint32_t _prev_fast_completed_seconds = 0;
     uint32_t _prev_completed_seconds = 0;
     usec_t _prev_top_of_second_time_us = 0;
-    MovingAverage<uint64_t, 60> _bicycles_per_gps_second_average;
-
-    int32_t static constexpr _lock_persistence_threshold_lo        =   0;
-    int32_t static constexpr _lock_persistence_threshold_hi        =  10;
-    int32_t static constexpr _lock_persistence_saturation_limit_lo =   0;
-    int32_t static constexpr _lock_persistence_saturation_limit_hi = 300;
-    int32_t static constexpr _lock_persistence_rate_up             =   3;
-    int32_t static constexpr _lock_persistence_rate_down           =  -1;
-    int32_t _lock_persistence = _lock_persistence_saturation_limit_lo;
+    // In 1/256ths of a cycle, fine enough to hold the quantization error corrections.
+    static constexpr uint32_t _average_fraction_bits = 8;
+    MovingAverage<uint64_t, 60> _cycles_per_gps_second_average;
+    double _chip_time_per_gps_time() const;
+    AllanDeviation _stability{static_cast<int64_t>(cycles_per_chip_second) << _average_fraction_bits};
+    PpsHistory _history{cycles_per_chip_second, cycles_per_nominal_pulse};
+    LatencyHistogram _edge_latency[2] = {LatencyHistogram(PpsCapture::cycles_per_us), LatencyHistogram(PpsCapture::cycles_per_us)};
+
+    ThermalModel _thermal;
+    double _temperature_c = 0;
+    bool _temperature_valid = false;
+    // How far the chip's frequency has been from the model's, averaged over _thermal_residual_s.
+    static uint32_t constexpr _thermal_residual_s = 600;
+    double _thermal_residual_ppm = 0;
+    bool _thermal_residual_valid = false;
+
+    // Seconds made up during holdover, on top of those the fast thread has counted.
+    static usec_t constexpr _holdover_margin_us = 100000;
+    // How far from where holdover has it the first good edge after can come for the lock to carry
+    // on: about as far as an hour of uncompensated holdover drifts.
+    static double constexpr _reacquire_margin_us = 2000;
+    bool _holding_over = false;
+    bool _edges_missing = false;
+    uint32_t _holdover_seconds = 0;
+    uint32_t _holdover_elapsed_s = 0;
+    double _holdover_top_us = 0;
+    double _holdover_chip_time_per_gps_time = 1;
+    bool _holdover_compensated = false;
+    void _dispatch_holdover(usec_t now_us);
+    void _start_holdover();
+    void _hold_over_second(uint32_t completed_seconds);
+
+    uint32_t _q_err_completed_seconds = 0;
+    int32_t _q_err_ps = 0;
+    bool _q_err_valid = false;
+    int32_t _prev_edge_q_err_ps = 0;
+    bool _prev_edge_q_err_valid = false;
+    void _add_second(uint32_t completed_seconds, usec_t top_us, uint32_t cycles_in_last_second, uint32_t cycles_in_last_pulse);
+
+    PpsLockThresholds const _thresholds;
+    int32_t _lock_persistence;
     bool _locked = false;
 
     // Track LOS duration.
     usec_t static constexpr _last_pps_unlocked_time_invalid = std::numeric_limits<usec_t>::max();
     usec_t _last_pps_unlocked_time = _last_pps_unlocked_time_invalid;
     usec_t _total_pps_unlocked_duration = 0;
+    void _track_los(bool lost);
 };
 
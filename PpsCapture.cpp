@@ -0,0 +1,347 @@
+#include "PpsCapture.h"
+
+#include <algorithm>
+
+#include "RingBuffer.h"
+#include "util.h"
+
+void PpsCapture::pulse(uint32_t const early_count, uint32_t const late_count)
+{
+    _cycles_in_last_pulse = bicycles_in_pulse(early_count) + bicycles_in_pulse(late_count);
+}
+
+bool PpsCapture::second(uint32_t const early_count, uint32_t const late_count, uint64_t const cycles_since_start)
+{
+    // Each state machine has counted about half the cycles since the last edge.
+    uint64_t const last_edge_cycles = _early_bicycles + _late_bicycles;
+    uint64_t const expected_bicycles =
+        cycles_since_start > last_edge_cycles ? (cycles_since_start - last_edge_cycles) / 2 : 0;
+
+    uint64_t const early = _unwrap(bicycles_in_second(early_count), expected_bicycles);
+    uint64_t const late = _unwrap(bicycles_in_second(late_count), expected_bicycles);
+    if (std::max(early, late) - std::min(early, late) > 1)
+    {
+        return false;
+    }
+    _early_bicycles += early;
+    _late_bicycles += late;
+    _cycles_in_last_second = std::min<uint64_t>(early + late, std::numeric_limits<uint32_t>::max());
+    return true;
+}
+
+void PpsCapture::restart()
+{
+    _early_bicycles = 0;
+    _late_bicycles = 0;
+    _cycles_in_last_pulse = 0;
+    _cycles_in_last_second = 0;
+}
+
+// Puts back the whole wraps of the count nearest to what the host expected.
+uint64_t PpsCapture::_unwrap(uint32_t const bicycles, uint64_t const expected_bicycles)
+{
+    uint64_t constexpr wrap = uint64_t(1) << 32;
+    if (expected_bicycles <= bicycles)
+    {
+        return bicycles;
+    }
+    return bicycles + (expected_bicycles - bicycles + wrap / 2) / wrap * wrap;
+}
+
+namespace
+{
+    // Just enough of a PIO state machine to run pps.pio, a cycle at a time.
+    class PpsStateMachine
+    {
+    public:
+        enum class Op
+        {
+            nop,
+            jmp_x_dec,
+            jmp_pin,
+            mov_isr_x,
+            push_noblock,
+            pull_noblock,
+            mov_x_osr,
+        };
+
+        struct Instruction
+        {
+            Op op;
+            uint8_t target;
+        };
+
+        // pps.pio, as assembled.
+        static constexpr Instruction program[] = {
+            {Op::nop, 0},           // start_late
+            {Op::mov_isr_x, 0},     // end_second
+            {Op::push_noblock, 0},
+            {Op::pull_noblock, 0},  // begin_second
+            {Op::mov_x_osr, 0},
+            {Op::jmp_x_dec, 6},     // count_while_high
+            {Op::jmp_pin, 5},       // check_for_low
+            {Op::mov_isr_x, 0},
+            {Op::push_noblock, 0},
+            {Op::jmp_x_dec, 10},    // count_while_low, .wrap_target
+            {Op::jmp_pin, 1},       // check_for_high, .wrap
+        };
+        static uint8_t constexpr start_late = 0;
+        static uint8_t constexpr end_second = 1;
+        static uint8_t constexpr wrap_target = 9;
+        static uint8_t constexpr wrap = 10;
+
+        explicit PpsStateMachine(uint8_t const pc):
+            _pc(pc)
+        {
+        }
+
+        // One cycle, with the pin as it's seen on that cycle.
+        void step(bool const pin)
+        {
+            Instruction const & instruction = program[_pc];
+            bool jump = false;
+            switch (instruction.op)
+            {
+            case Op::nop:
+                break;
+            case Op::jmp_x_dec:
+                jump = _x != 0;
+                --_x;
+                break;
+            case Op::jmp_pin:
+                jump = pin;
+                break;
+            case Op::mov_isr_x:
+                _isr = _x;
+                break;
+            case Op::push_noblock:
+                if (!rx.full())
+                {
+                    rx.push(_isr);
+                }
+                _isr = 0;
+                break;
+            case Op::pull_noblock:
+                if (tx.empty())
+                {
+                    _osr = _x;
+                }
+                else
+                {
+                    _osr = tx.peek(0);
+                    tx.pop(1);
+                }
+                break;
+            case Op::mov_x_osr:
+                _x = _osr;
+                break;
+            }
+
+            if (jump)
+            {
+                _pc = instruction.target;
+            }
+            else if (_pc == wrap)
+            {
+                _pc = wrap_target;
+            }
+            else
+            {
+                ++_pc;
+            }
+        }
+
+        uint32_t get()
+        {
+            uint32_t const value = rx.peek(0);
+            rx.pop(1);
+            return value;
+        }
+
+        RingBuffer<uint32_t, 4> tx;
+        RingBuffer<uint32_t, 4> rx;
+
+    private:
+        uint8_t _pc;
+        uint32_t _x = 0;
+        uint32_t _osr = 0;
+        uint32_t _isr = 0;
+    };
+}
+
+bool PpsCapture::unit_test()
+{
+    // The two state machines running pps.pio, and the host fetching their counts the way
+    // Pps::dispatch_fast_thread() does, whenever it gets round to it. Edges fall on both cycles of
+    // a bicycle, and the pulses are a cycle longer or shorter from one to the next.
+    {
+        uint32_t constexpr n_edges = 20;
+        uint64_t rises[n_edges];
+        uint64_t falls[n_edges];
+        for (uint32_t i = 0; i < n_edges; ++i)
+        {
+            rises[i] = 3001 + 10007 * i + i * i % 5;
+            falls[i] = rises[i] + 1000 + i % 3;
+        }
+
+        PpsStateMachine early(PpsStateMachine::end_second);
+        PpsStateMachine late(PpsStateMachine::start_late);
+        for (PpsStateMachine * const sm : {&early, &late})
+        {
+            sm->tx.push(initial_count);
+            sm->tx.push(initial_count);
+        }
+
+        PpsCapture capture;
+        bool junk_discarded = false;
+        bool pulse_complete = false;
+        uint32_t seconds = 0;
+        uint32_t edge = 0;
+        for (uint64_t cycle = 0; cycle < rises[n_edges - 1] + 100; ++cycle)
+        {
+            while (edge < n_edges && cycle >= falls[edge])
+            {
+                ++edge;
+            }
+            bool const pin = edge < n_edges && cycle >= rises[edge];
+            early.step(pin);
+            late.step(pin);
+
+            if (cycle % 37 != 0)
+            {
+                continue;
+            }
+            if (!junk_discarded)
+            {
+                if (early.rx.empty() || late.rx.empty())
+                {
+                    continue;
+                }
+                early.get();
+                late.get();
+                junk_discarded = true;
+            }
+            if (!pulse_complete && !early.rx.empty() && !late.rx.empty())
+            {
+                capture.pulse(early.get(), late.get());
+                pulse_complete = true;
+            }
+            if (pulse_complete && !early.rx.empty() && !late.rx.empty())
+            {
+                early.tx.push(initial_count);
+                late.tx.push(initial_count);
+                capture.second(early.get(), late.get(), cycle);
+                pulse_complete = false;
+
+                test_assert(capture.edge_cycles() == rises[seconds]);
+                if (seconds > 0)
+                {
+                    test_assert(capture.cycles_in_last_second() == rises[seconds] - rises[seconds - 1]);
+                    test_assert(capture.cycles_in_last_pulse() == falls[seconds - 1] - rises[seconds - 1]);
+                }
+                ++seconds;
+            }
+        }
+        test_assert_unsigned_eq(seconds, n_edges);
+    }
+
+    // A glitch a cycle long in the middle of a second, on each cycle of a bicycle in turn, so
+    // that one state machine sees it and the other doesn't. The second it ends is turned down,
+    // and once both state machines have been started over, the edges come out right again,
+    // counted from then.
+    for (uint64_t const glitch : {uint64_t(25000), uint64_t(25001)})
+    {
+        uint32_t constexpr n_edges = 6;
+        uint64_t rises[n_edges];
+        for (uint32_t i = 0; i < n_edges; ++i)
+        {
+            rises[i] = 3001 + 10007 * i;
+        }
+
+        PpsStateMachine early(PpsStateMachine::end_second);
+        PpsStateMachine late(PpsStateMachine::start_late);
+        auto const start = [&]() {
+            early = PpsStateMachine(PpsStateMachine::end_second);
+            late = PpsStateMachine(PpsStateMachine::start_late);
+            for (PpsStateMachine * const sm : {&early, &late})
+            {
+                sm->tx.push(initial_count);
+                sm->tx.push(initial_count);
+            }
+        };
+        start();
+
+        PpsCapture capture;
+        uint64_t start_cycle = 0;
+        bool junk_discarded = false;
+        bool pulse_complete = false;
+        uint32_t seconds = 0;
+        uint32_t turned_down = 0;
+        uint32_t edge = 0;
+        for (uint64_t cycle = 0; cycle < rises[n_edges - 1] + 100; ++cycle)
+        {
+            while (edge < n_edges && cycle >= rises[edge] + 1000)
+            {
+                ++edge;
+            }
+            bool const pin = (edge < n_edges && cycle >= rises[edge]) || cycle == glitch;
+            early.step(pin);
+            late.step(pin);
+
+            if (cycle % 37 != 0)
+            {
+                continue;
+            }
+            if (!junk_discarded)
+            {
+                if (early.rx.empty() || late.rx.empty())
+                {
+                    continue;
+                }
+                early.get();
+                late.get();
+                junk_discarded = true;
+            }
+            if (!pulse_complete && !early.rx.empty() && !late.rx.empty())
+            {
+                capture.pulse(early.get(), late.get());
+                pulse_complete = true;
+            }
+            if (pulse_complete && !early.rx.empty() && !late.rx.empty())
+            {
+                early.tx.push(initial_count);
+                late.tx.push(initial_count);
+                pulse_complete = false;
+                if (!capture.second(early.get(), late.get(), cycle - start_cycle))
+                {
+                    ++turned_down;
+                    start();
+                    capture.restart();
+                    start_cycle = cycle + 1;
+                    junk_discarded = false;
+                    continue;
+                }
+                test_assert(capture.edge_cycles() == rises[edge] - start_cycle);
+                ++seconds;
+            }
+        }
+        // Only the edge after the glitch is lost.
+        test_assert_unsigned_eq(turned_down, 1u);
+        test_assert_unsigned_eq(seconds, n_edges - 1);
+    }
+
+    // Edges that stop for longer than the counts take to wrap.
+    {
+        PpsCapture capture;
+        capture.second(initial_count + 3 - 62500000, initial_count + 3 - 62500001, 125000000);
+        test_assert(capture.edge_cycles() == 125000000u);
+
+        uint64_t const gap_bicycles = 100 * uint64_t(62500000);
+        uint32_t const count = initial_count + 3 - static_cast<uint32_t>(gap_bicycles);
+        capture.second(count, count, 125000000 + 2 * gap_bicycles + 125000);
+        test_assert(capture.edge_cycles() == 125000000 + 2 * gap_bicycles);
+        test_assert(capture.cycles_in_last_second() == std::numeric_limits<uint32_t>::max());
+    }
+
+    return true;
+}
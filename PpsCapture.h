@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+/*
+ * Exact edge times from the counts the pps PIO program pushes, in cycles of the chip's clock.
+ *
+ * A state machine can only look at the pin every other cycle, so each one counts bicycles. The
+ * program runs on two, one a cycle behind the other, so each edge is seen by one of them on the
+ * cycle it comes and by the other on the cycle after. The two counts between a pair of edges
+ * therefore add up to the cycles between them, exactly. Neither state machine stops counting at
+ * an edge, only restarts its count, so an edge's time is the sum of the seconds before it.
+ *
+ * Edges are as the state machines see them, a couple of cycles after the pin changes for the
+ * input synchronizer, which is the same for every edge.
+ *
+ * A glitch on the pin shorter than a bicycle can be seen by one state machine and not the other.
+ * That one then pushes a pair of counts the other doesn't, and the counts that are fetched
+ * together are no longer for the same edges, for good. Their counts for a second then disagree
+ * by far more than the one bicycle they can between them, so second() turns them down, and the
+ * state machines have to be started over together, with restart() to match.
+ */
+class PpsCapture
+{
+public:
+    static uint32_t constexpr cycles_per_us = 125;
+
+    // What the host gives each state machine to count down from each second.
+    static uint32_t constexpr initial_count = std::numeric_limits<uint32_t>::max() - 3;
+
+    // A state machine's count at the end of a pulse, and at the end of a second, as bicycles
+    // since the edge before, including those spent pushing and pulling rather than counting.
+    static constexpr uint32_t bicycles_in_pulse(uint32_t count) { return initial_count + 2 - count; }
+    static constexpr uint32_t bicycles_in_second(uint32_t count) { return initial_count + 3 - count; }
+
+    // The counts from both state machines at the end of a pulse.
+    void pulse(uint32_t early_count, uint32_t late_count);
+
+    // The counts from both state machines at the end of a second, and roughly how many cycles
+    // it's been since they started, to catch the counts wrapping (every 69 s or so) if the
+    // edges stopped for that long. False, leaving everything as it was, if the counts aren't
+    // for the same edge.
+    bool second(uint32_t early_count, uint32_t late_count, uint64_t cycles_since_start);
+
+    // The state machines have been started over, and count from nothing again.
+    void restart();
+
+    uint32_t cycles_in_last_pulse() const { return _cycles_in_last_pulse; }
+    uint32_t cycles_in_last_second() const { return _cycles_in_last_second; }
+
+    // When the last edge came, in cycles since the state machines started.
+    uint64_t edge_cycles() const { return _early_bicycles + _late_bicycles - 1; }
+
+    static bool unit_test();
+
+private:
+    // Every bicycle each state machine has counted up to the last edge.
+    uint64_t _early_bicycles = 0;
+    uint64_t _late_bicycles = 0;
+
+    uint32_t _cycles_in_last_pulse = 0;
+    uint32_t _cycles_in_last_second = 0;
+
+    static uint64_t _unwrap(uint32_t bicycles, uint64_t expected_bicycles);
+};
@@ -0,0 +1,391 @@
+#include "PpsHistory.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "util.h"
+
+namespace
+{
+    uint64_t constexpr us_per_second = 1000000;
+    size_t constexpr max_record_len = 1 + 3 * 10;
+    size_t constexpr bytes_per_dump_line = 32;
+
+    uint64_t zigzag(int64_t const x)
+    {
+        return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63);
+    }
+
+    int64_t unzigzag(uint64_t const x)
+    {
+        return static_cast<int64_t>(x >> 1) ^ -static_cast<int64_t>(x & 1);
+    }
+
+    size_t put_varint(uint8_t * const out, uint64_t x)
+    {
+        size_t len = 0;
+        while (x >= 0x80)
+        {
+            out[len++] = static_cast<uint8_t>(x) | 0x80;
+            x >>= 7;
+        }
+        out[len++] = static_cast<uint8_t>(x);
+        return len;
+    }
+
+    PpsHistoryEntry predict(PpsHistoryEntry const & prev)
+    {
+        return {prev.edge_us + us_per_second, prev.cycles, prev.pulse_cycles, prev.locked, PpsAnomaly::none};
+    }
+}
+
+PpsHistory::PpsHistory(uint32_t const nominal_cycles_per_second,
+                       uint32_t const nominal_cycles_per_pulse,
+                       size_t const capacity_bytes):
+    _nominal_cycles_per_second(nominal_cycles_per_second),
+    _nominal_cycles_per_pulse(nominal_cycles_per_pulse),
+    _bytes(capacity_bytes),
+    _base({0, nominal_cycles_per_second, nominal_cycles_per_pulse, false, PpsAnomaly::none}),
+    _last(_base)
+{
+}
+
+char const * PpsHistory::anomaly_name(PpsAnomaly const anomaly)
+{
+    switch (anomaly)
+    {
+    case PpsAnomaly::none:
+        return "none";
+    case PpsAnomaly::missing:
+        return "missing";
+    case PpsAnomaly::extra:
+        return "extra";
+    case PpsAnomaly::short_pulse:
+        return "short";
+    case PpsAnomaly::irregular:
+        return "irregular";
+    }
+    return "?";
+}
+
+// The chip's clock is good to far better than a part in a thousand, and the receiver's pulses are
+// 100 ms, or 50 ms without a fix.
+PpsAnomaly PpsHistory::_classify(uint32_t const cycles, uint32_t const pulse_cycles) const
+{
+    uint32_t const tolerance = _nominal_cycles_per_second / 1000;
+    if (cycles + tolerance < _nominal_cycles_per_second)
+    {
+        return PpsAnomaly::extra;
+    }
+    if (cycles >= _nominal_cycles_per_second * 2 - tolerance)
+    {
+        return PpsAnomaly::missing;
+    }
+    if (cycles > _nominal_cycles_per_second + tolerance)
+    {
+        return PpsAnomaly::irregular;
+    }
+    if (pulse_cycles < _nominal_cycles_per_pulse / 4)
+    {
+        return PpsAnomaly::short_pulse;
+    }
+    return PpsAnomaly::none;
+}
+
+void PpsHistory::add(uint64_t const edge_us, uint32_t const cycles, uint32_t const pulse_cycles, bool const locked)
+{
+    // The first edge has no second before it to judge.
+    PpsAnomaly const anomaly = _any ? _classify(cycles, pulse_cycles) : PpsAnomaly::none;
+    ++_anomalies[static_cast<size_t>(anomaly)];
+
+    PpsHistoryEntry const expected = predict(_last);
+    uint8_t record[max_record_len];
+    size_t len = 0;
+    record[len++] = (locked ? 1 : 0) | static_cast<uint8_t>(anomaly) << 1;
+    len += put_varint(record + len, zigzag(static_cast<int64_t>(edge_us - expected.edge_us)));
+    len += put_varint(record + len, zigzag(static_cast<int64_t>(cycles) - expected.cycles));
+    len += put_varint(record + len, zigzag(static_cast<int64_t>(pulse_cycles) - expected.pulse_cycles));
+
+    while (_bytes.size() - _used < len)
+    {
+        _drop_oldest();
+    }
+    for (size_t i = 0; i < len; ++i)
+    {
+        _bytes[(_start + _used + i) % _bytes.size()] = record[i];
+    }
+    _used += len;
+    ++_entries;
+
+    _last = {edge_us, cycles, pulse_cycles, locked, anomaly};
+    _any = true;
+}
+
+size_t PpsHistory::_decode(size_t pos, PpsHistoryEntry const & prev, PpsHistoryEntry & entry) const
+{
+    uint8_t const flags = _at(pos++);
+    int64_t deltas[3];
+    for (int64_t & delta : deltas)
+    {
+        uint64_t x = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            uint8_t const b = _at(pos++);
+            x |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80))
+            {
+                break;
+            }
+        }
+        delta = unzigzag(x);
+    }
+
+    entry = predict(prev);
+    entry.edge_us += deltas[0];
+    entry.cycles += deltas[1];
+    entry.pulse_cycles += deltas[2];
+    entry.locked = flags & 1;
+    entry.anomaly = static_cast<PpsAnomaly>(flags >> 1);
+    return pos;
+}
+
+size_t PpsHistory::_record_end(size_t pos) const
+{
+    if (pos >= _used)
+    {
+        return 0;
+    }
+    ++pos;
+    for (int varints = 0; varints < 3; )
+    {
+        if (pos >= _used)
+        {
+            return 0;
+        }
+        varints += !(_at(pos++) & 0x80);
+    }
+    return pos;
+}
+
+void PpsHistory::_drop_oldest()
+{
+    size_t const next = _decode(0, _base, _base);
+    _start = (_start + next) % _bytes.size();
+    _used -= next;
+    --_entries;
+}
+
+void PpsHistory::for_each(std::function<void(PpsHistoryEntry const &)> const & f) const
+{
+    PpsHistoryEntry entry = _base;
+    for (size_t pos = 0; pos < _used; )
+    {
+        pos = _decode(pos, entry, entry);
+        f(entry);
+    }
+}
+
+PpsHistoryDump::PpsHistoryDump(PpsHistory const & history, Format const format):
+    _history(history),
+    _format(format),
+    _entry(history._base)
+{
+}
+
+bool PpsHistoryDump::next_line(char * const line, size_t const len)
+{
+    if (!_header_done)
+    {
+        _header_done = true;
+        if (_format == Format::csv)
+        {
+            snprintf(line, len, "edge_us,cycles,pulse_cycles,locked,anomaly");
+        }
+        else
+        {
+            PpsHistoryEntry const & base = _history._base;
+            snprintf(line, len, "PPSH %" PRIu64 " %" PRIu32 " %" PRIu32 " %d %d",
+                     base.edge_us, base.cycles, base.pulse_cycles, base.locked, static_cast<int>(base.anomaly));
+        }
+        return true;
+    }
+
+    if (_pos >= _history._used)
+    {
+        return false;
+    }
+
+    if (_format == Format::csv)
+    {
+        _pos = _history._decode(_pos, _entry, _entry);
+        snprintf(line, len, "%" PRIu64 ",%" PRIu32 ",%" PRIu32 ",%d,%s",
+                 _entry.edge_us, _entry.cycles, _entry.pulse_cycles, _entry.locked, PpsHistory::anomaly_name(_entry.anomaly));
+    }
+    else
+    {
+        int n = snprintf(line, len, "PPSB ");
+        for (size_t i = 0; i < bytes_per_dump_line && _pos < _history._used; ++i, ++_pos)
+        {
+            n += snprintf(line + n, len - n, "%02x", _history._at(_pos));
+        }
+    }
+    return true;
+}
+
+bool PpsHistory::load_dump_line(char const * const line)
+{
+    if (strncmp(line, "PPSH ", 5) == 0)
+    {
+        unsigned long long edge_us;
+        unsigned long cycles;
+        unsigned long pulse_cycles;
+        int locked;
+        int anomaly;
+        if (sscanf(line + 5, "%llu %lu %lu %d %d", &edge_us, &cycles, &pulse_cycles, &locked, &anomaly) != 5)
+        {
+            return false;
+        }
+        _base = {edge_us, static_cast<uint32_t>(cycles), static_cast<uint32_t>(pulse_cycles),
+                 locked != 0, static_cast<PpsAnomaly>(anomaly)};
+        _last = _base;
+        _start = 0;
+        _used = 0;
+        _entries = 0;
+        _any = true;
+        return true;
+    }
+
+    if (strncmp(line, "PPSB ", 5) != 0)
+    {
+        return false;
+    }
+    for (char const * p = line + 5; *p != '\0'; p += 2)
+    {
+        char const hex[3] = {p[0], p[1], '\0'};
+        char * end;
+        unsigned long const b = strtoul(hex, &end, 16);
+        if (end != hex + 2 || _used == _bytes.size())
+        {
+            return false;
+        }
+        _bytes[_used++] = b;
+    }
+
+    // Count the edges that are whole now.
+    _entries = 0;
+    PpsHistoryEntry entry = _base;
+    for (size_t pos = 0, end; (end = _record_end(pos)) != 0; pos = end)
+    {
+        _decode(pos, entry, entry);
+        ++_entries;
+    }
+    _last = entry;
+    return true;
+}
+
+void PpsHistory::show_status() const
+{
+    printf("PPS anomalies: %" PRIu32 " missing, %" PRIu32 " extra, %" PRIu32 " short, %" PRIu32 " irregular; %zu edges kept in %zu bytes\n",
+           anomalies(PpsAnomaly::missing),
+           anomalies(PpsAnomaly::extra),
+           anomalies(PpsAnomaly::short_pulse),
+           anomalies(PpsAnomaly::irregular),
+           _entries,
+           _used);
+}
+
+bool pps_history_test()
+{
+    uint32_t constexpr second = 125000000;
+    uint32_t constexpr pulse = 12500000;
+
+    // Steady edges take four bytes each, and the oldest go to make room for more.
+    {
+        PpsHistory history(second, pulse, 1000);
+        uint64_t edge_us = 5000000;
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            edge_us += 1000008 + i % 3;
+            history.add(edge_us, second + 1000 + i % 7, pulse - 3 + i % 5, true);
+        }
+        test_assert(history.size() == 250 && history.bytes_used() == 1000);
+        test_assert(history.anomalies(PpsAnomaly::none) == 1000);
+
+        uint32_t i = 750;
+        uint64_t expected_us = 5000000;
+        for (uint32_t j = 0; j <= 750; ++j)
+        {
+            expected_us += 1000008 + j % 3;
+        }
+        bool ok = true;
+        history.for_each([&](PpsHistoryEntry const & entry) {
+            ok = ok && entry.edge_us == expected_us && entry.cycles == second + 1000 + i % 7 &&
+                 entry.pulse_cycles == pulse - 3 + i % 5 && entry.locked && entry.anomaly == PpsAnomaly::none;
+            ++i;
+            expected_us += 1000008 + i % 3;
+        });
+        test_assert(ok && i == 1000);
+    }
+
+    // Each kind of anomaly, as each edge comes.
+    {
+        PpsHistory history(second, pulse, 1000);
+        uint64_t edge_us = 0;
+        auto const add = [&](uint32_t const cycles, uint32_t const pulse_cycles) {
+            edge_us += cycles / 125;
+            history.add(edge_us, cycles, pulse_cycles, false);
+        };
+        add(second / 3, pulse);              // The first edge, after some part of a second.
+        add(second + 700, pulse);
+        add(3 * second + 2000, pulse);       // Two missing.
+        add(second / 2, pulse);              // An extra edge halfway...
+        add(second / 2, pulse);              // and, measured from it, the next one early too.
+        add(second + second / 10, pulse);    // A late edge.
+        add(second, pulse / 2);              // Without a fix, the pulses are shorter...
+        add(second, pulse / 10);             // but never this short.
+        test_assert(history.anomalies(PpsAnomaly::none) == 3);
+        test_assert(history.anomalies(PpsAnomaly::missing) == 1);
+        test_assert(history.anomalies(PpsAnomaly::extra) == 2);
+        test_assert(history.anomalies(PpsAnomaly::irregular) == 1);
+        test_assert(history.anomalies(PpsAnomaly::short_pulse) == 1);
+
+        // A dump as CSV...
+        std::vector<std::string> lines;
+        char line[128];
+        PpsHistoryDump csv(history, PpsHistoryDump::Format::csv);
+        while (csv.next_line(line, sizeof(line)))
+        {
+            lines.push_back(line);
+        }
+        test_assert(lines.size() == 9);
+        test_assert(lines[0] == "edge_us,cycles,pulse_cycles,locked,anomaly");
+        test_assert(lines[3].ends_with(",375002000,12500000,0,missing"));
+        test_assert(lines[8].ends_with(",125000000,1250000,0,short"));
+
+        // ...and as bytes, which load back into the same history, whatever the line breaks.
+        PpsHistoryDump binary(history, PpsHistoryDump::Format::binary);
+        PpsHistory loaded(second, pulse, 1000);
+        size_t n_binary = 0;
+        while (binary.next_line(line, sizeof(line)))
+        {
+            test_assert(loaded.load_dump_line(line));
+            ++n_binary;
+        }
+        test_assert(n_binary >= 2);
+        test_assert(loaded.size() == history.size());
+        std::vector<std::string> reloaded;
+        PpsHistoryDump csv_again(loaded, PpsHistoryDump::Format::csv);
+        while (csv_again.next_line(line, sizeof(line)))
+        {
+            reloaded.push_back(line);
+        }
+        test_assert(reloaded == lines);
+        test_assert(!loaded.load_dump_line("PPSB 0g"));
+        test_assert(!loaded.load_dump_line("@E"));
+    }
+
+    return true;
+}
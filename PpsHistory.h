@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+bool pps_history_test();
+
+// What looked wrong about an edge, judged from the second and the pulse that came before it.
+enum class PpsAnomaly: uint8_t
+{
+    none,
+    missing,        // The second is two or more long: edges went missing.
+    extra,          // The second is short: an edge came that shouldn't have.
+    short_pulse,    // Shorter than the receiver ever makes them.
+    irregular,      // Long, but not by a whole second.
+};
+
+struct PpsHistoryEntry
+{
+    uint64_t edge_us;       // When the edge came, on the chip's clock.
+    uint32_t cycles;        // In the second it ended.
+    uint32_t pulse_cycles;  // In the pulse before that.
+    bool locked;
+    PpsAnomaly anomaly;
+};
+
+/*
+ * The last few thousand PPS edges, for when something went wrong and someone wants to know what.
+ *
+ * Each edge is kept as its difference from what the one before it predicts: the same second and
+ * pulse lengths, and an edge a million microseconds later. A steady edge takes four bytes: one for
+ * the lock state and the anomaly, and one zigzag varint for each difference. The oldest edges are
+ * dropped to make room, folded into the entry the rest are differences from.
+ *
+ * PpsHistoryDump writes it out as CSV, or as the stored bytes in hex, which load_dump_line() takes
+ * back:
+ *
+ *   PPSH 1200345678 125000013 12500001 1 0    The entry the first stored one is a difference from.
+ *   PPSB 0200020202000202...                  Stored bytes, 32 to a line.
+ */
+class PpsHistory
+{
+public:
+    static size_t constexpr default_capacity_bytes = 16384;
+
+    PpsHistory(uint32_t nominal_cycles_per_second,
+               uint32_t nominal_cycles_per_pulse,
+               size_t capacity_bytes = default_capacity_bytes);
+
+    // Each edge, as Pps sees it.
+    void add(uint64_t edge_us, uint32_t cycles, uint32_t pulse_cycles, bool locked);
+
+    // Calls f with each edge kept, oldest first.
+    void for_each(std::function<void(PpsHistoryEntry const &)> const & f) const;
+
+    size_t size() const { return _entries; }
+    size_t bytes_used() const { return _used; }
+
+    // Every one there has been, not just those still kept.
+    uint32_t anomalies(PpsAnomaly anomaly) const { return _anomalies[static_cast<size_t>(anomaly)]; }
+
+    static char const * anomaly_name(PpsAnomaly anomaly);
+
+    // Takes back the lines of a binary dump, in order. False for a line that isn't one.
+    bool load_dump_line(char const * line);
+
+    void show_status() const;
+
+private:
+    uint32_t const _nominal_cycles_per_second;
+    uint32_t const _nominal_cycles_per_pulse;
+
+    std::vector<uint8_t> _bytes;
+    size_t _start = 0;
+    size_t _used = 0;
+    size_t _entries = 0;
+
+    // What the oldest stored edge is a difference from, and the newest edge.
+    PpsHistoryEntry _base;
+    PpsHistoryEntry _last;
+    bool _any = false;
+
+    uint32_t _anomalies[5] = {};
+
+    PpsAnomaly _classify(uint32_t cycles, uint32_t pulse_cycles) const;
+
+    uint8_t _at(size_t pos) const { return _bytes[(_start + pos) % _bytes.size()]; }
+
+    // The entry stored at pos, from the one before it. Returns the position of the next.
+    size_t _decode(size_t pos, PpsHistoryEntry const & prev, PpsHistoryEntry & entry) const;
+    // Where the entry stored at pos ends, or 0 if it isn't all there.
+    size_t _record_end(size_t pos) const;
+    void _drop_oldest();
+
+    friend class PpsHistoryDump;
+};
+
+// Writes the edges a PpsHistory has kept, a line at a time and without newlines, so that a long
+// history can go out a few lines at a time between other work. Has a copy of the history to
+// itself, so that edges coming meanwhile don't disturb it.
+class PpsHistoryDump
+{
+public:
+    enum class Format
+    {
+        csv,
+        binary,
+    };
+
+    PpsHistoryDump(PpsHistory const & history, Format format);
+
+    // False once there's nothing more.
+    bool next_line(char * line, size_t len);
+
+private:
+    PpsHistory const _history;
+    Format const _format;
+    bool _header_done = false;
+    size_t _pos = 0;
+    PpsHistoryEntry _entry;
+};
@@ -0,0 +1,543 @@
+#include "PpsSimulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Pps.h"
+#include "PpsCapture.h"
+#include "util.h"
+
+PpsSimulator::PpsSimulator(PpsScenario const & scenario, usec_t const start_us):
+    _scenario(scenario),
+    _lcg(scenario.seed),
+    _now_us(start_us)
+{
+}
+
+uint32_t PpsSimulator::_random(uint32_t const n)
+{
+    _lcg = _lcg * 1664525 + 1013904223;
+    return (_lcg >> 8) % n;
+}
+
+int64_t PpsSimulator::_now_cycle() const
+{
+    return static_cast<int64_t>(_now_us - _start_us) * cycles_per_us;
+}
+
+// The chip's count at a GPS time, in seconds since the counting started.
+double PpsSimulator::_cycles_at(double const gps_s) const
+{
+    double const drift_s = 1e-6 * (_scenario.chip_ppm * gps_s + _scenario.chip_ppm_per_day * gps_s * gps_s / (2 * 86400));
+    return (gps_s + drift_s) * cycles_per_us * 1e6;
+}
+
+double PpsSimulator::gps_second_us(uint64_t const second) const
+{
+    return _start_us + _cycles_at(_scenario.first_edge_us * 1e-6 + second) / cycles_per_us;
+}
+
+usec_t PpsSimulator::start()
+{
+    _start_us = _now_us;
+    _started = true;
+    return restart();
+}
+
+usec_t PpsSimulator::restart()
+{
+    _start_cycle = _now_cycle();
+
+    // What they had pushed is gone. Partway through a pulse, the next thing each pushes is its
+    // end, counted from now.
+    bool pin_high = false;
+    for (std::deque<Push> & pushes : _pushes)
+    {
+        while (!pushes.empty() && pushes.front().cycle <= _start_cycle)
+        {
+            pushes.pop_front();
+        }
+        pin_high |= !pushes.empty() && !pushes.front().second && pushes.front().from_cycle <= _start_cycle;
+    }
+
+    // Otherwise it's straight away, the end of a pulse that never was.
+    if (!pin_high)
+    {
+        for (std::deque<Push> & pushes : _pushes)
+        {
+            pushes.push_front({_start_cycle, false, _start_cycle - 1});
+        }
+    }
+    return _now_us;
+}
+
+void PpsSimulator::advance(usec_t const now_us)
+{
+    _now_us = now_us;
+    if (!_started)
+    {
+        return;
+    }
+
+    // Far enough ahead that every push up to now is known, and the next after it.
+    while (_cycles_at(_scenario.first_edge_us * 1e-6 + _second) <= _now_cycle() + cycles_per_us * 1000000)
+    {
+        _next_second();
+    }
+}
+
+usec_t PpsSimulator::next_push_us()
+{
+    advance(_now_us);
+    if (_pushes[early].empty() || _pushes[late].empty())
+    {
+        return std::numeric_limits<usec_t>::max();
+    }
+    int64_t const cycle = std::max(_pushes[early].front().cycle, _pushes[late].front().cycle);
+    return _start_us + (cycle + cycles_per_us - 1) / cycles_per_us;
+}
+
+usec_t PpsSimulator::next_count_us()
+{
+    advance(_now_us);
+    int64_t cycle = std::numeric_limits<int64_t>::max();
+    for (std::deque<Push> const & pushes : _pushes)
+    {
+        if (!pushes.empty())
+        {
+            cycle = std::min(cycle, pushes.front().cycle);
+        }
+    }
+    if (cycle == std::numeric_limits<int64_t>::max())
+    {
+        return std::numeric_limits<usec_t>::max();
+    }
+    return _start_us + (cycle + cycles_per_us - 1) / cycles_per_us;
+}
+
+bool PpsSimulator::interrupt_pending()
+{
+    return _waiting(early) > 0 || _waiting(late) > 0;
+}
+
+bool PpsSimulator::_fault(std::vector<std::pair<uint64_t, uint64_t>> const & spans, uint32_t const one_in)
+{
+    for (auto const & span : spans)
+    {
+        if (span.first <= _second && _second < span.second)
+        {
+            return true;
+        }
+    }
+    return one_in && _random(one_in) == 0;
+}
+
+void PpsSimulator::_next_second()
+{
+    double const gps_s = _scenario.first_edge_us * 1e-6 + _second;
+
+    if (_fault(_scenario.outages, _scenario.missing_one_in))
+    {
+        ++_missing;
+    }
+    else
+    {
+        double const late_cycles = _scenario.jitter_ns * _random(1000) / 1000 * cycles_per_us / 1000;
+        int64_t const rise = std::floor(_cycles_at(gps_s) + late_cycles);
+
+        uint32_t pulse_ms = _scenario.pulse_ms;
+        if (_fault(_scenario.bad_widths, _scenario.bad_width_one_in))
+        {
+            pulse_ms = 1 + _random(2 * _scenario.pulse_ms);
+            if (std::abs(static_cast<int32_t>(pulse_ms - _scenario.pulse_ms)) <= static_cast<int32_t>(_scenario.pulse_ms / 20))
+            {
+                pulse_ms = _scenario.pulse_ms / 2;
+            }
+            ++_bad_widths;
+        }
+        _pulse(rise, rise + std::floor(_cycles_at(gps_s + pulse_ms * 1e-3) - _cycles_at(gps_s)));
+
+        // After the widest pulse, and before any extra one.
+        if (_fault(_scenario.glitches, _scenario.glitch_one_in))
+        {
+            int64_t const glitch = std::floor(_cycles_at(gps_s + 0.25 + _random(50) * 1e-3));
+            _pulse(_random(2) ? early : late, glitch, glitch + 1);
+            ++_glitches;
+        }
+
+        if (_fault(_scenario.extra_pulses, _scenario.extra_one_in))
+        {
+            double const extra_s = gps_s + 0.3 + _random(400) * 1e-3;
+            int64_t const extra_rise = std::floor(_cycles_at(extra_s));
+            _pulse(extra_rise, std::floor(_cycles_at(extra_s + _scenario.pulse_ms * 1e-3)));
+            ++_extra;
+        }
+    }
+    ++_second;
+}
+
+// What a state machine pushes at the start and end of a pulse it sees.
+void PpsSimulator::_pulse(StateMachine const sm, int64_t const rise_cycle, int64_t const fall_cycle)
+{
+    _pushes[sm].push_back({rise_cycle, true, _last_edge_cycle[sm]});
+    _pushes[sm].push_back({fall_cycle, false, rise_cycle});
+    _last_edge_cycle[sm] = rise_cycle;
+}
+
+// A pulse both see.
+void PpsSimulator::_pulse(int64_t const rise_cycle, int64_t const fall_cycle)
+{
+    _pulse(early, rise_cycle, fall_cycle);
+    _pulse(late, rise_cycle, fall_cycle);
+    ++_edges;
+}
+
+// The bicycles a state machine has counted up to an edge on the given cycle, since the counting
+// last started. Each sees an edge on the cycle it comes or the one after, whichever it looks at
+// the pin on, so the two counts between a pair of edges add up to the cycles between them.
+int64_t PpsSimulator::_bicycles(StateMachine const sm, int64_t const cycle) const
+{
+    return (cycle - _start_cycle + (sm == early ? 2 : 1)) / 2;
+}
+
+bool PpsSimulator::_ready()
+{
+    return !_pushes[early].empty() && _pushes[early].front().cycle <= _now_cycle() &&
+           !_pushes[late].empty() && _pushes[late].front().cycle <= _now_cycle();
+}
+
+size_t PpsSimulator::_waiting(StateMachine const sm) const
+{
+    size_t n = 0;
+    while (n < _pushes[sm].size() && _pushes[sm][n].cycle <= _now_cycle())
+    {
+        ++n;
+    }
+    return n;
+}
+
+uint32_t PpsSimulator::_take(StateMachine const sm)
+{
+    Push const push = _pushes[sm].front();
+    _pushes[sm].pop_front();
+    int64_t const from_cycle = std::max(push.from_cycle, _start_cycle - 1);
+    return PpsCapture::initial_count + (push.second ? 3 : 2) -
+           static_cast<uint32_t>(_bicycles(sm, push.cycle) - _bicycles(sm, from_cycle));
+}
+
+bool PpsSimulator::pulse_completed()
+{
+    return _ready();
+}
+
+void PpsSimulator::get_pulse_counts(uint32_t & early_count, uint32_t & late_count)
+{
+    early_count = _take(early);
+    late_count = _take(late);
+}
+
+bool PpsSimulator::second_completed()
+{
+    return _ready();
+}
+
+void PpsSimulator::get_second_counts(uint32_t & early_count, uint32_t & late_count)
+{
+    early_count = _take(early);
+    late_count = _take(late);
+}
+
+bool PpsSimulator::counts_unpaired()
+{
+    return _waiting(early) != _waiting(late);
+}
+
+usec_t run_pps_simulation(PpsSimulator & simulator, Pps & pps, usec_t const until_us, usec_t const step_us, usec_t const fast_latency_us)
+{
+    usec_t longest_interrupt_us = 0;
+    usec_t now_us = simulator.now_us();
+    while (now_us < until_us)
+    {
+        usec_t const next_push_us = pps.interrupt_driven() ? simulator.next_count_us() : simulator.next_push_us();
+        usec_t const fast_us = next_push_us == std::numeric_limits<usec_t>::max() ? next_push_us : next_push_us + fast_latency_us;
+        now_us = std::min(until_us, std::min(now_us + step_us, std::max(now_us, fast_us)));
+        simulator.advance(now_us);
+        if (now_us >= fast_us)
+        {
+            usec_t const interrupt_us = now_us;
+            pps.dispatch_fast_thread();
+            while (pps.interrupt_driven() && simulator.interrupt_pending() && now_us < until_us)
+            {
+                simulator.advance(++now_us);
+                pps.dispatch_fast_thread();
+            }
+            longest_interrupt_us = std::max(longest_interrupt_us, now_us - interrupt_us);
+        }
+        pps.dispatch_main_thread();
+    }
+    return longest_interrupt_us;
+}
+
+namespace
+{
+    // How far Pps puts the top of a second from where the simulator does, in microseconds.
+    double top_error_us(Pps const & pps, PpsSimulator const & simulator, uint64_t const second)
+    {
+        // The first edge completes the first second.
+        return static_cast<double>(pps.get_time_us_of(second + 1, 0)) - simulator.gps_second_us(second);
+    }
+
+    // Runs until just after the edge the given second starts with.
+    void run_to(PpsSimulator & simulator, Pps & pps, uint64_t const second, usec_t const after_us = 1000)
+    {
+        run_pps_simulation(simulator, pps, std::ceil(simulator.gps_second_us(second)) + after_us);
+    }
+}
+
+bool pps_simulator_test()
+{
+    // Clean edges: it locks on the fifth, and from then on keeps time to the microsecond.
+    {
+        PpsScenario scenario;
+        scenario.chip_ppm = 12.5;
+        PpsSimulator simulator(scenario);
+        Pps pps(simulator);
+        pps.set_quiet(true);
+        pps.start();
+
+        run_to(simulator, pps, 3);
+        test_assert(!pps.locked());
+        run_to(simulator, pps, 4);
+        test_assert(pps.locked());
+        test_assert(pps.get_completed_seconds() == 5);
+
+        // Unlocked from the first edge until the fifth, on the chip's clock.
+        test_assert(std::abs(static_cast<double>(pps.unlocked_us()) - 4e6 * (1 + 12.5e-6)) < 2);
+
+        run_to(simulator, pps, 200, 400000);
+        test_assert(pps.locked());
+        test_assert(pps.get_completed_seconds() == 201);
+        test_assert(std::abs(top_error_us(pps, simulator, 200)) <= 1);
+        test_assert(std::abs(top_error_us(pps, simulator, 230)) <= 1);
+
+        // In GPS time, which the chip's runs a little ahead of.
+        double const additional_gps_us = (simulator.now_us() - simulator.gps_second_us(200)) / (1 + 12.5e-6);
+        uint32_t completed_seconds;
+        uint32_t additional_us;
+        pps.get_time(completed_seconds, additional_us);
+        test_assert(completed_seconds == 201);
+        test_assert(std::abs(additional_us - additional_gps_us) <= 1);
+        test_assert(std::abs(pps.get_us_until(202) - (1e6 - additional_gps_us)) <= 1);
+        test_assert(pps.history().size() == 201);
+    }
+
+    // Drifting and jittery: still locked throughout, and within a couple of microseconds.
+    {
+        PpsScenario scenario;
+        scenario.chip_ppm = -31;
+        scenario.chip_ppm_per_day = 200;
+        scenario.jitter_ns = 40;
+        PpsSimulator simulator(scenario);
+        Pps pps(simulator);
+        pps.set_quiet(true);
+        pps.start();
+
+        run_to(simulator, pps, 100);
+        usec_t const unlocked_us = pps.unlocked_us();
+        for (uint64_t second = 100; second < 2000; second += 100)
+        {
+            run_to(simulator, pps, second);
+            test_assert(pps.locked());
+            test_assert(std::abs(top_error_us(pps, simulator, second + 1)) <= 2);
+        }
+        test_assert(pps.unlocked_us() == unlocked_us);
+    }
+
+    // An edge goes missing: Pps holds over for it, and counts it lost. The next one comes where
+    // holdover has it, and the lock carries on.
+    {
+        PpsScenario scenario;
+        scenario.outages = {{50, 51}};
+        PpsSimulator simulator(scenario);
+        Pps pps(simulator);
+        pps.set_quiet(true);
+        pps.start();
+
+        run_to(simulator, pps, 49);
+        test_assert(pps.locked());
+        usec_t const unlocked_us = pps.unlocked_us();
+        run_to(simulator, pps, 50, 200000);
+        test_assert(pps.locked() && pps.holding_over());
+        test_assert(pps.get_completed_seconds() == 51);
+        test_assert(std::abs(top_error_us(pps, simulator, 50)) <= 1);
+
+        run_to(simulator, pps, 51);
+        test_assert(pps.locked() && !pps.holding_over());
+        test_assert(pps.get_completed_seconds() == 52);
+        test_assert(std::abs(top_error_us(pps, simulator, 51)) <= 1);
+
+        // From the second held over, a hundred milliseconds after the missing edge, to the next.
+        double const lost_us = pps.unlocked_us() - unlocked_us;
+        test_assert(lost_us > 0.8e6 && lost_us < 1e6);
+        test_assert(pps.history().anomalies(PpsAnomaly::missing) == 1);
+    }
+
+    // Edges stop for longer than the counts take to wrap, and come back where they should.
+    {
+        PpsScenario scenario;
+        scenario.outages = {{60, 160}};
+        PpsSimulator simulator(scenario);
+        Pps pps(simulator);
+        pps.set_quiet(true);
+        pps.start();
+
+        run_to(simulator, pps, 159, 500000);
+        test_assert(pps.holding_over());
+        test_assert(pps.get_completed_seconds() == 160);
+        run_to(simulator, pps, 160);
+        test_assert(!pps.holding_over());
+        test_assert(pps.get_completed_seconds() == 161);
+        test_assert(std::abs(top_error_us(pps, simulator, 160)) <= 1);
+    }
+
+    // An extra pulse unlocks it, and so does its second, which is short too.
+    {
+        PpsScenario scenario;
+        scenario.extra_pulses = {{40, 41}};
+        PpsSimulator simulator(scenario);
+        Pps pps(simulator);
+        pps.set_quiet(true);
+        pps.start();
+
+        run_to(simulator, pps, 40);
+        test_assert(pps.locked());
+        run_to(simulator, pps, 41);
+        test_assert(!pps.locked());
+        test_assert(pps.get_completed_seconds() == 43);
+        run_to(simulator, pps, 44);
+        test_assert(!pps.locked());
+        run_to(simulator, pps, 45);
+        test_assert(pps.locked());
+        test_assert(simulator.extra() == 1);
+        test_assert(pps.history().anomalies(PpsAnomaly::extra) == 2);
+    }
+
+    // A glitch only one state machine sees puts them out of step. The edge after it is lost and
+    // held over for, and once they have been started over, the edges come out right again.
+    {
+        PpsScenario scenario;
+        scenario.glitches = {{40, 41}};
+        PpsSimulator simulator(scenario);
+        Pps pps(simulator);
+        pps.set_quiet(true);
+        pps.start();
+
+        run_to(simulator, pps, 41, 200000);
+        test_assert(pps.locked() && pps.holding_over());
+        test_assert(pps.capture_restarts() == 1);
+        test_assert(pps.get_completed_seconds() == 42);
+        run_to(simulator, pps, 42);
+        test_assert(pps.locked() && !pps.holding_over());
+        test_assert(pps.get_completed_seconds() == 43);
+        test_assert(std::abs(top_error_us(pps, simulator, 42)) <= 1);
+
+        run_to(simulator, pps, 100);
+        test_assert(pps.locked());
+        test_assert(std::abs(top_error_us(pps, simulator, 100)) <= 1);
+        test_assert(simulator.glitches() == 1);
+        test_assert(pps.capture_restarts() == 1);
+    }
+
+    // Interrupt-driven, the count the glitch leaves unpaired holds the interrupt, and the fast
+    // thread is called over and over. It starts the state machines again within microseconds,
+    // rather than leaving the interrupt held until the next edge, or for good if none comes. As
+    // after any start over, that edge comes after a pulse that never was, and is held over for.
+    {
+        PpsScenario scenario;
+        scenario.glitches = {{40, 41}};
+        PpsSimulator simulator(scenario);
+        Pps pps(simulator);
+        pps.set_quiet(true);
+        pps.set_interrupt_driven(true);
+        pps.start();
+
+        run_to(simulator, pps, 40);
+        test_assert(pps.locked());
+        test_assert(run_pps_simulation(simulator, pps, std::ceil(simulator.gps_second_us(40)) + 600000) <= 25);
+        test_assert(pps.capture_restarts() == 1);
+        test_assert(run_pps_simulation(simulator, pps, std::ceil(simulator.gps_second_us(41)) + 1000) <= 25);
+        test_assert(pps.locked() && pps.holding_over());
+        test_assert(pps.get_completed_seconds() == 42);
+        run_to(simulator, pps, 42);
+        test_assert(pps.locked() && !pps.holding_over());
+        test_assert(std::abs(top_error_us(pps, simulator, 42)) <= 1);
+        test_assert(simulator.glitches() == 1);
+        test_assert(pps.capture_restarts() == 1);
+    }
+
+    // Pulses the wrong width while locked, as the receiver makes them without a fix: Pps holds
+    // over from the first, and once they're right again, the lock carries on.
+    {
+        PpsScenario scenario;
+        scenario.bad_widths = {{150, 1000}};
+        PpsSimulator simulator(scenario);
+        Pps pps(simulator);
+        pps.set_quiet(true);
+        pps.start();
+
+        // Each edge says how wide the pulse before it was.
+        run_to(simulator, pps, 150);
+        test_assert(pps.locked() && !pps.holding_over());
+        run_to(simulator, pps, 151);
+        test_assert(pps.locked() && pps.holding_over());
+        run_to(simulator, pps, 1000, 500000);
+        test_assert(pps.locked() && pps.holding_over());
+        test_assert(pps.get_completed_seconds() == 1001);
+        run_to(simulator, pps, 1001);
+        test_assert(pps.locked() && !pps.holding_over());
+        test_assert(std::abs(top_error_us(pps, simulator, 1001)) <= 1);
+        test_assert(simulator.bad_widths() == 850);
+    }
+
+    // Before it has locked, they wear the lock persistence down instead, and it only locks a few
+    // seconds after they're right again.
+    {
+        PpsScenario scenario;
+        scenario.bad_widths = {{3, 20}};
+        PpsSimulator simulator(scenario);
+        Pps pps(simulator);
+        pps.set_quiet(true);
+        pps.start();
+
+        run_to(simulator, pps, 20);
+        test_assert(!pps.locked());
+        run_to(simulator, pps, 23);
+        test_assert(!pps.locked());
+        run_to(simulator, pps, 24);
+        test_assert(pps.locked());
+    }
+
+    // How long after each edge the fast thread got to it, kept apart by how it was called.
+    {
+        PpsScenario scenario;
+        PpsSimulator simulator(scenario);
+        Pps pps(simulator);
+        pps.set_quiet(true);
+        pps.start();
+
+        for (uint64_t second = 0; second < 20; ++second)
+        {
+            pps.set_interrupt_driven(second >= 10);
+            usec_t const latency_us = second >= 10 ? 2 : 20;
+            run_pps_simulation(simulator, pps, std::ceil(simulator.gps_second_us(second)) + latency_us, 100000, latency_us);
+        }
+        LatencyHistogram const & polled = pps.edge_latency(false);
+        LatencyHistogram const & interrupt_driven = pps.edge_latency(true);
+        test_assert(polled.count() == 10 && interrupt_driven.count() == 10);
+        test_assert(polled.count(20) == 10);
+        test_assert(interrupt_driven.count(2) == 10);
+    }
+
+    return true;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "PpsSource.h"
+
+class Pps;
+
+bool pps_simulator_test();
+
+// What happens to the PPS edges, and when. Seconds count from the first edge.
+struct PpsScenario
+{
+    // How fast the Pico's crystal runs, in parts per million, and how fast that changes.
+    double chip_ppm = 12.5;
+    double chip_ppm_per_day = 0;
+
+    // Each edge comes late by up to this much, evenly spread.
+    double jitter_ns = 0;
+
+    // From the counting starting to the first edge.
+    uint32_t first_edge_us = 300000;
+
+    uint32_t pulse_ms = 100;
+
+    // Times with no edges, with an extra pulse in the middle of each second, with each pulse
+    // the wrong width: anywhere up to twice the usual, but not close to it, and with a glitch a
+    // cycle long in the middle of each second, which only one of the state machines sees. Each
+    // from its first second up to its second.
+    std::vector<std::pair<uint64_t, uint64_t>> outages;
+    std::vector<std::pair<uint64_t, uint64_t>> extra_pulses;
+    std::vector<std::pair<uint64_t, uint64_t>> bad_widths;
+    std::vector<std::pair<uint64_t, uint64_t>> glitches;
+
+    // The same, but in one second in this many, at random. None if 0.
+    uint32_t missing_one_in = 0;
+    uint32_t extra_one_in = 0;
+    uint32_t bad_width_one_in = 0;
+    uint32_t glitch_one_in = 0;
+
+    uint32_t seed = 1;
+};
+
+/*
+ * A stand-in for the pps PIO program and the chip's timer, with a receiver's pulses on the pin.
+ *
+ * The counts are what the two state machines would push for the edges and ends of pulses it has
+ * passed, wrapping as theirs do, each into its own FIFO, and taken a pair at a time as the host
+ * fetches them. The host is taken to keep up, so the FIFOs never fill.
+ *
+ * Time is the Pico's, in microseconds, and only moves when advance() is called.
+ */
+class PpsSimulator: public PpsSource
+{
+public:
+    static uint32_t constexpr cycles_per_us = 125;
+
+    explicit PpsSimulator(PpsScenario const & scenario, usec_t start_us = 1000);
+
+    // Runs the state machines up to now_us.
+    void advance(usec_t now_us);
+
+    // When the state machines next push a pair of counts, and when either next pushes one.
+    usec_t next_push_us();
+    usec_t next_count_us();
+
+    // Either state machine has a count waiting, which holds the PIO's interrupt.
+    bool interrupt_pending();
+
+    // Where GPS time puts the top of the given second on the chip's clock, less the jitter.
+    double gps_second_us(uint64_t second) const;
+
+    // Edges the pin has had, faults and all, and how many were faults of each kind.
+    uint64_t edges() const { return _edges; }
+    uint64_t missing() const { return _missing; }
+    uint64_t extra() const { return _extra; }
+    uint64_t bad_widths() const { return _bad_widths; }
+    uint64_t glitches() const { return _glitches; }
+
+    usec_t start() override;
+    usec_t restart() override;
+    usec_t now_us() override { return _now_us; }
+
+    bool pulse_completed() override;
+    void get_pulse_counts(uint32_t & early_count, uint32_t & late_count) override;
+
+    bool second_completed() override;
+    void get_second_counts(uint32_t & early_count, uint32_t & late_count) override;
+
+    bool counts_unpaired() override;
+
+private:
+    // What one state machine pushes, at the end of a second or of a pulse. The count is worked
+    // out when it's taken, from the edge before, or from when the counting last started.
+    struct Push
+    {
+        int64_t cycle;
+        bool second;
+        int64_t from_cycle;
+    };
+    enum StateMachine
+    {
+        early,
+        late,
+    };
+
+    PpsScenario const _scenario;
+    uint32_t _lcg;
+    uint32_t _random(uint32_t n);
+
+    usec_t _now_us;
+    usec_t _start_us = 0;
+    bool _started = false;
+    // Where the counting last started, in cycles since it first did.
+    int64_t _start_cycle = 0;
+    int64_t _now_cycle() const;
+
+    // The next second to put an edge on the pin for.
+    uint64_t _second = 0;
+    uint64_t _edges = 0;
+    uint64_t _missing = 0;
+    uint64_t _extra = 0;
+    uint64_t _bad_widths = 0;
+    uint64_t _glitches = 0;
+
+    // Where the last edge each state machine saw came, in cycles since the counting first
+    // started. Both have counted nothing by a cycle before they start.
+    int64_t _last_edge_cycle[2] = {-1, -1};
+    std::deque<Push> _pushes[2];
+
+    double _cycles_at(double gps_s) const;
+    bool _fault(std::vector<std::pair<uint64_t, uint64_t>> const & spans, uint32_t one_in);
+    void _pulse(StateMachine sm, int64_t rise_cycle, int64_t fall_cycle);
+    void _pulse(int64_t rise_cycle, int64_t fall_cycle);
+    void _next_second();
+    int64_t _bicycles(StateMachine sm, int64_t cycle) const;
+    bool _ready();
+    size_t _waiting(StateMachine sm) const;
+    uint32_t _take(StateMachine sm);
+};
+
+// Runs pps against simulator until until_us, the way gps_clock.cpp runs it, with the main
+// thread's dispatch every step_us and the fast thread's fast_latency_us after each push: after
+// each pair of them polled, or interrupt-driven, after the first of a pair, and then again a
+// microsecond after each return for as long as either state machine has a count waiting. Returns
+// the longest the interrupt held like that, in microseconds.
+usec_t run_pps_simulation(PpsSimulator & simulator, Pps & pps, usec_t until_us, usec_t step_us = 100000, usec_t fast_latency_us = 0);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+using usec_t = uint64_t;
+using susec_t = int64_t;
+
+/*
+ * Where Pps gets its counts and its sense of time: the pps PIO program and the chip's timer on
+ * the device, or a simulation of them on a host. Counts come in pairs, one from each of the two
+ * state machines, as PpsCapture expects them.
+ */
+class PpsSource
+{
+public:
+    // Starts the counting. Returns the time it started, from which the counts run.
+    virtual usec_t start() = 0;
+
+    // Stops both state machines, drops any counts they haven't had taken, and starts them again
+    // together, for when they've got out of step. Returns the time they started, as start() does.
+    virtual usec_t restart() = 0;
+
+    // The chip's clock.
+    virtual usec_t now_us() = 0;
+
+    // Both state machines have seen a pulse end.
+    virtual bool pulse_completed() = 0;
+    virtual void get_pulse_counts(uint32_t & early_count, uint32_t & late_count) = 0;
+
+    // Both state machines have seen a second end. Getting the counts also gives each the count
+    // it will start the second after next from.
+    virtual bool second_completed() = 0;
+    virtual void get_second_counts(uint32_t & early_count, uint32_t & late_count) = 0;
+
+    // One state machine has more counts waiting than the other. Both push theirs for a transition
+    // within a few cycles of each other, so this only lasts after a glitch only one of them saw.
+    virtual bool counts_unpaired() = 0;
+};
+
+// Never any counts, and a clock that stays where it's put, for tests that hand Pps its seconds
+// themselves.
+class IdlePpsSource: public PpsSource
+{
+public:
+    usec_t start() override { return now; }
+    usec_t restart() override { return now; }
+    usec_t now_us() override { return now; }
+    bool pulse_completed() override { return false; }
+    void get_pulse_counts(uint32_t &, uint32_t &) override {}
+    bool second_completed() override { return false; }
+    void get_second_counts(uint32_t &, uint32_t &) override {}
+    bool counts_unpaired() override { return false; }
+
+    usec_t now = 0;
+};
@@ -45,6 +45,21 @@ bool ring_buffer_test()
     test_assert(buffer.peek(2) == 1);
     test_assert(buffer.peek(3) == 9);
     test_assert(buffer.peek(4) == 6);
+
+    // The view wraps where the storage does.
+    RingBufferView<uint8_t> view = buffer.view(1, 4);
+    test_assert(view.size() == 4u);
+    test_assert(view.first().size() == 2u);
+    test_assert(view.second().size() == 2u);
+    test_assert(view[0] == 2);
+    test_assert(view[1] == 1);
+    test_assert(view[2] == 9);
+    test_assert(view[3] == 6);
+    test_assert((view + 2)[0] == 9);
+    test_assert((view + 3).size() == 1u);
+    test_assert((view + 3)[0] == 6);
+    test_assert(buffer.view(0, 2).second().empty());
+
     buffer.pop(5);
     test_assert(buffer.empty());
     test_assert(!buffer.full());
@@ -1,9 +1,48 @@
 #pragma once
 
 #include <cstddef>
+#include <span>
 
 bool ring_buffer_test();
 
+// Elements of a RingBuffer in place, in two pieces where they wrap around the end of its storage.
+template <typename T>
+class RingBufferView
+{
+public:
+    RingBufferView() = default;
+
+    RingBufferView(std::span<T const> const first, std::span<T const> const second):
+        _first(first), _second(second) {}
+
+    inline size_t size() const
+    {
+        return _first.size() + _second.size();
+    }
+
+    inline T const & operator[](size_t const n) const
+    {
+        return n < _first.size() ? _first[n] : _second[n - _first.size()];
+    }
+
+    // The view less its first n elements.
+    inline RingBufferView operator+(size_t const n) const
+    {
+        if (n < _first.size())
+        {
+            return RingBufferView(_first.subspan(n), _second);
+        }
+        return RingBufferView(_second.subspan(n - _first.size()), {});
+    }
+
+    inline std::span<T const> first() const { return _first; }
+    inline std::span<T const> second() const { return _second; }
+
+private:
+    std::span<T const> _first;
+    std::span<T const> _second;
+};
+
 template <typename T, size_t max_elements>
 class RingBuffer
 {
@@ -33,6 +72,18 @@ public:
         return _data[(_r_idx + n) % _data_len];
     }
 
+    // n elements starting n_start from the front, without copying them.
+    inline RingBufferView<T> view(size_t const n_start, size_t const n) const
+    {
+        size_t const start = (_r_idx + n_start) % _data_len;
+        size_t const to_end = _data_len - start;
+        if (n <= to_end)
+        {
+            return RingBufferView<T>(std::span<T const>(_data + start, n), {});
+        }
+        return RingBufferView<T>(std::span<T const>(_data + start, to_end), std::span<T const>(_data, n - to_end));
+    }
+
     inline void pop(size_t const n)
     {
         _r_idx = (_r_idx + n) % _data_len;
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The sending side of a serial link, so protocol code can run against a simulated device.
+class SerialPort
+{
+public:
+    // Either queues all len bytes or, if there isn't room for them, none.
+    virtual bool write(uint8_t const * data, size_t len) = 0;
+
+    // Everything written has left the wire.
+    virtual bool idle() = 0;
+
+    // Takes effect at once, even on bytes still queued, so wait for idle() first.
+    virtual void set_baud_rate(uint32_t baud_rate) = 0;
+};
@@ -0,0 +1,98 @@
+#include "SpscRingBuffer.h"
+
+#ifdef HOST_BUILD
+  #include <thread>
+#endif
+
+#include "util.h"
+
+bool spsc_ring_buffer_test()
+{
+    {
+        SpscRingBuffer<5> buffer;
+        uint8_t out[8];
+        test_assert(buffer.count() == 0);
+        test_assert(buffer.pop(out, sizeof(out)) == 0);
+
+        uint8_t const in[] = {1, 2, 3, 4, 5, 6, 7};
+        test_assert(buffer.push(in, 3) == 3);
+        test_assert(buffer.count() == 3);
+        test_assert(buffer.pop(out, 2) == 2);
+        test_assert(out[0] == 1 && out[1] == 2);
+
+        // Around the end of the storage, and more than fits.
+        test_assert(buffer.push(in + 3, 4) == 4);
+        test_assert(buffer.count() == 5);
+        test_assert(!buffer.push(9));
+        test_assert(buffer.dropped() == 1);
+        test_assert(buffer.push(in, 2) == 0);
+        test_assert(buffer.dropped() == 3);
+
+        test_assert(buffer.pop(out, sizeof(out)) == 5);
+        for (uint8_t i = 0; i < 5; ++i)
+        {
+            test_assert(out[i] == 3 + i);
+        }
+        test_assert(buffer.count() == 0);
+        test_assert(buffer.push(9));
+        test_assert(buffer.pop(out, sizeof(out)) == 1);
+        test_assert(out[0] == 9);
+    }
+
+#ifdef HOST_BUILD
+    // A producer and a consumer on their own threads. Every byte that isn't counted as dropped
+    // comes out, in order.
+    {
+        static SpscRingBuffer<61> buffer;
+        uint32_t constexpr n_bytes = 200000;
+
+        std::thread producer([] {
+            uint8_t chunk[7];
+            for (uint32_t i = 0; i < n_bytes; i += sizeof(chunk))
+            {
+                for (size_t j = 0; j < sizeof(chunk); ++j)
+                {
+                    chunk[j] = (i + j) % 251;
+                }
+                // Resend what didn't fit, so nothing's lost while this runs.
+                size_t sent = 0;
+                while (sent < sizeof(chunk))
+                {
+                    size_t const room = 61 - buffer.count();
+                    size_t const n = std::min(room, sizeof(chunk) - sent);
+                    size_t const n_pushed = buffer.push(chunk + sent, n);
+                    if (n_pushed == 0)
+                    {
+                        std::this_thread::yield();
+                    }
+                    sent += n_pushed;
+                }
+            }
+        });
+
+        uint32_t received = 0;
+        bool in_order = true;
+        uint32_t const n_expected = (n_bytes + 6) / 7 * 7;
+        while (received < n_expected)
+        {
+            uint8_t out[13];
+            size_t const n = buffer.pop(out, sizeof(out));
+            for (size_t i = 0; i < n; ++i)
+            {
+                in_order = in_order && out[i] == (received + i) % 251;
+            }
+            received += n;
+            if (n == 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+        test_assert(in_order);
+        test_assert(buffer.dropped() == 0);
+        test_assert(buffer.count() == 0);
+    }
+#endif
+
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+bool spsc_ring_buffer_test();
+
+/*
+ * A byte ring with one producer and one consumer that may interrupt each other, such as a UART
+ * IRQ handler and the main loop. Each index is written only by its own side, and published with
+ * release ordering once the bytes it covers are in place.
+ *
+ * Bytes that don't fit are counted and dropped, so the producer never waits.
+ */
+template <size_t capacity>
+class SpscRingBuffer
+{
+public:
+    // Producer side.
+    size_t push(uint8_t const * const data, size_t const n)
+    {
+        size_t const w_idx = _w_idx.load(std::memory_order_relaxed);
+        size_t const r_idx = _r_idx.load(std::memory_order_acquire);
+        size_t const n_pushed = std::min(n, capacity - _count(w_idx, r_idx));
+        for (size_t i = 0; i < n_pushed; ++i)
+        {
+            _data[(w_idx + i) % _data_len] = data[i];
+        }
+        _w_idx.store((w_idx + n_pushed) % _data_len, std::memory_order_release);
+        _dropped.store(_dropped.load(std::memory_order_relaxed) + (n - n_pushed), std::memory_order_relaxed);
+        return n_pushed;
+    }
+
+    inline bool push(uint8_t const byte)
+    {
+        return push(&byte, 1) == 1;
+    }
+
+    // Consumer side.
+    size_t pop(uint8_t * const data, size_t const max_n)
+    {
+        size_t const r_idx = _r_idx.load(std::memory_order_relaxed);
+        size_t const w_idx = _w_idx.load(std::memory_order_acquire);
+        size_t const n = std::min(max_n, _count(w_idx, r_idx));
+        for (size_t i = 0; i < n; ++i)
+        {
+            data[i] = _data[(r_idx + i) % _data_len];
+        }
+        _r_idx.store((r_idx + n) % _data_len, std::memory_order_release);
+        return n;
+    }
+
+    // Either side.
+    inline size_t count() const
+    {
+        return _count(_w_idx.load(std::memory_order_acquire), _r_idx.load(std::memory_order_acquire));
+    }
+
+    inline uint32_t dropped() const
+    {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr size_t _data_len = capacity + 1;
+    uint8_t _data[_data_len];
+    std::atomic<size_t> _r_idx = 0;
+    std::atomic<size_t> _w_idx = 0;
+    std::atomic<uint32_t> _dropped = 0;
+
+    static inline size_t _count(size_t const w_idx, size_t const r_idx)
+    {
+        return (w_idx + _data_len - r_idx) % _data_len;
+    }
+};
@@ -0,0 +1,270 @@
+#include "SurveyIn.h"
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "packing.h"
+#include "util.h"
+
+namespace
+{
+    uint32_t constexpr record_magic = 0x50594b53; // "SKYP"
+
+    // Along a meridian, near enough anywhere.
+    double constexpr mm_per_lat = 11.1319;
+}
+
+void SurveyedPosition::to_record(uint8_t (&record)[record_len]) const
+{
+    (Pack<record_len - 4>(record, LittleEndian())
+        << record_magic
+        << lat
+        << lon
+        << height
+        << acc).finalize();
+    (Pack<4>(record + record_len - 4, LittleEndian())
+        << fnv1a(record, record_len - 4)).finalize();
+}
+
+bool SurveyedPosition::from_record(uint8_t const * const record)
+{
+    uint32_t magic;
+    uint32_t checksum;
+    SurveyedPosition position;
+    (Unpack<record_len>(record, LittleEndian())
+        >> magic
+        >> position.lat
+        >> position.lon
+        >> position.height
+        >> position.acc
+        >> checksum).finalize();
+    if (magic != record_magic || checksum != fnv1a(record, record_len - 4))
+    {
+        return false;
+    }
+    *this = position;
+    return true;
+}
+
+void TaccStats::add(uint32_t const t_acc_ns)
+{
+    ++count;
+    sum_ns += t_acc_ns;
+    min_ns = std::min(min_ns, t_acc_ns);
+    max_ns = std::max(max_ns, t_acc_ns);
+}
+
+SurveyIn::SurveyIn(uint32_t const min_samples, uint32_t const max_h_acc_mm, uint32_t const accuracy_limit_mm):
+    _min_samples(min_samples),
+    _max_h_acc_mm(max_h_acc_mm),
+    _accuracy_limit_mm(accuracy_limit_mm)
+{
+}
+
+bool SurveyIn::on_nav_pvt(UbxNavPvt const & pvt)
+{
+    if (!pvt.gnssFixOK() || pvt.invalidLlh())
+    {
+        return false;
+    }
+    (_stationary ? _tacc_stationary : _tacc_navigating).add(pvt.tAcc);
+
+    if (_done)
+    {
+        return false;
+    }
+    if (pvt.fixType != 3 || pvt.hAcc > _max_h_acc_mm)
+    {
+        ++_rejected;
+        return false;
+    }
+
+    if (_n == 0)
+    {
+        _lat0 = pvt.lat;
+        _lon0 = pvt.lon;
+        _mm_per_lon = mm_per_lat * std::cos(pvt.lat * 1e-7 * M_PI / 180);
+    }
+    ++_n;
+    double const lat = pvt.lat - _lat0;
+    double const lon = pvt.lon - _lon0;
+    double const delta_lat = lat - _mean_lat;
+    double const delta_lon = lon - _mean_lon;
+    _mean_lat += delta_lat / _n;
+    _mean_lon += delta_lon / _n;
+    _mean_height += (pvt.height - _mean_height) / _n;
+    _m2_lat += delta_lat * (lat - _mean_lat);
+    _m2_lon += delta_lon * (lon - _mean_lon);
+
+    if (_n < _min_samples || accuracy_mm() > _accuracy_limit_mm)
+    {
+        return false;
+    }
+    _position.lat = _lat0 + std::lround(_mean_lat);
+    _position.lon = _lon0 + std::lround(_mean_lon);
+    _position.height = std::lround(_mean_height);
+    _position.acc = accuracy_mm();
+    _done = true;
+    return true;
+}
+
+void SurveyIn::restore(SurveyedPosition const & position)
+{
+    _position = position;
+    _done = true;
+}
+
+// Horizontally, the standard deviation of the fixes. Fixes a second apart are nothing like
+// independent, since their errors from multipath and the ionosphere wander over many minutes, so
+// dividing by the square root of their number would claim centimeters for a mean that is still
+// off by a meter or so. Their spread is what the mean can honestly be said to be good to.
+uint32_t SurveyIn::accuracy_mm() const
+{
+    if (_n < 2)
+    {
+        return UINT32_MAX;
+    }
+    double const variance_mm2 = (_m2_lat * mm_per_lat * mm_per_lat + _m2_lon * _mm_per_lon * _mm_per_lon) / (_n - 1);
+    return std::lround(std::sqrt(variance_mm2));
+}
+
+void SurveyIn::show_status() const
+{
+    if (_done)
+    {
+        printf("Survey: %" PRId32 " %" PRId32 " %" PRId32 " mm +/- %" PRIu32 " mm%s\n",
+               _position.lat, _position.lon, _position.height, _position.acc,
+               _stationary ? ", stationary" : "");
+    }
+    else
+    {
+        printf("Survey: %" PRIu32 " of %" PRIu32 " fixes, %" PRIu32 " rejected, +/- %" PRIu32 " mm\n",
+               _n, _min_samples, _rejected, accuracy_mm());
+    }
+    printf("tAcc ns navigating: %" PRIu32 " mean %" PRIu32 " min %" PRIu32 " max, stationary: %" PRIu32 " mean %" PRIu32 " min %" PRIu32 " max\n",
+           _tacc_navigating.mean_ns(), _tacc_navigating.count ? _tacc_navigating.min_ns : 0, _tacc_navigating.max_ns,
+           _tacc_stationary.mean_ns(), _tacc_stationary.count ? _tacc_stationary.min_ns : 0, _tacc_stationary.max_ns);
+}
+
+namespace
+{
+    // Fixes scattered around a point, from a receiver in the navigation model. Every tenth one
+    // has a poor hAcc and is off by a long way, as when satellites drop out.
+    class ScriptedFixes
+    {
+    public:
+        UbxNavPvt next()
+        {
+            UbxNavPvt pvt{};
+            pvt.fixType = 3;
+            pvt.flags = 0x01;
+            bool const poor = ++_count % 10 == 0;
+            // About 2 m either way, or 40 m for poor ones.
+            int32_t const spread = poor ? 3600 : 180;
+            pvt.lat = lat + _random(2 * spread + 1) - spread;
+            pvt.lon = lon + _random(2 * spread + 1) - spread;
+            pvt.height = height + _random(6001) - 3000;
+            pvt.hAcc = poor ? 50000 : 2500;
+            pvt.tAcc = 25 + _random(10);
+            return pvt;
+        }
+
+        static int32_t constexpr lat = 476062000;
+        static int32_t constexpr lon = -1223321000;
+        static int32_t constexpr height = 60000;
+
+    private:
+        uint32_t _count = 0;
+        uint32_t _lcg = 7;
+        int32_t _random(uint32_t const n)
+        {
+            _lcg = _lcg * 1664525 + 1013904223;
+            return (_lcg >> 8) % n;
+        }
+    };
+}
+
+bool survey_in_test()
+{
+    {
+        SurveyIn survey(600, 10000, 2000);
+        ScriptedFixes fixes;
+
+        // Not before it has enough fixes, and only counting the good ones.
+        UbxNavPvt no_fix{};
+        test_assert(!survey.on_nav_pvt(no_fix));
+        uint32_t n = 0;
+        while (!survey.on_nav_pvt(fixes.next()))
+        {
+            ++n;
+            test_assert(n < 10000);
+        }
+        test_assert(n >= 600 * 10 / 9 - 1);
+        test_assert(survey.done());
+        test_assert_unsigned_eq(survey.samples(), 600u);
+        test_assert(survey.rejected() >= 60);
+
+        // Good to the spread of the good fixes, about 1.4 m, not that over the square root of
+        // their number. The poor ones would have pulled it metres off.
+        SurveyedPosition const & position = survey.position();
+        test_assert(position.acc >= 1200 && position.acc <= 1600);
+        double const north_mm = (position.lat - ScriptedFixes::lat) * 11.1319;
+        double const east_mm = (position.lon - ScriptedFixes::lon) * 11.1319 * std::cos(47.6 * M_PI / 180);
+        test_assert(std::hypot(north_mm, east_mm) < position.acc);
+        test_assert(std::abs(position.height - ScriptedFixes::height) < 300);
+
+        // Done once only. From then on, it only keeps tAcc.
+        test_assert(!survey.on_nav_pvt(fixes.next()));
+        test_assert(survey.tacc_stationary().count == 0);
+        survey.set_stationary();
+        UbxNavPvt steady = fixes.next();
+        steady.tAcc = 12;
+        survey.on_nav_pvt(steady);
+        test_assert_unsigned_eq(survey.tacc_stationary().count, 1u);
+        test_assert_unsigned_eq(survey.tacc_stationary().mean_ns(), 12u);
+        test_assert(survey.tacc_navigating().min_ns >= 25 && survey.tacc_navigating().max_ns <= 34);
+    }
+
+    // However many fixes it takes, it isn't done while they are spread wider than the limit.
+    {
+        SurveyIn survey(600, 10000, 1000);
+        ScriptedFixes fixes;
+        for (int i = 0; i < 5000; ++i)
+        {
+            test_assert(!survey.on_nav_pvt(fixes.next()));
+        }
+        test_assert(!survey.done());
+        test_assert(survey.accuracy_mm() > 1000);
+    }
+
+    // Positions go to flash and come back, and anything else found there is refused.
+    {
+        SurveyedPosition const position = {476062123, -1223321456, -12345, 987};
+        uint8_t record[SurveyedPosition::record_len];
+        position.to_record(record);
+        SurveyedPosition loaded = {};
+        test_assert(loaded.from_record(record));
+        test_assert(loaded.lat == position.lat && loaded.lon == position.lon);
+        test_assert(loaded.height == position.height && loaded.acc == position.acc);
+
+        SurveyIn survey;
+        survey.restore(loaded);
+        test_assert(survey.done());
+        test_assert(survey.position().lat == position.lat);
+
+        for (size_t i = 0; i < sizeof(record); ++i)
+        {
+            uint8_t damaged[SurveyedPosition::record_len];
+            std::copy(record, record + sizeof(record), damaged);
+            damaged[i] ^= 0x10;
+            test_assert(!loaded.from_record(damaged));
+        }
+        uint8_t erased[SurveyedPosition::record_len];
+        std::fill(erased, erased + sizeof(erased), 0xff);
+        test_assert(!loaded.from_record(erased));
+    }
+
+    return true;
+}
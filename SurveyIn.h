@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "UbxMessages.h"
+
+bool survey_in_test();
+
+// Where the antenna is.
+struct SurveyedPosition
+{
+    int32_t lat;            // 1e-7 degrees
+    int32_t lon;            // 1e-7 degrees
+    int32_t height;         // Millimeters above the ellipsoid
+    uint32_t acc;           // Millimeters
+
+    // As kept in flash, with a magic number and a checksum, so that an erased or half written
+    // record isn't taken for a position.
+    static size_t constexpr record_len = 24;
+    void to_record(uint8_t (&record)[record_len]) const;
+    bool from_record(uint8_t const * record);
+};
+
+// Somewhere a surveyed position outlives a power cycle.
+class PositionStore
+{
+public:
+    virtual bool load(SurveyedPosition & position) = 0;
+    virtual bool save(SurveyedPosition const & position) = 0;
+};
+
+// The receiver's estimate of its time accuracy from NAV-PVT, over fixes.
+struct TaccStats
+{
+    uint32_t count = 0;
+    uint64_t sum_ns = 0;
+    uint32_t min_ns = UINT32_MAX;
+    uint32_t max_ns = 0;
+
+    void add(uint32_t t_acc_ns);
+    uint32_t mean_ns() const { return count == 0 ? 0 : sum_ns / count; }
+};
+
+/*
+ * Finds where the antenna is by averaging fixes, so the receiver can be told it isn't moving.
+ *
+ * The ZOE-M8Q has no timing mode to survey itself in and then hold its position fixed, as the
+ * M8T does. The nearest it has is the stationary dynamic model, which keeps it from chasing
+ * noise in its position and so steadies its time, and MGA-INI-POS_LLH to give it the surveyed
+ * position straight away after a restart. Fixes whose hAcc is too poor are left out, and the
+ * survey is done once it has enough of them and they are spread narrowly enough.
+ */
+class SurveyIn
+{
+public:
+    static uint32_t constexpr default_min_samples = 3600;
+    static uint32_t constexpr default_max_h_acc_mm = 10000;
+    static uint32_t constexpr default_accuracy_limit_mm = 2000;
+
+    SurveyIn(uint32_t min_samples = default_min_samples,
+             uint32_t max_h_acc_mm = default_max_h_acc_mm,
+             uint32_t accuracy_limit_mm = default_accuracy_limit_mm);
+
+    // Takes each NAV-PVT. True when that one finished the survey.
+    bool on_nav_pvt(UbxNavPvt const & pvt);
+
+    // Done already, with a position from before.
+    void restore(SurveyedPosition const & position);
+
+    // The receiver is now in the stationary model. Later tAcc counts as after the survey.
+    void set_stationary() { _stationary = true; }
+
+    bool done() const { return _done; }
+    bool stationary() const { return _stationary; }
+    SurveyedPosition const & position() const { return _position; }
+
+    uint32_t samples() const { return _n; }
+    uint32_t rejected() const { return _rejected; }
+    uint32_t accuracy_mm() const;
+
+    TaccStats const & tacc_navigating() const { return _tacc_navigating; }
+    TaccStats const & tacc_stationary() const { return _tacc_stationary; }
+
+    void show_status() const;
+
+private:
+    uint32_t const _min_samples;
+    uint32_t const _max_h_acc_mm;
+    uint32_t const _accuracy_limit_mm;
+
+    bool _done = false;
+    bool _stationary = false;
+    SurveyedPosition _position = {};
+
+    // Running means and sums of squared differences from them (Welford), relative to the
+    // first fix, in 1e-7 degrees and millimeters.
+    uint32_t _n = 0;
+    uint32_t _rejected = 0;
+    int32_t _lat0 = 0;
+    int32_t _lon0 = 0;
+    double _mean_lat = 0;
+    double _mean_lon = 0;
+    double _mean_height = 0;
+    double _m2_lat = 0;
+    double _m2_lon = 0;
+    double _mm_per_lon = 0;
+
+    TaccStats _tacc_navigating;
+    TaccStats _tacc_stationary;
+};
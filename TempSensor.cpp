@@ -0,0 +1,30 @@
+#include "TempSensor.h"
+
+#include <cstdint>
+
+#include "hardware/adc.h"
+
+namespace
+{
+    uint constexpr temp_sensor_input = 4;
+    int constexpr conversions = 64;
+}
+
+TempSensor::TempSensor()
+{
+    adc_init();
+    adc_set_temp_sensor_enabled(true);
+    adc_select_input(temp_sensor_input);
+}
+
+double TempSensor::read_celsius()
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < conversions; ++i)
+    {
+        sum += adc_read();
+    }
+    // From the RP2040 datasheet: 0.706 V at 27 C, falling 1.721 mV per degree.
+    double const volts = sum * 3.3 / (4096.0 * conversions);
+    return 27 - (volts - 0.706) / 0.001721;
+}
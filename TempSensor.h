@@ -0,0 +1,14 @@
+#pragma once
+
+/*
+ * The RP2040's on-die temperature sensor, on ADC input 4. It reads the die rather than the
+ * crystal, but they sit close together on the board and follow the room alike.
+ */
+class TempSensor
+{
+public:
+    TempSensor();
+
+    // Averaged over a few dozen conversions, a few hundred microseconds in all.
+    double read_celsius();
+};
@@ -0,0 +1,319 @@
+#include "ThermalModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "packing.h"
+#include "util.h"
+
+namespace
+{
+    uint32_t constexpr record_magic = 0x54594b53; // "SKYT"
+
+    // In the record, coefficients are in millionths of a ppm and temperatures in hundredths of a degree.
+    double constexpr record_ppm_scale = 1e6;
+    double constexpr record_c_scale = 100;
+
+    // Solves a x = b, or returns false if a is too near singular.
+    bool solve3(double (&a)[3][3], double (&b)[3], double (&x)[3])
+    {
+        for (int col = 0; col < 3; ++col)
+        {
+            int pivot = col;
+            for (int row = col + 1; row < 3; ++row)
+            {
+                if (std::abs(a[row][col]) > std::abs(a[pivot][col]))
+                {
+                    pivot = row;
+                }
+            }
+            if (std::abs(a[pivot][col]) < 1e-12)
+            {
+                return false;
+            }
+            std::swap(a[col], a[pivot]);
+            std::swap(b[col], b[pivot]);
+            for (int row = col + 1; row < 3; ++row)
+            {
+                double const f = a[row][col] / a[col][col];
+                for (int k = col; k < 3; ++k)
+                {
+                    a[row][k] -= f * a[col][k];
+                }
+                b[row] -= f * b[col];
+            }
+        }
+        for (int row = 2; row >= 0; --row)
+        {
+            double sum = b[row];
+            for (int k = row + 1; k < 3; ++k)
+            {
+                sum -= a[row][k] * x[k];
+            }
+            x[row] = sum / a[row][row];
+        }
+        return true;
+    }
+}
+
+void ThermalModel::Coefficients::to_record(uint8_t (&record)[record_len]) const
+{
+    (Pack<record_len - 4>(record, LittleEndian())
+        << record_magic
+        << static_cast<int32_t>(std::lround(c0 * record_ppm_scale))
+        << static_cast<int32_t>(std::lround(c1 * record_ppm_scale))
+        << static_cast<int32_t>(std::lround(c2 * record_ppm_scale))
+        << static_cast<int16_t>(std::lround(min_c * record_c_scale))
+        << static_cast<int16_t>(std::lround(max_c * record_c_scale))).finalize();
+    (Pack<4>(record + record_len - 4, LittleEndian())
+        << fnv1a(record, record_len - 4)).finalize();
+}
+
+bool ThermalModel::Coefficients::from_record(uint8_t const * const record)
+{
+    uint32_t magic;
+    int32_t r0;
+    int32_t r1;
+    int32_t r2;
+    int16_t r_min;
+    int16_t r_max;
+    uint32_t checksum;
+    (Unpack<record_len>(record, LittleEndian())
+        >> magic
+        >> r0
+        >> r1
+        >> r2
+        >> r_min
+        >> r_max
+        >> checksum).finalize();
+    if (magic != record_magic || checksum != fnv1a(record, record_len - 4))
+    {
+        return false;
+    }
+    c0 = r0 / record_ppm_scale;
+    c1 = r1 / record_ppm_scale;
+    c2 = r2 / record_ppm_scale;
+    min_c = r_min / record_c_scale;
+    max_c = r_max / record_c_scale;
+    return true;
+}
+
+void ThermalModel::add_second(double const celsius, double const ppm)
+{
+    _sum_c += celsius;
+    _sum_ppm += ppm;
+    if (++_n_seconds == seconds_per_point)
+    {
+        _add_point(_sum_c / seconds_per_point, _sum_ppm / seconds_per_point);
+        restart();
+    }
+}
+
+void ThermalModel::restart()
+{
+    _sum_c = 0;
+    _sum_ppm = 0;
+    _n_seconds = 0;
+}
+
+void ThermalModel::_add_point(double const celsius, double const ppm)
+{
+    double const x = (celsius - reference_c) / 10;
+    double const phi[3] = {1, x, x * x};
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            _xx[i][j] = forgetting * _xx[i][j] + phi[i] * phi[j];
+        }
+        _xy[i] = forgetting * _xy[i] + phi[i] * ppm;
+    }
+    _weight = forgetting * _weight + 1;
+
+    if (_points == 0)
+    {
+        _own_min_c = celsius;
+        _own_max_c = celsius;
+    }
+    _own_min_c = std::min(_own_min_c, celsius);
+    _own_max_c = std::max(_own_max_c, celsius);
+    ++_points;
+    ++_points_since_save;
+
+    _fit();
+}
+
+void ThermalModel::_fit()
+{
+    if (!fitted())
+    {
+        return;
+    }
+
+    double a[3][3];
+    double b[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            a[i][j] = _xx[i][j];
+        }
+        b[i] = _xy[i];
+    }
+    a[1][1] += ridge;
+    a[2][2] += ridge;
+
+    double k[3];
+    if (!solve3(a, b, k))
+    {
+        return;
+    }
+    _coefficients.c0 = k[0];
+    _coefficients.c1 = k[1] / 10;
+    _coefficients.c2 = k[2] / 100;
+    _coefficients.min_c = _own_min_c;
+    _coefficients.max_c = _own_max_c;
+}
+
+double ThermalModel::ppm_at(double const celsius) const
+{
+    Coefficients const & c = _coefficients;
+    double const d = std::clamp(celsius, c.min_c - extrapolation_c, c.max_c + extrapolation_c) - reference_c;
+    return c.c0 + d * (c.c1 + d * c.c2);
+}
+
+void ThermalModel::restore(Coefficients const & coefficients)
+{
+    if (fitted())
+    {
+        return;
+    }
+    _coefficients = coefficients;
+    _restored = true;
+}
+
+bool ThermalModel::take_save_due()
+{
+    if (!fitted() || _points_since_save < points_per_save)
+    {
+        return false;
+    }
+    _points_since_save = 0;
+    return true;
+}
+
+void ThermalModel::show_status() const
+{
+    Coefficients const & c = _coefficients;
+    printf("Thermal model: %" PRIu32 " points%s, %.4f ppm %+.5f/C %+.6f/C^2 at 25 C, over %.1f to %.1f C\n",
+           _points, fitted() ? "" : (_restored ? " (restored)" : " (unfitted)"),
+           c.c0, c.c1, c.c2, c.min_c, c.max_c);
+}
+
+namespace
+{
+    // A crystal near room temperature, a few degrees either side of it as the HVAC cycles.
+    double crystal_ppm(double const celsius)
+    {
+        double const d = celsius - 25;
+        return -8 + 0.25 * d - 0.015 * d * d;
+    }
+
+    class Noise
+    {
+    public:
+        // Uniform in [-1, 1).
+        double next()
+        {
+            _lcg = _lcg * 1664525 + 1013904223;
+            return (_lcg >> 8) / double(1 << 23) - 1;
+        }
+
+    private:
+        uint32_t _lcg = 99;
+    };
+}
+
+bool thermal_model_test()
+{
+    // Swinging from 19 to 27 C, it finds the curve through the noise.
+    {
+        ThermalModel model;
+        Noise noise;
+        test_assert(!model.usable());
+        for (uint32_t second = 0; second < 64 * 300; ++second)
+        {
+            double const celsius = 23 + 4 * std::sin(second * 2 * M_PI / 1800);
+            model.add_second(celsius, crystal_ppm(celsius) + 0.05 * noise.next());
+        }
+        test_assert(model.fitted() && model.usable());
+        test_assert(model.points() == 300);
+        for (double celsius = 19; celsius <= 27; celsius += 0.5)
+        {
+            test_assert(std::abs(model.ppm_at(celsius) - crystal_ppm(celsius)) < 0.02);
+        }
+        ThermalModel::Coefficients const & c = model.coefficients();
+        test_assert(c.min_c > 19 && c.min_c < 19.5 && c.max_c < 27 && c.max_c > 26.5);
+
+        // Well outside where it was fitted, it holds the curve's value at a little beyond the edge.
+        test_assert(model.ppm_at(60) == model.ppm_at(c.max_c + 2));
+        test_assert(model.ppm_at(-40) == model.ppm_at(c.min_c - 2));
+    }
+
+    // At one temperature, there's nothing to say how the offset changes with it.
+    {
+        ThermalModel model;
+        Noise noise;
+        for (uint32_t second = 0; second < 64 * 100; ++second)
+        {
+            model.add_second(22 + 0.05 * noise.next(), -3 + 0.05 * noise.next());
+        }
+        test_assert(std::abs(model.ppm_at(22) + 3) < 0.01);
+        test_assert(std::abs(model.ppm_at(30) - model.ppm_at(22)) < 0.01);
+    }
+
+    // Only whole points count, and a restart throws away a partial one.
+    {
+        ThermalModel model;
+        for (uint32_t second = 0; second < 63; ++second)
+        {
+            model.add_second(25, 1);
+        }
+        model.restart();
+        model.add_second(25, 1);
+        test_assert(model.points() == 0);
+    }
+
+    // Saved about once a day of locked time, and restored only until it has fitted its own.
+    {
+        ThermalModel model;
+        uint32_t saves = 0;
+        for (uint32_t second = 0; second < 86400 * 2; ++second)
+        {
+            model.add_second(25, 2);
+            saves += model.take_save_due();
+        }
+        test_assert_unsigned_eq(saves, 2u);
+
+        uint8_t record[ThermalModel::Coefficients::record_len];
+        ThermalModel::Coefficients const saved = {-7.654321, 0.248765, -0.014321, 18.76, 31.25};
+        saved.to_record(record);
+        ThermalModel::Coefficients loaded = {};
+        test_assert(loaded.from_record(record));
+        test_assert(std::abs(loaded.c0 - saved.c0) < 1e-6 && std::abs(loaded.c2 - saved.c2) < 1e-6);
+        test_assert(std::abs(loaded.min_c - saved.min_c) < 0.01 && std::abs(loaded.max_c - saved.max_c) < 0.01);
+        record[5] ^= 0x01;
+        test_assert(!loaded.from_record(record));
+
+        ThermalModel fresh;
+        fresh.restore(saved);
+        test_assert(fresh.usable() && !fresh.fitted());
+        test_assert(std::abs(fresh.ppm_at(25) - saved.c0) < 1e-9);
+
+        model.restore(saved);
+        test_assert(std::abs(model.ppm_at(25) - 2) < 1e-6);
+    }
+
+    return true;
+}
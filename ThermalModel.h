@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+bool thermal_model_test();
+
+/*
+ * How far the chip's crystal is off frequency at each temperature, learned while the PPS is
+ * locked, so that holdover can follow the temperature instead of assuming the last frequency
+ * holds.
+ *
+ * The offset is fitted as a quadratic in temperature around 25 C, by least squares over points
+ * that each average 64 locked seconds. Older points count for less and less, so that it follows
+ * the crystal as it ages. Curvature and slope are held towards zero until the temperature has
+ * moved enough to show them, and it doesn't extrapolate much beyond the temperatures it has seen.
+ */
+class ThermalModel
+{
+public:
+    static uint32_t constexpr seconds_per_point = 64;
+    static double constexpr reference_c = 25;
+
+    // Offset in ppm at reference_c, and its first and second derivatives per degree.
+    struct Coefficients
+    {
+        double c0;
+        double c1;
+        double c2;
+        // What it was fitted over.
+        double min_c;
+        double max_c;
+
+        // As kept in flash, with a magic number and a checksum.
+        static size_t constexpr record_len = 24;
+        void to_record(uint8_t (&record)[record_len]) const;
+        bool from_record(uint8_t const * record);
+    };
+
+    // A locked second, at the given temperature, during which the crystal was ppm fast.
+    void add_second(double celsius, double ppm);
+
+    // The seconds before and after this one weren't consecutive, or weren't locked.
+    void restart();
+
+    // Fitted to enough points of its own.
+    bool fitted() const { return _weight >= min_weight; }
+
+    // Fitted, or given coefficients from before.
+    bool usable() const { return fitted() || _restored; }
+
+    double ppm_at(double celsius) const;
+
+    Coefficients const & coefficients() const { return _coefficients; }
+
+    // Coefficients from a previous run, to use until it has fitted its own.
+    void restore(Coefficients const & coefficients);
+
+    // True once a day or so while it's fitted, for the coefficients to be saved.
+    bool take_save_due();
+
+    uint32_t points() const { return _points; }
+
+    void show_status() const;
+
+private:
+    // A point's weight falls by 1/e in about a week of locked time.
+    static double constexpr forgetting = 1 - 1.0 / 10000;
+    static double constexpr min_weight = 16;
+    static double constexpr ridge = 0.01;
+    static double constexpr extrapolation_c = 2;
+    static uint32_t constexpr points_per_save = 1350;
+
+    // The point being averaged.
+    double _sum_c = 0;
+    double _sum_ppm = 0;
+    uint32_t _n_seconds = 0;
+
+    // Normal equations in x = (celsius - reference_c) / 10, over 1, x, and x^2.
+    double _xx[3][3] = {};
+    double _xy[3] = {};
+    double _weight = 0;
+    uint32_t _points = 0;
+    double _own_min_c = reference_c;
+    double _own_max_c = reference_c;
+    uint32_t _points_since_save = 0;
+
+    Coefficients _coefficients = {0, 0, 0, reference_c, reference_c};
+    bool _restored = false;
+
+    void _add_point(double celsius, double ppm);
+    void _fit();
+};
+
+// Somewhere the coefficients outlive a power cycle.
+class ThermalModelStore
+{
+public:
+    virtual bool load(ThermalModel::Coefficients & coefficients) = 0;
+    virtual bool save(ThermalModel::Coefficients const & coefficients) = 0;
+};
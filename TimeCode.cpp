@@ -0,0 +1,688 @@
+#include "TimeCode.h"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#include "util.h"
+#include "iana_time_zones.h"
+
+namespace
+{
+    auto constexpr Minute                   = TimeCodeValue::Minute;
+    auto constexpr Hour                     = TimeCodeValue::Hour;
+    auto constexpr DayOfYear                = TimeCodeValue::DayOfYear;
+    auto constexpr DayOfMonth               = TimeCodeValue::DayOfMonth;
+    auto constexpr DayOfWeekSunday0         = TimeCodeValue::DayOfWeekSunday0;
+    auto constexpr DayOfWeekMonday1         = TimeCodeValue::DayOfWeekMonday1;
+    auto constexpr Month                    = TimeCodeValue::Month;
+    auto constexpr Year                     = TimeCodeValue::Year;
+    auto constexpr LeapYear                 = TimeCodeValue::LeapYear;
+    auto constexpr LeapSecondWarning        = TimeCodeValue::LeapSecondWarning;
+    auto constexpr LeapSecondInserted       = TimeCodeValue::LeapSecondInserted;
+    auto constexpr Dst                      = TimeCodeValue::Dst;
+    auto constexpr NotDst                   = TimeCodeValue::NotDst;
+    auto constexpr DstChangeWarning         = TimeCodeValue::DstChangeWarning;
+    auto constexpr DstAtUtcMidnightToday    = TimeCodeValue::DstAtUtcMidnightToday;
+    auto constexpr DstAtUtcMidnightTomorrow = TimeCodeValue::DstAtUtcMidnightTomorrow;
+    auto constexpr One                      = TimeCodeValue::One;
+
+    auto constexpr A = TimeCodeChannel::A;
+    auto constexpr B = TimeCodeChannel::B;
+
+    uint64_t constexpr second_bit(uint8_t second)
+    {
+        return static_cast<uint64_t>(1) << second;
+    }
+
+    // Carrier reduced at the start of the second, and restored after ms.
+    constexpr TimeCodeSchedule reduced_for(uint16_t ms)
+    {
+        return {2, {{{0, true}, {ms, false}}}};
+    }
+
+    // Carrier full at the start of the second, and reduced after ms.
+    constexpr TimeCodeSchedule full_for(uint16_t ms)
+    {
+        return {2, {{{0, false}, {ms, true}}}};
+    }
+
+    constexpr TimeCodeSchedule unmodulated()
+    {
+        return {1, {{{0, false}}}};
+    }
+
+    // NIST's WWVB amplitude code, MSB first, UTC, with US DST.
+    constexpr TimeCodeBit wwvb_bits[] = {
+        { 1, A, Minute, 40}, { 2, A, Minute, 20}, { 3, A, Minute, 10},
+        { 5, A, Minute,  8}, { 6, A, Minute,  4}, { 7, A, Minute,  2}, { 8, A, Minute,  1},
+        {12, A, Hour, 20}, {13, A, Hour, 10},
+        {15, A, Hour,  8}, {16, A, Hour,  4}, {17, A, Hour,  2}, {18, A, Hour,  1},
+        {22, A, DayOfYear, 200}, {23, A, DayOfYear, 100},
+        {25, A, DayOfYear,  80}, {26, A, DayOfYear,  40}, {27, A, DayOfYear,  20}, {28, A, DayOfYear,  10},
+        {30, A, DayOfYear,   8}, {31, A, DayOfYear,   4}, {32, A, DayOfYear,   2}, {33, A, DayOfYear,   1},
+        // We have no way to get DUT1
+        {45, A, Year, 80}, {46, A, Year, 40}, {47, A, Year, 20}, {48, A, Year, 10},
+        {50, A, Year,  8}, {51, A, Year,  4}, {52, A, Year,  2}, {53, A, Year,  1},
+        {55, A, LeapYear, 1},
+        {56, A, LeapSecondWarning, 1},
+        {57, A, DstAtUtcMidnightTomorrow, 1},
+        {58, A, DstAtUtcMidnightToday, 1},
+    };
+
+    // PTB's DCF77, LSB first, with even parity, carrying CET/CEST for the next minute.
+    constexpr TimeCodeBit dcf77_bits[] = {
+        {16, A, DstChangeWarning, 1},
+        {17, A, Dst, 1},
+        {18, A, NotDst, 1},
+        {19, A, LeapSecondWarning, 1},
+        {20, A, One, 1},
+        {21, A, Minute,  1}, {22, A, Minute,  2}, {23, A, Minute,  4}, {24, A, Minute,  8},
+        {25, A, Minute, 10}, {26, A, Minute, 20}, {27, A, Minute, 40},
+        {29, A, Hour,  1}, {30, A, Hour,  2}, {31, A, Hour,  4}, {32, A, Hour,  8},
+        {33, A, Hour, 10}, {34, A, Hour, 20},
+        {36, A, DayOfMonth,  1}, {37, A, DayOfMonth,  2}, {38, A, DayOfMonth,  4}, {39, A, DayOfMonth,  8},
+        {40, A, DayOfMonth, 10}, {41, A, DayOfMonth, 20},
+        {42, A, DayOfWeekMonday1, 1}, {43, A, DayOfWeekMonday1, 2}, {44, A, DayOfWeekMonday1, 4},
+        {45, A, Month,  1}, {46, A, Month,  2}, {47, A, Month,  4}, {48, A, Month,  8},
+        {49, A, Month, 10},
+        {50, A, Year,  1}, {51, A, Year,  2}, {52, A, Year,  4}, {53, A, Year,  8},
+        {54, A, Year, 10}, {55, A, Year, 20}, {56, A, Year, 40}, {57, A, Year, 80},
+    };
+    constexpr TimeCodeParity dcf77_parities[] = {
+        {28, A, 21, 27, false},
+        {35, A, 29, 34, false},
+        {58, A, 36, 57, false},
+    };
+
+    // NPL's MSF, MSB first, carrying UK civil time for the next minute. Channel B has
+    // DUT1 (which we leave zero), odd parity over the A channel, and the BST flags.
+    constexpr TimeCodeBit msf_bits[] = {
+        {17, A, Year, 80}, {18, A, Year, 40}, {19, A, Year, 20}, {20, A, Year, 10},
+        {21, A, Year,  8}, {22, A, Year,  4}, {23, A, Year,  2}, {24, A, Year,  1},
+        {25, A, Month, 10},
+        {26, A, Month,  8}, {27, A, Month,  4}, {28, A, Month,  2}, {29, A, Month,  1},
+        {30, A, DayOfMonth, 20}, {31, A, DayOfMonth, 10},
+        {32, A, DayOfMonth,  8}, {33, A, DayOfMonth,  4}, {34, A, DayOfMonth,  2}, {35, A, DayOfMonth,  1},
+        {36, A, DayOfWeekSunday0, 4}, {37, A, DayOfWeekSunday0, 2}, {38, A, DayOfWeekSunday0, 1},
+        {39, A, Hour, 20}, {40, A, Hour, 10},
+        {41, A, Hour,  8}, {42, A, Hour,  4}, {43, A, Hour,  2}, {44, A, Hour,  1},
+        {45, A, Minute, 40}, {46, A, Minute, 20}, {47, A, Minute, 10},
+        {48, A, Minute,  8}, {49, A, Minute,  4}, {50, A, Minute,  2}, {51, A, Minute,  1},
+        // 01111110 in 52A through 59A
+        {53, A, One, 1}, {54, A, One, 1}, {55, A, One, 1},
+        {56, A, One, 1}, {57, A, One, 1}, {58, A, One, 1},
+        {53, B, DstChangeWarning, 1},
+        {58, B, Dst, 1},
+    };
+    constexpr TimeCodeParity msf_parities[] = {
+        {54, B, 17, 24, true},
+        {55, B, 25, 35, true},
+        {56, B, 36, 38, true},
+        {57, B, 39, 51, true},
+    };
+
+    // NICT's JJY, MSB first, carrying JST for the current minute, with even parity on
+    // hours and minutes. The carrier is full at the start of each second, rather than reduced.
+    constexpr TimeCodeBit jjy_bits[] = {
+        { 1, A, Minute, 40}, { 2, A, Minute, 20}, { 3, A, Minute, 10},
+        { 5, A, Minute,  8}, { 6, A, Minute,  4}, { 7, A, Minute,  2}, { 8, A, Minute,  1},
+        {12, A, Hour, 20}, {13, A, Hour, 10},
+        {15, A, Hour,  8}, {16, A, Hour,  4}, {17, A, Hour,  2}, {18, A, Hour,  1},
+        {22, A, DayOfYear, 200}, {23, A, DayOfYear, 100},
+        {25, A, DayOfYear,  80}, {26, A, DayOfYear,  40}, {27, A, DayOfYear,  20}, {28, A, DayOfYear,  10},
+        {30, A, DayOfYear,   8}, {31, A, DayOfYear,   4}, {32, A, DayOfYear,   2}, {33, A, DayOfYear,   1},
+        {41, A, Year, 80}, {42, A, Year, 40}, {43, A, Year, 20}, {44, A, Year, 10},
+        {45, A, Year,  8}, {46, A, Year,  4}, {47, A, Year,  2}, {48, A, Year,  1},
+        {50, A, DayOfWeekSunday0, 4}, {51, A, DayOfWeekSunday0, 2}, {52, A, DayOfWeekSunday0, 1},
+        {53, A, LeapSecondWarning, 1},
+        {54, A, LeapSecondInserted, 1},
+    };
+    constexpr TimeCodeParity jjy_parities[] = {
+        {36, A, 12, 18, false},
+        {37, A,  1,  8, false},
+    };
+
+    uint64_t constexpr every_ten_seconds_markers =
+        second_bit( 0) | second_bit( 9) | second_bit(19) | second_bit(29) |
+        second_bit(39) | second_bit(49) | second_bit(59);
+
+    constexpr TimeCodeStandard jjy(char const * name, float carrier_hz)
+    {
+        return {
+            .name = name,
+            .carrier_hz = carrier_hz,
+            .zone = "Asia/Tokyo",
+            .dst_zone = nullptr,
+            .minute_offset = 0,
+            // Flagged through the month before.
+            .leap_second_warning_s = 31 * secs_per_day,
+            .dst_change_warning_s = 0,
+            .markers = every_ten_seconds_markers,
+            .minute_marker = 0,
+            // Keeps P0 and M together at the end of the minute.
+            .leap_second_after = 58,
+            .leap_second_symbol = TimeCodeSymbol::Zero,
+            .bits = jjy_bits,
+            .parities = jjy_parities,
+            .schedules = {
+                full_for(800),
+                full_for(500),
+                full_for(800),
+                full_for(500),
+                full_for(200),
+                full_for(200),
+            },
+        };
+    }
+}
+
+TimeCodeStandard const time_code_wwvb = {
+    .name = "WWVB",
+    .carrier_hz = 60000,
+    .zone = nullptr,
+    .dst_zone = "America/Los_Angeles",
+    .minute_offset = 0,
+    .leap_second_warning_s = 27 * secs_per_day,
+    .dst_change_warning_s = 0,
+    .markers = every_ten_seconds_markers,
+    .minute_marker = 0,
+    // Second 60 of a leap second minute is a marker too.
+    .leap_second_after = 59,
+    .leap_second_symbol = TimeCodeSymbol::Marker,
+    .bits = wwvb_bits,
+    .parities = {},
+    .schedules = {
+        reduced_for(200),
+        reduced_for(500),
+        reduced_for(200),
+        reduced_for(500),
+        reduced_for(800),
+        reduced_for(800),
+    },
+};
+
+TimeCodeStandard const time_code_wwvb_phase = {
+    .name = "WWVB + phase",
+    .carrier_hz = 60000,
+    .zone = nullptr,
+    .dst_zone = "America/Los_Angeles",
+    .minute_offset = 0,
+    .leap_second_warning_s = 27 * secs_per_day,
+    .dst_change_warning_s = 0,
+    .markers = every_ten_seconds_markers,
+    .minute_marker = 0,
+    .leap_second_after = 59,
+    .leap_second_symbol = TimeCodeSymbol::Marker,
+    .bits = wwvb_bits,
+    .parities = {},
+    .schedules = time_code_wwvb.schedules,
+    .wwvb_phase = true,
+};
+
+TimeCodeStandard const time_code_dcf77 = {
+    .name = "DCF77",
+    .carrier_hz = 77500,
+    // Central European Time, under the same rules as Berlin.
+    .zone = "Europe/Paris",
+    .dst_zone = "Europe/Paris",
+    .minute_offset = 1,
+    .leap_second_warning_s = secs_per_hour,
+    .dst_change_warning_s = secs_per_hour,
+    // No reduction in second 59 marks the coming minute.
+    .markers = second_bit(59),
+    .minute_marker = 59,
+    // The extra second is a zero, and the unmodulated one stays last.
+    .leap_second_after = 58,
+    .leap_second_symbol = TimeCodeSymbol::Zero,
+    .bits = dcf77_bits,
+    .parities = dcf77_parities,
+    .schedules = {
+        reduced_for(100),
+        reduced_for(200),
+        reduced_for(100),
+        reduced_for(200),
+        unmodulated(),
+        unmodulated(),
+    },
+};
+
+TimeCodeStandard const time_code_msf = {
+    .name = "MSF",
+    .carrier_hz = 60000,
+    .zone = "Europe/London",
+    .dst_zone = "Europe/London",
+    .minute_offset = 1,
+    .leap_second_warning_s = 0,
+    .dst_change_warning_s = 61 * secs_per_min,
+    .markers = second_bit(0),
+    .minute_marker = 0,
+    // The extra second follows the DUT1 bits, keeping 52A-59A at the end of the minute.
+    .leap_second_after = 16,
+    .leap_second_symbol = TimeCodeSymbol::Zero,
+    .bits = msf_bits,
+    .parities = msf_parities,
+    .schedules = {
+        reduced_for(100),
+        reduced_for(200),
+        {4, {{{0, true}, {100, false}, {200, true}, {300, false}}}},
+        reduced_for(300),
+        reduced_for(500),
+        reduced_for(500),
+    },
+};
+
+TimeCodeStandard const time_code_jjy40 = jjy("JJY 40kHz", 40000);
+TimeCodeStandard const time_code_jjy60 = jjy("JJY 60kHz", 60000);
+
+std::span<TimeCodeStandard const * const> time_code_standards()
+{
+    static TimeCodeStandard const * const standards[] = {
+        &time_code_wwvb,
+        &time_code_wwvb_phase,
+        &time_code_dcf77,
+        &time_code_msf,
+        &time_code_jjy40,
+        &time_code_jjy60,
+    };
+    return standards;
+}
+
+bool TimeCodeMinute::has_leap_second() const
+{
+    // Within the slop TopOfSecond allows around the end of the minute.
+    return leap_second_valid && leap_second_inserted &&
+        secs_per_min - 20 <= leap_second_time_until && leap_second_time_until <= secs_per_min + 20;
+}
+
+bool time_code_minute(TimeCodeStandard const & standard,
+                      TopOfSecond const & tos,
+                      TimeRepresentation const * zone,
+                      TimeRepresentation const * dst_zone,
+                      TimeCodeMinute & minute)
+{
+    if (!tos.utc_ymdhms_valid)
+    {
+        return false;
+    }
+
+    Ymdhms utc = tos.utc_ymdhms;
+    uint8_t const sec = utc.sec;
+    utc.sec = 0;
+    utc.add_seconds(standard.minute_offset * secs_per_min);
+
+    minute.time = utc;
+    if (standard.zone)
+    {
+        if (!zone)
+        {
+            return false;
+        }
+        TopOfSecond carried;
+        carried.set_utc_ymdhms(utc.year, utc.month, utc.day, utc.hour, utc.min, utc.sec);
+        if (!zone->make_ymdhms(carried, minute.time))
+        {
+            return false;
+        }
+    }
+
+    minute.leap_year = minute.time.is_leap_year();
+
+    minute.dst = false;
+    minute.dst_change_warning = false;
+    minute.dst_at_utc_midnight_today = false;
+    minute.dst_at_utc_midnight_tomorrow = false;
+    if (standard.dst_zone)
+    {
+        if (!dst_zone)
+        {
+            return false;
+        }
+
+        minute.dst = dst_zone->is_dst(utc);
+
+        if (standard.dst_change_warning_s > 0)
+        {
+            Ymdhms later = utc;
+            later.add_seconds(standard.dst_change_warning_s);
+            minute.dst_change_warning = dst_zone->is_dst(later) != minute.dst;
+        }
+
+        Ymdhms midnight = utc;
+        midnight.hour = 0;
+        midnight.min = 0;
+        minute.dst_at_utc_midnight_today = dst_zone->is_dst(midnight);
+        midnight.add_days(1);
+        minute.dst_at_utc_midnight_tomorrow = dst_zone->is_dst(midnight);
+    }
+
+    minute.leap_second_valid = tos.next_leap_second_valid;
+    minute.leap_second_time_until = tos.next_leap_second_time_until + sec;
+    minute.leap_second_inserted = tos.next_leap_second_direction > 0;
+
+    return true;
+}
+
+namespace
+{
+    uint16_t day_of_week_sunday0(Ymdhms const & date)
+    {
+        Ymdhms const sunday(2000, 1, 2, 0, 0, 0);
+        Ymdhms midnight = date;
+        midnight.hour = 0;
+        midnight.min = 0;
+        midnight.sec = 0;
+        int64_t const days = midnight.subtract_and_return_non_leap_seconds(sunday) / secs_per_day;
+        return mod<int64_t>(days, 7);
+    }
+
+    bool value_bit(TimeCodeStandard const & standard,
+                   TimeCodeMinute const & minute,
+                   TimeCodeBit const & bit)
+    {
+        Ymdhms const & t = minute.time;
+        uint16_t value = 0;
+
+        switch (bit.value)
+        {
+        case Minute:           value = t.min; break;
+        case Hour:             value = t.hour; break;
+        case DayOfYear:        value = t.day_of_year(); break;
+        case DayOfMonth:       value = t.day; break;
+        case DayOfWeekSunday0: value = day_of_week_sunday0(t); break;
+        case DayOfWeekMonday1: value = day_of_week_sunday0(t); if (value == 0) { value = 7; } break;
+        case Month:            value = t.month; break;
+        case Year:             value = t.year % 100; break;
+
+        case LeapYear:         return minute.leap_year;
+        case Dst:              return minute.dst;
+        case NotDst:           return !minute.dst;
+        case DstChangeWarning: return minute.dst_change_warning;
+        case DstAtUtcMidnightToday:    return minute.dst_at_utc_midnight_today;
+        case DstAtUtcMidnightTomorrow: return minute.dst_at_utc_midnight_tomorrow;
+        case One:              return true;
+
+        case LeapSecondWarning:
+        case LeapSecondInserted:
+        {
+            // As of the second carrying the bit, whenever in the minute the frame was built.
+            int32_t const time_until = minute.leap_second_time_until - bit.second;
+            bool const warning = minute.leap_second_valid &&
+                0 <= time_until && time_until < standard.leap_second_warning_s;
+            if (bit.value == LeapSecondWarning)
+            {
+                return warning;
+            }
+            return warning && minute.leap_second_inserted;
+        }
+        }
+
+        uint16_t decade = 1;
+        if (bit.weight >= 100)
+        {
+            decade = 100;
+        }
+        else if (bit.weight >= 10)
+        {
+            decade = 10;
+        }
+        return ((value / decade) % 10) & (bit.weight / decade);
+    }
+
+    void set_bit(TimeCodeFrame & frame, TimeCodeChannel channel, uint8_t second, bool value)
+    {
+        uint64_t & plane = channel == A ? frame.a : frame.b;
+        if (value)
+        {
+            plane |= second_bit(second);
+        }
+        else
+        {
+            plane &= ~second_bit(second);
+        }
+    }
+}
+
+void time_code_frame(TimeCodeStandard const & standard, TimeCodeMinute const & minute, TimeCodeFrame & frame)
+{
+    frame.a = 0;
+    frame.b = 0;
+
+    for (auto const & bit : standard.bits)
+    {
+        set_bit(frame, bit.channel, bit.second, value_bit(standard, minute, bit));
+    }
+
+    for (auto const & parity : standard.parities)
+    {
+        uint64_t const span = ((second_bit(parity.last) << 1) - 1) & ~(second_bit(parity.first) - 1);
+        bool const odd_ones = std::popcount(frame.a & span) & 1;
+        set_bit(frame, parity.channel, parity.second, odd_ones != parity.odd);
+    }
+}
+
+TimeCodeSymbol time_code_symbol(TimeCodeStandard const & standard,
+                                TimeCodeMinute const & minute,
+                                TimeCodeFrame const & frame,
+                                uint8_t sec)
+{
+    uint8_t position = sec;
+    if (minute.has_leap_second() || sec == 60)
+    {
+        if (sec == standard.leap_second_after + 1)
+        {
+            return standard.leap_second_symbol;
+        }
+        if (sec > standard.leap_second_after)
+        {
+            position = sec - 1;
+        }
+    }
+
+    if (position == standard.minute_marker)
+    {
+        return TimeCodeSymbol::MinuteMarker;
+    }
+    if ((standard.markers >> position) & 1)
+    {
+        return TimeCodeSymbol::Marker;
+    }
+
+    bool const a = (frame.a >> position) & 1;
+    bool const b = (frame.b >> position) & 1;
+    if (b)
+    {
+        return a ? TimeCodeSymbol::OneOne : TimeCodeSymbol::ZeroOne;
+    }
+    return a ? TimeCodeSymbol::One : TimeCodeSymbol::Zero;
+}
+
+void time_code_frame_string(TimeCodeStandard const & standard,
+                            TimeCodeMinute const & minute,
+                            TimeCodeFrame const & frame,
+                            char (&str)[62])
+{
+    uint8_t const secs_this_minute = minute.has_leap_second() ? 61 : 60;
+    for (uint8_t sec = 0; sec < secs_this_minute; ++sec)
+    {
+        switch (time_code_symbol(standard, minute, frame, sec))
+        {
+        case TimeCodeSymbol::Zero:         str[sec] = '0'; break;
+        case TimeCodeSymbol::One:          str[sec] = '1'; break;
+        case TimeCodeSymbol::ZeroOne:      str[sec] = '2'; break;
+        case TimeCodeSymbol::OneOne:       str[sec] = '3'; break;
+        case TimeCodeSymbol::Marker:       str[sec] = 'P'; break;
+        case TimeCodeSymbol::MinuteMarker: str[sec] = 'M'; break;
+        }
+    }
+    str[secs_this_minute] = '\0';
+}
+
+float time_code_pwm_setup(float carrier_hz, uint32_t sys_hz, uint8_t & div_int, uint8_t & div_frac, uint16_t & wrap)
+{
+    double best_error = INFINITY;
+    float best_hz = 0;
+
+    // Smallest dividers first, so ties go to the finest duty cycle resolution.
+    for (uint32_t div16 = 16; div16 < 256 * 16; ++div16)
+    {
+        double const period = static_cast<double>(sys_hz) * 16 / (div16 * carrier_hz);
+        if (period > 65536)
+        {
+            continue;
+        }
+        uint32_t const period_counts = std::lround(period);
+        if (period_counts < 2)
+        {
+            break;
+        }
+
+        double const hz = static_cast<double>(sys_hz) * 16 / (div16 * period_counts);
+        double const error = std::fabs(hz - carrier_hz);
+        if (error < best_error)
+        {
+            best_error = error;
+            best_hz = hz;
+            div_int = div16 / 16;
+            div_frac = div16 % 16;
+            wrap = period_counts - 1;
+        }
+    }
+
+    return best_hz;
+}
+
+namespace
+{
+    TimeRepresentation const * test_zone(char const * name)
+    {
+        if (!name)
+        {
+            return nullptr;
+        }
+        for (auto const & zone : get_iana_timezones())
+        {
+            if (std::get<std::string>(zone) == name)
+            {
+                return std::get<std::shared_ptr<TimeRepresentation>>(zone).get();
+            }
+        }
+        return nullptr;
+    }
+
+    bool check_frame(TimeCodeStandard const & standard, TopOfSecond const & tos, char const * expected)
+    {
+        TimeCodeMinute minute;
+        test_assert(time_code_minute(standard, tos, test_zone(standard.zone), test_zone(standard.dst_zone), minute));
+
+        TimeCodeFrame frame;
+        time_code_frame(standard, minute, frame);
+
+        char str[62];
+        time_code_frame_string(standard, minute, frame, str);
+        if (strcmp(str, expected) != 0)
+        {
+            printf("%s\n%s\n", str, expected);
+        }
+        test_assert(strcmp(str, expected) == 0);
+        return true;
+    }
+}
+
+bool time_code_test()
+{
+    for (auto const * standard : time_code_standards())
+    {
+        test_assert(!standard->zone || test_zone(standard->zone));
+        test_assert(!standard->dst_zone || test_zone(standard->dst_zone));
+
+        for (auto const & schedule : standard->schedules)
+        {
+            test_assert(schedule.num_changes >= 1);
+            test_assert(schedule.changes[0].at_ms == 0);
+            for (size_t i = 1; i < schedule.num_changes; ++i)
+            {
+                test_assert(schedule.changes[i - 1].at_ms < schedule.changes[i].at_ms);
+                test_assert(schedule.changes[i].at_ms < 1000);
+            }
+        }
+
+        uint8_t div_int;
+        uint8_t div_frac;
+        uint16_t wrap;
+        float const hz = time_code_pwm_setup(standard->carrier_hz, 125000000, div_int, div_frac, wrap);
+        test_assert(div_int >= 1);
+        test_assert(std::fabs(hz - standard->carrier_hz) < standard->carrier_hz * 20e-6f);
+        test_assert(std::fabs(125e6f / ((div_int + div_frac / 16.0f) * (wrap + 1)) - hz) < 0.01f);
+    }
+
+    {
+        uint8_t div_int;
+        uint8_t div_frac;
+        uint16_t wrap;
+        test_assert(time_code_pwm_setup(40000, 125000000, div_int, div_frac, wrap) == 40000);
+        test_assert_unsigned_eq(div_int, (uint8_t)1);
+        test_assert_unsigned_eq(div_frac, (uint8_t)0);
+        test_assert_unsigned_eq(wrap, (uint16_t)3124);
+    }
+
+    TopOfSecond tos;
+
+    // Day 258 of a leap year, in US DST.
+    tos.invalidate();
+    tos.set_utc_ymdhms(2024, 9, 14, 18, 42, 0);
+    test_assert(check_frame(time_code_wwvb, tos,
+        "M10000010P"
+        "000101000P"
+        "001000101P"
+        "100000000P"
+        "000000010P"
+        "010001011P"));
+
+    // 01:31 CET is coming, and CEST an hour after that. Sunday is 7.
+    tos.invalidate();
+    tos.set_utc_ymdhms(2024, 3, 31, 0, 30, 17);
+    test_assert(check_frame(time_code_dcf77, tos,
+        "0000000000"
+        "0000001010"
+        "1100011011"
+        "0000011000"
+        "1111111000"
+        "001001000M"));
+
+    // 01:00 CET on new year's day comes after a leap second, with the zero before the minute mark.
+    tos.invalidate();
+    tos.set_utc_ymdhms(2016, 12, 31, 23, 59, 0);
+    tos.set_next_leap_second(60, 1);
+    test_assert(check_frame(time_code_dcf77, tos,
+        "0000000000"
+        "0000000011"
+        "1000000001"
+        "0000011000"
+        "0011110000"
+        "1110100010M"));
+
+    // 01:16 BST, with the end of BST within the hour. Sunday is 0.
+    tos.invalidate();
+    tos.set_utc_ymdhms(2024, 10, 27, 0, 15, 42);
+    test_assert(check_frame(time_code_msf, tos,
+        "M000000000"
+        "0000000001"
+        "0010010000"
+        "1001110000"
+        "0000100101"
+        "1003313330"));
+
+    // 12:04 JST on a Monday.
+    tos.invalidate();
+    tos.set_utc_ymdhms(2024, 1, 1, 3, 4, 0);
+    test_assert(check_frame(time_code_jjy40, tos,
+        "M00000100P"
+        "000100010P"
+        "000000000P"
+        "000100010P"
+        "000100100P"
+        "001000000P"));
+
+    return true;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "time.h"
+
+bool time_code_test();
+
+/*
+ * Low frequency time code standards (WWVB, DCF77, MSF, JJY), each described by a table.
+ *
+ * A standard's table places BCD bits, flags, and parity bits in the seconds of a minute,
+ * on one or two channels (MSF sends two bits, A and B, per second). One builder turns a
+ * minute's worth of time into a frame from any table, and each second of the frame maps
+ * to a symbol whose schedule says when the carrier is reduced and restored.
+ */
+
+// What a bit of the frame carries.
+enum class TimeCodeValue: uint8_t
+{
+    Minute,
+    Hour,
+    DayOfYear,
+    DayOfMonth,
+    DayOfWeekSunday0,       // Sunday is 0, Saturday 6
+    DayOfWeekMonday1,       // Monday is 1, Sunday 7
+    Month,
+    Year,                   // Two digits
+    LeapYear,
+    LeapSecondWarning,      // A leap second is due within the standard's warning time
+    LeapSecondInserted,     // ...and it adds a second rather than removing one
+    Dst,                    // In the carried minute
+    NotDst,
+    DstChangeWarning,       // DST starts or ends within the standard's warning time
+    DstAtUtcMidnightToday,  // WWVB's pair of DST bits
+    DstAtUtcMidnightTomorrow,
+    One,
+};
+
+enum class TimeCodeChannel: uint8_t
+{
+    A,
+    B,
+};
+
+// BCD weight (1, 2, 4, 8, 10, 20, ... 200) of value, sent in second.
+struct TimeCodeBit
+{
+    uint8_t second;
+    TimeCodeChannel channel;
+    TimeCodeValue value;
+    uint8_t weight;
+};
+
+// Sent in second on channel, covering channel A from first through last.
+struct TimeCodeParity
+{
+    uint8_t second;
+    TimeCodeChannel channel;
+    uint8_t first;
+    uint8_t last;
+    bool odd;
+};
+
+enum class TimeCodeSymbol: uint8_t
+{
+    Zero,      // A 0, B 0
+    One,       // A 1, B 0
+    ZeroOne,   // A 0, B 1
+    OneOne,    // A 1, B 1
+    Marker,
+    MinuteMarker,
+};
+size_t constexpr time_code_num_symbols = 6;
+
+// Carrier changes within a second, in order. A symbol always starts with a change at 0.
+struct TimeCodeChange
+{
+    uint16_t at_ms;
+    bool reduced;
+};
+size_t constexpr time_code_max_changes = 4;
+
+struct TimeCodeSchedule
+{
+    uint8_t num_changes;
+    std::array<TimeCodeChange, time_code_max_changes> changes;
+};
+
+struct TimeCodeStandard
+{
+    char const * name;
+    float carrier_hz;
+
+    // IANA zone whose civil time is carried, or nullptr for UTC.
+    char const * zone;
+    // IANA zone whose daylight saving time the flags describe, or nullptr for none.
+    char const * dst_zone;
+    // 1 if each minute carries the time at the start of the next one.
+    uint8_t minute_offset;
+
+    int32_t leap_second_warning_s;
+    int32_t dst_change_warning_s;
+
+    // Bit n is second n.
+    uint64_t markers;
+    uint8_t minute_marker;
+
+    // In a 61 second minute, the extra second comes right after this one.
+    uint8_t leap_second_after;
+    TimeCodeSymbol leap_second_symbol;
+
+    std::span<TimeCodeBit const> bits;
+    std::span<TimeCodeParity const> parities;
+    std::array<TimeCodeSchedule, time_code_num_symbols> schedules;
+
+    // Also send WWVB's phase modulation code (see WwvbPhase.h) by inverting the carrier.
+    bool wwvb_phase = false;
+};
+
+extern TimeCodeStandard const time_code_wwvb;
+extern TimeCodeStandard const time_code_wwvb_phase;
+extern TimeCodeStandard const time_code_dcf77;
+extern TimeCodeStandard const time_code_msf;
+extern TimeCodeStandard const time_code_jjy40;
+extern TimeCodeStandard const time_code_jjy60;
+
+std::span<TimeCodeStandard const * const> time_code_standards();
+
+// Everything about a minute that a frame is built from.
+struct TimeCodeMinute
+{
+    Ymdhms time;            // Carried, in the standard's zone, seconds zero
+    bool leap_year = false;
+    bool dst = false;
+    bool dst_change_warning = false;
+    bool dst_at_utc_midnight_today = false;
+    bool dst_at_utc_midnight_tomorrow = false;
+
+    // Seconds from the start of the minute in which the frame is sent, to the leap second.
+    int32_t leap_second_time_until = -1;
+    bool leap_second_valid = false;
+    bool leap_second_inserted = false;
+
+    bool has_leap_second() const;
+};
+
+// Zones may be nullptr where the standard doesn't use them.
+bool time_code_minute(TimeCodeStandard const & standard,
+                      TopOfSecond const & tos,
+                      TimeRepresentation const * zone,
+                      TimeRepresentation const * dst_zone,
+                      TimeCodeMinute & minute);
+
+// Bit n of each channel is second n of the minute, before any leap second is inserted.
+struct TimeCodeFrame
+{
+    uint64_t a = 0;
+    uint64_t b = 0;
+};
+
+void time_code_frame(TimeCodeStandard const & standard, TimeCodeMinute const & minute, TimeCodeFrame & frame);
+
+TimeCodeSymbol time_code_symbol(TimeCodeStandard const & standard,
+                                TimeCodeMinute const & minute,
+                                TimeCodeFrame const & frame,
+                                uint8_t sec);
+
+// Frame as one character per second, for tests and debugging: '0' and '1', or for two
+// channels '0', '1', '2' (B only), and '3' (both). 'P' for markers, 'M' for the minute marker.
+void time_code_frame_string(TimeCodeStandard const & standard,
+                            TimeCodeMinute const & minute,
+                            TimeCodeFrame const & frame,
+                            char (&str)[62]);
+
+// The PWM setup closest to carrier_hz: divider int + frac/16, and wrap (the period less one).
+float time_code_pwm_setup(float carrier_hz, uint32_t sys_hz, uint8_t & div_int, uint8_t & div_frac, uint16_t & wrap);
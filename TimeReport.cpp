@@ -0,0 +1,202 @@
+#include "TimeReport.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#include "util.h"
+#include "Nmea.h"
+
+namespace
+{
+    char constexpr prefix[] = "$SKYT,";
+
+    bool parse_ymdhms(char const * digits, Ymdhms & ymdhms)
+    {
+        unsigned year, month, day, hour, min, sec;
+        if (6 != sscanf(digits, "%4u%2u%2u%2u%2u%2u", &year, &month, &day, &hour, &min, &sec))
+        {
+            return false;
+        }
+        ymdhms.set(year, month, day, hour, min, sec);
+        return true;
+    }
+}
+
+bool TimeReport::set(TopOfSecond const & upcoming, bool locked_, double us_until_edge_)
+{
+    if (!(upcoming.utc_ymdhms_valid && upcoming.tai_ymdhms_valid))
+    {
+        return false;
+    }
+
+    utc = upcoming.utc_ymdhms;
+    tai = upcoming.tai_ymdhms;
+    locked = locked_;
+    us_until_edge = us_until_edge_;
+
+    leap = 0;
+    if (upcoming.next_leap_second_valid)
+    {
+        int32_t const secs_left_today = secs_per_day - (utc.hour*secs_per_hour + utc.min*secs_per_min + utc.sec);
+        if (0 <= upcoming.next_leap_second_time_until && upcoming.next_leap_second_time_until <= secs_left_today)
+        {
+            leap = upcoming.next_leap_second_direction > 0 ? 1 : 2;
+        }
+    }
+
+    return true;
+}
+
+bool TimeReport::format(char * buf, size_t buf_len) const
+{
+    int len = snprintf(buf, buf_len, "%s%04d%02d%02d%02d%02d%02d,%04d%02d%02d%02d%02d%02d,%" PRId32 ",%d,%.3f",
+                       prefix,
+                       utc.year, utc.month, utc.day, utc.hour, utc.min, utc.sec,
+                       tai.year, tai.month, tai.day, tai.hour, tai.min, tai.sec,
+                       leap,
+                       locked,
+                       us_until_edge);
+    if (len < 0 || static_cast<size_t>(len) + 4 >= buf_len)
+    {
+        return false;
+    }
+
+    snprintf(buf + len, buf_len - len, "*%02X", nmea_checksum(buf + 1, buf + len));
+    return true;
+}
+
+bool TimeReport::parse(char const * line)
+{
+    if (strncmp(line, prefix, sizeof(prefix) - 1) != 0)
+    {
+        return false;
+    }
+
+    char const * star = strchr(line, '*');
+    if (star == nullptr)
+    {
+        return false;
+    }
+    unsigned actual_checksum;
+    if (1 != sscanf(star, "*%2X", &actual_checksum))
+    {
+        return false;
+    }
+    if (actual_checksum != nmea_checksum(line + 1, star))
+    {
+        return false;
+    }
+
+    char utc_digits[15];
+    char tai_digits[15];
+    int locked_int;
+    if (5 != sscanf(line + sizeof(prefix) - 1, "%14[0-9],%14[0-9],%" SCNd32 ",%d,%lf",
+                    utc_digits, tai_digits, &leap, &locked_int, &us_until_edge))
+    {
+        return false;
+    }
+    locked = locked_int;
+
+    return parse_ymdhms(utc_digits, utc) && parse_ymdhms(tai_digits, tai);
+}
+
+int64_t TimeReport::unix_seconds() const
+{
+    return utc.subtract_and_return_non_leap_seconds(Ymdhms(1970, 1, 1, 0, 0, 0));
+}
+
+double TimeReport::offset_s(int64_t host_receipt_s, double host_receipt_frac_s, double latency_s) const
+{
+    double const whole_seconds = unix_seconds() - host_receipt_s;
+    return whole_seconds - host_receipt_frac_s - us_until_edge / 1e6 + latency_s;
+}
+
+bool time_report_test()
+{
+    {
+        TopOfSecond tos;
+        tos.set_utc_ymdhms(2016, 12, 31, 23, 59, 60);
+        tos.set_gps_minus_utc(17);
+        tos.set_next_leap_second(0, 1);
+
+        TimeReport report;
+        test_assert(report.set(tos, true, 499987.125));
+        test_assert_signed_eq(report.leap, 1);
+
+        char buf[80];
+        test_assert(report.format(buf, sizeof(buf)));
+        test_assert(strcmp(buf, "$SKYT,20161231235960,20170101000036,1,1,499987.125*2D") == 0);
+
+        TimeReport parsed;
+        test_assert(parsed.parse(buf));
+        test_assert(parsed.utc == report.utc);
+        test_assert(parsed.tai == report.tai);
+        test_assert_signed_eq(parsed.leap, 1);
+        test_assert(parsed.locked);
+        test_assert(parsed.us_until_edge == 499987.125);
+
+        // POSIX time repeats across a leap second.
+        test_assert(parsed.unix_seconds() == 1483228800);
+
+        buf[10] = '7';
+        test_assert(!parsed.parse(buf));
+    }
+
+    {
+        TopOfSecond tos;
+        tos.set_utc_ymdhms(2016, 12, 30, 23, 59, 59);
+        tos.set_gps_minus_utc(17);
+        tos.set_next_leap_second(secs_per_day + 1, 1);
+
+        TimeReport report;
+        test_assert(report.set(tos, true, 0));
+        test_assert_signed_eq(report.leap, 0);
+    }
+
+#ifdef HOST_BUILD
+    // End to end: the device labels the upcoming edge and measures the time until it, the report
+    // crosses the wire, and the host helper recovers its own clock offset.
+    {
+        uint32_t lcg = 12345;
+        auto random_unit = [&lcg]() {
+            lcg = lcg * 1664525 + 1013904223;
+            return static_cast<double>(lcg) / 4294967296.0;
+        };
+
+        Ymdhms epoch(1970, 1, 1, 0, 0, 0);
+        for (int trial = 0; trial < 1000; ++trial)
+        {
+            Ymdhms utc(2024, 3, 1, 0, 0, 0);
+            utc.add_seconds(trial * 9973);
+            int64_t const edge_s = utc.subtract_and_return_non_leap_seconds(epoch);
+
+            // True time of emission, somewhere in the second before the edge.
+            double const us_until_edge = 1e6 * (0.001 + 0.998 * random_unit());
+
+            double const host_offset_s = (random_unit() - 0.5) * 0.2;
+            double const latency_s = 0.0002 + 0.002 * random_unit();
+
+            TopOfSecond tos;
+            tos.set_utc_ymdhms(utc.year, utc.month, utc.day, utc.hour, utc.min, utc.sec);
+            tos.set_gps_minus_utc(18);
+            TimeReport device;
+            test_assert(device.set(tos, true, us_until_edge));
+            char buf[80];
+            test_assert(device.format(buf, sizeof(buf)));
+
+            // The host clock reads host_offset_s ahead of the true time on receipt.
+            double const receipt_after_edge_s = latency_s - us_until_edge / 1e6 + host_offset_s;
+            int64_t const host_receipt_s = edge_s + static_cast<int64_t>(std::floor(receipt_after_edge_s));
+            double const host_receipt_frac_s = receipt_after_edge_s - std::floor(receipt_after_edge_s);
+
+            TimeReport host;
+            test_assert(host.parse(buf));
+            double const offset = host.offset_s(host_receipt_s, host_receipt_frac_s, latency_s);
+            test_assert(std::fabs(offset + host_offset_s) < 2e-9);
+        }
+    }
+#endif
+
+    return true;
+}
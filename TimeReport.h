@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "time.h"
+
+bool time_report_test();
+
+/*
+ * Machine readable time report, emitted on USB stdio once per second.
+ *
+ * $SKYT,<UTC YYYYMMDDhhmmss>,<TAI YYYYMMDDhhmmss>,<leap>,<locked>,<us until edge>*<checksum>
+ *
+ * The UTC and TAI fields label the upcoming top of second. The microseconds until the edge
+ * are measured from the moment the line was written, in GPS time. The checksum is the XOR of
+ * all of the characters between '$' and '*', as in NMEA.
+ */
+struct TimeReport
+{
+    Ymdhms utc;
+    Ymdhms tai;
+
+    // 0 for no leap second at the end of this UTC day, 1 for an insertion, 2 for a deletion.
+    int32_t leap = 0;
+
+    bool locked = false;
+
+    double us_until_edge = 0;
+
+    bool set(TopOfSecond const & upcoming, bool locked_, double us_until_edge_);
+
+    bool format(char * buf, size_t buf_len) const;
+    bool parse(char const * line);
+
+    // POSIX time of the upcoming edge.
+    int64_t unix_seconds() const;
+
+    // Offset of the reference (this clock) from a host clock, in seconds. The host read its
+    // own clock (POSIX seconds plus a fraction) when it received the report, the report having
+    // spent latency_s in transit. Kept in two parts so that doubles don't eat the nanoseconds.
+    double offset_s(int64_t host_receipt_s, double host_receipt_frac_s, double latency_s) const;
+};
@@ -0,0 +1,60 @@
+#include "UartPort.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+#include "hardware/gpio.h"
+
+UartPort::UartPort(uart_inst_t * const uart_id, uint const tx_pin, uint const rx_pin, uint32_t const baud_rate):
+    _uart_id(uart_id)
+{
+    uart_init(_uart_id, baud_rate);
+    gpio_set_function(tx_pin, GPIO_FUNC_UART);
+    gpio_set_function(rx_pin, GPIO_FUNC_UART);
+    uart_set_translate_crlf(_uart_id, false);
+
+    _rx = std::make_unique<UartRx>(_uart_id);
+}
+
+void UartPort::dispatch()
+{
+    while (!_tx_buf.empty() && uart_is_writable(_uart_id))
+    {
+        uart_putc_raw(_uart_id, _tx_buf.peek(0));
+        _tx_buf.pop(1);
+    }
+}
+
+bool UartPort::write(uint8_t const * const data, size_t const len)
+{
+    if (_tx_buf.count() + len > _tx_buf_len)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < len; ++i)
+    {
+        _tx_buf.push(data[i]);
+    }
+    dispatch();
+    return true;
+}
+
+bool UartPort::idle()
+{
+    return _tx_buf.empty() && !(uart_get_hw(_uart_id)->fr & UART_UARTFR_BUSY_BITS);
+}
+
+void UartPort::set_baud_rate(uint32_t const baud_rate)
+{
+    uart_set_baudrate(_uart_id, baud_rate);
+}
+
+size_t UartPort::read(uint8_t * const data, size_t const max_n)
+{
+    return _rx->read(data, max_n);
+}
+
+void UartPort::show_status() const
+{
+    printf("UART RX overflows: %" PRIu32 " ring, %" PRIu32 " FIFO\n", _rx->ring_overflows(), _rx->fifo_overruns());
+}
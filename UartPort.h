@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+
+#include "hardware/uart.h"
+
+#include "ByteSource.h"
+#include "RingBuffer.h"
+#include "SerialPort.h"
+#include "UartRx.h"
+
+/*
+ * A hardware UART as a SerialPort and a ByteSource. Received bytes come in from UartRx's
+ * interrupt. Bytes to send wait in a ring until dispatch() finds room in the TX FIFO.
+ */
+class UartPort: public SerialPort, public ByteSource
+{
+public:
+    UartPort(uart_inst_t * uart_id, uint tx_pin, uint rx_pin, uint32_t baud_rate);
+
+    void dispatch();
+
+    bool write(uint8_t const * data, size_t len) override;
+    bool idle() override;
+    void set_baud_rate(uint32_t baud_rate) override;
+
+    size_t read(uint8_t * data, size_t max_n) override;
+
+    void show_status() const;
+
+private:
+    uart_inst_t * const _uart_id;
+
+    static size_t constexpr _tx_buf_len = 200;
+    RingBuffer<uint8_t, _tx_buf_len> _tx_buf;
+
+    // Made once the UART is set up, since it starts taking interrupts.
+    std::unique_ptr<UartRx> _rx;
+};
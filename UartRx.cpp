@@ -0,0 +1,52 @@
+#include "UartRx.h"
+
+#include "hardware/irq.h"
+
+UartRx * UartRx::_instances[2] = {nullptr, nullptr};
+
+UartRx::UartRx(uart_inst_t * const uart_id):
+    _uart_id(uart_id)
+{
+    uint const index = uart_get_index(_uart_id);
+    _instances[index] = this;
+
+    // The receive timeout interrupt comes with the RX one, so the tail of a burst isn't left
+    // sitting in the FIFO below its threshold.
+    uint const irq = index == 0 ? UART0_IRQ : UART1_IRQ;
+    irq_set_exclusive_handler(irq, index == 0 ? _irq_handler_uart0 : _irq_handler_uart1);
+    irq_set_enabled(irq, true);
+    uart_set_irq_enables(_uart_id, true, false);
+}
+
+void UartRx::_irq_handler_uart0()
+{
+    _instances[0]->_irq_handler();
+}
+
+void UartRx::_irq_handler_uart1()
+{
+    _instances[1]->_irq_handler();
+}
+
+void UartRx::_irq_handler()
+{
+    uart_hw_t * const hw = uart_get_hw(_uart_id);
+    if (hw->rsr & UART_UARTRSR_OE_BITS)
+    {
+        ++_fifo_overruns;
+        hw->rsr = UART_UARTRSR_BITS;
+    }
+
+    uint8_t chunk[32];
+    size_t n = 0;
+    while (uart_is_readable(_uart_id) && n < sizeof(chunk))
+    {
+        chunk[n++] = static_cast<uint8_t>(hw->dr);
+    }
+    _ring.push(chunk, n);
+}
+
+size_t UartRx::read(uint8_t * const data, size_t const max_n)
+{
+    return _ring.pop(data, max_n);
+}
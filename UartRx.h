@@ -0,0 +1,38 @@
+#pragma once
+
+#include "hardware/uart.h"
+
+#include "ByteSource.h"
+#include "SpscRingBuffer.h"
+
+/*
+ * UART reception from the RX interrupt into a ring, so the 32 byte hardware FIFO is emptied
+ * however long the main loop takes to get around to it.
+ *
+ * One of these per UART at most. The interrupt is taken on the core that constructs it.
+ */
+class UartRx: public ByteSource
+{
+public:
+    UartRx(uart_inst_t * uart_id);
+
+    size_t read(uint8_t * data, size_t max_n) override;
+
+    // Bytes lost because the ring was full.
+    inline uint32_t ring_overflows() const { return _ring.dropped(); }
+
+    // Times the hardware FIFO filled before the interrupt emptied it.
+    inline uint32_t fifo_overruns() const { return _fifo_overruns; }
+
+private:
+    uart_inst_t * const _uart_id;
+
+    static size_t constexpr _ring_len = 1024;
+    SpscRingBuffer<_ring_len> _ring;
+    uint32_t volatile _fifo_overruns = 0;
+
+    static UartRx * _instances[2];
+    static void _irq_handler_uart0();
+    static void _irq_handler_uart1();
+    void _irq_handler();
+};
@@ -0,0 +1,413 @@
+#include "UbxBaudNegotiator.h"
+
+#include <algorithm>
+#include <deque>
+
+#include "RingBuffer.h"
+#include "util.h"
+
+UbxBaudNegotiator::UbxBaudNegotiator(UbxCfgPrt const & port):
+    _port(port)
+{
+}
+
+void UbxBaudNegotiator::_poll(uint64_t const now_us, SerialPort & serial)
+{
+    uint8_t frame[UbxCfgPrt::poll_len + ubx_overhead_len];
+    size_t const frame_len = ubx_encode(UbxCfgPrt::msg_class, UbxCfgPrt::msg_id, &_port.portID, UbxCfgPrt::poll_len, frame);
+    _poll_pending = !serial.write(frame, frame_len);
+    if (!_poll_pending)
+    {
+        ++_polls_sent;
+        _poll_sent_us = now_us;
+    }
+}
+
+void UbxBaudNegotiator::_probe(State const state, uint32_t const baud_rate, uint64_t const now_us, SerialPort & serial)
+{
+    _state = state;
+    _baud_rate = baud_rate;
+    serial.set_baud_rate(baud_rate);
+    _answered = false;
+    _polls_sent = 0;
+    _poll(now_us, serial);
+}
+
+void UbxBaudNegotiator::_next_round(uint64_t const now_us, SerialPort & serial)
+{
+    if (++_rounds >= max_rounds)
+    {
+        _state = State::failed;
+        return;
+    }
+    _probe(State::probe_fast, _port.baudRate, now_us, serial);
+}
+
+void UbxBaudNegotiator::dispatch(uint64_t const now_us, SerialPort & serial)
+{
+    switch (_state)
+    {
+    case State::start:
+        _probe(State::probe_fast, _port.baudRate, now_us, serial);
+        break;
+
+    case State::probe_fast:
+    case State::probe_default:
+    case State::verify_fast:
+    case State::verify_default:
+        if (_answered)
+        {
+            if (_state == State::probe_default)
+            {
+                _state = State::switching;
+                _poll_pending = true;
+            }
+            else
+            {
+                _fell_back = _state == State::verify_default;
+                _state = State::done;
+            }
+        }
+        else if (_poll_pending)
+        {
+            _poll(now_us, serial);
+        }
+        else if (now_us - _poll_sent_us >= poll_timeout_us)
+        {
+            if (_polls_sent < polls_per_probe)
+            {
+                _poll(now_us, serial);
+            }
+            else if (_state == State::probe_fast)
+            {
+                _probe(State::probe_default, default_baud_rate, now_us, serial);
+            }
+            else if (_state == State::verify_fast)
+            {
+                _probe(State::verify_default, default_baud_rate, now_us, serial);
+            }
+            else
+            {
+                _next_round(now_us, serial);
+            }
+        }
+        break;
+
+    case State::switching:
+        if (_poll_pending)
+        {
+            uint8_t frame[UbxCfgPrt::len + ubx_overhead_len];
+            size_t const frame_len = ubx_encode(_port, frame);
+            if (!serial.write(frame, frame_len))
+            {
+                break;
+            }
+            _poll_pending = false;
+        }
+        if (serial.idle())
+        {
+            serial.set_baud_rate(_port.baudRate);
+            _state = State::settling;
+            _state_start_us = now_us;
+        }
+        break;
+
+    case State::settling:
+        if (now_us - _state_start_us >= settle_us)
+        {
+            _probe(State::verify_fast, _port.baudRate, now_us, serial);
+        }
+        break;
+
+    case State::done:
+    case State::failed:
+        break;
+    }
+}
+
+bool UbxBaudNegotiator::on_frame(UbxFrame const & frame)
+{
+    if (frame.msg_class != UbxCfgPrt::msg_class || frame.msg_id != UbxCfgPrt::msg_id)
+    {
+        return false;
+    }
+    UbxCfgPrt prt;
+    if (ubx_decode(frame.payload, prt) && prt.portID == _port.portID && prt.baudRate == _baud_rate)
+    {
+        _answered = true;
+    }
+    return true;
+}
+
+namespace
+{
+    struct WireByte
+    {
+        uint64_t end_us;
+        uint8_t byte;
+        uint32_t baud_rate;
+    };
+
+    // One direction of a UART. Each byte takes ten bit times to cross at the sender's rate, and
+    // comes out garbled if the far end is listening at another.
+    class Wire
+    {
+    public:
+        void send(uint64_t const now_us, uint32_t const baud_rate, uint8_t const * const data, size_t const len)
+        {
+            uint64_t const byte_us = (10 * 1000000 + baud_rate - 1) / baud_rate;
+            for (size_t i = 0; i < len; ++i)
+            {
+                _free_us = std::max(now_us, _free_us) + byte_us;
+                _bytes.push_back({_free_us, data[i], baud_rate});
+            }
+        }
+
+        // When the last byte sent so far will have crossed.
+        inline uint64_t free_us() const { return _free_us; }
+
+        template <size_t buffer_len>
+        void receive(uint64_t const now_us, uint32_t const baud_rate, RingBuffer<uint8_t, buffer_len> & buffer)
+        {
+            while (!_bytes.empty() && _bytes.front().end_us <= now_us)
+            {
+                WireByte const & byte = _bytes.front();
+                if (!buffer.full())
+                {
+                    buffer.push(byte.baud_rate == baud_rate ? byte.byte : byte.byte ^ 0xa5);
+                }
+                _bytes.pop_front();
+            }
+        }
+
+    private:
+        std::deque<WireByte> _bytes;
+        uint64_t _free_us = 0;
+    };
+
+    // A receiver at the far end of both wires. It answers CFG-PRT polls and changes, ACKs any
+    // other CFG, and sends NAV-PVT, NAV-TIMELS, and TIM-TP at the top of every second.
+    class SimulatedReceiver: public SerialPort
+    {
+    public:
+        SimulatedReceiver(uint32_t const baud_rate, uint32_t const max_baud_rate, bool const present):
+            _baud_rate(baud_rate), _max_baud_rate(max_baud_rate), _present(present) {}
+
+        bool write(uint8_t const * const data, size_t const len) override
+        {
+            _to_receiver.send(now_us, _host_baud_rate, data, len);
+            return true;
+        }
+
+        bool idle() override
+        {
+            return now_us >= _to_receiver.free_us();
+        }
+
+        void set_baud_rate(uint32_t const baud_rate) override
+        {
+            _host_baud_rate = baud_rate;
+        }
+
+        template <size_t buffer_len>
+        void step(RingBuffer<uint8_t, buffer_len> & to_host)
+        {
+            if (_new_baud_rate != 0 && now_us >= _new_baud_rate_us)
+            {
+                _baud_rate = _new_baud_rate;
+                _new_baud_rate = 0;
+            }
+
+            _to_receiver.receive(now_us, _baud_rate, _rx_buf);
+            UbxFrame frame;
+            while (_ubx_parser.parse(frame))
+            {
+                _on_frame(frame);
+            }
+
+            if (_present && now_us >= _next_second_us)
+            {
+                uint8_t const zeros[UbxNavPvt::len] = {};
+                _send(UbxNavPvt::msg_class, UbxNavPvt::msg_id, zeros, UbxNavPvt::len);
+                pvt_latency_us = _to_host.free_us() - _next_second_us;
+                _send(UbxNavTimeLs::msg_class, UbxNavTimeLs::msg_id, zeros, UbxNavTimeLs::len);
+                _send(UbxTimTp::msg_class, UbxTimTp::msg_id, zeros, UbxTimTp::len);
+                _next_second_us += 1000000;
+            }
+
+            _to_host.receive(now_us, _host_baud_rate, to_host);
+        }
+
+        inline uint32_t baud_rate() const { return _baud_rate; }
+
+        uint64_t now_us = 0;
+
+        // From the top of the last second to the end of its NAV-PVT.
+        uint64_t pvt_latency_us = 0;
+
+        uint32_t changes_accepted = 0;
+
+    private:
+        uint32_t _baud_rate;
+        uint32_t const _max_baud_rate;
+        bool const _present;
+        uint32_t _new_baud_rate = 0;
+        uint64_t _new_baud_rate_us = 0;
+        uint64_t _next_second_us = 0;
+
+        uint32_t _host_baud_rate = UbxBaudNegotiator::default_baud_rate;
+        Wire _to_receiver;
+        Wire _to_host;
+
+        static size_t constexpr _rx_buf_len = 200;
+        RingBuffer<uint8_t, _rx_buf_len> _rx_buf;
+        UbxParser<_rx_buf_len> _ubx_parser{_rx_buf};
+
+        void _send(uint8_t const msg_class, uint8_t const msg_id, uint8_t const * const payload, uint16_t const len)
+        {
+            uint8_t out[UbxNavPvt::len + ubx_overhead_len];
+            size_t const out_len = ubx_encode(msg_class, msg_id, payload, len, out);
+            _to_host.send(now_us, _baud_rate, out, out_len);
+        }
+
+        void _ack(bool const ack, uint8_t const msg_id)
+        {
+            uint8_t const payload[UbxAck::len] = {UbxCfgPrt::msg_class, msg_id};
+            _send(UbxAck::msg_class, ack ? UbxAck::msg_id : UbxAck::msg_id_nak, payload, UbxAck::len);
+        }
+
+        void _on_frame(UbxFrame const & frame)
+        {
+            if (!_present || frame.msg_class != UbxCfgPrt::msg_class)
+            {
+                return;
+            }
+            if (frame.msg_id != UbxCfgPrt::msg_id)
+            {
+                _ack(true, frame.msg_id);
+                return;
+            }
+
+            if (frame.payload.size() == UbxCfgPrt::poll_len)
+            {
+                UbxCfgPrt const prt = {frame.payload[0], 0, 0x000008c0, _baud_rate, 0x0001, 0x0001, 0x0002};
+                uint8_t payload[UbxCfgPrt::len];
+                ubx_pack(prt, payload);
+                _send(UbxCfgPrt::msg_class, UbxCfgPrt::msg_id, payload, UbxCfgPrt::len);
+                _ack(true, frame.msg_id);
+                return;
+            }
+
+            UbxCfgPrt prt;
+            if (!ubx_decode(frame.payload, prt) || prt.baudRate > _max_baud_rate)
+            {
+                _ack(false, frame.msg_id);
+                return;
+            }
+            // The ACK goes out at the old rate.
+            _ack(true, frame.msg_id);
+            _new_baud_rate = prt.baudRate;
+            _new_baud_rate_us = _to_host.free_us();
+            ++changes_accepted;
+        }
+    };
+
+    class Link
+    {
+    public:
+        Link(UbxBaudNegotiator & negotiator, SimulatedReceiver & receiver):
+            _negotiator(negotiator), _receiver(receiver) {}
+
+        // Until the negotiator finishes one way or the other, or for at least the given time.
+        void run(uint64_t const min_duration_us = 0)
+        {
+            uint64_t const min_end_us = now_us + min_duration_us;
+            while ((!(_negotiator.done() || _negotiator.failed()) || now_us < min_end_us) && now_us < 100000000)
+            {
+                _receiver.now_us = now_us;
+                _negotiator.dispatch(now_us, _receiver);
+                _receiver.step(_host_buf);
+                UbxFrame frame;
+                while (_host_parser.parse(frame))
+                {
+                    _negotiator.on_frame(frame);
+                }
+                now_us += 1000;
+            }
+        }
+
+        uint64_t now_us = 0;
+
+    private:
+        UbxBaudNegotiator & _negotiator;
+        SimulatedReceiver & _receiver;
+
+        static size_t constexpr _host_buf_len = 1000;
+        RingBuffer<uint8_t, _host_buf_len> _host_buf;
+        UbxParser<_host_buf_len> _host_parser{_host_buf};
+    };
+
+    UbxCfgPrt constexpr test_port = {1, 0, 0x000008c0, 230400, 0x0001, 0x0001, 0x0002};
+}
+
+bool ubx_baud_negotiator_test()
+{
+    // A receiver fresh from power-up, at its default rate.
+    {
+        UbxBaudNegotiator negotiator(test_port);
+        SimulatedReceiver receiver(UbxBaudNegotiator::default_baud_rate, 921600, true);
+        Link link(negotiator, receiver);
+
+        // At the default rate, the first second's NAV-PVT takes a tenth of a second to arrive.
+        link.run(1000);
+        test_assert(receiver.pvt_latency_us > 100000);
+
+        link.run();
+        test_assert(negotiator.done());
+        test_assert(!negotiator.fell_back());
+        test_assert_unsigned_eq(negotiator.baud_rate(), test_port.baudRate);
+        test_assert_unsigned_eq(receiver.baud_rate(), test_port.baudRate);
+        test_assert_unsigned_eq(receiver.changes_accepted, 1u);
+
+        // Now it's there within a few milliseconds of the top of the second.
+        link.run(2000000);
+        test_assert(receiver.pvt_latency_us < 5000);
+    }
+
+    // A receiver still at the fast rate from before we were reset. Nothing needs to change.
+    {
+        UbxBaudNegotiator negotiator(test_port);
+        SimulatedReceiver receiver(test_port.baudRate, 921600, true);
+        Link link(negotiator, receiver);
+        link.run();
+        test_assert(negotiator.done());
+        test_assert(!negotiator.fell_back());
+        test_assert_unsigned_eq(negotiator.baud_rate(), test_port.baudRate);
+        test_assert_unsigned_eq(receiver.changes_accepted, 0u);
+        test_assert(link.now_us < UbxBaudNegotiator::poll_timeout_us);
+    }
+
+    // A receiver that won't go that fast stays at the default rate.
+    {
+        UbxBaudNegotiator negotiator(test_port);
+        SimulatedReceiver receiver(UbxBaudNegotiator::default_baud_rate, 115200, true);
+        Link link(negotiator, receiver);
+        link.run();
+        test_assert(negotiator.done());
+        test_assert(negotiator.fell_back());
+        test_assert_unsigned_eq(negotiator.baud_rate(), UbxBaudNegotiator::default_baud_rate);
+        test_assert_unsigned_eq(receiver.baud_rate(), UbxBaudNegotiator::default_baud_rate);
+    }
+
+    // No receiver at all.
+    {
+        UbxBaudNegotiator negotiator(test_port);
+        SimulatedReceiver receiver(UbxBaudNegotiator::default_baud_rate, 921600, false);
+        Link link(negotiator, receiver);
+        link.run();
+        test_assert(negotiator.failed());
+        test_assert(!negotiator.done());
+    }
+
+    return true;
+}
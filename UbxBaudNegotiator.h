@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "SerialPort.h"
+#include "UbxParser.h"
+#include "UbxMessages.h"
+
+bool ubx_baud_negotiator_test();
+
+/*
+ * Finds the receiver on its UART and moves the link up to a faster baud rate, without waiting.
+ *
+ * The receiver may be at its default rate after power-up, or already at the fast one if only we
+ * were reset, so it polls UBX-CFG-PRT at the fast rate, then the default. From the default it
+ * sends the new CFG-PRT, switches our UART once that has left the wire, and polls again at the
+ * fast rate. If that goes unanswered it falls back to the default rate and checks it's still
+ * there. A round that finds nothing starts over, up to max_rounds times.
+ */
+class UbxBaudNegotiator
+{
+public:
+    static uint32_t constexpr default_baud_rate = 9600;
+    static uint64_t constexpr poll_timeout_us = 250000;
+    static uint8_t constexpr polls_per_probe = 2;
+    // For the receiver to finish its ACK at the old rate and change over.
+    static uint64_t constexpr settle_us = 100000;
+    static uint8_t constexpr max_rounds = 5;
+
+    // The receiver's port settings, with the baud rate to move it to.
+    UbxBaudNegotiator(UbxCfgPrt const & port);
+
+    void dispatch(uint64_t now_us, SerialPort & serial);
+
+    // True if the frame was a CFG-PRT.
+    bool on_frame(UbxFrame const & frame);
+
+    inline bool done() const { return _state == State::done; }
+    inline bool failed() const { return _state == State::failed; }
+
+    // The rate we settled on, and whether it's the default because the fast one didn't work.
+    inline uint32_t baud_rate() const { return _baud_rate; }
+    inline bool fell_back() const { return _fell_back; }
+
+private:
+    enum class State: uint8_t
+    {
+        start,
+        probe_fast,
+        probe_default,
+        switching,
+        settling,
+        verify_fast,
+        verify_default,
+        done,
+        failed,
+    };
+
+    UbxCfgPrt const _port;
+    State _state = State::start;
+    uint32_t _baud_rate = default_baud_rate;
+    bool _fell_back = false;
+    uint8_t _rounds = 0;
+
+    uint64_t _state_start_us = 0;
+    uint64_t _poll_sent_us = 0;
+    uint8_t _polls_sent = 0;
+    bool _poll_pending = false;
+    bool _answered = false;
+
+    void _probe(State state, uint32_t baud_rate, uint64_t now_us, SerialPort & serial);
+    void _poll(uint64_t now_us, SerialPort & serial);
+    void _next_round(uint64_t now_us, SerialPort & serial);
+};
@@ -0,0 +1,324 @@
+#include "UbxConfigurator.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "UbxMessages.h"
+#include "util.h"
+
+bool UbxConfigurator::add(uint8_t const msg_id, uint8_t const * const payload, uint16_t const len)
+{
+    if (_n_messages == max_messages || len > max_payload_len)
+    {
+        return false;
+    }
+    Message & message = _messages[_n_messages++];
+    message.msg_id = msg_id;
+    message.len = len;
+    for (uint16_t i = 0; i < len; ++i)
+    {
+        message.payload[i] = payload[i];
+    }
+    message.state = State::waiting;
+    message.attempts = 0;
+    message.sent_us = 0;
+    return true;
+}
+
+bool UbxConfigurator::_id_in_flight(uint8_t const msg_id) const
+{
+    for (size_t i = 0; i < _n_messages; ++i)
+    {
+        if (_messages[i].state == State::in_flight && _messages[i].msg_id == msg_id)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UbxConfigurator::_send(Message & message, uint64_t const now_us, SerialPort & port)
+{
+    uint8_t frame[max_payload_len + ubx_overhead_len];
+    size_t const frame_len = ubx_encode(msg_class, message.msg_id, message.payload, message.len, frame);
+    if (!port.write(frame, frame_len))
+    {
+        return false;
+    }
+    message.state = State::in_flight;
+    ++message.attempts;
+    message.sent_us = now_us;
+    ++_n_in_flight;
+    ++_sends;
+    return true;
+}
+
+void UbxConfigurator::dispatch(uint64_t const now_us, SerialPort & port)
+{
+    if (_failed)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < _n_messages; ++i)
+    {
+        Message & message = _messages[i];
+        if (message.state == State::in_flight && now_us - message.sent_us >= ack_timeout_us)
+        {
+            if (message.attempts >= max_attempts)
+            {
+                _failed = true;
+                return;
+            }
+            message.state = State::waiting;
+            --_n_in_flight;
+        }
+    }
+
+    // In order, so when the port is short of room the earlier messages go first.
+    for (size_t i = 0; i < _n_messages && _n_in_flight < max_in_flight; ++i)
+    {
+        Message & message = _messages[i];
+        if (message.state != State::waiting || _id_in_flight(message.msg_id))
+        {
+            continue;
+        }
+        if (!_send(message, now_us, port))
+        {
+            return;
+        }
+    }
+}
+
+bool UbxConfigurator::on_frame(UbxFrame const & frame)
+{
+    if (frame.msg_class != UbxAck::msg_class)
+    {
+        return false;
+    }
+    if (!(frame.msg_id == UbxAck::msg_id || frame.msg_id == UbxAck::msg_id_nak))
+    {
+        return false;
+    }
+    UbxAck ack;
+    if (!ubx_decode(frame.payload, ack) || ack.clsID != msg_class)
+    {
+        return true;
+    }
+
+    for (size_t i = 0; i < _n_messages; ++i)
+    {
+        Message & message = _messages[i];
+        if (message.state != State::in_flight || message.msg_id != ack.msgID)
+        {
+            continue;
+        }
+        if (frame.msg_id == UbxAck::msg_id)
+        {
+            message.state = State::acked;
+            --_n_in_flight;
+            ++_n_acked;
+        }
+        else
+        {
+            // Leave it in flight, so it's sent again when it times out.
+            printf("NAK %02x %02x\n", ack.clsID, ack.msgID);
+            ++_naks;
+        }
+        break;
+    }
+    return true;
+}
+
+namespace
+{
+    // Takes UBX frames from a small input buffer, and answers each CFG message after a delay that
+    // varies, so answers to messages in flight together come back out of order. Drops or NAKs some
+    // of them in a fixed pattern.
+    class SimulatedReceiver: public SerialPort
+    {
+    public:
+        SimulatedReceiver(bool present): _present(present) {}
+
+        bool write(uint8_t const * const data, size_t const len) override
+        {
+            if (_rx_buf.count() + len > _rx_buf_len)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < len; ++i)
+            {
+                _rx_buf.push(data[i]);
+            }
+            return true;
+        }
+
+        bool idle() override { return true; }
+        void set_baud_rate(uint32_t) override {}
+
+        template <size_t buffer_len>
+        void step(uint64_t const now_us, RingBuffer<uint8_t, buffer_len> & to_host)
+        {
+            UbxFrame frame;
+            while (_ubx_parser.parse(frame))
+            {
+                uint32_t const n = _n_received++;
+                if (!_present || frame.msg_class != UbxConfigurator::msg_class || n % 5 == 1)
+                {
+                    continue;
+                }
+                bool const nak = n % 7 == 3;
+                if (!nak)
+                {
+                    std::vector<uint8_t> payload;
+                    for (size_t i = 0; i < frame.payload.size(); ++i)
+                    {
+                        payload.push_back(frame.payload[i]);
+                    }
+                    applied.push_back(payload);
+                }
+                _replies.push_back({now_us + 30000 + (n % 3) * 400000, frame.msg_id, nak});
+                max_unanswered = std::max(max_unanswered, _replies.size());
+            }
+
+            for (auto reply = _replies.begin(); reply != _replies.end();)
+            {
+                if (reply->time_us > now_us)
+                {
+                    ++reply;
+                    continue;
+                }
+                uint8_t const payload[UbxAck::len] = {UbxConfigurator::msg_class, reply->msg_id};
+                uint8_t out[UbxAck::len + ubx_overhead_len];
+                size_t const out_len = ubx_encode(
+                    UbxAck::msg_class, reply->nak ? UbxAck::msg_id_nak : UbxAck::msg_id, payload, UbxAck::len, out);
+                for (size_t i = 0; i < out_len; ++i)
+                {
+                    to_host.push(out[i]);
+                }
+                reply = _replies.erase(reply);
+            }
+        }
+
+        // Payloads of the messages it took, in the order it took them.
+        std::vector<std::vector<uint8_t>> applied;
+        size_t max_unanswered = 0;
+
+    private:
+        bool _present;
+
+        static size_t constexpr _rx_buf_len = 100;
+        RingBuffer<uint8_t, _rx_buf_len> _rx_buf;
+        UbxParser<_rx_buf_len> _ubx_parser{_rx_buf};
+        uint32_t _n_received = 0;
+
+        struct Reply
+        {
+            uint64_t time_us;
+            uint8_t msg_id;
+            bool nak;
+        };
+        std::vector<Reply> _replies;
+    };
+
+    // Runs until the configurator is done or has failed. Returns when that was.
+    uint64_t run(UbxConfigurator & configurator, SimulatedReceiver & receiver)
+    {
+        static size_t constexpr host_buf_len = 200;
+        RingBuffer<uint8_t, host_buf_len> host_buf;
+        UbxParser<host_buf_len> host_parser{host_buf};
+
+        uint64_t constexpr step_us = 10000;
+        uint64_t now_us = 0;
+        while (!configurator.done() && !configurator.failed() && now_us < 100000000)
+        {
+            configurator.dispatch(now_us, receiver);
+            receiver.step(now_us, host_buf);
+            UbxFrame frame;
+            while (host_parser.parse(frame))
+            {
+                configurator.on_frame(frame);
+            }
+            now_us += step_us;
+        }
+        return now_us;
+    }
+
+    // What GpsUBlox sends: CFG-PRT, CFG-TP5, and three CFG-MSGs sharing an ID.
+    std::vector<std::vector<uint8_t>> add_messages(UbxConfigurator & configurator)
+    {
+        std::vector<std::pair<uint8_t, std::vector<uint8_t>>> const messages = {
+            {0x00, std::vector<uint8_t>(20, 0x11)},
+            {0x31, std::vector<uint8_t>(32, 0x22)},
+            {0x01, {0x01, 0x07, 0x01}},
+            {0x01, {0x01, 0x26, 0x01}},
+            {0x01, {0x0d, 0x01, 0x01}},
+        };
+        std::vector<std::vector<uint8_t>> payloads;
+        for (auto const & [msg_id, payload] : messages)
+        {
+            configurator.add(msg_id, payload.data(), payload.size());
+            payloads.push_back(payload);
+        }
+        return payloads;
+    }
+}
+
+bool ubx_configurator_test()
+{
+    // Everything goes through in the end, despite the drops and NAKs.
+    {
+        UbxConfigurator configurator;
+        auto const payloads = add_messages(configurator);
+        test_assert(!configurator.done());
+
+        SimulatedReceiver receiver(true);
+        uint64_t const finished_us = run(configurator, receiver);
+        test_assert(configurator.done());
+        test_assert(!configurator.failed());
+        test_assert(configurator.naks() > 0);
+        test_assert(configurator.sends() > payloads.size());
+        test_assert(finished_us < 5 * UbxConfigurator::ack_timeout_us);
+        // Several at a time, but no more than it should.
+        test_assert(receiver.max_unanswered > 1);
+        test_assert(receiver.max_unanswered <= UbxConfigurator::max_in_flight);
+
+        for (auto const & payload : payloads)
+        {
+            bool found = false;
+            for (auto const & applied : receiver.applied)
+            {
+                found = found || applied == payload;
+            }
+            test_assert(found);
+        }
+    }
+
+    // A receiver that never answers. The configurator gives up on the first message after its
+    // last timeout, and gets there only by being dispatched.
+    {
+        UbxConfigurator configurator;
+        add_messages(configurator);
+
+        SimulatedReceiver receiver(false);
+        uint64_t const finished_us = run(configurator, receiver);
+        test_assert(configurator.failed());
+        test_assert(!configurator.done());
+        test_assert(finished_us >= UbxConfigurator::max_attempts * UbxConfigurator::ack_timeout_us);
+        test_assert(finished_us < (UbxConfigurator::max_attempts + 1) * UbxConfigurator::ack_timeout_us);
+    }
+
+    // No room for another message.
+    {
+        UbxConfigurator configurator;
+        uint8_t const payload[UbxConfigurator::max_payload_len + 1] = {};
+        test_assert(!configurator.add(0x00, payload, sizeof(payload)));
+        for (size_t i = 0; i < UbxConfigurator::max_messages; ++i)
+        {
+            test_assert(configurator.add(0x01, payload, 3));
+        }
+        test_assert(!configurator.add(0x01, payload, 3));
+    }
+
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "SerialPort.h"
+#include "UbxParser.h"
+
+bool ubx_configurator_test();
+
+/*
+ * Sends a list of UBX-CFG messages to the receiver without waiting on any of them.
+ *
+ * Several messages are in flight at once, and each ACK or NAK is matched to its message by ID,
+ * in whatever order they come back. The receiver's ACK doesn't say which of two messages with the
+ * same ID it's for, so only one with a given ID is in flight at a time. A message that is NAKed
+ * or never answered is sent again when its timeout expires, up to max_attempts times.
+ */
+class UbxConfigurator
+{
+public:
+    static size_t constexpr max_messages = 12;
+    static size_t constexpr max_payload_len = 40;
+    static size_t constexpr max_in_flight = 4;
+    static uint8_t constexpr max_attempts = 10;
+    static uint64_t constexpr ack_timeout_us = 1200000;
+
+    static uint8_t constexpr msg_class = 0x06;
+
+    // Adds a message to the end of the list. False if there's no room for it.
+    bool add(uint8_t msg_id, uint8_t const * payload, uint16_t len);
+
+    // Sends whatever can be sent now. Call it often.
+    void dispatch(uint64_t now_us, SerialPort & port);
+
+    // True if the frame was an ACK or NAK, whether or not it was for one of our messages.
+    bool on_frame(UbxFrame const & frame);
+
+    // Every message has been acknowledged.
+    inline bool done() const { return _n_acked == _n_messages; }
+
+    // Some message ran out of attempts. Nothing more is sent.
+    inline bool failed() const { return _failed; }
+
+    inline uint32_t sends() const { return _sends; }
+    inline uint32_t naks() const { return _naks; }
+
+private:
+    enum class State: uint8_t
+    {
+        waiting,
+        in_flight,
+        acked,
+    };
+
+    struct Message
+    {
+        uint8_t msg_id;
+        uint16_t len;
+        uint8_t payload[max_payload_len];
+        State state;
+        uint8_t attempts;
+        uint64_t sent_us;
+    };
+
+    std::array<Message, max_messages> _messages;
+    size_t _n_messages = 0;
+    size_t _n_acked = 0;
+    size_t _n_in_flight = 0;
+    bool _failed = false;
+
+    uint32_t _sends = 0;
+    uint32_t _naks = 0;
+
+    bool _id_in_flight(uint8_t msg_id) const;
+    bool _send(Message & message, uint64_t now_us, SerialPort & port);
+};
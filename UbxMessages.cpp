@@ -0,0 +1,161 @@
+#include "UbxMessages.h"
+
+#include <algorithm>
+
+#include "util.h"
+
+namespace
+{
+    // Frames as the receiver sends them, built field by field from the interface description.
+    uint8_t const nav_pvt_frame[] = {
+        0xb5, 0x62, 0x01, 0x07, 0x5c, 0x00, 0x78, 0x85, 0xe8, 0x1e, 0xe8, 0x07,
+        0x09, 0x0e, 0x12, 0x2a, 0x11, 0x37, 0x15, 0x00, 0x00, 0x00, 0xc7, 0xcf,
+        0xff, 0xff, 0x03, 0x01, 0xea, 0x0b, 0xf2, 0x39, 0x15, 0xb7, 0x95, 0x60,
+        0x38, 0x1c, 0x40, 0xe2, 0x01, 0x00, 0x0e, 0x39, 0x02, 0x00, 0xdc, 0x05,
+        0x00, 0x00, 0xc4, 0x09, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0xfc, 0xff,
+        0xff, 0xff, 0x05, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0xc8, 0x00, 0x00, 0x00, 0x80, 0xa8, 0x12, 0x01, 0x86, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x7d, 0x3e,
+    };
+
+    uint8_t const nav_time_ls_frame[] = {
+        0xb5, 0x62, 0x01, 0x26, 0x18, 0x00, 0x78, 0x85, 0xe8, 0x1e, 0x00, 0x00,
+        0x00, 0x00, 0x02, 0x12, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x5b, 0x74,
+    };
+
+    uint8_t const tim_tp_frame[] = {
+        0xb5, 0x62, 0x0d, 0x01, 0x10, 0x00, 0x60, 0x89, 0xe8, 0x1e, 0x00, 0x00,
+        0x00, 0x00, 0x2e, 0xfb, 0xff, 0xff, 0x1c, 0x09, 0x03, 0x00, 0x5c, 0x47,
+    };
+
+    // UBX-ACK-ACK for UBX-CFG-MSG.
+    uint8_t const ack_frame[] = {
+        0xb5, 0x62, 0x05, 0x01, 0x02, 0x00, 0x06, 0x01, 0x0f, 0x38,
+    };
+
+    class TestReceiver
+    {
+    public:
+        UbxNavPvt pvt;
+        UbxNavTimeLs time_ls;
+        UbxTimTp tim_tp;
+        uint32_t count = 0;
+
+        void on_nav_pvt(UbxNavPvt const & m) { pvt = m; ++count; }
+        void on_nav_time_ls(UbxNavTimeLs const & m) { time_ls = m; ++count; }
+        void on_tim_tp(UbxTimTp const & m) { tim_tp = m; ++count; }
+    };
+
+    constexpr std::array test_handlers = {
+        ubx_handler<TestReceiver, UbxNavPvt, &TestReceiver::on_nav_pvt>(),
+        ubx_handler<TestReceiver, UbxNavTimeLs, &TestReceiver::on_nav_time_ls>(),
+        ubx_handler<TestReceiver, UbxTimTp, &TestReceiver::on_tim_tp>(),
+    };
+    static_assert(ubx_handlers_unique(test_handlers));
+    static_assert(!ubx_handlers_unique(std::array{test_handlers[0], test_handlers[1], test_handlers[0]}));
+
+    template <size_t buffer_len>
+    void push(RingBuffer<uint8_t, buffer_len> & buffer, uint8_t const * bytes, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            buffer.push(bytes[i]);
+        }
+    }
+}
+
+bool ubx_messages_test()
+{
+    RingBuffer<uint8_t, 160> buffer;
+    UbxParser<160> parser(buffer);
+    TestReceiver receiver;
+    UbxFrame frame;
+
+    // Start partway into the buffer, so the NAV-PVT payload wraps around its end.
+    for (int i = 0; i < 100; ++i)
+    {
+        buffer.push(0);
+    }
+    test_assert(!parser.parse(frame));
+    push(buffer, nav_pvt_frame, sizeof(nav_pvt_frame));
+    test_assert(parser.parse(frame));
+    test_assert(!frame.payload.second().empty());
+    test_assert(ubx_dispatch(test_handlers, receiver, frame));
+    test_assert_unsigned_eq(receiver.count, 1u);
+
+    UbxNavPvt const & pvt = receiver.pvt;
+    test_assert_unsigned_eq(pvt.iTOW, 518555000u);
+    test_assert(pvt.year == 2024);
+    test_assert(pvt.month == 9);
+    test_assert(pvt.day == 14);
+    test_assert(pvt.hour == 18);
+    test_assert(pvt.min == 42);
+    test_assert(pvt.sec == 17);
+    test_assert(pvt.validDate() && pvt.validTime() && pvt.fullyResolved());
+    test_assert_signed_eq(pvt.nano, (int32_t)-12345);
+    test_assert(pvt.fixType == 3);
+    test_assert(pvt.gnssFixOK());
+    test_assert(pvt.confirmedAvai() && pvt.confirmedDate() && pvt.confirmedTime());
+    test_assert(pvt.numSV == 11);
+    test_assert_signed_eq(pvt.lon, (int32_t)-1223345678);
+    test_assert_signed_eq(pvt.lat, (int32_t)473456789);
+    test_assert_signed_eq(pvt.velE, (int32_t)-4);
+    test_assert_unsigned_eq(pvt.headAcc, 18000000u);
+    test_assert(pvt.pDOP == 134);
+    test_assert(!pvt.invalidLlh());
+
+    push(buffer, nav_time_ls_frame, sizeof(nav_time_ls_frame));
+    push(buffer, tim_tp_frame, sizeof(tim_tp_frame));
+    test_assert(parser.parse(frame));
+    test_assert(ubx_dispatch(test_handlers, receiver, frame));
+    test_assert(parser.parse(frame));
+    test_assert(ubx_dispatch(test_handlers, receiver, frame));
+    test_assert_unsigned_eq(receiver.count, 3u);
+
+    test_assert(receiver.time_ls.version == 0);
+    test_assert(receiver.time_ls.currLs == 18);
+    test_assert(receiver.time_ls.srcOfCurrLs == 2);
+    test_assert(receiver.time_ls.validCurrLs() && receiver.time_ls.validTimeToLsEvent());
+
+    test_assert_unsigned_eq(receiver.tim_tp.towMS, 518556000u);
+    test_assert_signed_eq(receiver.tim_tp.qErr, (int32_t)-1234);
+    test_assert(receiver.tim_tp.week == 2332);
+    test_assert(!receiver.tim_tp.qErrInvalid());
+
+    // Messages without a handler are left alone, and those with a wrong length aren't decoded.
+    push(buffer, ack_frame, sizeof(ack_frame));
+    test_assert(parser.parse(frame));
+    test_assert(!ubx_dispatch(test_handlers, receiver, frame));
+    UbxAck ack;
+    test_assert(ubx_decode(frame.payload, ack));
+    test_assert(ack.clsID == 0x06 && ack.msgID == 0x01);
+    test_assert(!ubx_decode(frame.payload, receiver.tim_tp));
+    test_assert_unsigned_eq(receiver.count, 3u);
+
+    // What was received packs back into the same bytes.
+    uint8_t out[UbxNavPvt::len + ubx_overhead_len];
+    test_assert(ubx_encode(receiver.pvt, out) == sizeof(nav_pvt_frame));
+    test_assert(std::equal(out, out + sizeof(nav_pvt_frame), nav_pvt_frame));
+    test_assert(ubx_encode(receiver.time_ls, out) == sizeof(nav_time_ls_frame));
+    test_assert(std::equal(out, out + sizeof(nav_time_ls_frame), nav_time_ls_frame));
+    test_assert(ubx_encode(receiver.tim_tp, out) == sizeof(tim_tp_frame));
+    test_assert(std::equal(out, out + sizeof(tim_tp_frame), tim_tp_frame));
+
+    UbxCfgPrt prt = {1, 0, 0x000008c0, 115200, 0x0001, 0x0001, 0x0002};
+    uint8_t prt_frame[UbxCfgPrt::len + ubx_overhead_len];
+    test_assert(ubx_encode(prt, prt_frame) == sizeof(prt_frame));
+    test_assert(prt_frame[ubx_header_len + 8] == 0x00 && prt_frame[ubx_header_len + 9] == 0xc2);
+    push(buffer, prt_frame, sizeof(prt_frame));
+    test_assert(parser.parse(frame));
+    test_assert(frame.msg_class == UbxCfgPrt::msg_class && frame.msg_id == UbxCfgPrt::msg_id);
+    UbxCfgPrt decoded_prt;
+    test_assert(ubx_decode(frame.payload, decoded_prt));
+    test_assert(decoded_prt.portID == 1);
+    test_assert_unsigned_eq(decoded_prt.mode, 0x000008c0u);
+    test_assert_unsigned_eq(decoded_prt.baudRate, 115200u);
+    test_assert(decoded_prt.inProtoMask == 1 && decoded_prt.outProtoMask == 1 && decoded_prt.flags == 2);
+
+    return true;
+}
@@ -0,0 +1,515 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "packing.h"
+#include "UbxParser.h"
+
+bool ubx_messages_test();
+
+/*
+ * UBX messages, each a struct holding its fields and listing their layout once, in unpack().
+ * Unpack checks at compile time that the layout covers exactly len bytes, and ubx_decode()
+ * reads the fields straight out of the parser's view of the receive buffer.
+ *
+ * To handle a new message, add its struct here and a line to the receiver's handler table.
+ * Messages we send, or that a simulated receiver sends, have a pack() as well, for ubx_encode().
+ */
+
+// UBX-ACK-ACK and UBX-ACK-NAK share a layout.
+struct UbxAck
+{
+    static uint8_t constexpr msg_class = 0x05;
+    static uint8_t constexpr msg_id = 0x01;
+    static uint8_t constexpr msg_id_nak = 0x00;
+    static size_t constexpr len = 2;
+
+    uint8_t clsID;
+    uint8_t msgID;
+
+    template <typename U>
+    auto unpack(U u)
+    {
+        return u
+            >> clsID
+            >> msgID;
+    }
+};
+
+struct UbxNavPvt
+{
+    static uint8_t constexpr msg_class = 0x01;
+    static uint8_t constexpr msg_id = 0x07;
+    static size_t constexpr len = 92;
+
+    uint32_t iTOW;
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t min;
+    uint8_t sec;
+    uint8_t valid;
+    uint32_t tAcc;
+    int32_t nano;
+    uint8_t fixType;
+    uint8_t flags;
+    uint8_t flags2;
+    uint8_t numSV;
+    int32_t lon;
+    int32_t lat;
+    int32_t height;
+    int32_t hMSL;
+    uint32_t hAcc;
+    uint32_t vAcc;
+    int32_t velN;
+    int32_t velE;
+    int32_t velD;
+    int32_t gSpeed;
+    int32_t headMot;
+    uint32_t sAcc;
+    uint32_t headAcc;
+    uint16_t pDOP;
+    uint16_t flags3;
+    int32_t headVeh;
+    int16_t magDec;
+    uint16_t magAcc;
+
+    template <typename U>
+    auto unpack(U u)
+    {
+        return u
+            >> iTOW
+            >> year
+            >> month
+            >> day
+            >> hour
+            >> min
+            >> sec
+            >> valid
+            >> tAcc
+            >> nano
+            >> fixType
+            >> flags
+            >> flags2
+            >> numSV
+            >> lon
+            >> lat
+            >> height
+            >> hMSL
+            >> hAcc
+            >> vAcc
+            >> velN
+            >> velE
+            >> velD
+            >> gSpeed
+            >> headMot
+            >> sAcc
+            >> headAcc
+            >> pDOP
+            >> flags3
+            >> Skip<4>()
+            >> headVeh
+            >> magDec
+            >> magAcc;
+    }
+
+    template <typename P>
+    auto pack(P p) const
+    {
+        return p
+            << iTOW
+            << year
+            << month
+            << day
+            << hour
+            << min
+            << sec
+            << valid
+            << tAcc
+            << nano
+            << fixType
+            << flags
+            << flags2
+            << numSV
+            << lon
+            << lat
+            << height
+            << hMSL
+            << hAcc
+            << vAcc
+            << velN
+            << velE
+            << velD
+            << gSpeed
+            << headMot
+            << sAcc
+            << headAcc
+            << pDOP
+            << flags3
+            << Skip<4>()
+            << headVeh
+            << magDec
+            << magAcc;
+    }
+
+    bool validDate() const     { return valid & 0x01; }
+    bool validTime() const     { return valid & 0x02; }
+    bool fullyResolved() const { return valid & 0x04; }
+    bool gnssFixOK() const     { return flags & 0x01; }
+    bool confirmedAvai() const { return flags2 & 0x20; }
+    bool confirmedDate() const { return flags2 & 0x40; }
+    bool confirmedTime() const { return flags2 & 0x80; }
+    bool invalidLlh() const    { return flags3 & 0x0001; }
+};
+
+struct UbxNavTimeLs
+{
+    static uint8_t constexpr msg_class = 0x01;
+    static uint8_t constexpr msg_id = 0x26;
+    static size_t constexpr len = 24;
+
+    uint32_t iTOW;
+    uint8_t version;
+    uint8_t srcOfCurrLs;
+    int8_t currLs;
+    uint8_t srcOfLsChange;
+    int8_t lsChange;
+    int32_t timeToLsEvent;
+    uint16_t dateOfLsGpsWn;
+    uint16_t dateOfLsGpsDn;
+    uint8_t valid;
+
+    template <typename U>
+    auto unpack(U u)
+    {
+        return u
+            >> iTOW
+            >> version
+            >> Skip<3>()
+            >> srcOfCurrLs
+            >> currLs
+            >> srcOfLsChange
+            >> lsChange
+            >> timeToLsEvent
+            >> dateOfLsGpsWn
+            >> dateOfLsGpsDn
+            >> Skip<3>()
+            >> valid;
+    }
+
+    template <typename P>
+    auto pack(P p) const
+    {
+        return p
+            << iTOW
+            << version
+            << Skip<3>()
+            << srcOfCurrLs
+            << currLs
+            << srcOfLsChange
+            << lsChange
+            << timeToLsEvent
+            << dateOfLsGpsWn
+            << dateOfLsGpsDn
+            << Skip<3>()
+            << valid;
+    }
+
+    bool validCurrLs() const        { return valid & 0x01; }
+    bool validTimeToLsEvent() const { return valid & 0x02; }
+};
+
+// Sent ahead of the time pulse it describes.
+struct UbxTimTp
+{
+    static uint8_t constexpr msg_class = 0x0d;
+    static uint8_t constexpr msg_id = 0x01;
+    static size_t constexpr len = 16;
+
+    uint32_t towMS;
+    uint32_t towSubMS;
+    int32_t qErr;           // Picoseconds
+    uint16_t week;
+    uint8_t flags;
+    uint8_t refInfo;
+
+    template <typename U>
+    auto unpack(U u)
+    {
+        return u
+            >> towMS
+            >> towSubMS
+            >> qErr
+            >> week
+            >> flags
+            >> refInfo;
+    }
+
+    template <typename P>
+    auto pack(P p) const
+    {
+        return p
+            << towMS
+            << towSubMS
+            << qErr
+            << week
+            << flags
+            << refInfo;
+    }
+
+    bool qErrInvalid() const { return flags & 0x10; }
+};
+
+// UBX-CFG-PRT for a UART. Polled by sending just the portID.
+struct UbxCfgPrt
+{
+    static uint8_t constexpr msg_class = 0x06;
+    static uint8_t constexpr msg_id = 0x00;
+    static size_t constexpr len = 20;
+    static size_t constexpr poll_len = 1;
+
+    uint8_t portID;
+    uint16_t txReady;
+    uint32_t mode;
+    uint32_t baudRate;
+    uint16_t inProtoMask;
+    uint16_t outProtoMask;
+    uint16_t flags;
+
+    template <typename U>
+    auto unpack(U u)
+    {
+        return u
+            >> portID
+            >> Skip<1>()
+            >> txReady
+            >> mode
+            >> baudRate
+            >> inProtoMask
+            >> outProtoMask
+            >> flags
+            >> Skip<2>();
+    }
+
+    template <typename P>
+    auto pack(P p) const
+    {
+        return p
+            << portID
+            << Skip<1>()
+            << txReady
+            << mode
+            << baudRate
+            << inProtoMask
+            << outProtoMask
+            << flags
+            << Skip<2>();
+    }
+};
+
+// UBX-CFG-NAV5. Only the parts of it named in mask are applied.
+struct UbxCfgNav5
+{
+    static uint8_t constexpr msg_class = 0x06;
+    static uint8_t constexpr msg_id = 0x24;
+    static size_t constexpr len = 36;
+
+    static uint16_t constexpr mask_dyn = 0x0001;
+    static uint8_t constexpr dyn_model_portable = 0;
+    static uint8_t constexpr dyn_model_stationary = 2;
+
+    uint16_t mask;
+    uint8_t dynModel;
+    uint8_t fixMode;
+    int32_t fixedAlt;
+    uint32_t fixedAltVar;
+    int8_t minElev;
+    uint8_t drLimit;
+    uint16_t pDop;
+    uint16_t tDop;
+    uint16_t pAcc;
+    uint16_t tAcc;
+    uint8_t staticHoldThresh;
+    uint8_t dgnssTimeout;
+    uint8_t cnoThreshNumSVs;
+    uint8_t cnoThresh;
+    uint16_t staticHoldMaxDist;
+    uint8_t utcStandard;
+
+    template <typename U>
+    auto unpack(U u)
+    {
+        return u
+            >> mask
+            >> dynModel
+            >> fixMode
+            >> fixedAlt
+            >> fixedAltVar
+            >> minElev
+            >> drLimit
+            >> pDop
+            >> tDop
+            >> pAcc
+            >> tAcc
+            >> staticHoldThresh
+            >> dgnssTimeout
+            >> cnoThreshNumSVs
+            >> cnoThresh
+            >> Skip<2>()
+            >> staticHoldMaxDist
+            >> utcStandard
+            >> Skip<5>();
+    }
+
+    template <typename P>
+    auto pack(P p) const
+    {
+        return p
+            << mask
+            << dynModel
+            << fixMode
+            << fixedAlt
+            << fixedAltVar
+            << minElev
+            << drLimit
+            << pDop
+            << tDop
+            << pAcc
+            << tAcc
+            << staticHoldThresh
+            << dgnssTimeout
+            << cnoThreshNumSVs
+            << cnoThresh
+            << Skip<2>()
+            << staticHoldMaxDist
+            << utcStandard
+            << Skip<5>();
+    }
+};
+
+// UBX-MGA-INI-POS_LLH: where the receiver is, to start it off. Not ACKed unless aiding ACKs are on.
+struct UbxMgaIniPosLlh
+{
+    static uint8_t constexpr msg_class = 0x13;
+    static uint8_t constexpr msg_id = 0x40;
+    static size_t constexpr len = 20;
+    static uint8_t constexpr type_pos_llh = 0x01;
+
+    uint8_t type;
+    uint8_t version;
+    int32_t lat;            // 1e-7 degrees
+    int32_t lon;            // 1e-7 degrees
+    int32_t alt;            // Centimeters above the ellipsoid
+    uint32_t posAcc;        // Centimeters
+
+    template <typename U>
+    auto unpack(U u)
+    {
+        return u
+            >> type
+            >> version
+            >> Skip<2>()
+            >> lat
+            >> lon
+            >> alt
+            >> posAcc;
+    }
+
+    template <typename P>
+    auto pack(P p) const
+    {
+        return p
+            << type
+            << version
+            << Skip<2>()
+            << lat
+            << lon
+            << alt
+            << posAcc;
+    }
+};
+
+template <typename Message>
+bool ubx_decode(UbxPayload const & payload, Message & message)
+{
+    if (payload.size() != Message::len)
+    {
+        return false;
+    }
+    message.unpack(Unpack<Message::len, 0, UbxPayload>(payload, LittleEndian())).finalize();
+    return true;
+}
+
+template <typename Message>
+void ubx_pack(Message const & message, uint8_t (&payload)[Message::len])
+{
+    message.pack(Pack<Message::len>(payload, LittleEndian())).finalize();
+}
+
+// A whole frame into out, which needs room for Message::len + ubx_overhead_len bytes. Returns its length.
+template <typename Message>
+size_t ubx_encode(Message const & message, uint8_t * const out)
+{
+    uint8_t payload[Message::len];
+    ubx_pack(message, payload);
+    return ubx_encode(Message::msg_class, Message::msg_id, payload, Message::len, out);
+}
+
+// One row of a receiver's table, from a message's class and ID to the member that handles it.
+template <typename Receiver>
+struct UbxHandler
+{
+    uint8_t msg_class;
+    uint8_t msg_id;
+    void (*handle)(Receiver & receiver, UbxPayload const & payload);
+};
+
+template <typename Receiver, typename Message, void (Receiver::*on_message)(Message const &)>
+constexpr UbxHandler<Receiver> ubx_handler()
+{
+    return {
+        Message::msg_class,
+        Message::msg_id,
+        [](Receiver & receiver, UbxPayload const & payload) {
+            Message message;
+            if (ubx_decode(payload, message))
+            {
+                (receiver.*on_message)(message);
+            }
+        },
+    };
+}
+
+template <typename Receiver, size_t n>
+constexpr bool ubx_handlers_unique(std::array<UbxHandler<Receiver>, n> const & handlers)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t j = 0; j < i; ++j)
+        {
+            if (handlers[i].msg_class == handlers[j].msg_class && handlers[i].msg_id == handlers[j].msg_id)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// False if no handler takes the frame's class and ID.
+template <typename Receiver, size_t n>
+bool ubx_dispatch(std::array<UbxHandler<Receiver>, n> const & handlers, Receiver & receiver, UbxFrame const & frame)
+{
+    for (auto const & handler : handlers)
+    {
+        if (handler.msg_class == frame.msg_class && handler.msg_id == frame.msg_id)
+        {
+            handler.handle(receiver, frame.payload);
+            return true;
+        }
+    }
+    return false;
+}
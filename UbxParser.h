@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "RingBuffer.h"
+
+bool ubx_parser_test();
+
+uint8_t constexpr ubx_sync1 = 181;
+uint8_t constexpr ubx_sync2 = 98;
+
+// Sync, class, ID, and length before the payload, and the checksum after it.
+size_t constexpr ubx_header_len = 6;
+size_t constexpr ubx_overhead_len = ubx_header_len + 2;
+
+using UbxPayload = RingBufferView<uint8_t>;
+
+// A whole frame into out, which needs room for len + ubx_overhead_len bytes. Returns its length.
+size_t ubx_encode(uint8_t msg_class, uint8_t msg_id, uint8_t const * payload, uint16_t len, uint8_t * out);
+
+struct UbxFrame
+{
+    uint8_t msg_class;
+    uint8_t msg_id;
+    // Still in the receive buffer. Valid until the next call to UbxParser::parse().
+    UbxPayload payload;
+};
+
+/*
+ * UBX frames, parsed in place in a receive buffer as bytes arrive.
+ *
+ * Each byte is looked at once as it comes in, and the checksum is kept up as it goes, so
+ * a complete frame is ready to use as soon as its last byte is in. Its payload is handed
+ * out as a view into the buffer rather than a copy. When a frame turns out to be bad,
+ * only its first sync byte is dropped, and parsing starts over from the byte after it,
+ * so a good frame that began inside the bad one is still found.
+ *
+ * A length longer than any message expected is taken as damage straight away, rather than
+ * waiting for the bytes it claims, which would hold up every good frame behind it.
+ */
+template <size_t buffer_len>
+class UbxParser
+{
+public:
+    explicit UbxParser(RingBuffer<uint8_t, buffer_len> & buffer, uint16_t max_payload_len = buffer_len - ubx_overhead_len):
+        _buffer(buffer),
+        _max_payload_len(std::min<size_t>(max_payload_len, buffer_len - ubx_overhead_len))
+    {
+    }
+
+    // Drops the frame returned last time, then parses what has arrived since.
+    bool parse(UbxFrame & frame)
+    {
+        _buffer.pop(_frame_len);
+        _frame_len = 0;
+
+        while (_parsed < _buffer.count())
+        {
+            UbxPayload const unparsed = _buffer.view(_parsed, _buffer.count() - _parsed);
+            for (std::span<uint8_t const> piece : {unparsed.first(), unparsed.second()})
+            {
+                for (size_t i = 0; i < piece.size(); ++i)
+                {
+                    if (_state == State::Payload)
+                    {
+                        // The bulk of the bytes, so take as many as are here in one go.
+                        size_t const n = std::min<size_t>(_payload_left, piece.size() - i);
+                        _checksum(piece.subspan(i, n));
+                        _parsed += n;
+                        _payload_left -= n;
+                        i += n - 1;
+                        if (_payload_left == 0)
+                        {
+                            _state = State::ChecksumA;
+                        }
+                        continue;
+                    }
+
+                    switch (_step(piece[i]))
+                    {
+                    case Step::More:
+                        break;
+                    case Step::Frame:
+                        _frame_len = _parsed;
+                        _restart();
+                        frame.msg_class = _msg_class;
+                        frame.msg_id = _msg_id;
+                        frame.payload = _buffer.view(ubx_header_len, _msg_len);
+                        return true;
+                    case Step::Bad:
+                        _buffer.pop(1);
+                        if (_parsed == 1)
+                        {
+                            // Not a sync byte. The next byte in the view is now the front.
+                            _restart();
+                            break;
+                        }
+                        // Start over from the byte after the bad frame's first.
+                        _restart();
+                        goto next_view;
+                    }
+                }
+            }
+            next_view:;
+        }
+        return false;
+    }
+
+    // Forget any partly parsed frame, for when the buffer has been cleared.
+    void reset()
+    {
+        _frame_len = 0;
+        _restart();
+    }
+
+    uint32_t checksum_errors() const { return _checksum_errors; }
+    uint32_t length_errors() const { return _length_errors; }
+    uint32_t skipped_bytes() const { return _skipped_bytes; }
+
+private:
+    RingBuffer<uint8_t, buffer_len> & _buffer;
+    uint16_t const _max_payload_len;
+
+    enum class State: uint8_t
+    {
+        Sync1,
+        Sync2,
+        Class,
+        Id,
+        Len1,
+        Len2,
+        Payload,
+        ChecksumA,
+        ChecksumB,
+    };
+
+    enum class Step: uint8_t
+    {
+        More,
+        Frame,
+        Bad,
+    };
+
+    State _state = State::Sync1;
+    // Bytes of the frame in progress, at the front of the buffer.
+    size_t _parsed = 0;
+    // Bytes of the frame last returned, still at the front of the buffer.
+    size_t _frame_len = 0;
+
+    uint8_t _msg_class = 0;
+    uint8_t _msg_id = 0;
+    uint16_t _msg_len = 0;
+    uint16_t _payload_left = 0;
+    uint8_t _ck_a = 0;
+    uint8_t _ck_b = 0;
+
+    uint32_t _checksum_errors = 0;
+    uint32_t _length_errors = 0;
+    uint32_t _skipped_bytes = 0;
+
+    void _restart()
+    {
+        _state = State::Sync1;
+        _parsed = 0;
+    }
+
+    inline void _checksum(uint8_t const byte)
+    {
+        _ck_a += byte;
+        _ck_b += _ck_a;
+    }
+
+    inline void _checksum(std::span<uint8_t const> const bytes)
+    {
+        uint8_t a = _ck_a;
+        uint8_t b = _ck_b;
+        for (uint8_t const byte : bytes)
+        {
+            a += byte;
+            b += a;
+        }
+        _ck_a = a;
+        _ck_b = b;
+    }
+
+    inline Step _step(uint8_t const byte)
+    {
+        ++_parsed;
+        switch (_state)
+        {
+        case State::Sync1:
+            if (byte != ubx_sync1)
+            {
+                ++_skipped_bytes;
+                return Step::Bad;
+            }
+            _state = State::Sync2;
+            return Step::More;
+        case State::Sync2:
+            if (byte != ubx_sync2)
+            {
+                ++_skipped_bytes;
+                return Step::Bad;
+            }
+            _ck_a = 0;
+            _ck_b = 0;
+            _state = State::Class;
+            return Step::More;
+        case State::Class:
+            _checksum(byte);
+            _msg_class = byte;
+            _state = State::Id;
+            return Step::More;
+        case State::Id:
+            _checksum(byte);
+            _msg_id = byte;
+            _state = State::Len1;
+            return Step::More;
+        case State::Len1:
+            _checksum(byte);
+            _msg_len = byte;
+            _state = State::Len2;
+            return Step::More;
+        case State::Len2:
+            _checksum(byte);
+            _msg_len |= static_cast<uint16_t>(byte) << 8;
+            // A frame that can't fit in the buffer would never finish, and one longer than
+            // anything expected would stall the good ones behind it until it did.
+            if (_msg_len > _max_payload_len)
+            {
+                ++_length_errors;
+                return Step::Bad;
+            }
+            _payload_left = _msg_len;
+            _state = _msg_len ? State::Payload : State::ChecksumA;
+            return Step::More;
+        case State::Payload:
+            // Taken in bulk by parse().
+            return Step::Bad;
+        case State::ChecksumA:
+            if (byte != _ck_a)
+            {
+                ++_checksum_errors;
+                return Step::Bad;
+            }
+            _state = State::ChecksumB;
+            return Step::More;
+        case State::ChecksumB:
+            if (byte != _ck_b)
+            {
+                ++_checksum_errors;
+                return Step::Bad;
+            }
+            return Step::Frame;
+        }
+        return Step::Bad;
+    }
+};
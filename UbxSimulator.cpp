@@ -0,0 +1,720 @@
+#include "UbxSimulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <optional>
+#include <vector>
+
+#include "util.h"
+
+namespace
+{
+    // How far the receiver's own clock wanders with no fix to steer it.
+    double constexpr free_run_drift = 2e-7;
+    double constexpr receiver_clock_period_ns = 1e9 / 48e6;
+    double constexpr ns_per_cycle = 8;
+
+    // Scatter in its fixes, in 1e-7 degrees and millimeters either way, and how sure it is of
+    // them. Less in the stationary model, which doesn't chase its own noise.
+    int32_t constexpr navigating_spread = 200;
+    int32_t constexpr stationary_spread = 20;
+    int32_t constexpr height_spread_mm = 3000;
+    uint32_t constexpr navigating_h_acc_mm = 3000;
+    uint32_t constexpr stationary_h_acc_mm = 1000;
+
+    uint32_t constexpr max_baud_rate = 921600;
+    int64_t constexpr secs_per_week = 7 * secs_per_day;
+}
+
+void UbxSimulator::Wire::send(uint64_t const now_us, uint32_t const baud_rate, uint8_t const * const data, size_t const len)
+{
+    uint64_t const byte_us = (10 * 1000000 + baud_rate - 1) / baud_rate;
+    for (size_t i = 0; i < len; ++i)
+    {
+        _free_us = std::max(now_us, _free_us) + byte_us;
+        _bytes.push_back({_free_us, data[i], baud_rate});
+    }
+}
+
+bool UbxSimulator::Wire::receive(uint64_t const now_us, uint32_t const baud_rate, uint8_t & byte)
+{
+    if (_bytes.empty() || _bytes.front().end_us > now_us)
+    {
+        return false;
+    }
+    WireByte const & front = _bytes.front();
+    byte = front.baud_rate == baud_rate ? front.byte : front.byte ^ 0xa5;
+    _bytes.pop_front();
+    return true;
+}
+
+UbxSimulator::UbxSimulator(UbxScenario const & scenario):
+    _scenario(scenario),
+    _lcg(scenario.seed),
+    _utc(scenario.start_utc),
+    _tai(scenario.start_utc),
+    _gps_minus_utc(scenario.gps_minus_utc),
+    _cycles_per_gps_second(cycles_per_second * (1 + scenario.chip_ppm * 1e-6))
+{
+    _tai.add_seconds(_gps_minus_utc + tai_minus_gps);
+    Ymdhms gps = _tai;
+    gps.add_seconds(-tai_minus_gps);
+    _gps_seconds_at_start = gps.subtract_and_return_non_leap_seconds(Ymdhms(1980, 1, 6, 0, 0, 0));
+
+    int64_t shift = 0;
+    for (auto const & leap : scenario.leap_seconds)
+    {
+        Ymdhms midnight = leap.day;
+        midnight.add_days(1);
+        int64_t const to_midnight = midnight.subtract_and_return_non_leap_seconds(scenario.start_utc);
+        _leap_events.push_back({static_cast<uint64_t>(to_midnight + shift - (leap.direction > 0 ? 0 : 1)),
+                                leap.direction});
+        shift += leap.direction;
+    }
+
+    // The one at the end of 2016, or if that's still to come, one long enough ago not to matter.
+    _last_leap_second = Ymdhms(2017, 1, 1, 0, 0, 0).subtract_and_return_non_leap_seconds(scenario.start_utc);
+    if (_last_leap_second > 0)
+    {
+        _last_leap_second = -secs_per_week;
+    }
+
+    // Powered up at some random point in the receiver's second.
+    _free_run_offset = _random(1000) / 1000.0 * _cycles_per_gps_second;
+    _schedule_next_edge();
+}
+
+uint32_t UbxSimulator::_random(uint32_t const n)
+{
+    _lcg = _lcg * 1664525 + 1013904223;
+    return (_lcg >> 8) % n;
+}
+
+bool UbxSimulator::_fix(uint64_t const second) const
+{
+    if (second < _scenario.cold_start_s)
+    {
+        return false;
+    }
+    for (auto const & outage : _scenario.outages)
+    {
+        if (second >= outage.first && second < outage.second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The receiver's clock drifts against GPS time, so this sweeps across its period.
+double UbxSimulator::_late_ns(uint64_t const second) const
+{
+    return (std::fmod(second * 0.1373, 1.0) - 0.5) * receiver_clock_period_ns;
+}
+
+void UbxSimulator::_schedule_next_edge()
+{
+    uint64_t const second = _second + 1;
+    double const whole = std::floor(_ideal_edge_fraction + _cycles_per_gps_second);
+    _ideal_edge_cycles += whole;
+    _ideal_edge_fraction += _cycles_per_gps_second - whole;
+
+    _next_fix = _fix(second);
+    if (_next_fix)
+    {
+        _free_run_offset = 0;
+    }
+    else
+    {
+        _free_run_offset += _cycles_per_gps_second * free_run_drift;
+    }
+
+    double const edge = _ideal_edge_fraction + _free_run_offset + _late_ns(second) / ns_per_cycle;
+    _next_edge_cycles = _ideal_edge_cycles + static_cast<int64_t>(std::floor(edge));
+    _next_edge_us = _next_edge_cycles / 125;
+
+    // CFG-TP5 has it pulse for 100 ms when locked and 50 ms when not. Until then, it only
+    // pulses when locked.
+    double const pulse_s = _next_fix ? 0.1 : (_tp5_set ? 0.05 : 0);
+    _next_pulse_cycles = std::lround(pulse_s * _cycles_per_gps_second);
+}
+
+void UbxSimulator::_next_second()
+{
+    ++_second;
+    _tai.add_seconds(1);
+
+    LeapEvent const * const leap = _next_leap < _leap_events.size() ? &_leap_events[_next_leap] : nullptr;
+    if (leap && leap->direction > 0 && _second == leap->second)
+    {
+        _utc.sec = 60;
+    }
+    else if (_utc.sec == 60)
+    {
+        _utc.sec = 59;
+        _utc.add_seconds(1);
+    }
+    else if (leap && leap->direction < 0 && _second == leap->second)
+    {
+        _utc.add_seconds(2);
+    }
+    else
+    {
+        _utc.add_seconds(1);
+    }
+
+    // UTC takes up its new offset from GPS time at the first midnight after the change.
+    if (leap && _second == leap->second + (leap->direction > 0 ? 1 : 0))
+    {
+        _gps_minus_utc += leap->direction;
+        _last_leap_second = leap->second;
+        ++_next_leap;
+        ++_leap_seconds_passed;
+    }
+
+    if (_next_fix)
+    {
+        _time_known = true;
+    }
+
+    if (_next_pulse_cycles != 0)
+    {
+        _edges.push_back({
+            _next_edge_us,
+            static_cast<uint32_t>(_next_edge_cycles - _last_edge_cycles),
+            _next_pulse_cycles,
+            _second,
+            _utc,
+            _tai,
+            _next_fix,
+        });
+        _last_edge_cycles = _next_edge_cycles;
+    }
+
+    uint64_t const edge_us = _next_edge_us;
+    bool const fix = _next_fix;
+    _schedule_next_edge();
+    _send_second(edge_us + receiver_latency_us, fix);
+}
+
+void UbxSimulator::advance(uint64_t const now_us)
+{
+    while (true)
+    {
+        _now_us = std::min(now_us, _next_edge_us);
+
+        if (_new_baud_rate != 0 && _now_us >= _new_baud_rate_us)
+        {
+            _baud_rate = _new_baud_rate;
+            _new_baud_rate = 0;
+        }
+
+        uint8_t byte;
+        while (_to_receiver.receive(_now_us, _baud_rate, byte))
+        {
+            if (!_rx_buf.full())
+            {
+                _rx_buf.push(byte);
+            }
+        }
+        UbxFrame frame;
+        while (_ubx_parser.parse(frame))
+        {
+            _on_frame(frame);
+        }
+
+        if (_next_edge_us > now_us)
+        {
+            break;
+        }
+        _next_second();
+    }
+}
+
+bool UbxSimulator::take_edge(Edge & edge)
+{
+    if (_edges.empty())
+    {
+        return false;
+    }
+    edge = _edges.front();
+    _edges.pop_front();
+    return true;
+}
+
+bool UbxSimulator::write(uint8_t const * const data, size_t const len)
+{
+    _to_receiver.send(_now_us, _host_baud_rate, data, len);
+    return true;
+}
+
+bool UbxSimulator::idle()
+{
+    return _now_us >= _to_receiver.free_us();
+}
+
+void UbxSimulator::set_baud_rate(uint32_t const baud_rate)
+{
+    _host_baud_rate = baud_rate;
+}
+
+size_t UbxSimulator::read(uint8_t * const data, size_t const max_n)
+{
+    size_t n = 0;
+    while (n < max_n && _to_host.receive(_now_us, _host_baud_rate, data[n]))
+    {
+        ++n;
+    }
+    return n;
+}
+
+void UbxSimulator::_send(uint64_t const at_us, uint8_t const * const data, size_t const len)
+{
+    uint8_t out[UbxNavPvt::len + ubx_overhead_len];
+    std::copy(data, data + len, out);
+    if (_scenario.corrupt_one_in)
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            if (_random(_scenario.corrupt_one_in) == 0)
+            {
+                out[i] ^= 1 << _random(8);
+                ++_bytes_corrupted;
+            }
+        }
+    }
+    _to_host.send(at_us, _baud_rate, out, len);
+}
+
+template <typename Message>
+void UbxSimulator::_send(uint64_t const at_us, Message const & message, std::optional<Damage> const damage)
+{
+    uint8_t frame[Message::len + ubx_overhead_len];
+    size_t const len = ubx_encode(message, frame);
+    if (damage)
+    {
+        frame[damage->at] ^= damage->bits;
+        ++_bytes_corrupted;
+    }
+    _send(at_us, frame, len);
+}
+
+std::optional<UbxSimulator::Damage> UbxSimulator::_damage(std::vector<uint64_t> const & seconds, size_t const at, uint8_t const bits) const
+{
+    if (std::find(seconds.begin(), seconds.end(), _second) == seconds.end())
+    {
+        return std::nullopt;
+    }
+    return Damage{at, bits};
+}
+
+void UbxSimulator::_ack(bool const ack, uint8_t const msg_id)
+{
+    uint8_t const payload[UbxAck::len] = {UbxCfgPrt::msg_class, msg_id};
+    uint8_t frame[UbxAck::len + ubx_overhead_len];
+    size_t const len = ubx_encode(UbxAck::msg_class, ack ? UbxAck::msg_id : UbxAck::msg_id_nak, payload, UbxAck::len, frame);
+    _send(_now_us, frame, len);
+    if (!ack)
+    {
+        ++_naks_sent;
+    }
+}
+
+void UbxSimulator::_on_frame(UbxFrame const & frame)
+{
+    uint8_t constexpr cfg_msg_id = 0x01;
+    uint8_t constexpr cfg_tp5_id = 0x31;
+
+    if (frame.msg_class == UbxMgaIniPosLlh::msg_class && frame.msg_id == UbxMgaIniPosLlh::msg_id)
+    {
+        UbxMgaIniPosLlh ini;
+        if (ubx_decode(frame.payload, ini) && ini.type == UbxMgaIniPosLlh::type_pos_llh)
+        {
+            _position_given = ini;
+            _position_was_given = true;
+        }
+        return;
+    }
+
+    if (frame.msg_class != UbxCfgPrt::msg_class)
+    {
+        return;
+    }
+
+    if (frame.msg_id == UbxCfgPrt::msg_id)
+    {
+        if (frame.payload.size() == UbxCfgPrt::poll_len)
+        {
+            UbxCfgPrt const prt = {frame.payload[0], 0, 0x000008c0, _baud_rate, 0x0003, uint16_t(_nmea_out ? 0x0003 : 0x0001), 0x0000};
+            _send(_now_us, prt);
+            _ack(true, frame.msg_id);
+            return;
+        }
+
+        UbxCfgPrt prt;
+        if (!ubx_decode(frame.payload, prt) || prt.baudRate > max_baud_rate)
+        {
+            _ack(false, frame.msg_id);
+            return;
+        }
+        // The ACK goes out at the old rate.
+        _ack(true, frame.msg_id);
+        _new_baud_rate = prt.baudRate;
+        _new_baud_rate_us = _to_host.free_us();
+        _nmea_out = prt.outProtoMask & 0x0002;
+        return;
+    }
+
+    if (_scenario.nak_one_in && _random(_scenario.nak_one_in) == 0)
+    {
+        _ack(false, frame.msg_id);
+        return;
+    }
+
+    if (frame.msg_id == cfg_msg_id && frame.payload.size() == 3)
+    {
+        uint8_t const msg_class = frame.payload[0];
+        uint8_t const msg_id = frame.payload[1];
+        bool const on = frame.payload[2] != 0;
+        if (msg_class == UbxNavPvt::msg_class && msg_id == UbxNavPvt::msg_id)
+        {
+            _nav_pvt_on = on;
+        }
+        else if (msg_class == UbxNavTimeLs::msg_class && msg_id == UbxNavTimeLs::msg_id)
+        {
+            _nav_time_ls_on = on;
+        }
+        else if (msg_class == UbxTimTp::msg_class && msg_id == UbxTimTp::msg_id)
+        {
+            _tim_tp_on = on;
+        }
+    }
+    else if (frame.msg_id == cfg_tp5_id)
+    {
+        _tp5_set = true;
+    }
+    else if (frame.msg_id == UbxCfgNav5::msg_id)
+    {
+        UbxCfgNav5 nav5;
+        if (!ubx_decode(frame.payload, nav5))
+        {
+            _ack(false, frame.msg_id);
+            return;
+        }
+        if (nav5.mask & UbxCfgNav5::mask_dyn)
+        {
+            _dyn_model = nav5.dynModel;
+        }
+    }
+    _ack(true, frame.msg_id);
+}
+
+// What the receiver says about the second that has just begun, and the next edge.
+void UbxSimulator::_send_second(uint64_t const at_us, bool const fix)
+{
+    int64_t const gps_seconds = _gps_seconds_at_start + _second;
+    uint32_t const tow_ms = gps_seconds % secs_per_week * 1000;
+
+    if (_nmea_out)
+    {
+        char sentence[48];
+        int len = snprintf(sentence, sizeof(sentence), "$GNZDA,%02d%02d%02d.00,%02d,%02d,%04d,00,00*",
+                           _utc.hour, _utc.min, _utc.sec, _utc.day, _utc.month, _utc.year);
+        uint8_t checksum = 0;
+        for (int i = 1; i < len - 1; ++i)
+        {
+            checksum ^= sentence[i];
+        }
+        len += snprintf(sentence + len, sizeof(sentence) - len, "%02X\r\n", checksum);
+        _send(at_us, reinterpret_cast<uint8_t const *>(sentence), len);
+    }
+
+    if (_nav_pvt_on)
+    {
+        UbxNavPvt pvt{};
+        pvt.iTOW = tow_ms;
+        pvt.year = _utc.year;
+        pvt.month = _utc.month;
+        pvt.day = _utc.day;
+        pvt.hour = _utc.hour;
+        pvt.min = _utc.min;
+        pvt.sec = _utc.sec;
+        // Once it has had a fix, it keeps time through an outage, but no longer vouches for it.
+        pvt.valid = _time_known ? 0x07 : 0x00;
+        pvt.flags2 = _time_known ? (0x20 | (fix ? 0xc0 : 0x00)) : 0x00;
+        pvt.fixType = fix ? 3 : 0;
+        pvt.flags = fix ? 0x01 : 0x00;
+        pvt.numSV = fix ? 9 : 0;
+        pvt.flags3 = fix ? 0x0000 : 0x0001;
+        pvt.tAcc = 0xffffffff;
+        pvt.hAcc = 0xffffffff;
+        if (fix)
+        {
+            bool const stationary = _dyn_model == UbxCfgNav5::dyn_model_stationary;
+            int32_t const spread = stationary ? stationary_spread : navigating_spread;
+            pvt.lat = lat + static_cast<int32_t>(_random(2 * spread + 1)) - spread;
+            pvt.lon = lon + static_cast<int32_t>(_random(2 * spread + 1)) - spread;
+            pvt.height = height + static_cast<int32_t>(_random(2 * height_spread_mm + 1)) - height_spread_mm;
+            pvt.hMSL = pvt.height;
+            pvt.hAcc = stationary ? stationary_h_acc_mm : navigating_h_acc_mm;
+            pvt.vAcc = 2 * pvt.hAcc;
+            pvt.tAcc = stationary ? 5 + _random(6) : 20 + _random(20);
+        }
+        _send(at_us, pvt, _damage(_scenario.damaged_nav_pvts, ubx_header_len, 0x01));
+    }
+
+    if (_nav_time_ls_on)
+    {
+        UbxNavTimeLs time_ls{};
+        time_ls.iTOW = tow_ms;
+        if (_time_known)
+        {
+            time_ls.srcOfCurrLs = 2;
+            time_ls.currLs = _gps_minus_utc;
+            time_ls.srcOfLsChange = 2;
+            if (_next_leap < _leap_events.size())
+            {
+                time_ls.lsChange = _leap_events[_next_leap].direction;
+                time_ls.timeToLsEvent = _leap_events[_next_leap].second - _second;
+            }
+            else
+            {
+                time_ls.timeToLsEvent = _last_leap_second - static_cast<int64_t>(_second);
+            }
+            time_ls.valid = 0x03;
+        }
+        _send(at_us, time_ls);
+    }
+
+    if (_tim_tp_on)
+    {
+        int64_t const next_gps_seconds = gps_seconds + 1;
+        UbxTimTp tim_tp{};
+        tim_tp.towMS = next_gps_seconds % secs_per_week * 1000;
+        tim_tp.qErr = std::lround(_late_ns(_second + 1) * 1000);
+        tim_tp.week = next_gps_seconds / secs_per_week;
+        tim_tp.flags = 0x01 | (_next_fix ? 0x00 : 0x10);
+        // The top byte of the length.
+        _send(at_us, tim_tp, _damage(_scenario.damaged_lengths, 5, 0x02));
+    }
+}
+
+namespace
+{
+    // The host end of the link, listening to the simulator without GpsUBlox in the way.
+    class Listener
+    {
+    public:
+        Listener(UbxSimulator & sim): _sim(sim) {}
+
+        void send(uint8_t const msg_class, uint8_t const msg_id, uint8_t const * const payload, uint16_t const len)
+        {
+            uint8_t frame[UbxCfgPrt::len + ubx_overhead_len];
+            _sim.write(frame, ubx_encode(msg_class, msg_id, payload, len, frame));
+        }
+
+        void enable(uint8_t const msg_class, uint8_t const msg_id)
+        {
+            uint8_t const payload[] = {msg_class, msg_id, 1};
+            send(0x06, 0x01, payload, sizeof(payload));
+        }
+
+        // Runs until the given time, in 10 ms steps, collecting what comes back.
+        void run_until(uint64_t const end_us)
+        {
+            while (now_us < end_us)
+            {
+                now_us += 10000;
+                _sim.advance(now_us);
+                UbxSimulator::Edge edge;
+                while (_sim.take_edge(edge))
+                {
+                    edges.push_back(edge);
+                }
+                fill_from(_sim, _buf);
+                UbxFrame frame;
+                while (_parser.parse(frame))
+                {
+                    UbxNavPvt pvt;
+                    UbxNavTimeLs time_ls;
+                    UbxTimTp tim_tp;
+                    if (frame.msg_class == UbxAck::msg_class)
+                    {
+                        frame.msg_id == UbxAck::msg_id ? ++acks : ++naks;
+                    }
+                    else if (ubx_decode(frame.payload, pvt) && frame.msg_id == UbxNavPvt::msg_id)
+                    {
+                        pvts.push_back(pvt);
+                    }
+                    else if (ubx_decode(frame.payload, time_ls) && frame.msg_id == UbxNavTimeLs::msg_id)
+                    {
+                        time_lss.push_back(time_ls);
+                    }
+                    else if (ubx_decode(frame.payload, tim_tp) && frame.msg_id == UbxTimTp::msg_id)
+                    {
+                        tim_tps.push_back(tim_tp);
+                    }
+                }
+            }
+        }
+
+        uint64_t now_us = 0;
+        uint32_t acks = 0;
+        uint32_t naks = 0;
+        std::vector<UbxSimulator::Edge> edges;
+        std::vector<UbxNavPvt> pvts;
+        std::vector<UbxNavTimeLs> time_lss;
+        std::vector<UbxTimTp> tim_tps;
+
+    private:
+        UbxSimulator & _sim;
+        static size_t constexpr _buf_len = 1000;
+        RingBuffer<uint8_t, _buf_len> _buf;
+        UbxParser<_buf_len> _parser{_buf};
+    };
+}
+
+bool ubx_simulator_test()
+{
+    // A cold start just before the leap second at the end of 2016.
+    {
+        UbxScenario scenario;
+        scenario.start_utc = Ymdhms(2016, 12, 31, 23, 58, 30);
+        scenario.cold_start_s = 10;
+        scenario.leap_seconds.push_back({Ymdhms(2016, 12, 31, 0, 0, 0), 1});
+        UbxSimulator sim(scenario);
+        Listener listener(sim);
+
+        listener.enable(UbxNavPvt::msg_class, UbxNavPvt::msg_id);
+        listener.enable(UbxNavTimeLs::msg_class, UbxNavTimeLs::msg_id);
+        listener.enable(UbxTimTp::msg_class, UbxTimTp::msg_id);
+        listener.run_until(120000000);
+        test_assert_unsigned_eq(listener.acks, 3u);
+        test_assert_unsigned_eq(sim.leap_seconds_passed(), 1u);
+
+        // No time until the first fix, and then every second in turn, through 23:59:60.
+        test_assert(listener.pvts.size() >= 118);
+        test_assert(!listener.pvts[0].validTime());
+        size_t seen_leap_second = 0;
+        UbxNavPvt const * prev = nullptr;
+        for (auto const & pvt : listener.pvts)
+        {
+            if (!pvt.validTime())
+            {
+                continue;
+            }
+            test_assert(pvt.gnssFixOK() && pvt.confirmedTime());
+            if (prev)
+            {
+                Ymdhms expected(prev->year, prev->month, prev->day, prev->hour, prev->min, prev->sec);
+                if (prev->sec == 59 && prev->min == 59 && prev->hour == 23 && prev->day == 31)
+                {
+                    expected.sec = 60;
+                    ++seen_leap_second;
+                }
+                else
+                {
+                    expected.sec = std::min<uint8_t>(expected.sec, 59);
+                    expected.add_seconds(1);
+                }
+                test_assert(Ymdhms(pvt.year, pvt.month, pvt.day, pvt.hour, pvt.min, pvt.sec) == expected);
+                // The GPS week turns over 17 seconds before UTC midnight.
+                test_assert_unsigned_eq(pvt.iTOW, (prev->iTOW + 1000) % 604800000);
+            }
+            prev = &pvt;
+        }
+        test_assert(seen_leap_second == 1);
+        test_assert(prev->year == 2017 && prev->min == 0);
+
+        // GPS minus UTC goes up once 23:59:60 is over.
+        bool counting_down = false;
+        for (auto const & time_ls : listener.time_lss)
+        {
+            if (!time_ls.validCurrLs())
+            {
+                continue;
+            }
+            if (time_ls.timeToLsEvent >= 0)
+            {
+                test_assert(time_ls.currLs == 17 && time_ls.lsChange == 1);
+                counting_down = true;
+            }
+            else
+            {
+                test_assert(time_ls.currLs == 18);
+            }
+        }
+        test_assert(counting_down);
+
+        // Each edge is as far from the last as the Pico's fast crystal says, once it's locked and
+        // corrected by the quantization errors TIM-TP gave for the two of them ahead of time.
+        double const cycles_per_gps_second = UbxSimulator::cycles_per_second * (1 + scenario.chip_ppm * 1e-6);
+        test_assert(listener.edges.size() >= 100);
+        test_assert(listener.edges[0].fix);
+        size_t checked = 0;
+        for (size_t i = 1; i < listener.edges.size(); ++i)
+        {
+            UbxSimulator::Edge const & edge = listener.edges[i];
+            test_assert(edge.second == listener.edges[i - 1].second + 1);
+            test_assert(edge.cycles_in_last_pulse == std::lround(0.1 * cycles_per_gps_second));
+
+            auto const q_err = [&](uint32_t const tow_ms) {
+                for (auto const & tim_tp : listener.tim_tps)
+                {
+                    if (tim_tp.towMS == tow_ms && !tim_tp.qErrInvalid())
+                    {
+                        return std::optional<int32_t>(tim_tp.qErr);
+                    }
+                }
+                return std::optional<int32_t>();
+            };
+            auto const pvt = std::find_if(listener.pvts.begin(), listener.pvts.end(), [&](UbxNavPvt const & p) {
+                return Ymdhms(p.year, p.month, p.day, p.hour, p.min, p.sec) == edge.utc;
+            });
+            if (pvt == listener.pvts.end())
+            {
+                continue;
+            }
+            auto const q_this = q_err(pvt->iTOW);
+            auto const q_prev = q_err(pvt->iTOW - 1000);
+            if (q_this && q_prev)
+            {
+                double const corrected = edge.cycles_in_last_second - (*q_this - *q_prev) / 8000.0;
+                test_assert(std::fabs(corrected - cycles_per_gps_second) <= 1.0);
+                ++checked;
+            }
+        }
+        test_assert(checked >= 90);
+    }
+
+    // Changing the baud rate, then a receiver that won't take any other configuration.
+    {
+        UbxScenario scenario;
+        scenario.nak_one_in = 1;
+        UbxSimulator sim(scenario);
+        Listener listener(sim);
+
+        uint8_t const poll[UbxCfgPrt::poll_len] = {1};
+        listener.send(UbxCfgPrt::msg_class, UbxCfgPrt::msg_id, poll, sizeof(poll));
+        listener.run_until(100000);
+        test_assert_unsigned_eq(listener.acks, 1u);
+
+        UbxCfgPrt const prt = {1, 0, 0x000008c0, 115200, 0x0001, 0x0001, 0x0000};
+        uint8_t payload[UbxCfgPrt::len];
+        ubx_pack(prt, payload);
+        listener.send(UbxCfgPrt::msg_class, UbxCfgPrt::msg_id, payload, sizeof(payload));
+        listener.run_until(200000);
+        test_assert_unsigned_eq(listener.acks, 2u);
+        test_assert_unsigned_eq(sim.baud_rate(), 115200u);
+
+        sim.set_baud_rate(115200);
+        listener.enable(UbxNavPvt::msg_class, UbxNavPvt::msg_id);
+        listener.run_until(5000000);
+        test_assert_unsigned_eq(listener.naks, 1u);
+        test_assert_unsigned_eq(sim.naks_sent(), 1u);
+        test_assert(listener.pvts.empty());
+    }
+
+    return true;
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "time.h"
+#include "ByteSource.h"
+#include "RingBuffer.h"
+#include "SerialPort.h"
+#include "UbxParser.h"
+#include "UbxMessages.h"
+
+bool ubx_simulator_test();
+
+// What happens to the simulated receiver, and when. Seconds count from the start of the simulation.
+struct UbxScenario
+{
+    // A leap second at the end of the given UTC day: 23:59:60 if direction is 1, or no 23:59:59 if -1.
+    struct LeapSecond
+    {
+        Ymdhms day;
+        int8_t direction;
+    };
+
+    Ymdhms start_utc{2016, 12, 31, 23, 30, 0};
+    int8_t gps_minus_utc = 17;
+
+    // From power-up to the first fix.
+    uint32_t cold_start_s = 30;
+
+    // Times with no fix, each from its first second up to its second.
+    std::vector<std::pair<uint64_t, uint64_t>> outages;
+
+    // In order. Announced by NAV-TIMELS from the first fix on.
+    std::vector<LeapSecond> leap_seconds;
+
+    // Of the bytes the receiver sends, one in this many comes out damaged. None if 0.
+    uint32_t corrupt_one_in = 0;
+
+    // Seconds whose TIM-TP comes out with its length 512 bytes too long, as it would with a bit
+    // of its top byte flipped.
+    std::vector<uint64_t> damaged_lengths;
+    // Seconds whose NAV-PVT comes out with a damaged byte in its payload.
+    std::vector<uint64_t> damaged_nav_pvts;
+
+    // Of the CFG messages other than CFG-PRT, one in this many is NAKed. None if 0.
+    uint32_t nak_one_in = 0;
+
+    // How fast the Pico's crystal runs, in parts per million.
+    double chip_ppm = 12.5;
+
+    uint32_t seed = 1;
+};
+
+/*
+ * A stand-in for the ZOE-M8Q at the far end of the GPS UART, and the PPS edges it makes.
+ *
+ * It starts at 9600 baud putting out NMEA, answers CFG-PRT polls and changes, ACKs or NAKs
+ * other CFG messages, and once they're turned on with CFG-MSG, sends NAV-PVT, NAV-TIMELS, and
+ * TIM-TP each second. Its fixes scatter less once CFG-NAV5 puts it in the stationary model.
+ * Bytes take as long to cross the wire as they would at the baud rate, and come out garbled if
+ * the two ends disagree about it.
+ *
+ * Time is the Pico's, in microseconds, and only moves when advance() is called, so it runs
+ * as fast as the code using it does.
+ */
+class UbxSimulator: public SerialPort, public ByteSource
+{
+public:
+    // What the PPS PIO program counts at, and what the receiver knows about each second.
+    static uint32_t constexpr cycles_per_second = 125000000;
+    static uint32_t constexpr receiver_latency_us = 20000;
+
+    // Where the antenna is: somewhere in Seattle, in 1e-7 degrees and millimeters.
+    static int32_t constexpr lat = 476062000;
+    static int32_t constexpr lon = -1223321000;
+    static int32_t constexpr height = 60000;
+
+    struct Edge
+    {
+        uint64_t us;
+        uint32_t cycles_in_last_second;
+        uint32_t cycles_in_last_pulse;
+        // The second this edge began.
+        uint64_t second;
+        Ymdhms utc;
+        Ymdhms tai;
+        bool fix;
+    };
+
+    explicit UbxSimulator(UbxScenario const & scenario);
+
+    // Runs the receiver up to now_us.
+    void advance(uint64_t now_us);
+
+    // When the next PPS edge comes, if it puts one out.
+    uint64_t next_edge_us() const { return _next_edge_us; }
+
+    // PPS edges advance() passed, oldest first.
+    bool take_edge(Edge & edge);
+
+    bool write(uint8_t const * data, size_t len) override;
+    bool idle() override;
+    void set_baud_rate(uint32_t baud_rate) override;
+
+    size_t read(uint8_t * data, size_t max_n) override;
+
+    uint32_t baud_rate() const { return _baud_rate; }
+    uint32_t leap_seconds_passed() const { return _leap_seconds_passed; }
+    uint64_t bytes_corrupted() const { return _bytes_corrupted; }
+    uint32_t naks_sent() const { return _naks_sent; }
+    uint8_t dyn_model() const { return _dyn_model; }
+
+    // From the last MGA-INI-POS_LLH, if there was one.
+    bool position_given(UbxMgaIniPosLlh & position) const
+    {
+        position = _position_given;
+        return _position_was_given;
+    }
+
+private:
+    struct WireByte
+    {
+        uint64_t end_us;
+        uint8_t byte;
+        uint32_t baud_rate;
+    };
+
+    // One direction of the UART.
+    class Wire
+    {
+    public:
+        void send(uint64_t now_us, uint32_t baud_rate, uint8_t const * data, size_t len);
+        uint64_t free_us() const { return _free_us; }
+
+        // The next byte that has crossed by now_us, as heard at baud_rate.
+        bool receive(uint64_t now_us, uint32_t baud_rate, uint8_t & byte);
+
+    private:
+        std::deque<WireByte> _bytes;
+        uint64_t _free_us = 0;
+    };
+
+    UbxScenario const _scenario;
+    uint32_t _lcg;
+    uint32_t _random(uint32_t n);
+
+    uint64_t _now_us = 0;
+
+    // Seconds since the start, and what they are called.
+    uint64_t _second = 0;
+    int64_t _gps_seconds_at_start;
+    Ymdhms _utc;
+    Ymdhms _tai;
+    int8_t _gps_minus_utc;
+    bool _time_known = false;
+
+    struct LeapEvent
+    {
+        // The second that is 23:59:60, or the one that would have been 23:59:59.
+        uint64_t second;
+        int8_t direction;
+    };
+    std::vector<LeapEvent> _leap_events;
+    size_t _next_leap = 0;
+    // The last leap second before the start, for NAV-TIMELS to count from.
+    int64_t _last_leap_second;
+    uint32_t _leap_seconds_passed = 0;
+
+    bool _fix(uint64_t second) const;
+    double _late_ns(uint64_t second) const;
+    void _next_second();
+
+    // Where in the Pico's count the edges of the receiver's pulses fall, in cycles. With no
+    // fix, its pulses run off its own clock, and drift away from where GPS time would have them.
+    double const _cycles_per_gps_second;
+    int64_t _ideal_edge_cycles = cycles_per_second / 2;
+    double _ideal_edge_fraction = 0;
+    double _free_run_offset;
+    int64_t _last_edge_cycles = 0;
+    std::deque<Edge> _edges;
+
+    // The second to come.
+    bool _next_fix;
+    int64_t _next_edge_cycles;
+    uint32_t _next_pulse_cycles;
+    uint64_t _next_edge_us;
+    void _schedule_next_edge();
+
+    // Configuration.
+    uint32_t _baud_rate = 9600;
+    uint32_t _new_baud_rate = 0;
+    uint64_t _new_baud_rate_us = 0;
+    bool _nmea_out = true;
+    bool _nav_pvt_on = false;
+    bool _nav_time_ls_on = false;
+    bool _tim_tp_on = false;
+    bool _tp5_set = false;
+    uint8_t _dyn_model = UbxCfgNav5::dyn_model_portable;
+    UbxMgaIniPosLlh _position_given = {};
+    bool _position_was_given = false;
+    uint32_t _naks_sent = 0;
+
+    uint32_t _host_baud_rate = 9600;
+    Wire _to_receiver;
+    Wire _to_host;
+    uint64_t _bytes_corrupted = 0;
+
+    static size_t constexpr _rx_buf_len = 200;
+    RingBuffer<uint8_t, _rx_buf_len> _rx_buf;
+    UbxParser<_rx_buf_len> _ubx_parser{_rx_buf};
+
+    void _send(uint64_t at_us, uint8_t const * data, size_t len);
+    // Bits to flip in one byte of a frame.
+    struct Damage
+    {
+        size_t at;
+        uint8_t bits;
+    };
+    template <typename Message>
+    void _send(uint64_t at_us, Message const & message, std::optional<Damage> damage = std::nullopt);
+    // The damage, if this second is one of seconds.
+    std::optional<Damage> _damage(std::vector<uint64_t> const & seconds, size_t at, uint8_t bits) const;
+    void _ack(bool ack, uint8_t msg_id);
+    void _on_frame(UbxFrame const & frame);
+    void _send_second(uint64_t at_us, bool fix);
+};
@@ -1,160 +1,375 @@
+#ifndef HOST_BUILD
 #include "hardware/pwm.h"
+#include "hardware/clocks.h"
+#endif
+
+#include <cstring>
 
 #include "Wwvb.h"
 #include "iana_time_zones.h"
+#include "util.h"
+
+namespace
+{
+    std::shared_ptr<TimeRepresentation> find_zone(char const * name)
+    {
+        if (!name)
+        {
+            return nullptr;
+        }
+        for (auto const & zone : get_iana_timezones())
+        {
+            if (std::get<std::string>(zone) == name)
+            {
+                return std::get<std::shared_ptr<TimeRepresentation>>(zone);
+            }
+        }
+        return nullptr;
+    }
+}
 
 Wwvb::Wwvb(uint carrier_pin, uint reduce_pin):
     _reduce(reduce_pin)
 {
     _reduce.off();
 
+#ifndef HOST_BUILD
     gpio_set_function(carrier_pin, GPIO_FUNC_PWM);
 
     _carrier_pwm_slice = pwm_gpio_to_slice_num(carrier_pin);
     _carrier_pwm_channel = pwm_gpio_to_channel(carrier_pin);
-    pwm_set_wrap(_carrier_pwm_slice, _pwm_count_wrap);
     pwm_set_chan_level(_carrier_pwm_slice, _carrier_pwm_channel, _pwm_count_off);
-    pwm_set_enabled(_carrier_pwm_slice, true);
+#else
+    (void)carrier_pin;
+#endif
+
+    set_standard(time_code_wwvb);
+}
 
-    for (auto const & zone : get_iana_timezones())
+void Wwvb::set_standard(TimeCodeStandard const & standard)
+{
+    if (_standard == &standard)
     {
-        if (std::get<std::string>(zone) == "America/Los_Angeles")
-        {
-            _pacific_time_zone = std::get<decltype(_pacific_time_zone)>(zone);
-        }
+        return;
     }
+    _standard = &standard;
+    _zone = find_zone(standard.zone);
+    _dst_zone = find_zone(standard.dst_zone);
+    _frame_valid = false;
+    _set_phase(false);
+
+#ifndef HOST_BUILD
+    uint8_t div_int;
+    uint8_t div_frac;
+    uint16_t wrap;
+    time_code_pwm_setup(standard.carrier_hz, clock_get_hz(clk_sys), div_int, div_frac, wrap);
+    _pwm_count_half = (static_cast<uint32_t>(wrap) + 1) / 2;
+
+    pwm_set_enabled(_carrier_pwm_slice, false);
+    pwm_set_clkdiv_int_frac(_carrier_pwm_slice, div_int, div_frac);
+    pwm_set_wrap(_carrier_pwm_slice, wrap);
+    pwm_set_counter(_carrier_pwm_slice, 0);
+    pwm_set_enabled(_carrier_pwm_slice, true);
+#endif
+
+    set_carrier(_carrier_enabled);
 }
 
 void Wwvb::set_carrier(bool enabled)
 {
+    _carrier_enabled = enabled;
+#ifndef HOST_BUILD
     pwm_set_chan_level(
         _carrier_pwm_slice,
         _carrier_pwm_channel,
         enabled? _pwm_count_half : _pwm_count_off);
+#endif
 }
 
-namespace
+void Wwvb::_set_phase(bool inverted)
 {
-    uint64_t convert_whole_portion_to_bit(uint16_t & value, uint16_t portion, uint8_t bit)
+    _phase_inverted = inverted;
+#ifndef HOST_BUILD
+    pwm_set_output_polarity(
+        _carrier_pwm_slice,
+        inverted && _carrier_pwm_channel == PWM_CHAN_A,
+        inverted && _carrier_pwm_channel == PWM_CHAN_B);
+#endif
+}
+
+uint32_t Wwvb::top_of_second(TopOfSecond const & tos)
+{
+    if (!tos.utc_ymdhms_valid)
     {
-        if (value < portion)
+        _set_phase(false);
+        return _never;
+    }
+
+    Ymdhms const & utc = tos.utc_ymdhms;
+
+    Ymdhms utc_minute = utc;
+    utc_minute.sec = 0;
+    if (!_frame_valid || utc_minute != _frame_utc_minute)
+    {
+        if (!time_code_minute(*_standard, tos, _zone.get(), _dst_zone.get(), _minute))
         {
-            return 0;
+            _set_phase(false);
+            return _never;
         }
-        value -= portion;
-        return static_cast<uint64_t>(1) << bit;
+        time_code_frame(*_standard, _minute, _frame);
+        _phase_frame = _standard->wwvb_phase ? wwvb_phase_frame(_minute) : 0;
+        _frame_utc_minute = utc_minute;
+        _frame_valid = true;
     }
+
+    // Phase changes at the top of the second; the leap second, past the frame, holds it.
+    _set_phase(utc.sec < secs_per_min && ((_phase_frame >> utc.sec) & 1));
+
+    TimeCodeSymbol const symbol = time_code_symbol(*_standard, _minute, _frame, utc.sec);
+    _schedule = &_standard->schedules[static_cast<size_t>(symbol)];
+    _next_change = 0;
+
+    return change();
 }
 
-uint32_t Wwvb::top_of_second(TopOfSecond const & tos)
+uint32_t Wwvb::change()
 {
-    if (!tos.utc_ymdhms_valid)
+    if (!_schedule || _next_change >= _schedule->num_changes)
     {
-        return 100000000; // Never
+        return _never;
     }
 
-    _reduce.on();
-
-    Ymdhms const & utc = tos.utc_ymdhms;
+    _reduce.set(_schedule->changes[_next_change].reduced);
+    ++_next_change;
 
-    uint64_t markers = 0;
-    markers |= static_cast<uint64_t>(1) << 0;
-    markers |= static_cast<uint64_t>(1) << 9;
-    markers |= static_cast<uint64_t>(1) << 19;
-    markers |= static_cast<uint64_t>(1) << 29;
-    markers |= static_cast<uint64_t>(1) << 39;
-    markers |= static_cast<uint64_t>(1) << 49;
-    markers |= static_cast<uint64_t>(1) << 59;
-    markers |= static_cast<uint64_t>(1) << 60;
-
-    bool mark_bit = (markers   >> utc.sec) & 1;
-    if (mark_bit)
+    if (_next_change >= _schedule->num_changes)
     {
-        return 800000;
+        return _never;
     }
+    return _schedule->changes[_next_change].at_ms * 1000;
+}
 
-    uint64_t time_code = 0;
-
-    uint16_t min = utc.min;
-    time_code |= convert_whole_portion_to_bit(min, 40, 1);
-    time_code |= convert_whole_portion_to_bit(min, 20, 2);
-    time_code |= convert_whole_portion_to_bit(min, 10, 3);
-    time_code |= convert_whole_portion_to_bit(min,  8, 5);
-    time_code |= convert_whole_portion_to_bit(min,  4, 6);
-    time_code |= convert_whole_portion_to_bit(min,  2, 7);
-    time_code |= convert_whole_portion_to_bit(min,  1, 8);
-
-    uint16_t hour = utc.hour;
-    time_code |= convert_whole_portion_to_bit(hour, 20, 12);
-    time_code |= convert_whole_portion_to_bit(hour, 10, 13);
-    time_code |= convert_whole_portion_to_bit(hour,  8, 15);
-    time_code |= convert_whole_portion_to_bit(hour,  4, 16);
-    time_code |= convert_whole_portion_to_bit(hour,  2, 17);
-    time_code |= convert_whole_portion_to_bit(hour,  1, 18);
-
-    uint16_t day_of_year = utc.day_of_year();
-    time_code |= convert_whole_portion_to_bit(day_of_year, 200, 22);
-    time_code |= convert_whole_portion_to_bit(day_of_year, 100, 23);
-    time_code |= convert_whole_portion_to_bit(day_of_year,  80, 25);
-    time_code |= convert_whole_portion_to_bit(day_of_year,  40, 26);
-    time_code |= convert_whole_portion_to_bit(day_of_year,  20, 27);
-    time_code |= convert_whole_portion_to_bit(day_of_year,  10, 28);
-    time_code |= convert_whole_portion_to_bit(day_of_year,   8, 30);
-    time_code |= convert_whole_portion_to_bit(day_of_year,   4, 31);
-    time_code |= convert_whole_portion_to_bit(day_of_year,   2, 32);
-    time_code |= convert_whole_portion_to_bit(day_of_year,   1, 33);
-
-    // We have no way to get DUT1
-
-    uint16_t year = utc.year % 100;
-    time_code |= convert_whole_portion_to_bit(year, 80, 45);
-    time_code |= convert_whole_portion_to_bit(year, 40, 46);
-    time_code |= convert_whole_portion_to_bit(year, 20, 47);
-    time_code |= convert_whole_portion_to_bit(year, 10, 48);
-    time_code |= convert_whole_portion_to_bit(year,  8, 50);
-    time_code |= convert_whole_portion_to_bit(year,  4, 51);
-    time_code |= convert_whole_portion_to_bit(year,  2, 52);
-    time_code |= convert_whole_portion_to_bit(year,  1, 53);
-
-    if (utc.is_leap_year())
+#ifdef HOST_BUILD
+namespace
+{
+    uint64_t convert_whole_portion_to_bit(uint16_t & value, uint16_t portion, uint8_t bit)
     {
-        time_code |= static_cast<uint64_t>(1) << 55;
+        if (value < portion)
+        {
+            return 0;
+        }
+        value -= portion;
+        return static_cast<uint64_t>(1) << bit;
     }
 
-    if (tos.next_leap_second_time_until < 27 * secs_per_day &&
-        tos.next_leap_second_time_until >= 0)
+    // The encoder as it was before frames were cached, building the whole time code every second.
+    uint32_t reference_top_of_second(TopOfSecond const & tos, TimeRepresentation const & pacific_time_zone)
     {
-        time_code |= static_cast<uint64_t>(1) << 56;
+        if (!tos.utc_ymdhms_valid)
+        {
+            return 100000000;
+        }
+
+        Ymdhms const & utc = tos.utc_ymdhms;
+
+        uint64_t markers = 0;
+        markers |= static_cast<uint64_t>(1) << 0;
+        markers |= static_cast<uint64_t>(1) << 9;
+        markers |= static_cast<uint64_t>(1) << 19;
+        markers |= static_cast<uint64_t>(1) << 29;
+        markers |= static_cast<uint64_t>(1) << 39;
+        markers |= static_cast<uint64_t>(1) << 49;
+        markers |= static_cast<uint64_t>(1) << 59;
+        markers |= static_cast<uint64_t>(1) << 60;
+
+        if ((markers >> utc.sec) & 1)
+        {
+            return 800000;
+        }
+
+        uint64_t time_code = 0;
+
+        uint16_t min = utc.min;
+        time_code |= convert_whole_portion_to_bit(min, 40, 1);
+        time_code |= convert_whole_portion_to_bit(min, 20, 2);
+        time_code |= convert_whole_portion_to_bit(min, 10, 3);
+        time_code |= convert_whole_portion_to_bit(min,  8, 5);
+        time_code |= convert_whole_portion_to_bit(min,  4, 6);
+        time_code |= convert_whole_portion_to_bit(min,  2, 7);
+        time_code |= convert_whole_portion_to_bit(min,  1, 8);
+
+        uint16_t hour = utc.hour;
+        time_code |= convert_whole_portion_to_bit(hour, 20, 12);
+        time_code |= convert_whole_portion_to_bit(hour, 10, 13);
+        time_code |= convert_whole_portion_to_bit(hour,  8, 15);
+        time_code |= convert_whole_portion_to_bit(hour,  4, 16);
+        time_code |= convert_whole_portion_to_bit(hour,  2, 17);
+        time_code |= convert_whole_portion_to_bit(hour,  1, 18);
+
+        uint16_t day_of_year = utc.day_of_year();
+        time_code |= convert_whole_portion_to_bit(day_of_year, 200, 22);
+        time_code |= convert_whole_portion_to_bit(day_of_year, 100, 23);
+        time_code |= convert_whole_portion_to_bit(day_of_year,  80, 25);
+        time_code |= convert_whole_portion_to_bit(day_of_year,  40, 26);
+        time_code |= convert_whole_portion_to_bit(day_of_year,  20, 27);
+        time_code |= convert_whole_portion_to_bit(day_of_year,  10, 28);
+        time_code |= convert_whole_portion_to_bit(day_of_year,   8, 30);
+        time_code |= convert_whole_portion_to_bit(day_of_year,   4, 31);
+        time_code |= convert_whole_portion_to_bit(day_of_year,   2, 32);
+        time_code |= convert_whole_portion_to_bit(day_of_year,   1, 33);
+
+        uint16_t year = utc.year % 100;
+        time_code |= convert_whole_portion_to_bit(year, 80, 45);
+        time_code |= convert_whole_portion_to_bit(year, 40, 46);
+        time_code |= convert_whole_portion_to_bit(year, 20, 47);
+        time_code |= convert_whole_portion_to_bit(year, 10, 48);
+        time_code |= convert_whole_portion_to_bit(year,  8, 50);
+        time_code |= convert_whole_portion_to_bit(year,  4, 51);
+        time_code |= convert_whole_portion_to_bit(year,  2, 52);
+        time_code |= convert_whole_portion_to_bit(year,  1, 53);
+
+        if (utc.is_leap_year())
+        {
+            time_code |= static_cast<uint64_t>(1) << 55;
+        }
+
+        if (tos.next_leap_second_time_until < 27 * secs_per_day &&
+            tos.next_leap_second_time_until >= 0)
+        {
+            time_code |= static_cast<uint64_t>(1) << 56;
+        }
+
+        Ymdhms start_today = utc;
+        start_today.hour = 0;
+        start_today.min = 0;
+        start_today.sec = 0;
+        Ymdhms start_tomorrow = start_today;
+        start_tomorrow.add_days(1);
+
+        if (pacific_time_zone.is_dst(start_tomorrow))
+        {
+            time_code |= static_cast<uint64_t>(1) << 57;
+        }
+        if (pacific_time_zone.is_dst(start_today))
+        {
+            time_code |= static_cast<uint64_t>(1) << 58;
+        }
+
+        if ((time_code >> utc.sec) & 1)
+        {
+            return 500000;
+        }
+        return 200000;
     }
+}
+#endif
 
-    Ymdhms start_today = utc;
-    start_today.hour = 0;
-    start_today.min = 0;
-    start_today.sec = 0;
-    Ymdhms start_tomorrow = start_today;
-    start_tomorrow.add_days(1);
+bool Wwvb::unit_test()
+{
+#ifdef HOST_BUILD
+    Wwvb wwvb(0, 0);
+    test_assert(wwvb._dst_zone);
 
-    bool const dst_start_today = _pacific_time_zone->is_dst(start_today);
-    bool const dst_start_tomorrow = _pacific_time_zone->is_dst(start_tomorrow);
+    struct TestDays
+    {
+        Ymdhms first_day;
+        int32_t n_days;
+
+        // From the start of the first day. Negative when it's already passed.
+        int32_t leap_second_time_until;
+    };
+
+    TestDays const test_days[] = {
+        // The 27 day warning comes on between these two days.
+        {Ymdhms(2016, 12,  4, 0, 0, 0), 2, 27 * secs_per_day + secs_per_day - 1},
+        // ...and partway through a minute, if the receiver counts that way.
+        {Ymdhms(2016,  6,  2, 0, 0, 0), 1, 27 * secs_per_day + 30},
+        // A 61 second minute at the end of the day.
+        {Ymdhms(2016, 12, 31, 0, 0, 0), 2, secs_per_day - 1},
+        // February 29th, and the end of a leap year.
+        {Ymdhms(2024,  2, 29, 0, 0, 0), 1, -100000},
+        {Ymdhms(2024, 12, 31, 0, 0, 0), 2, -100000},
+        // Daylight saving time starting and ending.
+        {Ymdhms(2024,  3,  9, 0, 0, 0), 3, -100000},
+        {Ymdhms(2024, 11,  2, 0, 0, 0), 3, -100000},
+        {Ymdhms(2023,  6, 15, 0, 0, 0), 1, -100000},
+    };
 
-    if (dst_start_tomorrow)
+    for (auto const & test : test_days)
     {
-        time_code |= static_cast<uint64_t>(1) << 57;
+        TopOfSecond tos;
+        Ymdhms day = test.first_day;
+        int32_t leap_second_time_until = test.leap_second_time_until;
+
+        for (int32_t i = 0; i < test.n_days; ++i)
+        {
+            bool const leap_second_today =
+                leap_second_time_until >= 0 && leap_second_time_until < secs_per_day;
+
+            for (uint8_t hour = 0; hour < hour_per_day; ++hour)
+            {
+                for (uint8_t min = 0; min < min_per_hour; ++min)
+                {
+                    bool const leap_second_this_minute = leap_second_today && hour == 23 && min == 59;
+                    uint8_t const secs_this_minute = leap_second_this_minute ? 61 : 60;
+                    for (uint8_t sec = 0; sec < secs_this_minute; ++sec)
+                    {
+                        tos.set_utc_ymdhms(day.year, day.month, day.day, hour, min, sec);
+                        tos.set_next_leap_second(leap_second_time_until, 1);
+                        --leap_second_time_until;
+
+                        uint32_t const expected = reference_top_of_second(tos, *wwvb._dst_zone);
+                        uint32_t const actual = wwvb.top_of_second(tos);
+                        if (actual != expected)
+                        {
+                            tos.utc_ymdhms.print();
+                            printf("\n");
+                        }
+                        test_assert_unsigned_eq(actual, expected);
+                    }
+                }
+            }
+
+            day.add_days(1);
+        }
     }
-    if (dst_start_today)
+
+    // Starting partway through a minute builds the same frame.
     {
-        time_code |= static_cast<uint64_t>(1) << 58;
+        TopOfSecond tos;
+        tos.set_next_leap_second(-100000, 1);
+        for (uint8_t sec = 37; sec < 60; ++sec)
+        {
+            Wwvb late(0, 0);
+            tos.set_utc_ymdhms(2024, 7, 4, 12, 34, sec);
+            test_assert_unsigned_eq(late.top_of_second(tos), reference_top_of_second(tos, *wwvb._dst_zone));
+        }
     }
 
-    bool data_bit = (time_code >> utc.sec) & 1;
-    if (data_bit)
+    // With phase modulation the amplitude code is unchanged, and the carrier follows the phase frame.
     {
-        return 500000;
+        Wwvb phase(0, 0);
+        phase.set_standard(time_code_wwvb_phase);
+        TopOfSecond tos;
+        tos.set_next_leap_second(-100000, 1);
+        uint64_t inverted = 0;
+        for (uint8_t sec = 0; sec < 60; ++sec)
+        {
+            tos.set_utc_ymdhms(2024, 9, 14, 18, 42, sec);
+            test_assert_unsigned_eq(phase.top_of_second(tos), reference_top_of_second(tos, *wwvb._dst_zone));
+            inverted |= static_cast<uint64_t>(phase._phase_inverted) << sec;
+        }
+        char str[61];
+        wwvb_phase_frame_string(inverted, str);
+        test_assert(strcmp(str, "001110110100000111000110001100010001101110000100000110001110") == 0);
+
+        phase.set_standard(time_code_wwvb);
+        test_assert(!phase._phase_inverted);
+        tos.set_utc_ymdhms(2024, 9, 14, 18, 43, 2);
+        phase.top_of_second(tos);
+        test_assert(!phase._phase_inverted);
     }
-    return 200000;
-}
+#endif
 
-void Wwvb::raise_power()
-{
-    _reduce.off();
+    return true;
 }
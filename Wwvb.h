@@ -2,29 +2,61 @@
 
 #include <memory>
 
+#ifdef HOST_BUILD
+  using uint = unsigned int;
+#endif
+
 #include "time.h"
 #include "Gpio.h"
+#include "TimeCode.h"
+#include "WwvbPhase.h"
 
 class Wwvb
 {
 public:
     Wwvb(uint carrier_pin, uint reduce_pin);
 
+    // WWVB until told otherwise.
+    void set_standard(TimeCodeStandard const & standard);
+
     void set_carrier(bool enabled);
 
-    // Returns the time within the second in microseconds for the raise_power() callback.
+    // Both return the time within the second in microseconds for the next change() callback.
     uint32_t top_of_second(TopOfSecond const & tos);
-    void raise_power();
+    uint32_t change();
+
+    // What the carrier is doing now, as a receiver would see it.
+    bool carrier_reduced() const { return _reduce.get(); }
+    bool carrier_phase_inverted() const { return _phase_inverted; }
+
+    static bool unit_test();
 
 private:
     GpioOut _reduce;
     uint _carrier_pwm_slice;
     uint _carrier_pwm_channel;
+    bool _carrier_enabled = false;
 
-    float static constexpr _pwm_freq = 60000;
-    uint16_t static constexpr _pwm_count_wrap = 125000000 / _pwm_freq;
-    uint16_t static constexpr _pwm_count_half = _pwm_count_wrap / 2;
+    uint16_t _pwm_count_half = 0;
     uint16_t static constexpr _pwm_count_off = 0;
 
-    std::shared_ptr<TimeRepresentation> _pacific_time_zone;
+    // Inverting the output of a square wave carrier shifts its phase by half a cycle.
+    bool _phase_inverted = false;
+    void _set_phase(bool inverted);
+
+    TimeCodeStandard const * _standard = nullptr;
+    std::shared_ptr<TimeRepresentation> _zone;
+    std::shared_ptr<TimeRepresentation> _dst_zone;
+
+    // Built once per minute, keyed by the UTC minute with seconds zeroed.
+    TimeCodeMinute _minute;
+    TimeCodeFrame _frame;
+    uint64_t _phase_frame = 0;
+    Ymdhms _frame_utc_minute;
+    bool _frame_valid = false;
+
+    TimeCodeSchedule const * _schedule = nullptr;
+    uint8_t _next_change = 0;
+
+    static uint32_t constexpr _never = 100000000;
 };
@@ -0,0 +1,320 @@
+#include "WwvbDecoder.h"
+
+#include "WwvbPhase.h"
+#include "util.h"
+
+#ifdef HOST_BUILD
+#include "Wwvb.h"
+#include "iana_time_zones.h"
+#endif
+
+void WwvbDecoder::edge(uint64_t const time_us, bool const reduced, bool const phase_inverted)
+{
+    if (reduced == _reduced)
+    {
+        return;
+    }
+    _reduced = reduced;
+
+    if (reduced)
+    {
+        _reduced_at_us = time_us;
+        _reduced_at_valid = true;
+        _phase = phase_inverted;
+        return;
+    }
+
+    if (!_reduced_at_valid)
+    {
+        return;
+    }
+
+    // Allow 100 ms either way of each width.
+    uint64_t const width_ms = (time_us - _reduced_at_us) / 1000;
+    Symbol symbol = Symbol::Unknown;
+    if (100 <= width_ms && width_ms < 300)
+    {
+        symbol = Symbol::Zero;
+    }
+    else if (400 <= width_ms && width_ms < 600)
+    {
+        symbol = Symbol::One;
+    }
+    else if (700 <= width_ms && width_ms < 900)
+    {
+        symbol = Symbol::Marker;
+    }
+    else
+    {
+        ++_symbol_errors;
+    }
+    _symbol(symbol, _phase);
+}
+
+bool WwvbDecoder::pop_minute(WwvbDecodedMinute & minute)
+{
+    if (!_minute_ready)
+    {
+        return false;
+    }
+    minute = _minute;
+    _minute_ready = false;
+    return true;
+}
+
+void WwvbDecoder::_symbol(Symbol const symbol, bool const phase)
+{
+    // Second 1 is never a marker, so a pair of markers followed by anything else puts
+    // the second of the pair at second 0, even when a leap second makes it three in a row.
+    bool const minute_started =
+        symbol != Symbol::Marker && _previous[0] == Symbol::Marker && _previous[1] == Symbol::Marker;
+    _previous[1] = _previous[0];
+    _previous[0] = symbol;
+
+    if (minute_started)
+    {
+        // The last symbol received was second 0 of this minute, not the end of the previous one.
+        if (_in_minute && !_decode(_num_symbols - 1))
+        {
+            ++_frame_errors;
+        }
+        _symbols[0] = Symbol::Marker;
+        _phases[0] = _previous_phase;
+        _num_symbols = 1;
+        _in_minute = true;
+    }
+    _previous_phase = phase;
+
+    if (!_in_minute)
+    {
+        return;
+    }
+    if (_num_symbols == _max_symbols)
+    {
+        ++_frame_errors;
+        _in_minute = false;
+        return;
+    }
+    _symbols[_num_symbols] = symbol;
+    _phases[_num_symbols] = phase;
+    ++_num_symbols;
+}
+
+uint32_t WwvbDecoder::_bcd(std::initializer_list<std::pair<uint8_t, uint16_t>> bits) const
+{
+    uint32_t value = 0;
+    for (auto const & [sec, weight] : bits)
+    {
+        if (_symbols[sec] == Symbol::One)
+        {
+            value += weight;
+        }
+    }
+    return value;
+}
+
+bool WwvbDecoder::_decode(size_t const num_symbols)
+{
+    if (num_symbols != 60 && num_symbols != 61)
+    {
+        return false;
+    }
+
+    for (size_t sec = 0; sec < num_symbols; ++sec)
+    {
+        bool const marker = sec == 0 || sec % 10 == 9 || sec == 60;
+        if ((_symbols[sec] == Symbol::Marker) != marker || _symbols[sec] == Symbol::Unknown)
+        {
+            return false;
+        }
+    }
+
+    uint32_t const min = _bcd({{1, 40}, {2, 20}, {3, 10}, {5, 8}, {6, 4}, {7, 2}, {8, 1}});
+    uint32_t const hour = _bcd({{12, 20}, {13, 10}, {15, 8}, {16, 4}, {17, 2}, {18, 1}});
+    uint32_t const day_of_year = _bcd({{22, 200}, {23, 100}, {25, 80}, {26, 40}, {27, 20}, {28, 10},
+                                       {30, 8}, {31, 4}, {32, 2}, {33, 1}});
+    uint32_t const year = _bcd({{45, 80}, {46, 40}, {47, 20}, {48, 10}, {50, 8}, {51, 4}, {52, 2}, {53, 1}});
+
+    bool const leap_year = _symbols[55] == Symbol::One;
+    if (min >= min_per_hour || hour >= hour_per_day || day_of_year < 1 || day_of_year > (leap_year ? 366u : 365u))
+    {
+        return false;
+    }
+
+    WwvbDecodedMinute & minute = _minute;
+    minute.utc = Ymdhms(2000 + year, 1, 1, hour, min, 0);
+    minute.utc.add_days(day_of_year - 1);
+    minute.leap_year = leap_year;
+    minute.leap_second_warning = _symbols[56] == Symbol::One;
+    minute.dst_at_utc_midnight_tomorrow = _symbols[57] == Symbol::One;
+    minute.dst_at_utc_midnight_today = _symbols[58] == Symbol::One;
+    minute.leap_second = num_symbols == 61;
+
+    auto const phase_bits = [this](uint8_t first, uint8_t n) {
+        uint32_t value = 0;
+        for (uint8_t sec = first; sec < first + n; ++sec)
+        {
+            value = (value << 1) | _phases[sec];
+        }
+        return value;
+    };
+    uint32_t const moc =
+        (phase_bits(18, 1) << 25) | (phase_bits(20, 9) << 16) | (phase_bits(30, 9) << 7) | phase_bits(40, 7);
+    minute.phase_minute_of_century = moc;
+    minute.phase_valid =
+        phase_bits(0, 13) == 0x768 &&
+        phase_bits(13, 5) == wwvb_phase_time_parity(moc) &&
+        phase_bits(19, 1) == (moc & 1);
+
+    _minute_ready = true;
+    return true;
+}
+
+#ifdef HOST_BUILD
+namespace
+{
+    struct Simulation
+    {
+        Wwvb wwvb{0, 0};
+        WwvbDecoder decoder;
+        uint64_t now_us = 0;
+
+        void sample(uint64_t time_us)
+        {
+            decoder.edge(time_us, wwvb.carrier_reduced(), wwvb.carrier_phase_inverted());
+        }
+
+        // One second of the emitter, driven the way gps_clock drives it.
+        void second(TopOfSecond const & tos)
+        {
+            uint32_t change_us = wwvb.top_of_second(tos);
+            sample(now_us);
+            while (change_us < 1000000)
+            {
+                uint32_t const at_us = change_us;
+                change_us = wwvb.change();
+                sample(now_us + at_us);
+            }
+            now_us += 1000000;
+        }
+    };
+
+    TimeRepresentation const * los_angeles()
+    {
+        for (auto const & zone : get_iana_timezones())
+        {
+            if (std::get<std::string>(zone) == "America/Los_Angeles")
+            {
+                return std::get<std::shared_ptr<TimeRepresentation>>(zone).get();
+            }
+        }
+        return nullptr;
+    }
+
+    // Runs the emitter from first_day for n_days, with a leap second added at the end of
+    // leap_day, and checks that every minute but the first decodes to what was sent.
+    bool check_closed_loop(TimeCodeStandard const & standard, Ymdhms const & first_day, int32_t n_days, Ymdhms const & leap_day)
+    {
+        TimeRepresentation const * const zone = los_angeles();
+        test_assert(zone);
+
+        Simulation sim;
+        sim.wwvb.set_standard(standard);
+        sim.wwvb.set_carrier(true);
+
+        // The leap second as seen from the start of the run.
+        Ymdhms leap_second = leap_day;
+        leap_second.hour = 23;
+        leap_second.min = 59;
+        leap_second.sec = 59;
+        int32_t leap_second_time_until = leap_second.subtract_and_return_non_leap_seconds(first_day) + 1;
+
+        Ymdhms expected = first_day;
+        expected.add_seconds(secs_per_min);
+        uint32_t num_decoded = 0;
+
+        TopOfSecond tos;
+        Ymdhms day = first_day;
+        for (int32_t i = 0; i < n_days; ++i)
+        {
+            bool const leap_second_today = day == leap_day;
+            for (uint8_t hour = 0; hour < hour_per_day; ++hour)
+            {
+                for (uint8_t min = 0; min < min_per_hour; ++min)
+                {
+                    uint8_t const secs_this_minute = leap_second_today && hour == 23 && min == 59 ? 61 : 60;
+                    for (uint8_t sec = 0; sec < secs_this_minute; ++sec)
+                    {
+                        tos.set_utc_ymdhms(day.year, day.month, day.day, hour, min, sec);
+                        tos.set_next_leap_second(leap_second_time_until, 1);
+                        --leap_second_time_until;
+                        sim.second(tos);
+
+                        WwvbDecodedMinute decoded;
+                        if (!sim.decoder.pop_minute(decoded))
+                        {
+                            continue;
+                        }
+
+                        if (decoded.utc != expected)
+                        {
+                            decoded.utc.print();
+                            printf(" decoded, ");
+                            expected.print();
+                            printf(" expected\n");
+                        }
+                        test_assert(decoded.utc == expected);
+                        test_assert(decoded.leap_year == expected.is_leap_year());
+
+                        // The emitter checks the warning each second, and the bit goes out in second 56.
+                        int32_t const until_at_56 =
+                            leap_second.subtract_and_return_non_leap_seconds(expected) + 1 - 56;
+                        test_assert(decoded.leap_second_warning == (0 <= until_at_56 && until_at_56 < 27 * secs_per_day));
+
+                        Ymdhms midnight = expected;
+                        midnight.hour = 0;
+                        midnight.min = 0;
+                        test_assert(decoded.dst_at_utc_midnight_today == zone->is_dst(midnight));
+                        midnight.add_days(1);
+                        test_assert(decoded.dst_at_utc_midnight_tomorrow == zone->is_dst(midnight));
+
+                        bool const leap_minute = expected.day == leap_day.day && expected.month == leap_day.month &&
+                            expected.year == leap_day.year && expected.hour == 23 && expected.min == 59;
+                        test_assert(decoded.leap_second == leap_minute);
+
+                        test_assert(decoded.phase_valid == standard.wwvb_phase);
+                        if (standard.wwvb_phase)
+                        {
+                            test_assert_unsigned_eq(decoded.phase_minute_of_century, wwvb_phase_minute_of_century(expected));
+                        }
+
+                        expected.add_seconds(secs_per_min);
+                        ++num_decoded;
+                    }
+                }
+            }
+            day.add_days(1);
+        }
+
+        // All but the first minute, which had no marker before it, and the last, still waiting for its second 1.
+        test_assert_unsigned_eq(num_decoded, (uint32_t)(n_days * min_per_day - 2));
+        test_assert_unsigned_eq(sim.decoder.symbol_errors(), 0u);
+        test_assert_unsigned_eq(sim.decoder.frame_errors(), 0u);
+        return true;
+    }
+}
+#endif
+
+bool wwvb_decoder_test()
+{
+#ifdef HOST_BUILD
+    // Three months with phase, through February 29th, the start of DST, and a leap second
+    // at the end of March (one that wasn't really scheduled).
+    test_assert(check_closed_loop(time_code_wwvb_phase, Ymdhms(2024, 2, 1, 0, 0, 0), 91, Ymdhms(2024, 3, 31, 0, 0, 0)));
+
+    // Amplitude only, through the end of DST and the year.
+    test_assert(check_closed_loop(time_code_wwvb, Ymdhms(2024, 10, 20, 0, 0, 0), 75, Ymdhms(2024, 12, 31, 0, 0, 0)));
+#endif
+
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+
+#include "time.h"
+
+bool wwvb_decoder_test();
+
+/*
+ * A WWVB receiver in software, for checking what the emitter sends.
+ *
+ * It watches the carrier the way a receiver would: each second starts when the power
+ * is reduced, and how long it stays reduced gives a 0, 1, or marker. Two markers in a
+ * row mark the start of a minute, and a whole minute of symbols decodes to the UTC
+ * time and flags. The carrier's phase over each second is decoded as the phase code.
+ */
+
+struct WwvbDecodedMinute
+{
+    Ymdhms utc;
+    bool leap_year;
+    bool leap_second_warning;
+    bool dst_at_utc_midnight_today;
+    bool dst_at_utc_midnight_tomorrow;
+    // 61 seconds long.
+    bool leap_second;
+
+    // The phase code's minute of the century, when its sync word and parity check out.
+    bool phase_valid;
+    uint32_t phase_minute_of_century;
+};
+
+class WwvbDecoder
+{
+public:
+    // The carrier was reduced (or restored) at time_us, with the given phase.
+    void edge(uint64_t time_us, bool reduced, bool phase_inverted);
+
+    // True once each time a whole minute has been decoded.
+    bool pop_minute(WwvbDecodedMinute & minute);
+
+    // Seconds whose symbol couldn't be read, and minutes that didn't decode.
+    uint32_t symbol_errors() const { return _symbol_errors; }
+    uint32_t frame_errors() const { return _frame_errors; }
+
+private:
+    enum class Symbol: uint8_t
+    {
+        Zero,
+        One,
+        Marker,
+        Unknown,
+    };
+
+    uint64_t _reduced_at_us = 0;
+    bool _reduced_at_valid = false;
+    bool _reduced = false;
+    bool _phase = false;
+    bool _previous_phase = false;
+
+    // Symbols of the minute in progress, which started at the second of a pair of markers.
+    static size_t constexpr _max_symbols = 62;
+    Symbol _symbols[_max_symbols];
+    bool _phases[_max_symbols];
+    size_t _num_symbols = 0;
+    bool _in_minute = false;
+    Symbol _previous[2] = {Symbol::Unknown, Symbol::Unknown};
+
+    WwvbDecodedMinute _minute;
+    bool _minute_ready = false;
+
+    uint32_t _symbol_errors = 0;
+    uint32_t _frame_errors = 0;
+
+    void _symbol(Symbol symbol, bool phase);
+    bool _decode(size_t num_symbols);
+    uint32_t _bcd(std::initializer_list<std::pair<uint8_t, uint16_t>> bits) const;
+};
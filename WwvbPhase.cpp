@@ -0,0 +1,216 @@
+#include "WwvbPhase.h"
+
+#include <cstring>
+
+#include "util.h"
+
+namespace
+{
+    // Sent in seconds 0 through 12, most significant bit first.
+    uint16_t constexpr sync_t = 0x768;
+
+    // Time bits summed (mod 2) into each parity bit, time_par[0] first.
+    uint32_t constexpr time_parity_masks[5] = {
+        0x0b3e375,
+        0x167c6ea,
+        0x2cf8dd4,
+        0x12cf8dd,
+        0x259f1ba,
+    };
+
+    // Indexed by WWVB's two DST bits (tomorrow, today), plus 4 for a leap second this month.
+    uint8_t constexpr dst_ls_codes[8] = {
+        0b01000,
+        0b10101,
+        0b10110,
+        0b00011,
+        0b01101,
+        0b10000,
+        0b10011,
+        0b00110,
+    };
+
+    // Fixed, rather than announcing the next DST change.
+    uint8_t constexpr dst_next = 0b000111;
+
+    // Most significant bit first, starting at the given second.
+    void put_bits(uint64_t & frame, uint8_t sec, uint32_t value, uint8_t n_bits)
+    {
+        for (uint8_t i = 0; i < n_bits; ++i)
+        {
+            if ((value >> (n_bits - 1 - i)) & 1)
+            {
+                frame |= static_cast<uint64_t>(1) << (sec + i);
+            }
+        }
+    }
+
+    uint32_t extract_bits(uint32_t value, uint8_t high, uint8_t low)
+    {
+        return (value >> low) & ((1u << (high - low + 1)) - 1);
+    }
+
+    bool leap_second_this_month(TimeCodeMinute const & minute)
+    {
+        if (!(minute.leap_second_valid && minute.leap_second_inserted && minute.leap_second_time_until >= 0))
+        {
+            return false;
+        }
+        Ymdhms const & time = minute.time;
+        Ymdhms const next_month = time.month == 12
+            ? Ymdhms(time.year + 1, 1, 1, 0, 0, 0)
+            : Ymdhms(time.year, time.month + 1, 1, 0, 0, 0);
+        return minute.leap_second_time_until <= next_month.subtract_and_return_non_leap_seconds(time);
+    }
+}
+
+uint32_t wwvb_phase_minute_of_century(Ymdhms const & utc)
+{
+    Ymdhms minute = utc;
+    minute.sec = 0;
+    return minute.subtract_and_return_non_leap_seconds(Ymdhms(2000, 1, 1, 0, 0, 0)) / secs_per_min;
+}
+
+uint8_t wwvb_phase_time_parity(uint32_t const minute_of_century)
+{
+    uint8_t parity = 0;
+    for (uint8_t i = 0; i < 5; ++i)
+    {
+        parity |= (__builtin_popcount(minute_of_century & time_parity_masks[i]) & 1) << i;
+    }
+    return parity;
+}
+
+uint8_t wwvb_phase_dst_ls(bool const dst_at_utc_midnight_tomorrow,
+                          bool const dst_at_utc_midnight_today,
+                          bool const leap_second)
+{
+    return dst_ls_codes[(leap_second ? 4 : 0) | (dst_at_utc_midnight_tomorrow ? 2 : 0) | (dst_at_utc_midnight_today ? 1 : 0)];
+}
+
+uint64_t wwvb_phase_frame(TimeCodeMinute const & minute)
+{
+    uint32_t const time = wwvb_phase_minute_of_century(minute.time);
+    uint8_t const dst_ls = wwvb_phase_dst_ls(
+        minute.dst_at_utc_midnight_tomorrow,
+        minute.dst_at_utc_midnight_today,
+        leap_second_this_month(minute));
+
+    uint64_t frame = 0;
+    put_bits(frame,  0, sync_t, 13);
+    put_bits(frame, 13, wwvb_phase_time_parity(time), 5);
+    put_bits(frame, 18, extract_bits(time, 25, 25), 1);
+    put_bits(frame, 19, extract_bits(time,  0,  0), 1);
+    put_bits(frame, 20, extract_bits(time, 24, 16), 9);
+    // Second 29 is reserved, always 0.
+    put_bits(frame, 30, extract_bits(time, 15,  7), 9);
+    // Second 39 is reserved, always 1.
+    put_bits(frame, 39, 1, 1);
+    put_bits(frame, 40, extract_bits(time,  6,  0), 7);
+    put_bits(frame, 47, extract_bits(dst_ls, 4, 3), 2);
+    // Second 49 is the notice bit, 0 with nothing to announce.
+    put_bits(frame, 50, extract_bits(dst_ls, 2, 0), 3);
+    put_bits(frame, 53, dst_next, 6);
+    // Second 59 is always 0.
+    return frame;
+}
+
+void wwvb_phase_frame_string(uint64_t const frame, char (&str)[61])
+{
+    for (uint8_t sec = 0; sec < secs_per_min; ++sec)
+    {
+        str[sec] = ((frame >> sec) & 1) ? '1' : '0';
+    }
+    str[secs_per_min] = '\0';
+}
+
+namespace
+{
+    // The DST bits are set by hand instead.
+    TimeCodeStandard test_standard()
+    {
+        TimeCodeStandard standard = time_code_wwvb_phase;
+        standard.dst_zone = nullptr;
+        return standard;
+    }
+
+    bool check_frame(TopOfSecond const & tos, char const * expected)
+    {
+        TimeCodeMinute minute;
+        test_assert(time_code_minute(test_standard(), tos, nullptr, nullptr, minute));
+        minute.dst_at_utc_midnight_tomorrow = expected[0] == 'T' || expected[0] == 'B';
+        minute.dst_at_utc_midnight_today = expected[0] == 'T' || expected[0] == 'E';
+
+        char str[61];
+        wwvb_phase_frame_string(wwvb_phase_frame(minute), str);
+        if (strcmp(str, expected + 1) != 0)
+        {
+            printf("%s\n%s\n", str, expected + 1);
+        }
+        test_assert(strcmp(str, expected + 1) == 0);
+        return true;
+    }
+}
+
+bool wwvb_phase_test()
+{
+    test_assert_unsigned_eq(wwvb_phase_minute_of_century(Ymdhms(2000, 1, 1, 0, 0, 0)), 0u);
+    test_assert_unsigned_eq(wwvb_phase_minute_of_century(Ymdhms(2000, 1, 1, 0, 1, 59)), 1u);
+    test_assert_unsigned_eq(wwvb_phase_minute_of_century(Ymdhms(2024, 9, 14, 18, 42, 0)), 12994242u);
+
+    // A Hamming code: every single bit error in the 26 time bits gives a different
+    // syndrome, and none of them looks like an error in a parity bit alone.
+    uint32_t seen = 0;
+    for (uint8_t bit = 0; bit < 26; ++bit)
+    {
+        uint8_t const syndrome = wwvb_phase_time_parity(1u << bit);
+        test_assert(__builtin_popcount(syndrome) >= 2);
+        test_assert(!((seen >> syndrome) & 1));
+        seen |= 1u << syndrome;
+    }
+    test_assert_unsigned_eq(wwvb_phase_time_parity(12994242), 7u);
+    test_assert_unsigned_eq(wwvb_phase_time_parity(8942399), 23u);
+
+    // Every DST and leap second combination has its own code, and the DST states alone
+    // differ from each other in at least two bits.
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        for (uint8_t j = 0; j < i; ++j)
+        {
+            test_assert(dst_ls_codes[i] != dst_ls_codes[j]);
+            test_assert(i >= 4 || __builtin_popcount(dst_ls_codes[i] ^ dst_ls_codes[j]) >= 2);
+        }
+    }
+
+    TopOfSecond tos;
+
+    // The first character picks the DST bits: Not in effect, Begins today, in efFect (T), Ends today.
+    tos.set_utc_ymdhms(2000, 1, 1, 0, 0, 0);
+    test_assert(check_frame(tos,
+        "N001110110100000000000000000000000000000100000000100000001110"));
+
+    tos.set_utc_ymdhms(2024, 9, 14, 18, 42, 17);
+    test_assert(check_frame(tos,
+        "T001110110100000111000110001100010001101110000100000110001110"));
+
+    tos.set_utc_ymdhms(2024, 3, 10, 12, 0, 0);
+    test_assert(check_frame(tos,
+        "B001110110100001011000110000100001000111101100001001100001110"));
+
+    // The minute with the leap second at the end of 2016, announced all month.
+    tos.set_utc_ymdhms(2016, 12, 31, 23, 59, 0);
+    tos.set_next_leap_second(60, 1);
+    test_assert(check_frame(tos,
+        "N001110110100010111010100010000011100110101111110101010001110"));
+    tos.set_utc_ymdhms(2016, 12, 1, 0, 0, 0);
+    tos.set_next_leap_second(31 * secs_per_day, 1);
+    TimeCodeMinute minute;
+    test_assert(time_code_minute(test_standard(), tos, nullptr, nullptr, minute));
+    test_assert(leap_second_this_month(minute));
+    tos.set_utc_ymdhms(2016, 11, 30, 23, 59, 0);
+    tos.set_next_leap_second(secs_per_day * 31 + 60, 1);
+    test_assert(time_code_minute(test_standard(), tos, nullptr, nullptr, minute));
+    test_assert(!leap_second_this_month(minute));
+
+    return true;
+}
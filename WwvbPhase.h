@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+#include "TimeCode.h"
+
+bool wwvb_phase_test();
+
+/*
+ * WWVB's phase modulation time code, broadcast alongside the amplitude code since 2012.
+ *
+ * One bit per second: the carrier holds its phase for a 0 and is inverted for a 1, for the
+ * whole second. A minute opens with a 13 bit sync word, then carries the minutes since the
+ * start of the century as 26 bits protected by 5 Hamming parity bits, and a 5 bit code for
+ * the daylight saving time state and a leap second at the end of the month.
+ *
+ * Only the regular minute frame is sent. The extended frames WWVB substitutes in six minutes
+ * of each half hour are left out; receivers decode the regular frame on its own.
+ */
+
+// Minutes since 2000-01-01 00:00 UTC.
+uint32_t wwvb_phase_minute_of_century(Ymdhms const & utc);
+
+// The 5 time parity bits for a 26 bit minute of the century, parity 4 in the high bit.
+uint8_t wwvb_phase_time_parity(uint32_t minute_of_century);
+
+// The dst_ls code for WWVB's two DST bits (at UTC midnight tomorrow, today) and a leap second.
+uint8_t wwvb_phase_dst_ls(bool dst_at_utc_midnight_tomorrow, bool dst_at_utc_midnight_today, bool leap_second);
+
+// Bit n is second n, 1 where the carrier is inverted. A leap second (60) holds the phase.
+// The minute must come from time_code_minute() with a UTC standard such as time_code_wwvb.
+uint64_t wwvb_phase_frame(TimeCodeMinute const & minute);
+
+// Frame as a string of '0' and '1', for tests and debugging.
+void wwvb_phase_frame_string(uint64_t frame, char (&str)[61]);
@@ -0,0 +1,274 @@
+// Host benchmarks, built by benchmarks.sh. Each prints its throughput.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+
+#include "Display.h"
+#include "Ht16k33Simulator.h"
+#include "Pps.h"
+#include "PpsSimulator.h"
+#include "RingBuffer.h"
+#include "UbxParser.h"
+
+namespace
+{
+    size_t constexpr rx_buf_len = 2000;
+
+    // A stream of NAV-PVT and NAV-TIMELS sized frames, as the receiver sends them, with
+    // one in damaged_one_in damaged and some garbage between frames.
+    std::vector<uint8_t> ubx_stream(size_t n_frames, uint32_t damaged_one_in)
+    {
+        uint32_t lcg = 1;
+        auto random = [&lcg](uint32_t n) {
+            lcg = lcg * 1664525 + 1013904223;
+            return (lcg >> 8) % n;
+        };
+
+        std::vector<uint8_t> stream;
+        for (size_t i = 0; i < n_frames; ++i)
+        {
+            uint8_t payload[92];
+            for (auto & byte : payload)
+            {
+                byte = random(256);
+            }
+            bool const pvt = i % 2 == 0;
+            uint8_t frame[sizeof(payload) + ubx_overhead_len];
+            size_t const len = ubx_encode(0x01, pvt ? 0x07 : 0x26, payload, pvt ? 92 : 24, frame);
+            if (damaged_one_in && random(damaged_one_in) == 0)
+            {
+                frame[random(len)] ^= 0x5a;
+                for (uint32_t n = random(20); n > 0; --n)
+                {
+                    stream.push_back(random(2) ? ubx_sync1 : random(256));
+                }
+            }
+            stream.insert(stream.end(), frame, frame + len);
+        }
+        return stream;
+    }
+
+    // The receive path before UbxParser: look for a whole frame from the front of the
+    // buffer on every call, copy its payload out, and check the copy.
+    bool copying_read(RingBuffer<uint8_t, rx_buf_len> & buffer, uint8_t & msg_class, uint8_t & msg_id, uint16_t & len, uint8_t * msg, uint16_t msg_buffer_len)
+    {
+        while (!buffer.empty())
+        {
+            if (buffer.count() < ubx_overhead_len)
+            {
+                return false;
+            }
+            size_t next_byte = 1;
+            if (buffer.peek(0) != ubx_sync1 || buffer.peek(1) != ubx_sync2)
+            {
+                buffer.pop(next_byte);
+                continue;
+            }
+            msg_class = buffer.peek(2);
+            msg_id = buffer.peek(3);
+            len = buffer.peek(4) | (buffer.peek(5) << 8);
+            if (len > msg_buffer_len)
+            {
+                buffer.pop(next_byte);
+                continue;
+            }
+            if (buffer.count() < ubx_overhead_len + len)
+            {
+                return false;
+            }
+            uint8_t a = 0;
+            uint8_t b = 0;
+            for (size_t i = 2; i < ubx_header_len; ++i)
+            {
+                a += buffer.peek(i);
+                b += a;
+            }
+            for (size_t i = 0; i < len; ++i)
+            {
+                msg[i] = buffer.peek(ubx_header_len + i);
+                a += msg[i];
+                b += a;
+            }
+            if (buffer.peek(ubx_header_len + len) != a || buffer.peek(ubx_header_len + len + 1) != b)
+            {
+                buffer.pop(next_byte);
+                continue;
+            }
+            buffer.pop(ubx_overhead_len + len);
+            return true;
+        }
+        return false;
+    }
+
+    // Feeds the stream in UART FIFO sized pieces, reading frames after each, and returns
+    // the frames read and a sum of their payloads so nothing is optimized away.
+    template <typename Read>
+    void run(char const * name, std::vector<uint8_t> const & stream, Read read)
+    {
+        RingBuffer<uint8_t, rx_buf_len> buffer;
+        size_t frames = 0;
+        uint32_t sum = 0;
+        int constexpr repeats = 20;
+
+        auto const start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r)
+        {
+            size_t sent = 0;
+            while (sent < stream.size())
+            {
+                for (int n = 0; n < 32 && sent < stream.size() && !buffer.full(); ++n)
+                {
+                    buffer.push(stream[sent++]);
+                }
+                read(buffer, frames, sum);
+            }
+        }
+        auto const end = std::chrono::steady_clock::now();
+
+        double const s = std::chrono::duration<double>(end - start).count();
+        double const mb = repeats * stream.size() / 1e6;
+        printf("%-32s %8.1f MB/s  %zu frames (%08x)\n", name, mb / s, frames, sum);
+    }
+
+    void ubx_benchmarks()
+    {
+        for (uint32_t damaged_one_in : {0u, 10u})
+        {
+            std::vector<uint8_t> const stream = ubx_stream(50000, damaged_one_in);
+            printf("UBX, %s:\n", damaged_one_in ? "1 in 10 frames damaged" : "clean");
+
+            run("  copy per frame", stream, [](RingBuffer<uint8_t, rx_buf_len> & buffer, size_t & frames, uint32_t & sum) {
+                uint8_t msg_class;
+                uint8_t msg_id;
+                uint16_t len;
+                uint8_t msg[92];
+                while (copying_read(buffer, msg_class, msg_id, len, msg, sizeof(msg)))
+                {
+                    ++frames;
+                    sum += msg[0] + msg[len - 1];
+                }
+            });
+
+            UbxParser<rx_buf_len> * parser = nullptr;
+            run("  UbxParser", stream, [&parser](RingBuffer<uint8_t, rx_buf_len> & buffer, size_t & frames, uint32_t & sum) {
+                if (!parser)
+                {
+                    parser = new UbxParser<rx_buf_len>(buffer);
+                }
+                UbxFrame frame;
+                while (parser->parse(frame))
+                {
+                    ++frames;
+                    sum += frame.payload[0] + frame.payload[frame.payload.size() - 1];
+                }
+            });
+            delete parser;
+        }
+    }
+
+    // Pps against a simulated day after day of edges with every kind of fault, a second at a
+    // time, with the lock thresholds it runs with and a few others to compare them to.
+    void pps_benchmarks()
+    {
+        PpsScenario scenario;
+        scenario.chip_ppm_per_day = 0.5;
+        scenario.jitter_ns = 20;
+        scenario.missing_one_in = 20000;
+        scenario.extra_one_in = 50000;
+        scenario.bad_width_one_in = 500;
+        uint64_t constexpr seconds = 1000000;
+
+        struct Variant
+        {
+            char const * name;
+            PpsLockThresholds thresholds;
+        };
+        std::vector<Variant> variants = {{"default", {}}};
+        variants.push_back({"threshold_hi 30", {}});
+        variants.back().thresholds.threshold_hi = 30;
+        variants.push_back({"saturation_hi 60", {}});
+        variants.back().thresholds.saturation_limit_hi = 60;
+        variants.push_back({"rate_down -3", {}});
+        variants.back().thresholds.rate_down = -3;
+
+        printf("PPS, %" PRIu64 " seconds, 1 in %" PRIu32 " missing, 1 in %" PRIu32 " extra, 1 in %" PRIu32 " the wrong width:\n",
+               seconds, scenario.missing_one_in, scenario.extra_one_in, scenario.bad_width_one_in);
+        for (Variant const & variant : variants)
+        {
+            PpsSimulator simulator(scenario);
+            Pps pps(simulator, variant.thresholds);
+            pps.set_quiet(true);
+            pps.start();
+
+            uint64_t locked_s = 0;
+            uint32_t lock_losses = 0;
+            bool locked = false;
+            auto const start = std::chrono::steady_clock::now();
+            for (uint64_t second = 0; second < seconds; ++second)
+            {
+                run_pps_simulation(simulator, pps, simulator.gps_second_us(second) + 500000);
+                locked_s += pps.locked();
+                lock_losses += locked && !pps.locked();
+                locked = pps.locked();
+            }
+            auto const end = std::chrono::steady_clock::now();
+
+            double const s = std::chrono::duration<double>(end - start).count();
+            printf("  %-30s %8.2f M s/s  locked %7.3f%%  %5" PRIu32 " lock losses  %8.0f s LOS\n",
+                   variant.name, seconds / s / 1e6, 100.0 * locked_s / seconds, lock_losses, pps.unlocked_us() / 1e6);
+        }
+    }
+
+    // Whole frames drawn and committed, and sent to simulated chips, with every column changing
+    // from one frame to the next.
+    void display_benchmarks()
+    {
+        uint32_t constexpr frames = 200000;
+        printf("Display, %" PRIu32 " frames, every column changed:\n", frames);
+        for (bool const send : {false, true})
+        {
+            Ht16k33Simulator busses;
+            Display display(busses);
+            busses.reset_counts();
+
+            auto const start = std::chrono::steady_clock::now();
+            for (uint32_t frame = 0; frame < frames; ++frame)
+            {
+                char const digit = '0' + frame % 10;
+                for (size_t line_idx = 0; line_idx < Display::num_lines; ++line_idx)
+                {
+                    display.printf(line_idx, frame % 2 ? "%c.%c.%c.%c.%c.%c.%c.%c.%c.%c.%c.%c.%c.%c.%c.%c.%c.%c.%c.%c."
+                                                       : "%c%c%c%c%c%c%c%c%c%c%c%c%c%c%c%c%c%c%c%c",
+                                   digit, digit, digit, digit, digit, digit, digit, digit, digit, digit,
+                                   digit, digit, digit, digit, digit, digit, digit, digit, digit, digit);
+                }
+                display.commit(frame);
+                uint64_t writes;
+                do
+                {
+                    writes = busses.writes();
+                    if (send)
+                    {
+                        display.dispatch(frame);
+                    }
+                }
+                while (writes != busses.writes());
+            }
+            auto const end = std::chrono::steady_clock::now();
+
+            double const s = std::chrono::duration<double>(end - start).count();
+            printf("  %-30s %8.3f M frames/s  %6.1f bytes/frame\n",
+                   send ? "draw, commit and send" : "draw and commit", frames / s / 1e6, static_cast<double>(busses.bytes()) / frames);
+        }
+    }
+}
+
+int main()
+{
+    ubx_benchmarks();
+    pps_benchmarks();
+    display_benchmarks();
+    return 0;
+}
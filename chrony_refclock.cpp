@@ -0,0 +1,150 @@
+/*
+ * Feed the clock's USB time reports to chrony.
+ *
+ * Set the clock's "USB Output" menu to "Refclock", add this to chrony.conf:
+ *
+ *     refclock SOCK /run/chrony.skytime.sock refid GPS
+ *
+ * and then run:
+ *
+ *     chrony_refclock /dev/ttyACM0 /run/chrony.skytime.sock [usb latency in microseconds]
+ *
+ * Lines on the serial port that aren't time reports (debug text) are ignored.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "TimeReport.h"
+
+namespace
+{
+    // Defined by chrony's refclock_sock.c
+    struct sock_sample
+    {
+        struct timeval tv;
+        double offset;
+        int pulse;
+        int leap;
+        int _pad;
+        int magic;
+    };
+    int constexpr sock_magic = 0x534f434b;
+
+    int open_serial(char const * path)
+    {
+        int fd = open(path, O_RDONLY | O_NOCTTY);
+        if (fd < 0)
+        {
+            return fd;
+        }
+
+        termios tio;
+        if (tcgetattr(fd, &tio) == 0)
+        {
+            cfmakeraw(&tio);
+            tio.c_cc[VMIN] = 1;
+            tio.c_cc[VTIME] = 0;
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+        return fd;
+    }
+
+    int open_chrony_socket(char const * path)
+    {
+        int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (fd < 0)
+        {
+            return fd;
+        }
+
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+        if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc < 3 || argc > 4)
+    {
+        fprintf(stderr, "Usage: %s <serial device> <chrony socket> [usb latency us]\n", argv[0]);
+        return 1;
+    }
+
+    double const latency_s = (argc == 4) ? atof(argv[3]) / 1e6 : 0;
+
+    int serial_fd = open_serial(argv[1]);
+    if (serial_fd < 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    int chrony_fd = open_chrony_socket(argv[2]);
+    if (chrony_fd < 0)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    std::string line;
+    char buf[256];
+    while (true)
+    {
+        ssize_t n = read(serial_fd, buf, sizeof(buf));
+        if (n <= 0)
+        {
+            perror("read");
+            return 1;
+        }
+
+        // The end of a report is the last thing the clock writes, so the read that returns
+        // the newline is the best available estimate of when the report arrived.
+        timespec receipt;
+        clock_gettime(CLOCK_REALTIME, &receipt);
+
+        for (ssize_t i = 0; i < n; ++i)
+        {
+            if (buf[i] != '\n')
+            {
+                line.push_back(buf[i]);
+                continue;
+            }
+
+            TimeReport report;
+            if (report.parse(line.c_str()) && report.locked)
+            {
+                sock_sample sample;
+                memset(&sample, 0, sizeof(sample));
+                sample.tv.tv_sec = receipt.tv_sec;
+                sample.tv.tv_usec = receipt.tv_nsec / 1000;
+                sample.offset = report.offset_s(receipt.tv_sec, (receipt.tv_nsec / 1000) / 1e6, latency_s);
+                sample.pulse = 0;
+                sample.leap = report.leap;
+                sample.magic = sock_magic;
+                if (send(chrony_fd, &sample, sizeof(sample), 0) != sizeof(sample))
+                {
+                    perror("send");
+                }
+            }
+            line.clear();
+        }
+    }
+}
@@ -0,0 +1,10 @@
+#!/bin/bash
+
+set -e
+
+mkdir -p bin_host
+g++ -std=c++20 -Wall -Wextra -Werror -DHOST_BUILD=1 -o bin_host/chrony_refclock \
+    chrony_refclock.cpp \
+    TimeReport.cpp \
+    Nmea.cpp \
+    time.cpp
@@ -48,26 +48,44 @@
 #include <vector>
 #include <limits>
 #include <charconv>
+#include <cstring>
 #include "pico/stdlib.h"
 
 #include "pico/binary_info.h"
 #include "pico/multicore.h"
+#include "hardware/sync.h"
 
 #include "unit_tests.h"
 #include "Gpio.h"
 #include "Pps.h"
+#include "PioPpsSource.h"
 #include "FiveSimdHt16k33Busses.h"
 #include "Display.h"
 #include "RingBuffer.h"
+#include "UartPort.h"
 #include "GpsUBlox.h"
+#include "FlashPositionStore.h"
+#include "FlashThermalModelStore.h"
+#include "TempSensor.h"
+#include "Capture.h"
 #include "Buttons.h"
 #include "Artist.h"
 #include "Wwvb.h"
 #include "Analog.h"
+#include "TimeReport.h"
+#include "NmeaOutput.h"
+#include "IrigBOutput.h"
+#include "Console.h"
 
+std::unique_ptr<PioPpsSource> pps_source;
 std::unique_ptr<Pps> pps;
 bool volatile pps_go = false;
 
+void pps_irq_handler()
+{
+    pps->dispatch_fast_thread();
+}
+
 void core1_main()
 {
     uint constexpr led_pin = 25;
@@ -91,24 +109,41 @@ void core1_main()
 
     uint constexpr pps_pin = 18;
     bi_decl(bi_1pin_with_name(pps_pin, "PPS"));
-    pps = std::make_unique<Pps>(pio0, pps_pin);
+    pps_source = std::make_unique<PioPpsSource>(pio0, pps_pin);
+    pps = std::make_unique<Pps>(*pps_source);
+    // So core0 can sleep between edges.
+    pps->set_interrupt_driven(true);
     printf("PPS init complete.\n");
 
+    TempSensor temp_sensor;
+    FlashThermalModelStore thermal_model_store;
+    ThermalModel::Coefficients thermal_coefficients;
+    if (thermal_model_store.load(thermal_coefficients))
+    {
+        pps->thermal_model().restore(thermal_coefficients);
+    }
+    printf("Temperature sensor init complete.\n");
+
     uint constexpr gps_tx_pin = 16;
     uint constexpr gps_rx_pin = 17;
     bi_decl(bi_1pin_with_name(gps_tx_pin, "GPS"));
     bi_decl(bi_1pin_with_func(gps_tx_pin, GPIO_FUNC_UART));
     bi_decl(bi_1pin_with_name(gps_rx_pin, "GPS"));
     bi_decl(bi_1pin_with_func(gps_rx_pin, GPIO_FUNC_UART));
-    GpsUBlox gps(uart0, gps_tx_pin, gps_rx_pin);
-    if (gps.initialized_successfully())
-    {
-        printf("GPS init complete.\n");
-    }
-    else
-    {
-        printf("GPS init FAILED.\n");
-    }
+    UartPort gps_uart(uart0, gps_tx_pin, gps_rx_pin, UbxBaudNegotiator::default_baud_rate);
+
+    // Print everything the receiver sends, for replay.sh's tool to play back on a host.
+    bool constexpr capture_gps_uart = false;
+    CaptureWriter capture_writer(
+        [](char const * line) { printf("%s\n", line); },
+        []() {
+            uint32_t completed_seconds, us;
+            pps->get_time(completed_seconds, us);
+            return us;
+        });
+    CaptureByteSource capture_source(gps_uart, capture_writer);
+    FlashPositionStore position_store;
+    GpsUBlox gps(gps_uart, capture_gps_uart ? static_cast<ByteSource &>(capture_source) : gps_uart, true, &position_store);
 
     uint constexpr ht16k33_scl_pin = 0;
     uint constexpr ht16k33_sda0_pin = 1;
@@ -173,12 +208,64 @@ void core1_main()
     bi_decl(bi_1pin_with_name(sense9_pin, "ANALOG SENSE 9"));
     Analog analog(*pps, analog_tick_pin, sense0_pin, sense3_pin, sense6_pin, sense9_pin);
 
+    uint constexpr nmea_tx_pin = 22;
+    uint constexpr nmea_baud = 4800;
+    uint32_t constexpr nmea_delay_after_edge_us = 20000;
+    bi_decl(bi_1pin_with_name(nmea_tx_pin, "NMEA TX"));
+    NmeaOutput nmea(*pps, gps, pio0, nmea_tx_pin, nmea_baud, nmea_delay_after_edge_us);
+    printf("NMEA init complete.\n");
+
+    uint constexpr irig_b_pin = 21;
+    bi_decl(bi_1pin_with_name(irig_b_pin, "IRIG-B"));
+    IrigBOutput irig_b(*pps, gps, pio0, irig_b_pin, pps_pin);
+    printf("IRIG-B init complete.\n");
+
     std::vector<std::tuple<std::string, std::shared_ptr<LinePrinter>>> extra_line_options;
     extra_line_options.push_back(pps->los_printer(display));
+    extra_line_options.push_back(pps->stability_printer(display));
     extra_line_options.push_back(analog.analog_time_printer(display));
     Artist artist(display, buttons, gps, extra_line_options);
     printf("Artist init complete.\n");
 
+    std::unique_ptr<PpsHistoryDump> pps_history_dump;
+    Console console([]() { return getchar_timeout_us(0); },
+                    [](char const * const line) { printf("%s\n", line); });
+    console.add_command("pps_history", "Dump the PPS history, as csv or bin",
+                        [&](char const * const args)
+                        {
+                            if (strcmp(args, "csv") == 0)
+                            {
+                                pps_history_dump = std::make_unique<PpsHistoryDump>(pps->history(), PpsHistoryDump::Format::csv);
+                            }
+                            else if (strcmp(args, "bin") == 0)
+                            {
+                                pps_history_dump = std::make_unique<PpsHistoryDump>(pps->history(), PpsHistoryDump::Format::binary);
+                            }
+                            else
+                            {
+                                printf("pps_history csv|bin\n");
+                            }
+                        });
+    console.add_command("pps_capture", "Fetch the PPS counts on interrupt or by polling, or show their latency",
+                        [&](char const * const args)
+                        {
+                            if (strcmp(args, "irq") == 0)
+                            {
+                                pps->set_interrupt_driven(true);
+                            }
+                            else if (strcmp(args, "poll") == 0)
+                            {
+                                pps->set_interrupt_driven(false);
+                            }
+                            else
+                            {
+                                printf("pps_capture irq|poll\n");
+                                pps->edge_latency(false).print("PPS edge latency, polled", PpsCapture::cycles_per_us);
+                                pps->edge_latency(true).print("PPS edge latency, interrupt-driven", PpsCapture::cycles_per_us);
+                            }
+                        });
+    printf("Console init complete.\n");
+
     led.on();
 
     printf("Releasing PPS monitoring thread.\n");
@@ -192,15 +279,34 @@ void core1_main()
     uint32_t prev_completed_seconds = 0;
 
     bool wwvb_needs_top_of_second = false;
-    uint32_t wwvb_raise_power_us = 100000000; // Never
+    uint32_t wwvb_change_us = 100000000; // Never
+
+    // Mid-second, so that the GPS messages describing the upcoming edge have arrived.
+    usec_t constexpr time_report_us = 500000;
+    bool time_report_needed = false;
+
+    // Writing flash stops both cores for about 50 ms. Well after the edge, by which time the UBX
+    // messages are in and the NMEA sentences have gone out, and between the WWVB carrier changes
+    // at 200 and 500 ms, done before the tenth at 400 ms is due on the display.
+    usec_t constexpr thermal_model_save_us = 320000;
+    bool thermal_model_save_check_needed = false;
 
     while (true)
     {
-        gps.dispatch();
+        gps.dispatch(time_us_64());
+        gps_uart.dispatch();
+        int32_t q_err_ps;
+        if (gps.take_quantization_error(q_err_ps))
+        {
+            // UBX-TIM-TP comes between the edge it follows and the one it describes.
+            pps->set_quantization_error(pps->get_completed_seconds() + 1, q_err_ps);
+        }
         five_simd_ht16k33_busses.dispatch();
-        display.dispatch();
+        display.dispatch(time_us_64());
         buttons.dispatch();
         analog.dispatch(prev_completed_seconds);
+        nmea.dispatch(prev_completed_seconds);
+        irig_b.dispatch(prev_completed_seconds);
         pps->dispatch_main_thread();
 
         uint32_t completed_seconds = pps->get_completed_seconds();
@@ -208,21 +314,29 @@ void core1_main()
         {
             prev_completed_seconds = completed_seconds;
             next_display_update_us = 0;
+            if (capture_gps_uart)
+            {
+                capture_writer.edge(pps->locked());
+            }
+            pps->set_temperature(temp_sensor.read_celsius());
+
             gps.pps_lock_state(pps->locked());
             gps.pps_pulsed();
             analog.pps_pulsed(gps.tops_of_seconds().prev());
+            time_report_needed = true;
+            thermal_model_save_check_needed = true;
 
             if (pps->locked())
             {
                 wwvb.set_carrier(true);
                 wwvb_needs_top_of_second = true;
-                wwvb_raise_power_us = 100000000; // Never
+                wwvb_change_us = 100000000; // Never
             }
             else
             {
                 wwvb.set_carrier(false);
                 wwvb_needs_top_of_second = false;
-                wwvb_raise_power_us = 100000000; // Never
+                wwvb_change_us = 100000000; // Never
             }
         }
 
@@ -236,42 +350,94 @@ void core1_main()
                 next_display_update_us += 10000000; // Move the next update far into the future.
             }
 
-            artist.top_of_tenth_of_second(tenths);
-
-            display.dump_to_console(true);
-            printf("Error counts: %ld %ld %ld %ld\n",
-                   display.error_count(),
-                   gps.tops_of_seconds().error_count(),
-                   buttons.error_count(),
-                   artist.error_count());
-            gps.show_status();
-            pps->show_status();
-            analog.show_sensors();
-            analog.print_time();
-
-            uint32_t a, b;
-            pps->get_time(a, b);
-            printf("Time: %lu %lu\n", a, b);
+            // The coming tenth's frame, to be ready at its top rather than drawn after it.
+            artist.tenth_of_second_ahead((tenths + 1) % 10, tenths == 9,
+                                         pps->get_time_us_of(completed_seconds, (tenths + 1) * 100000));
+
+            if (artist.get_usb_output_mode() == UsbOutputMode::DebugText)
+            {
+                display.dump_to_console(true);
+                printf("Error counts: %ld %ld %ld %ld\n",
+                       display.error_count(),
+                       gps.tops_of_seconds().error_count(),
+                       buttons.error_count(),
+                       artist.error_count());
+                gps.show_status();
+                gps_uart.show_status();
+                pps->show_status();
+                display.show_status();
+                analog.show_sensors();
+                analog.print_time();
+
+                uint32_t a, b;
+                pps->get_time(a, b);
+                printf("Time: %lu %lu\n", a, b);
+            }
+            else if (artist.get_usb_output_mode() == UsbOutputMode::Stability && tenths == 0)
+            {
+                pps->stability().print();
+            }
+        }
+
+        if (time_report_needed && pps->get_time_us_of(completed_seconds, time_report_us) <= time_us_64())
+        {
+            time_report_needed = false;
+            if (artist.get_usb_output_mode() == UsbOutputMode::Refclock)
+            {
+                TimeReport report;
+                char report_line[80];
+                if (report.set(gps.tops_of_seconds().next(), pps->locked(), pps->get_us_until(completed_seconds + 1)) &&
+                    report.format(report_line, sizeof(report_line)))
+                {
+                    printf("%s\n", report_line);
+                }
+            }
+        }
+
+        if (thermal_model_save_check_needed && pps->get_time_us_of(completed_seconds, thermal_model_save_us) <= time_us_64())
+        {
+            thermal_model_save_check_needed = false;
+            if (pps->thermal_model().take_save_due() &&
+                !thermal_model_store.save(pps->thermal_model().coefficients()))
+            {
+                printf("Thermal model not saved.\n");
+            }
         }
 
         Button button;
         while (buttons.get_button(button))
         {
-            artist.button_pressed(button);
+            artist.button_pressed(button, time_us_64());
+        }
+
+        console.dispatch();
+        // A few lines at a time, so that the rest of the loop keeps up.
+        for (int i = 0; pps_history_dump && i < 4; ++i)
+        {
+            char line[96];
+            if (pps_history_dump->next_line(line, sizeof(line)))
+            {
+                printf("%s\n", line);
+            }
+            else
+            {
+                pps_history_dump.reset();
+            }
         }
 
         display.set_brightness(artist.get_brightness());
+        wwvb.set_standard(artist.get_time_code_standard());
 
         if (wwvb_needs_top_of_second)
         {
             wwvb_needs_top_of_second = false;
-            wwvb_raise_power_us = wwvb.top_of_second(gps.tops_of_seconds().prev());
+            wwvb_change_us = wwvb.top_of_second(gps.tops_of_seconds().prev());
         }
 
-        usec_t wwvb_raise_power_time_us = pps->get_time_us_of(completed_seconds, wwvb_raise_power_us);
-        if (wwvb_raise_power_time_us <= time_us_64())
+        usec_t wwvb_change_time_us = pps->get_time_us_of(completed_seconds, wwvb_change_us);
+        if (wwvb_change_time_us <= time_us_64())
         {
-            wwvb.raise_power();
+            wwvb_change_us = wwvb.change();
         }
     }
 }
@@ -286,6 +452,9 @@ int main()
     //sleep_ms(4000);
     //printf("Go!\n");
 
+    // So the main thread can pause this one while it writes to flash.
+    multicore_lockout_victim_init();
+
     printf("Launching Main Thread.\n");
     multicore_launch_core1(core1_main);
 
@@ -293,9 +462,31 @@ int main()
     {
     }
 
-    pps->pio_init();
+    pps->start();
+    bool interrupt_driven = false;
     while (true)
     {
-        pps->dispatch_fast_thread();
+        // A change takes effect by the next edge at the latest, when the interrupt wakes this.
+        if (pps->interrupt_driven() != interrupt_driven)
+        {
+            interrupt_driven = pps->interrupt_driven();
+            if (interrupt_driven)
+            {
+                pps_source->enable_interrupt(pps_irq_handler);
+            }
+            else
+            {
+                pps_source->disable_interrupt();
+            }
+        }
+
+        if (interrupt_driven)
+        {
+            __wfi();
+        }
+        else
+        {
+            pps->dispatch_fast_thread();
+        }
     }
 }
@@ -0,0 +1,42 @@
+// Compares holdover with and without the thermal model, built by holdover.sh.
+//
+//   ./bin_host/holdover [HOURS]
+//
+// Six hours locked in a room whose temperature cycles by 3 C either way every half hour, then
+// an hour with no edges by default, starting at several points in the cycle. Prints the worst
+// error in the top of the second during each holdover.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+#include "HoldoverSimulation.h"
+
+int main(int argc, char ** argv)
+{
+    double const hours = argc > 1 ? strtod(argv[1], nullptr) : 1;
+    if (argc > 2 || hours <= 0)
+    {
+        fprintf(stderr, "Usage: %s [HOURS]\n", argv[0]);
+        return 1;
+    }
+
+    ThermalScenario scenario;
+    scenario.holdover_s = hours * 3600;
+
+    printf("  phase   uncompensated us   compensated us\n");
+    double worst_ratio = 0;
+    for (int eighth = 0; eighth < 8; ++eighth)
+    {
+        scenario.locked_s = 6 * 3600 + eighth * scenario.period_s / 8;
+        scenario.temperature_sensor = false;
+        HoldoverResult const uncompensated = simulate_holdover(scenario);
+        scenario.temperature_sensor = true;
+        HoldoverResult const compensated = simulate_holdover(scenario);
+        printf("  %d/8    %16.0f %16.0f\n", eighth, uncompensated.max_error_us, compensated.max_error_us);
+        worst_ratio = std::max(worst_ratio, compensated.max_error_us / uncompensated.max_error_us);
+    }
+    printf("Compensated error at most %.0f%% of uncompensated.\n", 100 * worst_ratio);
+    return 0;
+}
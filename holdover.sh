@@ -0,0 +1,19 @@
+#!/bin/bash
+
+set -e
+
+mkdir -p bin_host
+g++ -std=c++20 -O2 -Wall -Wextra -Werror -DHOST_BUILD=1 -o bin_host/holdover \
+    holdover.cpp \
+    HoldoverSimulation.cpp \
+    AllanDeviation.cpp \
+    LatencyHistogram.cpp \
+    ThermalModel.cpp \
+    PpsCapture.cpp \
+    PpsHistory.cpp \
+    Pps.cpp \
+    Display.cpp \
+    Ht16k33Simulator.cpp \
+    packing.cpp \
+    util.cpp
+./bin_host/holdover "$@"
@@ -197,6 +197,19 @@ bool pack_test()
     test_assert(i64 == ri64);
     test_assert(u64 == ru64);
 
+    (Unpack<sizeof(bytes)>(bytes, LittleEndian())
+        >> Skip<14>()
+        >> ri64
+        >> Skip<8>()).finalize();
+    test_assert(i64 == ri64);
+
+    uint8_t skipped[4] = {0xff, 0xff, 0xff, 0xff};
+    (Pack<sizeof(skipped)>(skipped, LittleEndian())
+        << u8
+        << Skip<2>()
+        << u8).finalize();
+    test_assert(skipped[0] == u8 && skipped[1] == 0 && skipped[2] == 0 && skipped[3] == u8);
+
     int8_t   mi8  = from_little_endian<int8_t  >(&bytes[0]);
     uint8_t  mu8  = from_little_endian<uint8_t >(&bytes[1]);
     int16_t  mi16 = from_little_endian<int16_t >(&bytes[2]);
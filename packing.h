@@ -55,9 +55,9 @@ inline void to_big_endian(uint8_t * bytes, T value)
     to_big_endian(bytes, unsigned_twos_complement_from_signed<UT, T>(value));
 }
 
-template <typename T>
+template <typename T, typename Bytes = uint8_t const *>
 requires std::unsigned_integral<T>
-inline T from_big_endian(uint8_t const * const bytes)
+inline T from_big_endian(Bytes const & bytes)
 {
     T value = 0;
     for (ssize_t value_idx = sizeof(T) - 1; value_idx >= 0; --value_idx)
@@ -69,9 +69,9 @@ inline T from_big_endian(uint8_t const * const bytes)
     return value;
 }
 
-template <typename T>
+template <typename T, typename Bytes = uint8_t const *>
 requires std::signed_integral<T>
-inline T from_big_endian(uint8_t const * const bytes)
+inline T from_big_endian(Bytes const & bytes)
 {
     using UT = WidthMatch<T>::u;
     return signed_from_unsigned_twos_complement<UT, T>(from_big_endian<UT>(bytes));
@@ -96,9 +96,9 @@ inline void to_little_endian(uint8_t * bytes, T value)
     to_little_endian(bytes, unsigned_twos_complement_from_signed<UT, T>(value));
 }
 
-template <typename T>
+template <typename T, typename Bytes = uint8_t const *>
 requires std::unsigned_integral<T>
-inline T from_little_endian(uint8_t const * const bytes)
+inline T from_little_endian(Bytes const & bytes)
 {
     T value = 0;
     for (ssize_t value_idx = sizeof(T) - 1; value_idx >= 0; --value_idx)
@@ -110,9 +110,9 @@ inline T from_little_endian(uint8_t const * const bytes)
     return value;
 }
 
-template <typename T>
+template <typename T, typename Bytes = uint8_t const *>
 requires std::signed_integral<T>
-inline T from_little_endian(uint8_t const * const bytes)
+inline T from_little_endian(Bytes const & bytes)
 {
     using UT = WidthMatch<T>::u;
     return signed_from_unsigned_twos_complement<UT, T>(from_little_endian<UT>(bytes));
@@ -136,6 +136,10 @@ public:
     Endian value() const override { return Endian::Little; }
 };
 
+// Bytes to step over when unpacking, such as reserved fields, or to zero when packing.
+template <size_t n>
+struct Skip {};
+
 template <size_t buffer_size, size_t idx = 0>
 requires (idx <= buffer_size)
 class Pack
@@ -173,19 +177,30 @@ public:
         return Pack<buffer_size, idx>(_buffer, endianness.value());
     }
 
+    template <size_t n>
+    inline auto operator<<(Skip<n>)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            _buffer[idx + i] = 0;
+        }
+        return Pack<buffer_size, idx + n>(_buffer, _endianness);
+    }
+
 private:
     uint8_t * const _buffer;
     Endian _endianness;
 };
 
-template <size_t buffer_size, size_t idx = 0>
+// Bytes is anything indexable that can be offset with +, like a pointer or a RingBufferView.
+template <size_t buffer_size, size_t idx = 0, typename Bytes = uint8_t const *>
 requires (idx <= buffer_size)
 class Unpack
 {
 public:
-    inline Unpack(uint8_t const * const buffer, Endianness const & endianness):
+    inline Unpack(Bytes const buffer, Endianness const & endianness):
         _buffer(buffer), _endianness(endianness.value()) {}
-    inline Unpack(uint8_t const * const buffer, Endian endianness):
+    inline Unpack(Bytes const buffer, Endian endianness):
         _buffer(buffer), _endianness(endianness) {}
 
     void constexpr finalize()
@@ -205,17 +220,23 @@ public:
         {
             value = from_big_endian<T>(_buffer + idx);
         }
-        return Unpack<buffer_size, idx + sizeof(T)>(_buffer, _endianness);
+        return Unpack<buffer_size, idx + sizeof(T), Bytes>(_buffer, _endianness);
     }
 
     template <typename T>
     requires std::derived_from<T, Endianness>
     inline auto operator>>(T const & endianness)
     {
-        return Unpack<buffer_size, idx>(_buffer, endianness.value());
+        return Unpack<buffer_size, idx, Bytes>(_buffer, endianness.value());
+    }
+
+    template <size_t n>
+    inline auto operator>>(Skip<n>)
+    {
+        return Unpack<buffer_size, idx + n, Bytes>(_buffer, _endianness);
     }
 
 private:
-    uint8_t const * const _buffer;
+    Bytes const _buffer;
     Endian _endianness;
 };
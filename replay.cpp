@@ -0,0 +1,124 @@
+// Plays a capture of the GPS UART back through GpsUBlox on a host, built by replay.sh.
+//
+// Turn on capture_gps_uart in gps_clock.cpp, save what comes out over USB, and run:
+//
+//   ./bin_host/replay capture.txt
+//   ./bin_host/replay capture.txt.gz
+//   ./bin_host/replay - < capture.txt
+//
+// Lines that aren't part of the capture are skipped, so the whole USB log can be given.
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "CaptureReplay.h"
+
+// The file at path, through gzip -dc. The file is gzip's standard input, so its name never
+// goes near a shell, nor an argument gzip might take for an option.
+static FILE * open_gunzipped(std::string const & path, pid_t & pid)
+{
+    int const fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+    pid = fork();
+    if (pid == 0)
+    {
+        dup2(fd, STDIN_FILENO);
+        dup2(pipe_fds[1], STDOUT_FILENO);
+        close(fd);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        execlp("gzip", "gzip", "-dc", static_cast<char *>(nullptr));
+        _exit(127);
+    }
+    close(fd);
+    close(pipe_fds[1]);
+    if (pid < 0)
+    {
+        close(pipe_fds[0]);
+        return nullptr;
+    }
+    return fdopen(pipe_fds[0], "r");
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s CAPTURE | CAPTURE.gz | -\n", argv[0]);
+        return 1;
+    }
+
+    std::string const path = argv[1];
+    bool const gzipped = path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0;
+    FILE * file;
+    pid_t gzip_pid = -1;
+    if (path == "-")
+    {
+        file = stdin;
+    }
+    else if (gzipped)
+    {
+        file = open_gunzipped(path, gzip_pid);
+    }
+    else
+    {
+        file = fopen(path.c_str(), "r");
+    }
+    if (!file)
+    {
+        fprintf(stderr, "Can't open %s\n", path.c_str());
+        return 1;
+    }
+
+    CaptureReplay replay([](uint32_t edge, TopOfSecond const & top) {
+        printf("edge %" PRIu32 "  ", edge);
+        top.show();
+    });
+
+    uint64_t capture_lines = 0;
+    uint64_t other_lines = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        if (replay.line(line))
+        {
+            ++capture_lines;
+        }
+        else
+        {
+            ++other_lines;
+        }
+    }
+
+    if (file != stdin)
+    {
+        fclose(file);
+    }
+    if (gzip_pid > 0)
+    {
+        waitpid(gzip_pid, nullptr, 0);
+    }
+
+    printf("%llu capture lines, %llu others, %" PRIu32 " edges, %llu bytes\n",
+           (unsigned long long)capture_lines,
+           (unsigned long long)other_lines,
+           replay.edges(),
+           (unsigned long long)replay.bytes());
+    replay.gps().show_status();
+    return 0;
+}
@@ -0,0 +1,19 @@
+#!/bin/bash
+
+set -e
+
+mkdir -p bin_host
+g++ -std=c++20 -O2 -Wall -Wextra -Werror -DHOST_BUILD=1 -o bin_host/replay \
+    replay.cpp \
+    Capture.cpp \
+    CaptureReplay.cpp \
+    GpsUBlox.cpp \
+    SurveyIn.cpp \
+    UbxParser.cpp \
+    UbxMessages.cpp \
+    UbxConfigurator.cpp \
+    UbxBaudNegotiator.cpp \
+    packing.cpp \
+    time.cpp \
+    util.cpp \
+    gen/iana_time_zones.cpp
@@ -0,0 +1,66 @@
+// Runs the clock against a simulated receiver for a long time, built by simulate.sh.
+//
+//   ./bin_host/simulate [DAYS]
+//
+// A year by default, through the leap second at the end of 2016, losing the fix every so often,
+// with a few damaged bytes and NAKed configuration messages. Prints what it saw, and fails if
+// the clock ever showed the wrong time.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+#include "ClockSimulation.h"
+
+int main(int argc, char ** argv)
+{
+    uint64_t const days = argc > 1 ? strtoull(argv[1], nullptr, 10) : 365;
+    if (argc > 2 || days == 0)
+    {
+        fprintf(stderr, "Usage: %s [DAYS]\n", argv[0]);
+        return 1;
+    }
+
+    UbxScenario scenario;
+    scenario.start_utc = Ymdhms(2016, 6, 1, 0, 0, 0);
+    scenario.leap_seconds.push_back({Ymdhms(2016, 12, 31, 0, 0, 0), 1});
+    for (uint64_t day = 3; day < days; day += 9)
+    {
+        uint64_t const start = day * secs_per_day + 7 * secs_per_hour;
+        scenario.outages.push_back({start, start + 20 * secs_per_min});
+    }
+    scenario.corrupt_one_in = 100000;
+    scenario.nak_one_in = 4;
+
+    ClockSimulation sim(scenario);
+    uint64_t wrong_before = 0;
+    sim.on_edge = [&](UbxSimulator::Edge const & edge, TopOfSecond const & top, bool) {
+        if (sim.stats().wrong_edges != wrong_before)
+        {
+            wrong_before = sim.stats().wrong_edges;
+            printf("Wrong at second %" PRIu64 ": ", edge.second);
+            top.show();
+        }
+    };
+
+    auto const start = std::chrono::steady_clock::now();
+    for (uint64_t day = 0; day < days; ++day)
+    {
+        sim.run(secs_per_day);
+    }
+    double const elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ClockSimulation::Stats const & stats = sim.stats();
+    printf("%" PRIu64 " days in %.1f s\n", days, elapsed_s);
+    printf("Edges:                %12" PRIu64 "\n", stats.edges);
+    printf("Locked:               %12" PRIu64 "\n", stats.locked_edges);
+    printf("Valid:                %12" PRIu64 "\n", stats.valid_edges);
+    printf("Wrong:                %12" PRIu64 "\n", stats.wrong_edges);
+    printf("Leap seconds shown:   %12" PRIu64 " of %" PRIu32 "\n", stats.leap_seconds_shown, sim.receiver().leap_seconds_passed());
+    printf("First valid second:   %12" PRIu64 "\n", stats.first_valid_second);
+    printf("Bytes damaged:        %12" PRIu64 "\n", sim.receiver().bytes_corrupted());
+    printf("NAKs:                 %12" PRIu32 "\n", sim.receiver().naks_sent());
+    sim.gps().show_status();
+    return stats.wrong_edges == 0 ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+#!/bin/bash
+
+set -e
+
+mkdir -p bin_host
+g++ -std=c++20 -O2 -Wall -Wextra -Werror -DHOST_BUILD=1 -o bin_host/simulate \
+    simulate.cpp \
+    ClockSimulation.cpp \
+    UbxSimulator.cpp \
+    GpsUBlox.cpp \
+    SurveyIn.cpp \
+    AllanDeviation.cpp \
+    LatencyHistogram.cpp \
+    ThermalModel.cpp \
+    PpsCapture.cpp \
+    PpsHistory.cpp \
+    Pps.cpp \
+    Display.cpp \
+    Ht16k33Simulator.cpp \
+    UbxParser.cpp \
+    UbxMessages.cpp \
+    UbxConfigurator.cpp \
+    UbxBaudNegotiator.cpp \
+    packing.cpp \
+    time.cpp \
+    util.cpp
+./bin_host/simulate "$@"
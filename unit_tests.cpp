@@ -3,7 +3,37 @@
 #include "time.h"
 #include "packing.h"
 #include "RingBuffer.h"
+#include "SpscRingBuffer.h"
+#include "UbxParser.h"
+#include "UbxMessages.h"
+#include "UbxConfigurator.h"
+#include "UbxBaudNegotiator.h"
+#include "Capture.h"
+#include "SurveyIn.h"
+#include "GpsUBlox.h"
+#ifdef HOST_BUILD
+  #include "CaptureReplay.h"
+  #include "UbxSimulator.h"
+  #include "ClockSimulation.h"
+  #include "HoldoverSimulation.h"
+  #include "PpsSimulator.h"
+  #include "Display.h"
+#endif
+#include "Console.h"
 #include "Analog.h"
+#include "TimeReport.h"
+#include "Nmea.h"
+#include "IrigB.h"
+#include "TimeCode.h"
+#include "WwvbPhase.h"
+#include "Wwvb.h"
+#include "WwvbDecoder.h"
+#include "AllanDeviation.h"
+#include "LatencyHistogram.h"
+#include "ThermalModel.h"
+#include "PpsCapture.h"
+#include "PpsHistory.h"
+#include "Pps.h"
 
 bool unit_tests()
 {
@@ -11,7 +41,40 @@ bool unit_tests()
     test_assert(time_test());
     test_assert(packing_test());
     test_assert(ring_buffer_test());
+    test_assert(spsc_ring_buffer_test());
+    test_assert(ubx_parser_test());
+    test_assert(ubx_messages_test());
+    test_assert(ubx_configurator_test());
+    test_assert(ubx_baud_negotiator_test());
+    test_assert(capture_test());
+    test_assert(survey_in_test());
+#ifdef HOST_BUILD
+    // GpsUBlox is too big for the stack on the device, and replay only runs on a host anyway.
+    test_assert(gps_ublox_test());
+    test_assert(capture_replay_test());
+#endif
+    test_assert(console_test());
     test_assert(Analog::unit_test());
+    test_assert(time_report_test());
+    test_assert(nmea_test());
+    test_assert(irig_b_test());
+    test_assert(time_code_test());
+    test_assert(wwvb_phase_test());
+    test_assert(Wwvb::unit_test());
+    test_assert(wwvb_decoder_test());
+    test_assert(allan_deviation_test());
+    test_assert(latency_histogram_test());
+    test_assert(thermal_model_test());
+    test_assert(PpsCapture::unit_test());
+    test_assert(pps_history_test());
+    test_assert(Pps::unit_test());
+#ifdef HOST_BUILD
+    test_assert(ubx_simulator_test());
+    test_assert(clock_simulation_test());
+    test_assert(holdover_simulation_test());
+    test_assert(pps_simulator_test());
+    test_assert(Display::unit_test());
+#endif
 
     return true;
 }
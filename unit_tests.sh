@@ -10,7 +10,35 @@ g++ -std=c++20 -Wall -Wextra -Werror -DHOST_BUILD=1 -o bin_test/unit_tests \
     util.cpp \
     packing.cpp \
     RingBuffer.cpp \
+    SpscRingBuffer.cpp \
+    UbxParser.cpp \
+    UbxMessages.cpp \
+    UbxConfigurator.cpp \
+    UbxBaudNegotiator.cpp \
+    Capture.cpp \
+    CaptureReplay.cpp \
+    GpsUBlox.cpp \
+    SurveyIn.cpp \
     Analog.cpp \
+    TimeCode.cpp \
+    WwvbPhase.cpp \
+    WwvbDecoder.cpp \
+    Wwvb.cpp \
+    TimeReport.cpp \
+    Nmea.cpp \
+    IrigB.cpp \
+    Console.cpp \
     gen/iana_time_zones.cpp \
-    Pps.cpp
+    AllanDeviation.cpp \
+    LatencyHistogram.cpp \
+    ThermalModel.cpp \
+    PpsCapture.cpp \
+    PpsHistory.cpp \
+    Pps.cpp \
+    UbxSimulator.cpp \
+    ClockSimulation.cpp \
+    HoldoverSimulation.cpp \
+    PpsSimulator.cpp \
+    Display.cpp \
+    Ht16k33Simulator.cpp
 ./bin_test/unit_tests
@@ -50,10 +50,23 @@ bool nwraps_test()
     return true;
 }
 
+bool fnv1a_test()
+{
+    uint8_t const empty[1] = {};
+    uint8_t const a[] = {'a'};
+    uint8_t const foobar[] = {'f', 'o', 'o', 'b', 'a', 'r'};
+    test_assert_unsigned_eq(fnv1a(empty, 0), 0x811c9dc5u);
+    test_assert_unsigned_eq(fnv1a(a, sizeof(a)), 0xe40c292cu);
+    test_assert_unsigned_eq(fnv1a(foobar, sizeof(foobar)), 0xbf9cf968u);
+
+    return true;
+}
+
 bool util_test()
 {
     test_assert(mod_test());
     test_assert(nwraps_test());
+    test_assert(fnv1a_test());
 
     return true;
 }
@@ -82,3 +82,14 @@ inline WidthMatch<U>::s signed_difference(U a, U b)
         return static_cast<S>(b - a) * -1;
     }
 }
+
+// FNV-1a, to tell a record kept in flash from whatever else might be there.
+inline uint32_t fnv1a(uint8_t const * const data, size_t const len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i)
+    {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}